@@ -101,7 +101,9 @@ int BTConnection::connect()
     // otherwise
     int retryCount = 3;
     do {
-        iFd = open( iDevice.toLatin1().constData(), O_RDWR | O_NOCTTY | O_SYNC );
+        // Not O_SYNC: OBEX writes whole packets, which the tty may buffer.
+        // Pending output is drained when the connection is closed
+        iFd = open( iDevice.toLatin1().constData(), O_RDWR | O_NOCTTY );
         if (iFd > 0) break;
         QThread::msleep (100); // Sleep for 100msec before trying again
     } while ((--retryCount > 0) && (iFd == -1));
@@ -135,6 +137,7 @@ void BTConnection::disconnect()
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     if( iFd != -1 ) {
+        tcdrain( iFd );
         close( iFd );
         iFd = -1;
     }
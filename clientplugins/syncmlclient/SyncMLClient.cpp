@@ -32,17 +32,14 @@
 #include <buteosyncml5/SyncAgentConfigProperties.h>
 #include <buteosyncml5/HTTPTransport.h>
 #include <buteosyncml5/OBEXTransport.h>
-#include <buteosyncml5/DeviceInfo.h>
 #include "SyncMLPluginLogging.h"
 #include <buteosyncfw5/ProfileEngineDefs.h>
 
 #include <Accounts/Account>
-#include "SyncMLConfig.h"
 #include "SyncMLCommon.h"
-#include "DeviceInfo.h"
+#include "SyncAgentConfigCache.h"
+#include "SyncMLConfig.h"
 
-const QString DEFAULTCONFIGFILE("/etc/buteo/meego-syncml-conf.xml");
-const QString EXTCONFIGFILE("/etc/buteo/ext-syncml-conf.xml");
 
 
 Buteo::ClientPlugin* SyncMLClientLoader::createClientPlugin(
@@ -397,6 +394,8 @@ bool SyncMLClient::initTransport() {
 		success = initHttpTransport();
 	} else if (transportType == OBEX_TRANSPORT) {
 		success = initObexTransport();
+	} else if (transportType == OBEX_TCP_TRANSPORT) {
+		success = initObexTcpTransport();
 	} else {
 		qCDebug(lcSyncMLPlugin) << "Unknown transport type:" << transportType;
 	}
@@ -436,50 +435,26 @@ bool SyncMLClient::initConfig() {
 		return false;
 	}
 
-	iConfig = new DataSync::SyncAgentConfig;
-
     // ** Read configuration
 
-    // Two configuration files are being read: first the Meego default config file,
-    // and then possible external config file, which can be used to add additional
-    // configuration, or replace some of the configuration of Meego default config.
-
-    // Default configuration file should always exist
-    if( !iConfig->fromFile( DEFAULTCONFIGFILE ) )
+    // The Meego default config file, possibly extended by the external config
+    // file, and the device info are parsed once per process and copied from
+    // there as long as the files do not change.
+    iConfig = SyncAgentConfigCache::createConfig();
+    if( !iConfig )
     {
-        qCCritical(lcSyncMLPlugin) << "Could not read default SyncML configuration file:" << DEFAULTCONFIGFILE;
         return false;
     }
 
-    if( iConfig->fromFile( EXTCONFIGFILE ) )
-    {
-        qCDebug(lcSyncMLPlugin) << "Found & read external configuration file:" << EXTCONFIGFILE;
-    }
-    else
-    {
-        qCDebug(lcSyncMLPlugin) << "Could not find external configuration file" << EXTCONFIGFILE <<", skipping";
-    }
-
 	// ** Set up storage provider
 
+	// The agent fixes the message size for the session, so it is sized from
+	// what earlier syncs measured over the same link
+	qint64 messageSize = iStorageProvider.setLink(linkId(),
+			iConfig->getAgentProperty(DataSync::MAXMESSAGESIZEPROP).toLongLong());
+	iConfig->setAgentProperty(DataSync::MAXMESSAGESIZEPROP, QString::number(messageSize));
 	iConfig->setStorageProvider(&iStorageProvider);
 
-	// ** Set up device info
-
-	QString DEV_INFO_FILE_PATH = SyncMLConfig::getDevInfoFile();
-	QFile devInfoFile(DEV_INFO_FILE_PATH);
-
-	if (!devInfoFile.exists()) {
-		Buteo::DeviceInfo appDevInfo;
-		QMap < QString, QString > deviceInfoMap
-				= appDevInfo.getDeviceInformation();
-		appDevInfo.saveDevInfoToFile(deviceInfoMap, DEV_INFO_FILE_PATH);
-	}
-
-	DataSync::DeviceInfo syncDeviceInfo;
-	syncDeviceInfo.readFromFile(DEV_INFO_FILE_PATH);
-	iConfig->setDeviceInfo(syncDeviceInfo);
-
 	// ** Set up sync targets
 
 	for (int i = 0; i < storageNames.count(); ++i) {
@@ -507,7 +482,7 @@ bool SyncMLClient::initConfig() {
 	if (transportType == HTTP_TRANSPORT) {
 		// Ovi.com requires remote device name to be the sync URI
 		remoteDeviceName = iProperties[PROF_REMOTE_URI];
-	} else if (transportType == OBEX_TRANSPORT) {
+	} else if (transportType == OBEX_TRANSPORT || transportType == OBEX_TCP_TRANSPORT) {
 		// Over OBEX, set remote device to it's address as designated in profile
 		remoteDeviceName = iProperties[PROF_REMOTE_ADDRESS];
 		if (remoteDeviceName.isEmpty()) {
@@ -535,7 +510,7 @@ bool SyncMLClient::initConfig() {
 
 	if (transportType == HTTP_TRANSPORT) {
 		initiator = DataSync::INIT_CLIENT;
-	} else if (transportType == OBEX_TRANSPORT) {
+	} else if (transportType == OBEX_TRANSPORT || transportType == OBEX_TCP_TRANSPORT) {
 		initiator = DataSync::INIT_SERVER;
 	}
 
@@ -547,6 +522,15 @@ bool SyncMLClient::initConfig() {
 		syncMode.toSlowSync();
 	}
 
+	// Let storages know what the session needs from them
+	QString storageDirection = STORAGE_SYNC_DIRECTION_TWO_WAY;
+	if (iProfile.syncDirection() == Buteo::SyncProfile::SYNC_DIRECTION_FROM_REMOTE) {
+		storageDirection = STORAGE_SYNC_DIRECTION_FROM_REMOTE;
+	} else if (iProfile.syncDirection() == Buteo::SyncProfile::SYNC_DIRECTION_TO_REMOTE) {
+		storageDirection = STORAGE_SYNC_DIRECTION_TO_REMOTE;
+	}
+	iStorageProvider.setSyncMode(storageDirection, forceSlowSync);
+
 	iConfig->setSyncParams(remoteDeviceName, version, syncMode);
 
 	// ** Set up auth parameters
@@ -559,7 +543,7 @@ bool SyncMLClient::initConfig() {
 		type = DataSync::AUTH_BASIC;
 		username = iProperties[PROF_USERID];
 		password = iProperties[PROF_PASSWD];
-	} else if (transportType == OBEX_TRANSPORT) {
+	} else if (transportType == OBEX_TRANSPORT || transportType == OBEX_TCP_TRANSPORT) {
 		type = DataSync::AUTH_NONE;
 	}
 
@@ -575,12 +559,32 @@ bool SyncMLClient::initConfig() {
 	if (transportType == HTTP_TRANSPORT) {
 		// Make sure that S60 EMI tags are not sent over HTTP.
 		iConfig->clearExtension(DataSync::EMITAGSEXTENSION);
+	} else if (transportType == OBEX_TRANSPORT) {
+		iConfig->setAgentProperty(DataSync::BTOBEXMTUPROP, QString::number(
+				SyncMLConfig::getObexMtu(iProperties[PROF_BT_OBEX_MTU], DEFAULT_BT_OBEX_MTU)));
+	} else if (transportType == OBEX_TCP_TRANSPORT) {
+		// TCP uses the USB type hint, so its size goes to the USB property
+		iConfig->setAgentProperty(DataSync::USBOBEXMTUPROP, QString::number(
+				SyncMLConfig::getObexMtu(iProperties[PROF_TCP_OBEX_MTU], DEFAULT_TCP_OBEX_MTU)));
 	}
 
 	return true;
 
 }
 
+QString SyncMLClient::linkId() const {
+
+	QString transportType = iProperties[PROF_SYNC_TRANSPORT];
+
+	if (transportType == OBEX_TRANSPORT) {
+		return "bt:" + iProperties[PROF_BT_ADDRESS];
+	} else if (transportType == OBEX_TCP_TRANSPORT) {
+		return "tcp:" + iProperties[PROF_TCP_ADDRESS];
+	} else {
+		return "http:" + QUrl(iProperties[PROF_REMOTE_URI]).host();
+	}
+}
+
 void SyncMLClient::closeConfig() {
 
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -734,6 +738,52 @@ bool SyncMLClient::initObexTransport()
 
 }
 
+bool SyncMLClient::initObexTcpTransport()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "Creating OBEX over TCP transport";
+
+    QString host = iProperties[PROF_TCP_ADDRESS];
+
+    if( host.isEmpty() )
+    {
+        qCCritical(lcSyncMLPlugin) << "Could not find mandatory property:" << PROF_TCP_ADDRESS;
+        return false;
+    }
+
+    quint16 port = iProperties[PROF_TCP_PORT].toUShort();
+
+    if( port == 0 )
+    {
+        qCCritical(lcSyncMLPlugin) << "Could not find mandatory property:" << PROF_TCP_PORT;
+        return false;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Using TCP address:" << host << "port:" << port;
+
+    iTCPConnection.setConnectionInfo( host, port );
+
+    // There is no type hint for TCP, it is a reliable stream like the USB
+    // gadget and gets the same OBEX setup
+    DataSync::OBEXTransport* transport = new DataSync::OBEXTransport( iTCPConnection,
+                                                                      DataSync::OBEXTransport::MODE_OBEX_CLIENT,
+                                                                      DataSync::OBEXTransport::TYPEHINT_USB );
+
+    if (iProperties[PROF_USE_WBXML] == PROPS_TRUE) {
+        qCDebug(lcSyncMLPlugin) << "Using wbXML";
+        transport->setWbXml(true);
+    } else {
+        qCDebug(lcSyncMLPlugin) << "Not using wbXML";
+        transport->setWbXml(false);
+    }
+
+    iTransport = transport;
+
+    return true;
+
+}
+
 bool SyncMLClient::initHttpTransport() {
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
@@ -25,6 +25,7 @@
 #define SYNCMLCLIENT_H
 
 #include "BTConnection.h"
+#include "TCPClientConnection.h"
 #include "SyncMLStorageProvider.h"
 #include <ClientPlugin.h>
 #include <SyncPluginLoader.h>
@@ -159,12 +160,24 @@ private:
      */
     bool initObexTransport();
 
+    /**
+     * \brief Subroutine for obex over tcp transport initiation
+     * @return True is success, false if not
+     */
+    bool initObexTcpTransport();
+
     /**
      * \brief Subroutine for http transport initiation
      * @return True is success, false if not
      */
     bool initHttpTransport();
 
+    /*! \brief Identifies the link to the remote party for sizing messages
+     *
+     * @return Transport and address of the remote party
+     */
+    QString linkId() const;
+
     /*! \brief Resolves sync direction from current profile
      *
      * @param aInitiator Initiator of the sync
@@ -204,6 +217,7 @@ private:
     DataSync::SyncAgent*        iAgent;
 
     BTConnection                iBTConnection;
+    TCPClientConnection         iTCPConnection;
     DataSync::Transport*        iTransport;
 
     DataSync::SyncAgentConfig*  iConfig;
@@ -0,0 +1,115 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#include "TCPClientConnection.h"
+
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+
+#include "SyncMLPluginLogging.h"
+
+TCPClientConnection::TCPClientConnection()
+ : iPort( 0 ), iFd( -1 )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+TCPClientConnection::~TCPClientConnection()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+    disconnect();
+}
+
+void TCPClientConnection::setConnectionInfo( const QString& aHost, quint16 aPort )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+    iHost = aHost;
+    iPort = aPort;
+}
+
+int TCPClientConnection::connect()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iFd != -1 ) {
+        qCDebug(lcSyncMLPlugin) << "Using existing connection";
+        return iFd;
+    }
+
+    struct addrinfo hints;
+    memset( &hints, 0, sizeof( hints ) );
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    struct addrinfo* addresses = NULL;
+    QByteArray port = QByteArray::number( iPort );
+    int error = getaddrinfo( iHost.toLatin1().constData(), port.constData(), &hints, &addresses );
+
+    if( error != 0 ) {
+        qCCritical(lcSyncMLPlugin) << "Could not resolve" << iHost << ":" << gai_strerror( error );
+        return -1;
+    }
+
+    for( struct addrinfo* address = addresses; address != NULL; address = address->ai_next ) {
+        iFd = socket( address->ai_family, address->ai_socktype, address->ai_protocol );
+        if( iFd == -1 ) {
+            continue;
+        }
+
+        if( ::connect( iFd, address->ai_addr, address->ai_addrlen ) == 0 ) {
+            break;
+        }
+
+        close( iFd );
+        iFd = -1;
+    }
+
+    freeaddrinfo( addresses );
+
+    if( iFd == -1 ) {
+        qCCritical(lcSyncMLPlugin) << "Could not connect to" << iHost << "port" << iPort << ", aborting";
+        return -1;
+    }
+
+    // OBEX is request-response, don't let small packets wait for a full
+    // segment
+    int noDelay = 1;
+    setsockopt( iFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof( noDelay ) );
+
+    return iFd;
+}
+
+bool TCPClientConnection::isConnected() const
+{
+    return ( iFd != -1 );
+}
+
+void TCPClientConnection::disconnect()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iFd != -1 ) {
+        close( iFd );
+        iFd = -1;
+    }
+}
@@ -0,0 +1,72 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+#ifndef TCPCLIENTCONNECTION_H
+#define TCPCLIENTCONNECTION_H
+
+#include <QString>
+
+#include <buteosyncml5/OBEXConnection.h>
+
+/*! \brief Class for creating an OBEX connection to another device over
+ *         TCP/IP for libmeegosyncml
+ *
+ */
+class TCPClientConnection : public DataSync::OBEXConnection
+{
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    TCPClientConnection();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~TCPClientConnection();
+
+    /*! \brief Sets connection info
+     *
+     * @param aHost Host name or address of remote device
+     * @param aPort TCP port the remote device listens on
+     */
+    void setConnectionInfo( const QString& aHost, quint16 aPort );
+
+    /*! \sa DataSync::OBEXConnection::connect()
+     *
+     */
+    virtual int connect();
+
+    /*! \sa DataSync::OBEXConnection::isConnected()
+     *
+     */
+    virtual bool isConnected() const;
+
+    /*! \sa DataSync::OBEXConnection::disconnect()
+     *
+     */
+    virtual void disconnect();
+
+private:
+    QString         iHost;
+    quint16         iPort;
+    int             iFd;
+
+};
+
+#endif // TCPCLIENTCONNECTION_H
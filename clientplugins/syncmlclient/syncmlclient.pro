@@ -15,8 +15,8 @@ VER_MIN = 0
 VER_PAT = 0
 
 #DEFINES += BUTEO_ENABLE_DEBUG
-HEADERS += SyncMLClient.h BTConnection.h
-SOURCES += SyncMLClient.cpp BTConnection.cpp
+HEADERS += SyncMLClient.h BTConnection.h TCPClientConnection.h
+SOURCES += SyncMLClient.cpp BTConnection.cpp TCPClientConnection.cpp
 
 TEMPLATE = lib
 CONFIG += plugin
@@ -61,8 +61,7 @@ btAddrInHex (const btbdaddr_t* ba, char* str)
 BTConnection::BTConnection() :
     mServerFd (-1), mClientFd (-1), mPeerSocket (-1), mMutex (QMutex::Recursive),
     mDisconnected (true), mClientServiceRecordId (-1), mServerServiceRecordId (-1),
-    mServerReadNotifier (0), mServerWriteNotifier (0), mServerExceptionNotifier (0),
-    mClientReadNotifier (0), mClientWriteNotifier (0), mClientExceptionNotifier (0),
+    mServerReadNotifier (0), mClientReadNotifier (0),
     mServerFdWatching (false), mClientFdWatching (false)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -78,35 +77,11 @@ BTConnection::~BTConnection ()
         mServerReadNotifier = 0;
     }
 
-    if (mServerWriteNotifier)
-    {
-        delete mServerWriteNotifier;
-        mServerWriteNotifier = 0;
-    }
-    
-    if (mServerExceptionNotifier)
-    {
-        delete mServerExceptionNotifier;
-        mServerExceptionNotifier = 0;
-    }
-
     if (mClientReadNotifier)
     {
         delete mClientReadNotifier;
         mClientReadNotifier = 0;
     }
-
-    if (mClientWriteNotifier)
-    {
-        delete mClientWriteNotifier;
-        mClientWriteNotifier = 0;
-    }
-    
-    if (mClientExceptionNotifier)
-    {
-        delete mClientExceptionNotifier;
-        mClientExceptionNotifier = 0;
-    }
 }
 
 int
@@ -152,8 +127,8 @@ BTConnection::handleSyncFinished (bool isSyncInError)
         removeFdListener (BT_CLIENT_CHANNEL);
         closeBTSocket (mServerFd);
         closeBTSocket (mClientFd);
-        openBTSocket (BT_SERVER_CHANNEL);
-        openBTSocket (BT_CLIENT_CHANNEL);
+        mServerFd = openBTSocket (BT_SERVER_CHANNEL);
+        mClientFd = openBTSocket (BT_CLIENT_CHANNEL);
 
         addFdListener (BT_SERVER_CHANNEL, mServerFd);
         addFdListener (BT_CLIENT_CHANNEL, mClientFd);
@@ -237,6 +212,32 @@ BTConnection::closeBTSocket (int& fd)
     }
 }
 
+QSocketNotifier*
+BTConnection::armNotifier (QSocketNotifier *notifier, int fd)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // The socket may have been reopened since the notifier was created
+    if (notifier && notifier->socket () != fd)
+    {
+        notifier->deleteLater ();
+        notifier = 0;
+    }
+
+    // A listening socket only becomes readable when a peer is waiting to be
+    // accepted, and errors are reported as readable too. There is nothing
+    // to write on it, so it is not watched for that
+    if (!notifier)
+    {
+        notifier = new QSocketNotifier (fd, QSocketNotifier::Read, this);
+        QObject::connect (notifier, SIGNAL (activated (int)),
+                          this, SLOT (handleIncomingBTConnection (int)));
+    }
+
+    notifier->setEnabled (true);
+    return notifier;
+}
+
 void
 BTConnection::addFdListener (const int channelNumber, int fd)
 {
@@ -244,20 +245,7 @@ BTConnection::addFdListener (const int channelNumber, int fd)
     
     if ((channelNumber == BT_SERVER_CHANNEL) && (mServerFdWatching == false) && (fd != -1))
     {
-        mServerReadNotifier = new QSocketNotifier (fd, QSocketNotifier::Read);
-    	mServerWriteNotifier = new QSocketNotifier (fd, QSocketNotifier::Write);
-    	mServerExceptionNotifier = new QSocketNotifier (fd, QSocketNotifier::Exception);
-    
-    	mServerReadNotifier->setEnabled (true);
-    	mServerWriteNotifier->setEnabled (true);
-    	mServerExceptionNotifier->setEnabled (true);
-    
-    	QObject::connect (mServerReadNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::connect (mServerWriteNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::connect (mServerExceptionNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleBTError (int)));
+        mServerReadNotifier = armNotifier (mServerReadNotifier, fd);
 
         qCDebug(lcSyncMLPlugin) << "Added listener for server socket " << fd;
         mServerFdWatching = true;
@@ -265,20 +253,7 @@ BTConnection::addFdListener (const int channelNumber, int fd)
 
     if ((channelNumber == BT_CLIENT_CHANNEL) && (mClientFdWatching == false) && (fd != -1))
     {
-    	mClientReadNotifier = new QSocketNotifier (fd, QSocketNotifier::Read);
-    	mClientWriteNotifier = new QSocketNotifier (fd, QSocketNotifier::Write);
-    	mClientExceptionNotifier = new QSocketNotifier (fd, QSocketNotifier::Exception);
-    
-    	mClientReadNotifier->setEnabled (true);
-    	mClientWriteNotifier->setEnabled (true);
-    	mClientExceptionNotifier->setEnabled (true);
-    
-    	QObject::connect (mClientReadNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::connect (mClientWriteNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::connect (mClientExceptionNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleBTError (int)));
+        mClientReadNotifier = armNotifier (mClientReadNotifier, fd);
 
         qCDebug(lcSyncMLPlugin) << "Added listener for client socket " << fd;
         mClientFdWatching = true;
@@ -293,30 +268,14 @@ BTConnection::removeFdListener (const int channelNumber)
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
     if (channelNumber == BT_SERVER_CHANNEL)
     {
-        mServerReadNotifier->setEnabled (false);
-    	mServerWriteNotifier->setEnabled (false);
-    	mServerExceptionNotifier->setEnabled (false);
-    
-    	QObject::disconnect (mServerReadNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::disconnect (mServerWriteNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::disconnect (mServerExceptionNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleBTError (int)));
+        if (mServerReadNotifier)
+            mServerReadNotifier->setEnabled (false);
         
         mServerFdWatching = false;
     } else if (channelNumber == BT_CLIENT_CHANNEL)
     {
-        mClientReadNotifier->setEnabled (false);
-    	mClientWriteNotifier->setEnabled (false);
-    	mClientExceptionNotifier->setEnabled (false);
-
-    	QObject::disconnect (mClientReadNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::disconnect (mClientWriteNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleIncomingBTConnection (int)));
-    	QObject::disconnect (mClientExceptionNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleBTError (int)));
+        if (mClientReadNotifier)
+            mClientReadNotifier->setEnabled (false);
         
         mClientFdWatching = false;
     }
@@ -336,6 +295,14 @@ BTConnection::handleIncomingBTConnection (int fd)
     if (mPeerSocket < 0)
     {
         qCDebug(lcSyncMLPlugin) << "Error in accept:" << strerror (errno);
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR)
+        {
+            // The peer went away before we got to it, keep listening
+            return;
+        }
+
+        handleBTError (fd);
+        return;
     } else
     {
         char buf[128] = { 0 };
@@ -361,21 +328,18 @@ BTConnection::handleBTError (int fd)
     
     // FIXME: Ugly API for fd listeners. Add a more decent way
     if (fd == mServerFd)
+    {
         removeFdListener (BT_SERVER_CHANNEL);
-    else if (fd == mClientFd)
+        closeBTSocket (mServerFd);
+        mServerFd = openBTSocket (BT_SERVER_CHANNEL);
+        addFdListener (BT_SERVER_CHANNEL, mServerFd);
+    } else if (fd == mClientFd)
+    {
         removeFdListener (BT_CLIENT_CHANNEL);
-
-    closeBTSocket (fd);
-
-    if (fd == mServerFd)
-        openBTSocket (BT_SERVER_CHANNEL);
-    else if (fd == mClientFd)
-        openBTSocket (BT_CLIENT_CHANNEL);
-
-    if (fd == mServerFd)
-        addFdListener (BT_SERVER_CHANNEL, fd);
-    else if (fd == mClientFd)
-        addFdListener (BT_CLIENT_CHANNEL, fd);
+        closeBTSocket (mClientFd);
+        mClientFd = openBTSocket (BT_CLIENT_CHANNEL);
+        addFdListener (BT_CLIENT_CHANNEL, mClientFd);
+    }
 }
 
 bool
@@ -94,6 +94,11 @@ private:
      */
     void addFdListener (const int channelNumber, int fd);
 
+    /**
+     * ! \brief Arms a read notifier for fd, replacing one for an old socket
+     */
+    QSocketNotifier* armNotifier (QSocketNotifier *notifier, int fd);
+
     /**
      * ! \brief Removes fd listening
      */
@@ -136,16 +141,8 @@ private:
     
     QSocketNotifier         *mServerReadNotifier;
     
-    QSocketNotifier         *mServerWriteNotifier;
-
-    QSocketNotifier         *mServerExceptionNotifier;
-    
     QSocketNotifier         *mClientReadNotifier;
     
-    QSocketNotifier         *mClientWriteNotifier;
-    
-    QSocketNotifier         *mClientExceptionNotifier;
-
     bool                    mServerFdWatching;
 
     bool                    mClientFdWatching;
@@ -20,16 +20,14 @@
 * 02110-1301 USA
 */
 #include "SyncMLServer.h"
+#include "SyncMLServerSession.h"
 #include "SyncMLPluginLogging.h"
+#include "SyncMLCommon.h"
 
 #include <buteosyncfw5/SyncProfile.h>
 #include <buteosyncml5/OBEXTransport.h>
-#include <buteosyncml5/SyncAgentConfig.h>
 #include <buteosyncfw5/PluginCbInterface.h>
 
-#include "SyncMLConfig.h"
-#include "DeviceInfo.h"
-
 Buteo::ServerPlugin* SyncMLServerLoader::createServerPlugin(
         const QString& pluginName,
         const Buteo::Profile& profile,
@@ -42,24 +40,44 @@ Buteo::ServerPlugin* SyncMLServerLoader::createServerPlugin(
 SyncMLServer::SyncMLServer (const QString& pluginName,
                             const Buteo::Profile profile,
                             Buteo::PluginCbInterface *cbInterface) :
-    ServerPlugin (pluginName, profile, cbInterface), mAgent (0), mConfig (0),
-    mTransport (0), mCommittedItems (0), mConnectionType (Sync::CONNECTIVITY_USB),
-    mIsSessionInProgress (false), mBTActive (false), mUSBActive (false)
+    ServerPlugin (pluginName, profile, cbInterface),
+    mBTActive (false), mUSBActive (false), mTCPActive (false)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // One session per connection type, so that USB and BT peers can be
+    // served at the same time
+    QList<Sync::ConnectivityType> types;
+    types << Sync::CONNECTIVITY_USB << Sync::CONNECTIVITY_BT << Sync::CONNECTIVITY_INTERNET;
+
+    foreach (Sync::ConnectivityType type, types)
+    {
+        SyncMLServerSession *session = new SyncMLServerSession (type, this, &iProfile,
+                                                                iCbInterface, &mReservations);
+
+        QObject::connect (session, SIGNAL (finished (DataSync::SyncState)),
+                 this, SLOT (handleSyncFinished (DataSync::SyncState)));
+        QObject::connect (session, SIGNAL (storageAccquired (QString)),
+                 this, SLOT (handleStorageAccquired (QString)));
+        QObject::connect (session, SIGNAL (itemsProcessed (Sync::TransferDatabase, Sync::TransferType, QString, int)),
+                 this, SLOT (handleItemsProcessed (Sync::TransferDatabase, Sync::TransferType, QString, int)));
+
+        mSessions.insert (type, session);
+    }
 }
 
 SyncMLServer::~SyncMLServer ()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    closeSyncAgentConfig ();
-    closeSyncAgent ();
+    qDeleteAll (mSessions);
+    mSessions.clear ();
     if (mUSBActive)
         closeUSBTransport ();
     if (mBTActive)
         closeBTTransport ();
-    delete mTransport;
+    if (mTCPActive)
+        closeTCPTransport ();
 }
 
 bool
@@ -75,13 +93,9 @@ SyncMLServer::uninit ()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    closeSyncAgentConfig ();
-    closeSyncAgent ();
-
-    // uninit() is called after completion of every sync session
-    // Do not invoke close of transports, since in server mode
-    // sync would be initiated from external entities and so
-    // transport has to be open
+    // Each session is ended when it finishes. Do not invoke close of
+    // transports, since in server mode sync would be initiated from
+    // external entities and so transport has to be open
 
     return true;
 }
@@ -96,12 +110,15 @@ SyncMLServer::abortSync (Sync::SyncStatus status)
     if (status == Sync::SYNC_ERROR)
         state = DataSync::CONNECTION_ERROR;
 
-    if (mAgent && mAgent->abort (state))
+    bool aborted = false;
+    foreach (SyncMLServerSession *session, mSessions)
     {
-        qCDebug(lcSyncMLPlugin) << "Signaling SyncML agent abort";
-    } else
+        aborted |= session->abort (state);
+    }
+
+    if (!aborted)
     {
-        handleSyncFinished (DataSync::ABORTED);
+        qCDebug(lcSyncMLPlugin) << "No sync session to abort";
     }
 }
 
@@ -117,7 +134,13 @@ SyncMLServer::cleanUp ()
 Buteo::SyncResults
 SyncMLServer::getSyncResults () const
 {
-    return mResults;
+    // Sessions over different connections can finish close together. The
+    // results are read once for every success or error reported, so every
+    // read gets the session reported next
+    if (!mResults.isEmpty ())
+        mLastResults = mResults.takeFirst ();
+
+    return mLastResults;
 }
 
 bool
@@ -138,11 +161,24 @@ SyncMLServer::startListen ()
         mBTActive = listening |= createBTTransport ();
     }
     
-    if (iCbInterface->isConnectivityAvailable (Sync::CONNECTIVITY_INTERNET))
+    // OBEX over TCP is served when the profile has a port for it. The
+    // listener does not depend on internet connectivity, so that also
+    // loopback and LAN peers are served
+    if (!iProfile.key (PROF_TCP_PORT).isEmpty ())
     {
-        // No sync over IP as of now
+        mTCPActive = createTCPTransport ();
+        listening |= mTCPActive;
     }
 
+    // Do the session setup that does not depend on the peer before anyone
+    // connects
+    if (mUSBActive)
+        mSessions[Sync::CONNECTIVITY_USB]->prepare ();
+    if (mBTActive)
+        mSessions[Sync::CONNECTIVITY_BT]->prepare ();
+    if (mTCPActive)
+        mSessions[Sync::CONNECTIVITY_INTERNET]->prepare ();
+
     return listening;
 }
 
@@ -156,6 +192,14 @@ SyncMLServer::stopListen ()
         closeUSBTransport ();
     if (mBTActive)
         closeBTTransport ();
+    if (mTCPActive)
+        closeTCPTransport ();
+
+    // Nothing is kept warm while not listening
+    foreach (SyncMLServerSession *session, mSessions)
+    {
+        session->release ();
+    }
 }
 
 void
@@ -188,6 +232,8 @@ SyncMLServer::connectivityStateChanged (Sync::ConnectivityType type, bool state)
         {
             qCDebug(lcSyncMLPlugin) << "USB available. Starting sync...";
             mUSBActive = createUSBTransport ();
+            if (mUSBActive)
+                mSessions[Sync::CONNECTIVITY_USB]->prepare ();
         } else {
             qCDebug(lcSyncMLPlugin) << "USB connection not available. Stopping sync...";
             closeUSBTransport ();
@@ -201,6 +247,8 @@ SyncMLServer::connectivityStateChanged (Sync::ConnectivityType type, bool state)
         {
             qCDebug(lcSyncMLPlugin) << "BT connection is available. Creating BT connection...";
             mBTActive = createBTTransport ();
+            if (mBTActive)
+                mSessions[Sync::CONNECTIVITY_BT]->prepare ();
         } else
         {
             qCDebug(lcSyncMLPlugin) << "BT connection unavailable. Closing BT connection...";
@@ -210,84 +258,6 @@ SyncMLServer::connectivityStateChanged (Sync::ConnectivityType type, bool state)
     }
 }
 
-bool
-SyncMLServer::initSyncAgent ()
-{
-    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
-
-    qCDebug(lcSyncMLPlugin) << "Creating SyncML agent...";
-
-    mAgent = new DataSync::SyncAgent ();
-    return true;
-}
-
-void
-SyncMLServer::closeSyncAgent ()
-{
-    delete mAgent;
-    mAgent = 0;
-}
-
-DataSync::SyncAgentConfig*
-SyncMLServer::initSyncAgentConfig ()
-{
-    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
-
-    if (!mTransport || !mStorageProvider.init (&iProfile, this, iCbInterface, true))
-        return 0;
-
-    mConfig = new DataSync::SyncAgentConfig ();
-
-    QString defaultSyncMLConfigFile, extSyncMLConfigFile;
-    SyncMLConfig::syncmlConfigFilePaths (defaultSyncMLConfigFile, extSyncMLConfigFile);
-    if (!mConfig->fromFile (defaultSyncMLConfigFile))
-    {
-        qCCritical(lcSyncMLPlugin) << "Unable to read default SyncML config";
-        delete mConfig;
-        mConfig = 0;
-        return mConfig;
-    }
-
-    if (!mConfig->fromFile (extSyncMLConfigFile))
-    {
-        qCDebug(lcSyncMLPlugin) << "Could not find external configuration file";
-    }
-
-    mConfig->setStorageProvider (&mStorageProvider);
-    mConfig->setTransport (mTransport);
-
-    // Do we need to read the device info from file?
-    QString DEV_INFO_FILE = SyncMLConfig::getDevInfoFile ();
-    QFile devInfoFile (DEV_INFO_FILE);
-
-    if (!devInfoFile.exists ())
-    {
-        Buteo::DeviceInfo devInfo;
-        QMap<QString,QString> deviceInfoMap = devInfo.getDeviceInformation ();
-        devInfo.saveDevInfoToFile (deviceInfoMap, DEV_INFO_FILE);
-    }
-
-    DataSync::DeviceInfo syncDeviceInfo;
-    syncDeviceInfo.readFromFile (DEV_INFO_FILE);
-    mConfig->setDeviceInfo (syncDeviceInfo);
-
-    return mConfig;
-}
-
-void
-SyncMLServer::closeSyncAgentConfig ()
-{
-    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
-
-    qCDebug(lcSyncMLPlugin) << "Closing config...";
-
-    delete mConfig;
-    mConfig = 0;
-
-    if (!mStorageProvider.uninit ())
-        qCCritical(lcSyncMLPlugin) << "Unable to close storage provider";
-}
-
 bool
 SyncMLServer::createUSBTransport ()
 {
@@ -317,6 +287,31 @@ SyncMLServer::createBTTransport ()
     return btInitRes;
 }
 
+bool
+SyncMLServer::createTCPTransport ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    quint16 port = iProfile.key (PROF_TCP_PORT).toUShort ();
+    if (port == 0)
+    {
+        qCWarning(lcSyncMLPlugin) << "Invalid TCP port" << iProfile.key (PROF_TCP_PORT);
+        return false;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Creating new TCP listener on port" << port;
+    QStringList allowedPeers = iProfile.key (PROF_TCP_ALLOWED_PEERS).split (',', QString::SkipEmptyParts);
+    for (int i = 0; i < allowedPeers.count (); ++i)
+        allowedPeers[i] = allowedPeers[i].trimmed ();
+
+    bool tcpInitRes = mTCPConnection.init (iProfile.key (PROF_TCP_ADDRESS), port, allowedPeers);
+
+    QObject::connect (&mTCPConnection, SIGNAL (tcpConnected (int, QString)),
+                      this, SLOT (handleTCPConnected (int, QString)));
+
+    return tcpInitRes;
+}
+
 void
 SyncMLServer::closeUSBTransport ()
 {
@@ -337,39 +332,41 @@ SyncMLServer::closeBTTransport ()
     mBTConnection.uninit ();
 }
 
+void
+SyncMLServer::closeTCPTransport ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QObject::disconnect (&mTCPConnection, SIGNAL (tcpConnected (int, QString)),
+                         this, SLOT (handleTCPConnected (int, QString)));
+    mTCPConnection.uninit ();
+}
+
 void
 SyncMLServer::handleUSBConnected (int fd)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
     Q_UNUSED (fd);
 
-    if (mIsSessionInProgress)
+    SyncMLServerSession *session = mSessions[Sync::CONNECTIVITY_USB];
+
+    if (session->isInProgress ())
     {
-        qCDebug(lcSyncMLPlugin) << "Sync session is in progress over transport " << mConnectionType;
-        emit sessionInProgress (mConnectionType);
+        qCDebug(lcSyncMLPlugin) << "Sync session is already in progress over USB";
+        emit sessionInProgress (Sync::CONNECTIVITY_USB);
         return;
     }
 
     qCDebug(lcSyncMLPlugin) << "New incoming data over USB";
 
-    if (mTransport == NULL)
+    if (!session->hasTransport ())
     {
-        mTransport = new DataSync::OBEXTransport (mUSBConnection,
-                                              DataSync::OBEXTransport::MODE_OBEX_SERVER,
-                                              DataSync::OBEXTransport::TYPEHINT_USB);
-    }
-    
-    if (!mTransport)
-    {
-        qCDebug(lcSyncMLPlugin) << "Creation of USB transport failed";
-        return;
+        session->setTransport (new DataSync::OBEXTransport (mUSBConnection,
+                                                           DataSync::OBEXTransport::MODE_OBEX_SERVER,
+                                                           DataSync::OBEXTransport::TYPEHINT_USB));
     }
 
-    if (!mAgent)
-    {
-        mConnectionType = Sync::CONNECTIVITY_USB;
-        startNewSession ("USB");
-    }
+    startNewSession (session, "USB");
 }
 
 void
@@ -378,70 +375,100 @@ SyncMLServer::handleBTConnected (int fd, QString btAddr)
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
     Q_UNUSED (fd);
 
-    if (mIsSessionInProgress)
+    SyncMLServerSession *session = mSessions[Sync::CONNECTIVITY_BT];
+
+    if (session->isInProgress ())
     {
-        qCDebug(lcSyncMLPlugin) << "Sync session is in progress over transport " << mConnectionType;
-        emit sessionInProgress (mConnectionType);
+        qCDebug(lcSyncMLPlugin) << "Sync session is already in progress over BT";
+        emit sessionInProgress (Sync::CONNECTIVITY_BT);
         return;
     }
 
     qCDebug(lcSyncMLPlugin) << "New incoming connection over BT";
     
-    if (mTransport == NULL)
+    if (!session->hasTransport ())
     {
-        mTransport = new DataSync::OBEXTransport (mBTConnection,
-                                              DataSync::OBEXTransport::MODE_OBEX_SERVER,
-                                              DataSync::OBEXTransport::TYPEHINT_BT);
+        session->setTransport (new DataSync::OBEXTransport (mBTConnection,
+                                                           DataSync::OBEXTransport::MODE_OBEX_SERVER,
+                                                           DataSync::OBEXTransport::TYPEHINT_BT));
     }
     
-    if (!mTransport)
+    startNewSession (session, btAddr);
+}
+
+void
+SyncMLServer::handleTCPConnected (int fd, QString peerAddr)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+    Q_UNUSED (fd);
+
+    SyncMLServerSession *session = mSessions[Sync::CONNECTIVITY_INTERNET];
+
+    if (session->isInProgress ())
     {
-        qCDebug(lcSyncMLPlugin) << "Creation of BT transport failed";
+        qCDebug(lcSyncMLPlugin) << "Sync session is already in progress over TCP";
+        emit sessionInProgress (Sync::CONNECTIVITY_INTERNET);
         return;
     }
-    
-    if (!mAgent)
+
+    qCDebug(lcSyncMLPlugin) << "New incoming connection over TCP from" << peerAddr;
+
+    if (!session->hasTransport ())
     {
-        mConnectionType = Sync::CONNECTIVITY_BT;
-        startNewSession (btAddr);
+        // There is no type hint for TCP, it is a reliable stream like the
+        // USB gadget and gets the same OBEX setup
+        session->setTransport (new DataSync::OBEXTransport (mTCPConnection,
+                                                           DataSync::OBEXTransport::MODE_OBEX_SERVER,
+                                                           DataSync::OBEXTransport::TYPEHINT_USB));
     }
+
+    startNewSession (session, peerAddr);
 }
 
 bool
-SyncMLServer::startNewSession (QString address)
+SyncMLServer::startNewSession (SyncMLServerSession *session, QString address)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    if (!initSyncAgent () || !initSyncAgentConfig ())
+    // Sessions over other connections may be running at the same time,
+    // their storage providers share reservations of the storage backends
+    if (!session->start (address))
+    {
+        qCWarning(lcSyncMLPlugin) << "Could not start session over connection" << session->connectionType ();
+
+        // The connection does not serve anyone else until the session is
+        // over
+        finishConnection (session->connectionType (), true);
         return false;
+    }
 
-    QObject::connect (mAgent, SIGNAL (stateChanged (DataSync::SyncState)),
-             this, SLOT (handleStateChanged (DataSync::SyncState)));
-    QObject::connect (mAgent, SIGNAL (syncFinished (DataSync::SyncState)),
-             this, SLOT (handleSyncFinished (DataSync::SyncState)));
-    QObject::connect (mAgent, SIGNAL (storageAccquired (QString)),
-             this, SLOT (handleStorageAccquired (QString)));
-    QObject::connect (mAgent, SIGNAL (itemProcessed (DataSync::ModificationType, DataSync::ModifiedDatabase, QString, QString, int)),
-             this, SLOT (handleItemProcessed (DataSync::ModificationType, DataSync::ModifiedDatabase, QString, QString, int)));
+    emit newSession (address);
+    return true;
+}
+
+void
+SyncMLServer::addResults (const Buteo::SyncResults &results)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    mIsSessionInProgress = true;
+    mResults.append (results);
 
-    if (mAgent->listen (*mConfig))
-    {
-        emit newSession (address);
-        return true;
-    } else
-    {
-        return false;
-    }
+    // Keep no more than one unread result per connection
+    while (mResults.size () > mSessions.size ())
+        mResults.removeFirst ();
 }
 
 void
-SyncMLServer::handleStateChanged (DataSync::SyncState state)
+SyncMLServer::finishConnection (Sync::ConnectivityType type, bool isSyncInError)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    qCDebug(lcSyncMLPlugin) << "SyncML new state " << state;
+    if (type == Sync::CONNECTIVITY_USB)
+        mUSBConnection.handleSyncFinished (isSyncInError);
+    else if (type == Sync::CONNECTIVITY_BT)
+        mBTConnection.handleSyncFinished (isSyncInError);
+    else if (type == Sync::CONNECTIVITY_INTERNET)
+        mTCPConnection.handleSyncFinished (isSyncInError);
 }
 
 void
@@ -449,7 +476,11 @@ SyncMLServer::handleSyncFinished (DataSync::SyncState state)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    qCDebug(lcSyncMLPlugin) << "Sync finished with state " << state;
+    SyncMLServerSession *session = qobject_cast<SyncMLServerSession*> (sender ());
+    if (!session)
+        return;
+
+    qCDebug(lcSyncMLPlugin) << "Sync over connection" << session->connectionType () << "finished with state " << state;
     bool errorStatus = true;
 
     switch (state)
@@ -458,7 +489,7 @@ SyncMLServer::handleSyncFinished (DataSync::SyncState state)
     case DataSync::ABORTED:
     case DataSync::SYNC_FINISHED:
     {
-        generateResults (true);
+        addResults (session->results (true));
         errorStatus = false;
         emit success(getProfileName(), QString::number(state));
         break;
@@ -469,7 +500,7 @@ SyncMLServer::handleSyncFinished (DataSync::SyncState state)
     case DataSync::CONNECTION_ERROR:
     case DataSync::INVALID_SYNCML_MESSAGE:
     {
-        generateResults (false);
+        addResults (session->results (false));
         emit error(getProfileName(), QString::number(state), Buteo::SyncResults::INTERNAL_ERROR);
         break;
     }
@@ -477,22 +508,23 @@ SyncMLServer::handleSyncFinished (DataSync::SyncState state)
     default:
     {
         qCCritical(lcSyncMLPlugin) << "Unexpected state change";
-        generateResults (false);
+        addResults (session->results (false));
 
         emit error(getProfileName(), QString::number(state), Buteo::SyncResults::INTERNAL_ERROR);
         break;
     }
     }
 
-    uninit ();
+    session->end ();
 
-    // Signal the USBConnection that sync has finished
-    if (mConnectionType == Sync::CONNECTIVITY_USB)
-        mUSBConnection.handleSyncFinished (errorStatus);
-    else if (mConnectionType == Sync::CONNECTIVITY_BT)
-        mBTConnection.handleSyncFinished (errorStatus);
+    // Signal the connection that sync has finished
+    finishConnection (session->connectionType (), errorStatus);
 
-    mIsSessionInProgress = false;
+    // Have an agent ready for the next connection
+    if ((session->connectionType () == Sync::CONNECTIVITY_USB && mUSBActive) ||
+        (session->connectionType () == Sync::CONNECTIVITY_BT && mBTActive) ||
+        (session->connectionType () == Sync::CONNECTIVITY_INTERNET && mTCPActive))
+        session->prepare ();
 }
 
 void
@@ -505,124 +537,10 @@ SyncMLServer::handleStorageAccquired (QString type)
 }
 
 void
-SyncMLServer::handleItemProcessed (DataSync::ModificationType modificationType,
-                                   DataSync::ModifiedDatabase modifiedDb,
-                                   QString localDb,
-                                   QString dbType,
-                                   int committedItems)
+SyncMLServer::handleItemsProcessed (Sync::TransferDatabase database, Sync::TransferType type,
+                                    QString mimeType, int count)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    qCDebug(lcSyncMLPlugin) << "Modification type:" << modificationType;
-    qCDebug(lcSyncMLPlugin) << "ModificationType database:" << modifiedDb;
-    qCDebug(lcSyncMLPlugin) << "Local database:" << localDb;
-    qCDebug(lcSyncMLPlugin) << "Database type:" << dbType;
-    qCDebug(lcSyncMLPlugin) << "Committed items:" << committedItems;
-
-    mCommittedItems++;
-
-    if (!receivedItems.contains (localDb))
-    {
-        ReceivedItemDetails details;
-        details.added = details.modified = details.deleted = details.error = 0;
-        details.mime = dbType;
-        receivedItems[localDb] = details;
-    }
-
-    switch (modificationType)
-    {
-    case DataSync::MOD_ITEM_ADDED:
-    {
-        ++receivedItems[localDb].added;
-        break;
-    }
-    case DataSync::MOD_ITEM_MODIFIED:
-    {
-        ++receivedItems[localDb].modified;
-        break;
-    }
-    case DataSync::MOD_ITEM_DELETED:
-    {
-        ++receivedItems[localDb].deleted;
-        break;
-    }
-    case DataSync::MOD_ITEM_ERROR:
-    {
-        ++receivedItems[localDb].error;
-        break;
-    }
-    default:
-    {
-        Q_ASSERT (0);
-        break;
-    }
-    }
-
-    Sync::TransferDatabase db = Sync::LOCAL_DATABASE;
-    if (modifiedDb == DataSync::MOD_LOCAL_DATABASE)
-        db = Sync::LOCAL_DATABASE;
-    else
-        db = Sync::REMOTE_DATABASE;
-
-    if (mCommittedItems == committedItems)
-    {
-        QMapIterator<QString, ReceivedItemDetails> itr (receivedItems);
-        while (itr.hasNext ())
-        {
-            itr.next ();
-            if (itr.value ().added)
-                emit transferProgress (getProfileName (), db, Sync::ITEM_ADDED, itr.value ().mime, itr.value ().added);
-            if (itr.value ().modified)
-                emit transferProgress (getProfileName (), db, Sync::ITEM_MODIFIED, itr.value ().mime, itr.value ().modified);
-            if (itr.value ().deleted)
-                emit transferProgress (getProfileName (), db, Sync::ITEM_DELETED, itr.value ().mime, itr.value ().deleted);
-            if (itr.value ().error)
-                emit transferProgress (getProfileName (), db, Sync::ITEM_ERROR, itr.value ().mime, itr.value ().error);
-        }
-
-        mCommittedItems = 0;
-        receivedItems.clear ();
-    }
-}
-
-void
-SyncMLServer::generateResults (bool success)
-{
-    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
-
-    mResults.setMajorCode (success ? Buteo::SyncResults::SYNC_RESULT_SUCCESS : Buteo::SyncResults::SYNC_RESULT_FAILED);
-
-    mResults.setTargetId (mAgent->getResults().getRemoteDeviceId ());
-    const QMap<QString, DataSync::DatabaseResults>* dbResults = mAgent->getResults ().getDatabaseResults ();
-
-    if (dbResults->isEmpty ())
-    {
-        qCDebug(lcSyncMLPlugin) << "No items transferred";
-    }
-    else
-    {
-        QMapIterator<QString, DataSync::DatabaseResults> itr (*dbResults);
-        while (itr.hasNext ())
-        {
-            itr.next ();
-            const DataSync::DatabaseResults& r = itr.value ();
-            Buteo::TargetResults targetResults(
-                    itr.key(), // Target name
-                    Buteo::ItemCounts (r.iLocalItemsAdded,
-                                       r.iLocalItemsDeleted,
-                                       r.iLocalItemsModified),
-                    Buteo::ItemCounts (r.iRemoteItemsAdded,
-                                       r.iRemoteItemsDeleted,
-                                       r.iRemoteItemsModified));
-            mResults.addTargetResults (targetResults);
-
-            qCDebug(lcSyncMLPlugin) << "Items for" << targetResults.targetName () << ":";
-            qCDebug(lcSyncMLPlugin) << "LA:" << targetResults.localItems ().added <<
-                      "LD:" << targetResults.localItems ().deleted <<
-                      "LM:" << targetResults.localItems ().modified <<
-                      "RA:" << targetResults.remoteItems ().added <<
-                      "RD:" << targetResults.remoteItems ().deleted <<
-                      "RM:" << targetResults.remoteItems ().modified;
-        }
-    }
+    emit transferProgress (getProfileName (), database, type, mimeType, count);
 }
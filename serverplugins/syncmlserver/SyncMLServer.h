@@ -25,27 +25,22 @@
 #include "syncmlserver_global.h"
 #include "USBConnection.h"
 #include "BTConnection.h"
-#include "SyncMLStorageProvider.h"
+#include "TCPConnection.h"
+#include "StorageReservations.h"
 
 #include <buteosyncfw5/ServerPlugin.h>
 #include <buteosyncfw5/SyncPluginLoader.h>
 #include <buteosyncfw5/SyncCommonDefs.h>
 #include <buteosyncfw5/SyncResults.h>
-#include <buteosyncml5/StorageProvider.h>
 #include <buteosyncml5/SyncAgent.h>
-#include <buteosyncml5/Transport.h>
-#include <buteosyncml5/SyncAgentConfig.h>
-#include <buteosyncml5/OBEXTransport.h>
 
 namespace Buteo {
     class ServerPlugin;
     class Profile;
 }
 
-namespace DataSync {
-    class SyncAgent;
-    class Transport;
-}
+class SyncMLServerSession;
+
 class SYNCMLSERVERSHARED_EXPORT SyncMLServer : public Buteo::ServerPlugin
 {
     Q_OBJECT
@@ -92,67 +87,56 @@ protected slots:
 
     void handleBTConnected (int fd, QString btAddr);
 
-    void handleSyncFinished (DataSync::SyncState state);
+    void handleTCPConnected (int fd, QString peerAddr);
 
-    void handleStateChanged (DataSync::SyncState state);
+    void handleSyncFinished (DataSync::SyncState state);
 
     void handleStorageAccquired (QString storageType);
 
-    void handleItemProcessed (DataSync::ModificationType modificationType,
-                              DataSync::ModifiedDatabase modifiedDb,
-                              QString localDb,
-                              QString dbType, int committedItems);
+    void handleItemsProcessed (Sync::TransferDatabase database, Sync::TransferType type,
+                               QString mimeType, int count);
 private:
 
-    bool initSyncAgent ();
-
-    void closeSyncAgent ();
-
     void closeUSBTransport ();
     
     void closeBTTransport ();
 
-    DataSync::SyncAgentConfig *initSyncAgentConfig ();
-
-    void closeSyncAgentConfig ();
-
-    bool initStorageProvider ();
+    void closeTCPTransport ();
 
     bool createUSBTransport ();
     
     bool createBTTransport ();
 
-    bool startNewSession (QString address);
-
-    void generateResults (bool success);
+    bool createTCPTransport ();
 
-    QMap<QString, QString>          mProperties;
+    bool startNewSession (SyncMLServerSession *session, QString address);
 
-    DataSync::SyncAgent*            mAgent;
+    void finishConnection (Sync::ConnectivityType type, bool isSyncInError);
 
-    DataSync::SyncAgentConfig*      mConfig;
+    void addResults (const Buteo::SyncResults &results);
 
     USBConnection                   mUSBConnection;
 
     BTConnection                    mBTConnection;
 
-    DataSync::Transport*            mTransport;
+    TCPConnection                   mTCPConnection;
 
-    Buteo::SyncResults              mResults;
-
-    SyncMLStorageProvider           mStorageProvider;
+    /**
+      * ! \brief Results of finished sessions not read yet, oldest first
+      */
+    mutable QList<Buteo::SyncResults> mResults;
 
-    qint32                          mCommittedItems;
+    mutable Buteo::SyncResults      mLastResults;
 
     /**
-      * ! \brief The connectivity type used for the current sync session
+      * ! \brief Storage backends in use by the sessions
       */
-    Sync::ConnectivityType          mConnectionType;
-    
+    StorageReservations             mReservations;
+
     /**
-      * ! \brief Flag to indicate if the sync session is in progress
+      * ! \brief Sync session of each connectivity type
       */
-    bool                            mIsSessionInProgress;
+    QMap<Sync::ConnectivityType, SyncMLServerSession*> mSessions;
     
     /**
       * ! \brief Flag to indicate if bluetooth is active
@@ -163,6 +147,11 @@ private:
       * ! \brief Flag to indicate if USB is active
       */
     bool                            mUSBActive;
+
+    /**
+      * ! \brief Flag to indicate if the TCP listener is active
+      */
+    bool                            mTCPActive;
 };
 
 class SyncMLServerLoader : public Buteo::SyncPluginLoader
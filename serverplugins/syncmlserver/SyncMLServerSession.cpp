@@ -0,0 +1,433 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+#include "SyncMLServerSession.h"
+
+#include <QElapsedTimer>
+
+#include <buteosyncfw5/Profile.h>
+#include <buteosyncml5/SyncAgentConfigProperties.h>
+
+#include "SyncAgentConfigCache.h"
+#include "SyncMLConfig.h"
+#include "SyncMLCommon.h"
+#include "SyncMLPluginLogging.h"
+
+SyncMLServerSession::SyncMLServerSession (Sync::ConnectivityType type,
+                                          Buteo::SyncPluginBase *plugin,
+                                          Buteo::Profile *profile,
+                                          Buteo::PluginCbInterface *cbInterface,
+                                          StorageReservations *reservations) :
+    mConnectionType (type), mPlugin (plugin), mProfile (profile), mCbInterface (cbInterface),
+    mAgent (0), mConfig (0), mConfigGeneration (0), mConfiguredMessageSize (0), mTransport (0), mCommittedItems (0), mIsSessionInProgress (false)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    mStorageProvider.setReservations (reservations);
+}
+
+SyncMLServerSession::~SyncMLServerSession ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    closeSyncAgent ();
+    closeSyncAgentConfig ();
+    delete mTransport;
+}
+
+Sync::ConnectivityType
+SyncMLServerSession::connectionType () const
+{
+    return mConnectionType;
+}
+
+bool
+SyncMLServerSession::isInProgress () const
+{
+    return mIsSessionInProgress;
+}
+
+bool
+SyncMLServerSession::hasTransport () const
+{
+    return mTransport != 0;
+}
+
+void
+SyncMLServerSession::setTransport (DataSync::Transport *transport)
+{
+    delete mTransport;
+    mTransport = transport;
+}
+
+void
+SyncMLServerSession::prepare ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (!mAgent)
+        initSyncAgent ();
+    loadSyncAgentConfig ();
+}
+
+bool
+SyncMLServerSession::start (const QString &peer)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QElapsedTimer setupTimer;
+    setupTimer.start ();
+
+    // The agent and the parsed configuration are normally ready from the
+    // previous session or from prepare()
+    if ((!mAgent && !initSyncAgent ()) || !initSyncAgentConfig ())
+        return false;
+
+    // The agent fixes the message size for the session, so it is sized from
+    // what earlier sessions measured over the same link
+    qint64 messageSize = mStorageProvider.setLink (linkId (peer), mConfiguredMessageSize);
+    mConfig->setAgentProperty (DataSync::MAXMESSAGESIZEPROP, QString::number (messageSize));
+
+    mIsSessionInProgress = true;
+
+    if (!mAgent->listen (*mConfig))
+    {
+        qCWarning(lcSyncMLPlugin) << "SyncML agent could not start listening";
+        end ();
+        return false;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Session over connection" << mConnectionType << "set up in"
+                            << setupTimer.elapsed () << "ms";
+    return true;
+}
+
+bool
+SyncMLServerSession::abort (DataSync::SyncState state)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (!mIsSessionInProgress || !mAgent)
+        return false;
+
+    if (mAgent->abort (state))
+    {
+        qCDebug(lcSyncMLPlugin) << "Signaling SyncML agent abort";
+    } else
+    {
+        emit finished (DataSync::ABORTED);
+    }
+
+    return true;
+}
+
+void
+SyncMLServerSession::end ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    closeSyncAgent ();
+
+    if (!mStorageProvider.uninit ())
+        qCCritical(lcSyncMLPlugin) << "Unable to close storage provider";
+
+    mCommittedItems = 0;
+    mReceivedItems.clear ();
+    mIsSessionInProgress = false;
+}
+
+void
+SyncMLServerSession::release ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (!mIsSessionInProgress)
+    {
+        closeSyncAgent ();
+        closeSyncAgentConfig ();
+    }
+    mStorageProvider.releasePooledStorages ();
+}
+
+Buteo::SyncResults
+SyncMLServerSession::results (bool success) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    Buteo::SyncResults results;
+    results.setMajorCode (success ? Buteo::SyncResults::SYNC_RESULT_SUCCESS : Buteo::SyncResults::SYNC_RESULT_FAILED);
+
+    if (!mAgent)
+        return results;
+
+    results.setTargetId (mAgent->getResults().getRemoteDeviceId ());
+    const QMap<QString, DataSync::DatabaseResults>* dbResults = mAgent->getResults ().getDatabaseResults ();
+
+    if (dbResults->isEmpty ())
+    {
+        qCDebug(lcSyncMLPlugin) << "No items transferred";
+    }
+    else
+    {
+        QMapIterator<QString, DataSync::DatabaseResults> itr (*dbResults);
+        while (itr.hasNext ())
+        {
+            itr.next ();
+            const DataSync::DatabaseResults& r = itr.value ();
+            Buteo::TargetResults targetResults(
+                    itr.key(), // Target name
+                    Buteo::ItemCounts (r.iLocalItemsAdded,
+                                       r.iLocalItemsDeleted,
+                                       r.iLocalItemsModified),
+                    Buteo::ItemCounts (r.iRemoteItemsAdded,
+                                       r.iRemoteItemsDeleted,
+                                       r.iRemoteItemsModified));
+            results.addTargetResults (targetResults);
+
+            qCDebug(lcSyncMLPlugin) << "Items for" << targetResults.targetName () << ":";
+            qCDebug(lcSyncMLPlugin) << "LA:" << targetResults.localItems ().added <<
+                      "LD:" << targetResults.localItems ().deleted <<
+                      "LM:" << targetResults.localItems ().modified <<
+                      "RA:" << targetResults.remoteItems ().added <<
+                      "RD:" << targetResults.remoteItems ().deleted <<
+                      "RM:" << targetResults.remoteItems ().modified;
+        }
+    }
+
+    return results;
+}
+
+void
+SyncMLServerSession::handleStateChanged (DataSync::SyncState state)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "SyncML new state " << state << "over connection" << mConnectionType;
+}
+
+void
+SyncMLServerSession::handleSyncFinished (DataSync::SyncState state)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    emit finished (state);
+}
+
+void
+SyncMLServerSession::handleStorageAccquired (QString storageType)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    emit storageAccquired (storageType);
+}
+
+void
+SyncMLServerSession::handleItemProcessed (DataSync::ModificationType modificationType,
+                                          DataSync::ModifiedDatabase modifiedDb,
+                                          QString localDb,
+                                          QString dbType,
+                                          int committedItems)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "Modification type:" << modificationType;
+    qCDebug(lcSyncMLPlugin) << "ModificationType database:" << modifiedDb;
+    qCDebug(lcSyncMLPlugin) << "Local database:" << localDb;
+    qCDebug(lcSyncMLPlugin) << "Database type:" << dbType;
+    qCDebug(lcSyncMLPlugin) << "Committed items:" << committedItems;
+
+    mCommittedItems++;
+
+    if (!mReceivedItems.contains (localDb))
+    {
+        ReceivedItems details;
+        details.added = details.modified = details.deleted = details.error = 0;
+        details.mime = dbType;
+        mReceivedItems[localDb] = details;
+    }
+
+    switch (modificationType)
+    {
+    case DataSync::MOD_ITEM_ADDED:
+    {
+        ++mReceivedItems[localDb].added;
+        break;
+    }
+    case DataSync::MOD_ITEM_MODIFIED:
+    {
+        ++mReceivedItems[localDb].modified;
+        break;
+    }
+    case DataSync::MOD_ITEM_DELETED:
+    {
+        ++mReceivedItems[localDb].deleted;
+        break;
+    }
+    case DataSync::MOD_ITEM_ERROR:
+    {
+        ++mReceivedItems[localDb].error;
+        break;
+    }
+    default:
+    {
+        Q_ASSERT (0);
+        break;
+    }
+    }
+
+    Sync::TransferDatabase db = Sync::LOCAL_DATABASE;
+    if (modifiedDb == DataSync::MOD_LOCAL_DATABASE)
+        db = Sync::LOCAL_DATABASE;
+    else
+        db = Sync::REMOTE_DATABASE;
+
+    if (mCommittedItems == committedItems)
+    {
+        QMapIterator<QString, ReceivedItems> itr (mReceivedItems);
+        while (itr.hasNext ())
+        {
+            itr.next ();
+            if (itr.value ().added)
+                emit itemsProcessed (db, Sync::ITEM_ADDED, itr.value ().mime, itr.value ().added);
+            if (itr.value ().modified)
+                emit itemsProcessed (db, Sync::ITEM_MODIFIED, itr.value ().mime, itr.value ().modified);
+            if (itr.value ().deleted)
+                emit itemsProcessed (db, Sync::ITEM_DELETED, itr.value ().mime, itr.value ().deleted);
+            if (itr.value ().error)
+                emit itemsProcessed (db, Sync::ITEM_ERROR, itr.value ().mime, itr.value ().error);
+        }
+
+        mCommittedItems = 0;
+        mReceivedItems.clear ();
+    }
+}
+
+bool
+SyncMLServerSession::initSyncAgent ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "Creating SyncML agent...";
+
+    mAgent = new DataSync::SyncAgent ();
+
+    QObject::connect (mAgent, SIGNAL (stateChanged (DataSync::SyncState)),
+             this, SLOT (handleStateChanged (DataSync::SyncState)));
+    QObject::connect (mAgent, SIGNAL (syncFinished (DataSync::SyncState)),
+             this, SLOT (handleSyncFinished (DataSync::SyncState)));
+    QObject::connect (mAgent, SIGNAL (storageAccquired (QString)),
+             this, SLOT (handleStorageAccquired (QString)));
+    QObject::connect (mAgent, SIGNAL (itemProcessed (DataSync::ModificationType, DataSync::ModifiedDatabase, QString, QString, int)),
+             this, SLOT (handleItemProcessed (DataSync::ModificationType, DataSync::ModifiedDatabase, QString, QString, int)));
+
+    return true;
+}
+
+void
+SyncMLServerSession::closeSyncAgent ()
+{
+    delete mAgent;
+    mAgent = 0;
+}
+
+DataSync::SyncAgentConfig*
+SyncMLServerSession::initSyncAgentConfig ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (!mTransport || !loadSyncAgentConfig () ||
+        !mStorageProvider.init (mProfile, mPlugin, mCbInterface, true))
+        return 0;
+
+    // Only the parts that change between sessions are set here
+    mConfig->setStorageProvider (&mStorageProvider);
+    mConfig->setTransport (mTransport);
+
+    // OBEX packet size of the connection. TCP uses the USB type hint, so
+    // its size goes to the USB property
+    if (mConnectionType == Sync::CONNECTIVITY_BT)
+    {
+        mConfig->setAgentProperty (DataSync::BTOBEXMTUPROP, QString::number (
+                SyncMLConfig::getObexMtu (mProfile->key (PROF_BT_OBEX_MTU), DEFAULT_BT_OBEX_MTU)));
+    } else if (mConnectionType == Sync::CONNECTIVITY_INTERNET)
+    {
+        mConfig->setAgentProperty (DataSync::USBOBEXMTUPROP, QString::number (
+                SyncMLConfig::getObexMtu (mProfile->key (PROF_TCP_OBEX_MTU), DEFAULT_TCP_OBEX_MTU)));
+    } else
+    {
+        mConfig->setAgentProperty (DataSync::USBOBEXMTUPROP, QString::number (
+                SyncMLConfig::getObexMtu (mProfile->key (PROF_USB_OBEX_MTU), DEFAULT_USB_OBEX_MTU)));
+    }
+
+    return mConfig;
+}
+
+bool
+SyncMLServerSession::loadSyncAgentConfig ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (mConfig)
+    {
+        if (mIsSessionInProgress || SyncAgentConfigCache::isCurrent (mConfigGeneration))
+            return true;
+
+        qCDebug(lcSyncMLPlugin) << "SyncML config files changed, dropping prepared config";
+        closeSyncAgentConfig ();
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Loading SyncML config...";
+
+    // Parsed default and ext config with the device info, shared with the
+    // other SyncML plugins of the process
+    mConfig = SyncAgentConfigCache::createConfig (&mConfigGeneration);
+
+    if (!mConfig)
+        return false;
+
+    // Overridden per session with the size for the link
+    mConfiguredMessageSize = mConfig->getAgentProperty (DataSync::MAXMESSAGESIZEPROP).toLongLong ();
+
+    return true;
+}
+
+void
+SyncMLServerSession::closeSyncAgentConfig ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "Closing config...";
+
+    delete mConfig;
+    mConfig = 0;
+    mConfiguredMessageSize = 0;
+}
+
+QString
+SyncMLServerSession::linkId (const QString &peer) const
+{
+    switch (mConnectionType)
+    {
+    case Sync::CONNECTIVITY_BT:
+        return "bt:" + peer;
+    case Sync::CONNECTIVITY_INTERNET:
+        return "tcp:" + peer;
+    default:
+        // There is a single USB peer
+        return "usb";
+    }
+}
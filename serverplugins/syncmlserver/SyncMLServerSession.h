@@ -0,0 +1,187 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+#ifndef SYNCMLSERVERSESSION_H
+#define SYNCMLSERVERSESSION_H
+
+#include "SyncMLStorageProvider.h"
+
+#include <QObject>
+#include <QMap>
+
+#include <buteosyncfw5/SyncCommonDefs.h>
+#include <buteosyncfw5/SyncResults.h>
+#include <buteosyncml5/SyncAgent.h>
+#include <buteosyncml5/SyncAgentConfig.h>
+#include <buteosyncml5/Transport.h>
+
+namespace Buteo {
+    class Profile;
+    class SyncPluginBase;
+    class PluginCbInterface;
+}
+
+class StorageReservations;
+
+/*! \brief Sync session state of one connection of the SyncML server
+ *
+ * Each connection type has its own agent, configuration, transport and
+ * storage provider, so that sessions over different connections can run at
+ * the same time. The storage providers of the sessions share reservations,
+ * which keeps two sessions from using the same storage backend.
+ *
+ * Between sessions the parsed configuration and a fresh agent are kept
+ * ready for the next connection.
+ */
+class SyncMLServerSession : public QObject
+{
+    Q_OBJECT
+
+public:
+    SyncMLServerSession (Sync::ConnectivityType type,
+                         Buteo::SyncPluginBase *plugin,
+                         Buteo::Profile *profile,
+                         Buteo::PluginCbInterface *cbInterface,
+                         StorageReservations *reservations);
+
+    virtual ~SyncMLServerSession ();
+
+    /*! \brief Returns the connectivity type of the session
+     */
+    Sync::ConnectivityType connectionType () const;
+
+    /*! \brief Checks if a sync session is running
+     */
+    bool isInProgress () const;
+
+    /*! \brief Checks if the transport of the connection has been set
+     */
+    bool hasTransport () const;
+
+    /*! \brief Sets the transport of the connection, taking ownership of it
+     */
+    void setTransport (DataSync::Transport *transport);
+
+    /*! \brief Prepares the agent and configuration for the next session
+     *
+     * A configuration prepared earlier is loaded again if the config files
+     * have changed since.
+     */
+    void prepare ();
+
+    /*! \brief Starts serving a session over the transport
+     *
+     * @param peer Address of the remote party, used to size messages for
+     *             the link to it
+     * @return True if the agent is listening, otherwise false
+     */
+    bool start (const QString &peer);
+
+    /*! \brief Aborts the running session
+     *
+     * @param state State to abort with
+     * @return True if the agent was signaled, false if there was no session
+     */
+    bool abort (DataSync::SyncState state);
+
+    /*! \brief Ends the session after finished() has been handled
+     */
+    void end ();
+
+    /*! \brief Releases everything kept between sessions
+     */
+    void release ();
+
+    /*! \brief Returns the results of the finished session
+     *
+     * @param success True if the session finished successfully
+     */
+    Buteo::SyncResults results (bool success) const;
+
+signals:
+
+    void finished (DataSync::SyncState state);
+
+    void storageAccquired (QString storageType);
+
+    void itemsProcessed (Sync::TransferDatabase database, Sync::TransferType type,
+                         QString mimeType, int count);
+
+private slots:
+
+    void handleStateChanged (DataSync::SyncState state);
+
+    void handleSyncFinished (DataSync::SyncState state);
+
+    void handleStorageAccquired (QString storageType);
+
+    void handleItemProcessed (DataSync::ModificationType modificationType,
+                              DataSync::ModifiedDatabase modifiedDb,
+                              QString localDb,
+                              QString dbType, int committedItems);
+
+private:
+
+    struct ReceivedItems
+    {
+        QString mime;
+        int     added;
+        int     modified;
+        int     deleted;
+        int     error;
+    };
+
+    bool initSyncAgent ();
+
+    void closeSyncAgent ();
+
+    DataSync::SyncAgentConfig *initSyncAgentConfig ();
+
+    bool loadSyncAgentConfig ();
+
+    void closeSyncAgentConfig ();
+
+    QString linkId (const QString &peer) const;
+
+    Sync::ConnectivityType          mConnectionType;
+
+    Buteo::SyncPluginBase*          mPlugin;
+
+    Buteo::Profile*                 mProfile;
+
+    Buteo::PluginCbInterface*       mCbInterface;
+
+    DataSync::SyncAgent*            mAgent;
+
+    DataSync::SyncAgentConfig*      mConfig;
+
+    int                             mConfigGeneration;
+
+    qint64                          mConfiguredMessageSize;
+
+    DataSync::Transport*            mTransport;
+
+    SyncMLStorageProvider           mStorageProvider;
+
+    qint32                          mCommittedItems;
+
+    QMap<QString, ReceivedItems>    mReceivedItems;
+
+    bool                            mIsSessionInProgress;
+};
+
+#endif // SYNCMLSERVERSESSION_H
@@ -0,0 +1,355 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#include "SyncMLPluginLogging.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "TCPConnection.h"
+
+// Listened on when no address is configured
+static const char LOOPBACK_ADDRESS[] = "127.0.0.1";
+
+static bool
+isLoopback (const struct sockaddr *addr)
+{
+    if (addr->sa_family == AF_INET)
+    {
+        const struct sockaddr_in *addr4 = (const struct sockaddr_in*)addr;
+        return (ntohl (addr4->sin_addr.s_addr) >> 24) == IN_LOOPBACKNET;
+    }
+
+    if (addr->sa_family == AF_INET6)
+    {
+        const struct in6_addr *addr6 = &((const struct sockaddr_in6*)addr)->sin6_addr;
+        return IN6_IS_ADDR_LOOPBACK (addr6) ||
+               (IN6_IS_ADDR_V4MAPPED (addr6) && addr6->s6_addr[12] == IN_LOOPBACKNET);
+    }
+
+    return false;
+}
+
+TCPConnection::TCPConnection () :
+    mPort (0), mServerFd (-1), mPeerSocket (-1),
+    mReadNotifier (0), mExceptionNotifier (0)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+TCPConnection::~TCPConnection ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit ();
+}
+
+int
+TCPConnection::connect ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    return mPeerSocket;
+}
+
+bool
+TCPConnection::isConnected () const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    return (mPeerSocket != -1);
+}
+
+void
+TCPConnection::disconnect ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    closeTCPSocket (mPeerSocket);
+}
+
+void
+TCPConnection::handleSyncFinished (bool isSyncInError)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // Every session has its own connection, the peer reconnects for the next
+    closeTCPSocket (mPeerSocket);
+
+    if (isSyncInError == true)
+    {
+        // If sync error, then reopen the listening socket
+        removeFdListener ();
+        closeTCPSocket (mServerFd);
+        mServerFd = openTCPSocket ();
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Sync finished. Adding fd listener";
+    addFdListener ();
+}
+
+bool
+TCPConnection::init (const QString &address, quint16 port, const QStringList &allowedPeers)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    mAddress = address;
+    mPort = port;
+    mAllowedPeers = allowedPeers;
+
+    mServerFd = openTCPSocket ();
+
+    if (mServerFd == -1)
+    {
+        qCWarning(lcSyncMLPlugin) << "Error in opening TCP server socket";
+        return false;
+    }
+
+    addFdListener ();
+
+    return true;
+}
+
+quint16
+TCPConnection::listeningPort () const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    struct sockaddr_storage local;
+    socklen_t len = sizeof (local);
+
+    if (mServerFd == -1 || getsockname (mServerFd, (struct sockaddr*)&local, &len) != 0)
+        return 0;
+
+    if (local.ss_family == AF_INET6)
+        return ntohs (((struct sockaddr_in6*)&local)->sin6_port);
+
+    return ntohs (((struct sockaddr_in*)&local)->sin_port);
+}
+
+void
+TCPConnection::uninit ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    removeFdListener ();
+
+    closeTCPSocket (mServerFd);
+    closeTCPSocket (mPeerSocket);
+}
+
+int
+TCPConnection::openTCPSocket ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    struct addrinfo hints;
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    struct addrinfo *addresses = NULL;
+    QByteArray port = QByteArray::number (mPort);
+    QByteArray address = mAddress.isEmpty () ? QByteArray (LOOPBACK_ADDRESS) : mAddress.toLatin1 ();
+    int error = getaddrinfo (address.constData (), port.constData (), &hints, &addresses);
+
+    if (error != 0)
+    {
+        qCWarning(lcSyncMLPlugin) << "Unable to resolve" << address << ":" << gai_strerror (error);
+        return -1;
+    }
+
+    int sock = -1;
+    for (struct addrinfo *addr = addresses; addr != NULL; addr = addr->ai_next)
+    {
+        // Anyone reaching the address could read and change all synced
+        // data, so it must be restricted to known peers
+        if (!isLoopback (addr->ai_addr) && mAllowedPeers.isEmpty ())
+        {
+            qCWarning(lcSyncMLPlugin) << "Not listening on non-loopback address" << address
+                                      << "without allowed peers";
+            continue;
+        }
+
+        sock = socket (addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                       addr->ai_protocol);
+        if (sock < 0)
+            continue;
+
+        // Allow rebinding right after an error restart
+        int reuse = 1;
+        setsockopt (sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof (reuse));
+
+        if (addr->ai_family == AF_INET6)
+        {
+            // Accept IPv4 peers on the same socket
+            int v6Only = 0;
+            setsockopt (sock, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof (v6Only));
+        }
+
+        // We allow a max of 1 connection per SyncML session
+        if (bind (sock, addr->ai_addr, addr->ai_addrlen) == 0 && listen (sock, 1) == 0)
+            break;
+
+        qCWarning(lcSyncMLPlugin) << "Unable to listen on port" << mPort << ":" << strerror (errno);
+        close (sock);
+        sock = -1;
+    }
+
+    freeaddrinfo (addresses);
+
+    if (sock != -1)
+        qCDebug(lcSyncMLPlugin) << "Opened TCP socket with fd " << sock << " for port " << mPort;
+
+    return sock;
+}
+
+bool
+TCPConnection::isPeerAllowed (const struct sockaddr *addr, const QString &host) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (isLoopback (addr))
+        return true;
+
+    // IPv4 peers of a dual stack socket are reported as mapped addresses
+    QString peer = host;
+    if (peer.startsWith (QLatin1String ("::ffff:"), Qt::CaseInsensitive) && peer.contains ('.'))
+        peer = peer.mid (7);
+
+    return !peer.isEmpty () && mAllowedPeers.contains (peer);
+}
+
+void
+TCPConnection::closeTCPSocket (int &fd)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (fd != -1)
+    {
+        close (fd);
+        fd = -1;
+    }
+}
+
+void
+TCPConnection::addFdListener ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if (mReadNotifier || mServerFd == -1)
+        return;
+
+    // A listening socket becomes readable when a peer is waiting to be
+    // accepted, there is nothing to write on it
+    mReadNotifier = new QSocketNotifier (mServerFd, QSocketNotifier::Read);
+    mExceptionNotifier = new QSocketNotifier (mServerFd, QSocketNotifier::Exception);
+
+    QObject::connect (mReadNotifier, SIGNAL (activated (int)),
+                      this, SLOT (handleIncomingTCPConnection (int)));
+    QObject::connect (mExceptionNotifier, SIGNAL (activated (int)),
+                      this, SLOT (handleTCPError (int)));
+
+    qCDebug(lcSyncMLPlugin) << "Added listener for TCP socket " << mServerFd;
+}
+
+void
+TCPConnection::removeFdListener ()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // Called from the notifiers' own signals, so defer the deletion
+    if (mReadNotifier)
+    {
+        mReadNotifier->setEnabled (false);
+        mReadNotifier->deleteLater ();
+        mReadNotifier = 0;
+    }
+
+    if (mExceptionNotifier)
+    {
+        mExceptionNotifier->setEnabled (false);
+        mExceptionNotifier->deleteLater ();
+        mExceptionNotifier = 0;
+    }
+}
+
+void
+TCPConnection::handleIncomingTCPConnection (int fd)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "Incoming TCP connection. Emitting signal to handle the incoming data";
+
+    struct sockaddr_storage remote;
+    socklen_t len = sizeof (remote);
+
+    int peer = accept4 (fd, (struct sockaddr*)&remote, &len, SOCK_CLOEXEC);
+    if (peer < 0)
+    {
+        // The peer may have given up already, keep listening
+        qCDebug(lcSyncMLPlugin) << "Error in accept:" << strerror (errno);
+        return;
+    }
+
+    char host[NI_MAXHOST] = { 0 };
+    if (getnameinfo ((struct sockaddr*)&remote, len, host, sizeof (host),
+                     NULL, 0, NI_NUMERICHOST) != 0)
+        host[0] = '\0';
+
+    if (!isPeerAllowed ((struct sockaddr*)&remote, QString::fromLatin1 (host)))
+    {
+        qCWarning(lcSyncMLPlugin) << "Rejecting TCP connection from" << host;
+        close (peer);
+        return;
+    }
+
+    mPeerSocket = peer;
+
+    // OBEX is request-response, don't let small packets wait for a full
+    // segment
+    int noDelay = 1;
+    setsockopt (mPeerSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof (noDelay));
+
+    // Disable event notifier for the duration of the session
+    removeFdListener ();
+
+    emit tcpConnected (mPeerSocket, QString::fromLatin1 (host));
+}
+
+void
+TCPConnection::handleTCPError (int fd)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+    Q_UNUSED (fd);
+
+    qCDebug(lcSyncMLPlugin) << "Error in TCP connection";
+
+    removeFdListener ();
+    closeTCPSocket (mServerFd);
+    mServerFd = openTCPSocket ();
+    addFdListener ();
+}
@@ -0,0 +1,136 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#ifndef TCPCONNECTION_H
+#define TCPCONNECTION_H
+
+#include <QObject>
+#include <QSocketNotifier>
+#include <QStringList>
+
+#include <buteosyncml5/OBEXConnection.h>
+
+/*! \brief Class for accepting OBEX connections from peers over TCP/IP
+ *
+ * Peers are not authenticated by OBEX, so only the loopback interface is
+ * listened on unless another address is given. Listening on any other
+ * address also needs the addresses of the peers allowed to connect.
+ */
+class TCPConnection : public QObject, public DataSync::OBEXConnection
+{
+    Q_OBJECT
+public:
+
+    TCPConnection ();
+
+    virtual ~TCPConnection ();
+
+    /*! \sa DataSync::OBEXConnection::connect ()
+     *
+     */
+    virtual int connect ();
+
+    /*! \sa DataSync::OBEXConnection::isConnected ()
+     *
+     */
+    virtual bool isConnected () const;
+
+    /*! \sa DataSync::OBEXConnection::disconnect ()
+     *
+     */
+    virtual void disconnect ();
+
+    void handleSyncFinished (bool isSyncInError);
+
+    /**
+     * ! \brief Starts listening for connections
+     *
+     * @param address Local address to listen on, loopback if empty
+     * @param port TCP port to listen on
+     * @param allowedPeers Numeric addresses of the peers allowed to connect
+     *        from outside the device. Required for non-loopback addresses
+     */
+    bool init (const QString &address, quint16 port,
+               const QStringList &allowedPeers = QStringList ());
+
+    /**
+     * ! \brief Returns the port listened on, 0 if not listening
+     */
+    quint16 listeningPort () const;
+
+    /**
+      * ! \brief Stops listening and closes the peer connection
+      */
+    void uninit ();
+
+signals:
+
+    void tcpConnected (int fd, QString peerAddr);
+
+protected slots:
+
+    void handleIncomingTCPConnection (int fd);
+
+    void handleTCPError (int fd);
+
+private:
+    // Functions
+
+    /**
+     * ! \brief Method to open the listening socket
+     */
+    int openTCPSocket ();
+
+    /**
+     * ! \brief Checks if a peer may be served
+     */
+    bool isPeerAllowed (const struct sockaddr *addr, const QString &host) const;
+
+    /**
+     * ! \brief Method to close a socket
+     */
+    void closeTCPSocket (int &fd);
+
+    /**
+     * ! \brief FD listener method
+     */
+    void addFdListener ();
+
+    /**
+     * ! \brief Removes fd listening
+     */
+    void removeFdListener ();
+
+private:
+
+    QString                 mAddress;
+
+    quint16                 mPort;
+
+    QStringList             mAllowedPeers;
+
+    int                     mServerFd;
+
+    int                     mPeerSocket;
+
+    QSocketNotifier         *mReadNotifier;
+
+    QSocketNotifier         *mExceptionNotifier;
+};
+
+#endif // TCPCONNECTION_H
@@ -24,7 +24,10 @@
 #include "SyncMLPluginLogging.h"
 #include <QDateTime>
 
+#include <QThread>
+
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <termios.h>
 #include <unistd.h>
@@ -34,11 +37,11 @@
 #endif
 
 USBConnection::USBConnection () :
-    mFd (-1), mMutex (QMutex::Recursive), mDisconnected (true), mFdWatching (false),
+    mDevicePath ("/dev/ttyGS1"), mFd (-1), mMutex (QMutex::Recursive), mDisconnected (true), mFdWatching (false),
 #ifdef GLIB_FD_WATCH
     mIOChannel (0), mIdleEventSource (0), mFdWatchEventSource (0)
 #else
-    mReadNotifier (0), mWriteNotifier (0), mExceptionNotifier (0)
+    mReadNotifier (0)
 #endif
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -58,16 +61,6 @@ USBConnection::~USBConnection ()
         delete mReadNotifier;
         mReadNotifier = 0;
     }
-    if (mWriteNotifier)
-    {
-        delete mWriteNotifier;
-        mWriteNotifier = 0;
-    }
-    if (mExceptionNotifier)
-    {
-        delete mExceptionNotifier;
-        mExceptionNotifier = 0;
-    }
 #endif
 }
 
@@ -107,6 +100,14 @@ USBConnection::disconnect ()
     // the host (PC/device/...) might initiate sync again
 }
 
+void
+USBConnection::setDevicePath (const QString &path)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    mDevicePath = path;
+}
+
 bool
 USBConnection::isConnected () const
 {
@@ -129,9 +130,7 @@ USBConnection::openUSBDevice ()
         return mFd;
     }
 
-    const QString USB_DEVICE ("/dev/ttyGS1");
-
-    mFd = open (USB_DEVICE.toLocal8Bit ().constData (),
+    mFd = open (mDevicePath.toLocal8Bit ().constData (),
                    O_RDWR | O_NOCTTY);
 
     if (mFd < 0) {
@@ -223,6 +222,16 @@ USBConnection::addFdListener ()
 
     QMutexLocker lock (&mMutex);
 
+#ifndef GLIB_FD_WATCH
+    // The OBEX worker reconnects from its own thread, but the notifier has
+    // to be armed from the thread whose event loop polls it
+    if (QThread::currentThread () != thread ())
+    {
+        QMetaObject::invokeMethod (this, "addFdListener", Qt::QueuedConnection);
+        return;
+    }
+#endif
+
     if ((mFdWatching == false) && isConnected ())
     {
 #ifdef GLIB_FD_WATCH
@@ -240,21 +249,23 @@ USBConnection::addFdListener ()
 
         qCDebug(lcSyncMLPlugin) << "Added fd listner for fd " << mFd << " with event source " << mFdWatchEventSource;
 #else
+        // Only incoming data starts a session. The tty is writable nearly
+        // all the time, so watching for that would wake us up constantly.
+        // Hangups and errors are reported as readable too
+        if (mReadNotifier && mReadNotifier->socket () != mFd)
+        {
+            mReadNotifier->deleteLater ();
+            mReadNotifier = 0;
+        }
 
-        mReadNotifier = new QSocketNotifier (mFd, QSocketNotifier::Read);
-    	mWriteNotifier = new QSocketNotifier (mFd, QSocketNotifier::Write);
-    	mExceptionNotifier = new QSocketNotifier (mFd, QSocketNotifier::Exception);
-
-    	mReadNotifier->setEnabled (true);
-    	mWriteNotifier->setEnabled (true);
-    	mExceptionNotifier->setEnabled (true);
+        if (!mReadNotifier)
+        {
+            mReadNotifier = new QSocketNotifier (mFd, QSocketNotifier::Read, this);
+            QObject::connect (mReadNotifier, SIGNAL (activated (int)),
+                              this, SLOT (handleUSBActivated (int)));
+        }
 
-    	QObject::connect (mReadNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleUSBActivated (int)), Qt::BlockingQueuedConnection);
-    	QObject::connect (mWriteNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleUSBActivated (int)), Qt::BlockingQueuedConnection);
-    	QObject::connect (mExceptionNotifier, SIGNAL (activated (int)),
-                      	this, SLOT (handleUSBError (int)), Qt::BlockingQueuedConnection);
+        mReadNotifier->setEnabled (true);
 #endif
         mFdWatching = true;
         mDisconnected = false;
@@ -279,16 +290,12 @@ USBConnection::removeFdListener ()
         }
     }
 #else
-    mWriteNotifier->setEnabled (false);
-    mReadNotifier->setEnabled (false);
-    mExceptionNotifier->setEnabled (false);
-
-    QObject::disconnect (mReadNotifier, SIGNAL (activated (int)),
-                      this, SLOT (handleUSBActivated (int)));
-    QObject::disconnect (mWriteNotifier, SIGNAL (activated (int)),
-                      this, SLOT (handleUSBActivated (int)));
-    QObject::disconnect (mExceptionNotifier, SIGNAL (activated (int)),
-                      this, SLOT (handleUSBError (int)));
+    // The notifier is already disarmed while a session runs, which is when
+    // the OBEX worker disconnects from its own thread
+    if (mFdWatching && mReadNotifier)
+    {
+        mReadNotifier->setEnabled (false);
+    }
 #endif
     mFdWatching = false;
 }
@@ -414,18 +421,26 @@ USBConnection::handleUSBActivated (int fd)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    qCDebug(lcSyncMLPlugin) << "USB is activated. Emitting signal to handle incoming data";
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    if (poll (&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)))
+    {
+        handleUSBError (fd);
+        return;
+    }
 
-    emit usbConnected (fd);
+    qCDebug(lcSyncMLPlugin) << "USB is activated. Emitting signal to handle incoming data";
 
-    // Disable the event notifier
+    // Disable the event notifier before the session starts reading
     removeFdListener ();
+
+    emit usbConnected (fd);
 }
 
 void
 USBConnection::handleUSBError (int fd)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+    Q_UNUSED (fd);
 
     qCDebug(lcSyncMLPlugin) << "Error in USB connection";
 
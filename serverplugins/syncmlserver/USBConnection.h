@@ -64,6 +64,12 @@ public:
 
     void handleSyncFinished (bool isSyncInError);
 
+    /*! \brief Sets the device to open, /dev/ttyGS1 by default
+     *
+     * Used to stand in a pty for the USB gadget serial device
+     */
+    void setDevicePath (const QString &path);
+
 signals:
 
     void usbConnected (int fd);
@@ -83,7 +89,7 @@ private:
 
     void closeUSBDevice ();
 
-    void addFdListener ();
+    Q_INVOKABLE void addFdListener ();
 
     void removeFdListener ();
 
@@ -109,6 +115,8 @@ private:
 #endif
 private:
 
+    QString                 mDevicePath;
+
     int                     mFd;
 
     QMutex                  mMutex;
@@ -125,10 +133,6 @@ private:
     guint                   mFdWatchEventSource;
 #else
     QSocketNotifier         *mReadNotifier;
-
-    QSocketNotifier         *mWriteNotifier;
-
-    QSocketNotifier         *mExceptionNotifier;
 #endif
 };
 
@@ -22,13 +22,17 @@ QMAKE_CLEAN += $(TARGET) $(TARGET0) $(TARGET1) $(TARGET2)
 QMAKE_CLEAN += $(OBJECTS_DIR)/*.gcda $(OBJECTS_DIR)/*.gcno $(OBJECTS_DIR)/*.gcov $(OBJECTS_DIR)/moc_*
 
 SOURCES += SyncMLServer.cpp \
+    SyncMLServerSession.cpp \
     USBConnection.cpp \
-    BTConnection.cpp
+    BTConnection.cpp \
+    TCPConnection.cpp
 
 HEADERS += SyncMLServer.h\
+    SyncMLServerSession.h \
     syncmlserver_global.h \
     USBConnection.h \
-    BTConnection.h
+    BTConnection.h \
+    TCPConnection.h
 
 OTHER_FILES += xml/*
 
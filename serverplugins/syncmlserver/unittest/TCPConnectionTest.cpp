@@ -0,0 +1,105 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#include "TCPConnectionTest.h"
+
+#include <QtTest>
+
+#include <unistd.h>
+
+#include "TCPClientConnection.h"
+
+// Connects a client to the server and checks that data gets through both
+// ways
+static void
+exchange (TCPConnection *server, const QString &host)
+{
+    QSignalSpy spy (server, SIGNAL (tcpConnected (int, QString)));
+
+    TCPClientConnection client;
+    client.setConnectionInfo (host, server->listeningPort ());
+
+    int clientFd = client.connect ();
+    QVERIFY (clientFd != -1);
+
+    QVERIFY (spy.wait (1000));
+    QCOMPARE (spy.count (), 1);
+
+    int serverFd = spy.at (0).at (0).toInt ();
+    QCOMPARE (server->connect (), serverFd);
+    QCOMPARE (spy.at (0).at (1).toString (), QString ("127.0.0.1"));
+
+    char buf[4];
+    QCOMPARE (write (clientFd, "put", 3), (ssize_t)3);
+    QCOMPARE (read (serverFd, buf, sizeof (buf)), (ssize_t)3);
+    QCOMPARE (QByteArray (buf, 3), QByteArray ("put"));
+
+    QCOMPARE (write (serverFd, "ok", 2), (ssize_t)2);
+    QCOMPARE (read (clientFd, buf, sizeof (buf)), (ssize_t)2);
+    QCOMPARE (QByteArray (buf, 2), QByteArray ("ok"));
+
+    client.disconnect ();
+}
+
+void
+TCPConnectionTest::initTestCase ()
+{
+    // Any free port on loopback
+    mConnection = new TCPConnection ();
+    QVERIFY (mConnection->init (QString (), 0));
+    QVERIFY (mConnection->listeningPort () != 0);
+}
+
+void
+TCPConnectionTest::cleanupTestCase ()
+{
+    delete mConnection;
+    mConnection = 0;
+}
+
+void
+TCPConnectionTest::testConnect ()
+{
+    exchange (mConnection, "127.0.0.1");
+}
+
+void
+TCPConnectionTest::testRearm ()
+{
+    // The peer reconnects for the next session
+    mConnection->handleSyncFinished (false);
+    QVERIFY (!mConnection->isConnected ());
+
+    exchange (mConnection, "localhost");
+}
+
+void
+TCPConnectionTest::testNonLoopbackAddress ()
+{
+    // Not served without knowing whom to serve
+    TCPConnection open;
+    QVERIFY (!open.init ("0.0.0.0", 0));
+    QCOMPARE (open.listeningPort (), (quint16)0);
+
+    TCPConnection restricted;
+    QVERIFY (restricted.init ("0.0.0.0", 0, QStringList () << "192.0.2.1"));
+    QVERIFY (restricted.listeningPort () != 0);
+
+    // Loopback peers are always served
+    exchange (&restricted, "127.0.0.1");
+}
@@ -0,0 +1,47 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#ifndef TCPCONNECTIONTEST_H
+#define TCPCONNECTIONTEST_H
+
+#include <QObject>
+
+#include "TCPConnection.h"
+
+/*! \brief Connects the client plugin's TCP connection to TCPConnection
+ *         over loopback
+ */
+class TCPConnectionTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase ();
+    void cleanupTestCase ();
+
+    void testConnect ();
+    void testRearm ();
+    void testNonLoopbackAddress ();
+
+private:
+
+    TCPConnection   *mConnection;
+};
+
+#endif  //  TCPCONNECTIONTEST_H
@@ -0,0 +1,179 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#include "USBConnectionTest.h"
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// How long the idle connection is watched for wakeups
+static const int IDLE_TIME = 5000;
+
+void
+USBConnectionTest::initTestCase ()
+{
+    mMaster = posix_openpt (O_RDWR | O_NOCTTY);
+    QVERIFY (mMaster != -1);
+    QVERIFY (grantpt (mMaster) == 0);
+    QVERIFY (unlockpt (mMaster) == 0);
+
+    mConnection = new USBConnection ();
+    mConnection->setDevicePath (QString::fromLocal8Bit (ptsname (mMaster)));
+
+    mFd = mConnection->connect ();
+    QVERIFY (mFd != -1);
+}
+
+void
+USBConnectionTest::cleanupTestCase ()
+{
+    mConnection->disconnect ();
+    delete mConnection;
+    mConnection = 0;
+
+    close (mFd);
+    close (mMaster);
+}
+
+void
+USBConnectionTest::testIdleWakeups ()
+{
+    QSignalSpy spy (mConnection, SIGNAL (usbConnected (int)));
+
+    // Nothing is written, so a writable tty must not wake the server
+    QTest::qWait (IDLE_TIME);
+
+    qDebug () << "Wakeups per idle minute:" << spy.count () * 60000 / IDLE_TIME;
+    QCOMPARE (spy.count (), 0);
+}
+
+void
+USBConnectionTest::testConnectionLatency ()
+{
+    QSignalSpy spy (mConnection, SIGNAL (usbConnected (int)));
+
+    QElapsedTimer timer;
+    timer.start ();
+    QCOMPARE (write (mMaster, "x", 1), (ssize_t)1);
+
+    QVERIFY (spy.wait (1000));
+    qDebug () << "Connection to session latency:" << timer.nsecsElapsed () / 1000 << "us";
+
+    QCOMPARE (spy.count (), 1);
+    QCOMPARE (spy.at (0).at (0).toInt (), mFd);
+
+    // The session owns the fd now, no more signals while data is pending
+    QTest::qWait (100);
+    QCOMPARE (spy.count (), 1);
+
+    drain ();
+}
+
+void
+USBConnectionTest::testRearm ()
+{
+    QSignalSpy spy (mConnection, SIGNAL (usbConnected (int)));
+
+    mConnection->handleSyncFinished (false);
+    QTest::qWait (100);
+    QCOMPARE (spy.count (), 0);
+
+    QCOMPARE (write (mMaster, "x", 1), (ssize_t)1);
+    QVERIFY (spy.wait (1000));
+    QCOMPARE (spy.count (), 1);
+
+    drain ();
+}
+
+void
+USBConnectionTest::benchmarkObexMtu_data ()
+{
+    QTest::addColumn<int> ("mtu");
+
+    QTest::newRow ("1024") << 1024;
+    QTest::newRow ("4096") << 4096;
+    QTest::newRow ("8192") << 8192;
+    QTest::newRow ("16384") << 16384;
+    QTest::newRow ("32767") << 32767;
+    QTest::newRow ("65535") << 65535;
+}
+
+void
+USBConnectionTest::benchmarkObexMtu ()
+{
+    QFETCH (int, mtu);
+
+    // Packets of the given size from the peer, each answered with a short
+    // response like an OBEX put is
+    const int total = 4 * 1024 * 1024;
+    const int response = 8;
+    QByteArray buffer (mtu, 'x');
+
+    long flags = fcntl (mMaster, F_GETFL);
+    fcntl (mMaster, F_SETFL, flags | O_NONBLOCK);
+
+    QElapsedTimer timer;
+    timer.start ();
+
+    QBENCHMARK_ONCE {
+        for (int sent = 0; sent < total; sent += mtu)
+        {
+            transfer (mMaster, mFd, buffer.data (), mtu);
+            transfer (mFd, mMaster, buffer.data (), response);
+        }
+    }
+
+    qDebug () << "OBEX MTU" << mtu << ":" << (total / 1024) * 1000 / qMax (timer.elapsed (), (qint64)1) << "kB/s";
+
+    fcntl (mMaster, F_SETFL, flags);
+}
+
+void
+USBConnectionTest::transfer (int from, int to, char *buffer, int size)
+{
+    int written = 0;
+    int received = 0;
+
+    // Both ends are non-blocking and the pty buffers less than a packet,
+    // so write and read in turns
+    while (received < size)
+    {
+        if (written < size)
+        {
+            ssize_t count = write (from, buffer + written, size - written);
+            if (count > 0)
+                written += count;
+        }
+
+        ssize_t count = read (to, buffer, size - received);
+        if (count > 0)
+            received += count;
+    }
+}
+
+void
+USBConnectionTest::drain ()
+{
+    char buf[16];
+    while (read (mFd, buf, sizeof (buf)) > 0)
+        ;
+}
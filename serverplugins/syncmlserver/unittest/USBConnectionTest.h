@@ -0,0 +1,57 @@
+/*
+* This file is part of buteo-sync-plugins package
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Lesser General Public License
+* version 2.1 as published by the Free Software Foundation.
+*
+* This library is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+* Lesser General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+* 02110-1301 USA
+*/
+
+#ifndef USBCONNECTIONTEST_H
+#define USBCONNECTIONTEST_H
+
+#include <QObject>
+
+#include "USBConnection.h"
+
+/*! \brief Measures USBConnection against a pty standing in for /dev/ttyGS1
+ */
+class USBConnectionTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+
+    void initTestCase ();
+    void cleanupTestCase ();
+
+    void testIdleWakeups ();
+    void testConnectionLatency ();
+    void testRearm ();
+
+    void benchmarkObexMtu_data ();
+    void benchmarkObexMtu ();
+
+private:
+
+    void drain ();
+
+    void transfer (int from, int to, char *buffer, int size);
+
+    int             mMaster;
+
+    int             mFd;
+
+    USBConnection   *mConnection;
+};
+
+#endif  //  USBCONNECTIONTEST_H
@@ -0,0 +1,61 @@
+#/*
+# * This file is part of buteo-sync-plugins package
+# *
+# * This library is free software; you can redistribute it and/or
+# * modify it under the terms of the GNU Lesser General Public License
+# * version 2.1 as published by the Free Software Foundation.
+# *
+# * This library is distributed in the hope that it will be useful, but
+# * WITHOUT ANY WARRANTY; without even the implied warranty of
+# * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# * Lesser General Public License for more details.
+# *
+# * You should have received a copy of the GNU Lesser General Public
+# * License along with this library; if not, write to the Free Software
+# * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+# * 02110-1301 USA
+# *
+# */
+#
+
+TEMPLATE = app
+TARGET = syncmlserver-tests
+DEPENDPATH += . \
+              ../ \
+
+VPATH = .. \
+    ../../../
+
+INCLUDEPATH += . \
+    ../ \
+    ../../../syncmlcommon \
+    ../../../clientplugins/syncmlclient
+
+HEADERS += USBConnectionTest.h \
+           TCPConnectionTest.h \
+           USBConnection.h \
+           TCPConnection.h \
+           clientplugins/syncmlclient/TCPClientConnection.h \
+           syncmlcommon/SyncMLPluginLogging.h
+
+SOURCES += main.cpp \
+           USBConnectionTest.cpp \
+           TCPConnectionTest.cpp \
+           USBConnection.cpp \
+           TCPConnection.cpp \
+           clientplugins/syncmlclient/TCPClientConnection.cpp \
+           syncmlcommon/SyncMLPluginLogging.cpp
+
+QT += testlib
+QT -= gui
+CONFIG += link_pkgconfig
+
+PKGCONFIG = buteosyncfw5 buteosyncml5
+
+QMAKE_CLEAN += $(OBJECTS_DIR)/*.gcda $(OBJECTS_DIR)/*.gcno
+QMAKE_CXXFLAGS += -fprofile-arcs -ftest-coverage
+QMAKE_LFLAGS += -fprofile-arcs -ftest-coverage
+
+target.path = /opt/tests/buteo-sync-plugins/
+
+INSTALLS += target
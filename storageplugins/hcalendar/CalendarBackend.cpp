@@ -24,11 +24,14 @@
 #include "CalendarBackend.h"
 #include <KCalendarCore/Event>
 #include <KCalendarCore/Journal>
+#include <KCalendarCore/Todo>
+#include <KCalendarCore/Recurrence>
 #include "SyncMLPluginLogging.h"
 #include <QDir>
 #include <QDebug>
 
-CalendarBackend::CalendarBackend() : iCalendar( 0 ), iStorage( 0 )
+CalendarBackend::CalendarBackend() : iCalendar( 0 ), iStorage( 0 ), iIdQueryAvailable( false ),
+    iLoaded( false )
 {
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 }
@@ -38,7 +41,16 @@ CalendarBackend::~CalendarBackend()
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 }
 
-bool CalendarBackend::init(const QString &aNotebookName, const QString& aUid)
+void CalendarBackend::setSyncWindow( const QDateTime& aStart, const QDateTime& aEnd )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iWindowStart = aStart;
+    iWindowEnd = aEnd;
+}
+
+bool CalendarBackend::init(const QString &aNotebookName, const QString& aUid, bool aLoadAll,
+                           const QString& aSyncSession)
 {
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
@@ -50,66 +62,52 @@ bool CalendarBackend::init(const QString &aNotebookName, const QString& aUid)
 
     iNotebookStr = aNotebookName;
 
-    iCalendar = mKCal::ExtendedCalendar::Ptr( new mKCal::ExtendedCalendar( QTimeZone::systemTimeZone()) );
-
-    qCDebug(lcSyncMLPlugin) << "Creating Default Maemo Storage";
-    iStorage = iCalendar->defaultStorage( iCalendar );
-
-    bool opened = iStorage->open();
-    if(!opened)
-    {
-        qCDebug(lcSyncMLPluginTrace) << "Calendar storage open failed";
-    }
+    // The calendar database is opened once per sync session and shared
+    // with the notes storage
+    iSession = CalendarSession::acquire(aSyncSession);
+    bool opened = !iSession.isNull();
 
     mKCal::Notebook::Ptr openedNb;
-
-    // If we have an Uid, we try to get the corresponding Notebook
-    if (!aUid.isEmpty()) {
-        openedNb = iStorage->notebook(aUid);
-
-        // If we didn't get one, we create one and set its Uid
-        if (!openedNb) {
-            openedNb = mKCal::Notebook::Ptr(new mKCal::Notebook(aNotebookName,
-                                                                "Synchronization Created Notebook for " + aNotebookName));
-            if (!openedNb.isNull()) {
-                openedNb->setUid(aUid);
-                if (!iStorage->addNotebook(openedNb)) {
-                    qCWarning(lcSyncMLPlugin) << "Failed to add notebook to storage";
-                    openedNb.clear();
-                }
-            }
-        }
-    }
-
-    // If we didn't have an Uid or the creation above failed,
-    // we use the default notebook
-    if (openedNb.isNull()) {
-        openedNb = iStorage->defaultNotebook();
-        if(openedNb.isNull()) {
-            qCDebug(lcSyncMLPlugin) << "No default notebook exists, creating one";
-            openedNb = mKCal::Notebook::Ptr(new mKCal::Notebook("Default", QString()));
-            if (!iStorage->setDefaultNotebook(openedNb)) {
-                qCWarning(lcSyncMLPlugin) << "Failed to set default notebook of storage";
-                openedNb.clear();
-            }
-        }
+    if(opened)
+    {
+        iCalendar = iSession->calendar();
+        iStorage = iSession->storage();
+        openedNb = iSession->notebook(aNotebookName, aUid);
     }
 
     bool loaded = false;
-    if(opened && openedNb)
+    if(opened && openedNb && !aLoadAll)
+    {
+        qCDebug(lcSyncMLPlugin) << "Loading incidences on demand from::" << openedNb->uid();
+        loaded = true;
+    }
+    else if(opened && openedNb && hasSyncWindow())
     {
-        qCDebug(lcSyncMLPlugin) << "Loading all incidences from::" << openedNb->uid();
-        loaded = iStorage->loadNotebookIncidences(openedNb->uid());
+        loaded = iSession->load(iWindowStart.date(), iWindowEnd.date().addDays(1));
         if(!loaded)
         {
             qCWarning(lcSyncMLPlugin) << "Failed to load calendar!";
         }
+        aLoadAll = false;
+    }
+    else if(opened && openedNb)
+    {
+        loaded = iSession->loadNotebook(openedNb->uid());
     }
+    iLoaded = loaded && aLoadAll;
 
     if (opened && loaded && !openedNb.isNull())
     {
         iNotebookStr = openedNb->uid();
 
+        // Change detection only needs ids, read them directly from the database
+        // when possible instead of materializing full incidences.
+        QString databaseName = iSession->databaseName();
+        iIdQueryAvailable = !databaseName.isEmpty() && iIdQuery.init( databaseName );
+        if( !iIdQueryAvailable ) {
+            qCDebug(lcSyncMLPlugin) << "Id-only queries not available, using incidence queries";
+        }
+
         qCDebug(lcSyncMLPlugin) << "Calendar initialized";
         return true;
     }
@@ -125,6 +123,8 @@ bool CalendarBackend::init(const QString &aNotebookName, const QString& aUid)
 
         qCDebug(lcSyncMLPluginTrace) << "Calendar deleted";
 
+        iSession.clear();
+
         return false;
     }
 }
@@ -133,19 +133,15 @@ bool CalendarBackend::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    if( iStorage ) {
-        qCDebug(lcSyncMLPluginTrace) << "Closing calendar storage...";
-        iStorage->close();
-        qCDebug(lcSyncMLPluginTrace) << "Done";
-        iStorage.clear();
-    }
+    iIdQuery.uninit();
+    iIdQueryAvailable = false;
 
-    if( iCalendar ) {
-        qCDebug(lcSyncMLPluginTrace) << "Closing calendar...";
-        iCalendar->close();
-        qCDebug(lcSyncMLPluginTrace) << "Done";
-        iCalendar.clear();
-    }
+    // The storage is closed once no plugin uses the session anymore
+    iStorage.clear();
+    iCalendar.clear();
+    iSession.clear();
+
+    iTimeZones.clear();
 
     return true;
 }
@@ -158,6 +154,10 @@ bool CalendarBackend::getAllIncidences( KCalendarCore::Incidence::List& aInciden
 	    return false;
 	}
 
+    if( iIdQueryAvailable && queryIncidences( IncidenceIdQuery::ALL_INCIDENCES, QDateTime(), aIncidences ) ) {
+        return true;
+    }
+
 	if( !iStorage->allIncidences( &aIncidences, iNotebookStr ) ) {
         qCWarning(lcSyncMLPlugin) << "Error Retrieving ALL Incidences from the  Storage ";
         return false;
@@ -167,20 +167,76 @@ bool CalendarBackend::getAllIncidences( KCalendarCore::Incidence::List& aInciden
     return true;
 }
 
-void CalendarBackend::filterIncidences(KCalendarCore::Incidence::List& aList)
+void CalendarBackend::filterIncidences(KCalendarCore::Incidence::List& aList, bool aApplyWindow)
 {
-	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
-	QString event(INCIDENCE_TYPE_EVENT);
-	QString todo(INCIDENCE_TYPE_TODO);
-
-	for (int i = 0; i < aList.size(); ++i) {
-        KCalendarCore::Incidence::Ptr incidence = aList.at(i);
-        if ((incidence->type() != KCalendarCore::Incidence::TypeEvent) && (incidence->type() != KCalendarCore::Incidence::TypeTodo)) {
-	        qCDebug(lcSyncMLPlugin) << "Removing incidence type" << incidence->typeStr();
-                aList.remove( i, 1);
-		incidence.clear();
-	    }
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // Compact the list in a single pass instead of removing items one by one
+    int count = 0;
+    for (int i = 0; i < aList.size(); ++i) {
+        const KCalendarCore::Incidence::Ptr &incidence = aList.at(i);
+        bool supported = (incidence->type() == KCalendarCore::Incidence::TypeEvent) || (incidence->type() == KCalendarCore::Incidence::TypeTodo);
+        if (!supported) {
+            qCDebug(lcSyncMLPlugin) << "Removing incidence type" << incidence->typeStr();
+        }
+        if (supported && (!aApplyWindow || inSyncWindow(incidence))) {
+            if (count != i) {
+                aList[count] = incidence;
+            }
+            ++count;
         }
+    }
+    aList.resize(count);
+}
+
+bool CalendarBackend::hasSyncWindow() const
+{
+    return iWindowStart.isValid() && iWindowEnd.isValid();
+}
+
+bool CalendarBackend::inSyncWindow( const KCalendarCore::Incidence::Ptr& aIncidence ) const
+{
+    if( !hasSyncWindow() ) {
+        return true;
+    }
+
+    QDateTime start = aIncidence->dtStart();
+    QDateTime end;
+
+    if( aIncidence->type() == KCalendarCore::Incidence::TypeEvent ) {
+        end = aIncidence.staticCast<KCalendarCore::Event>()->dtEnd();
+    }
+    else if( aIncidence->type() == KCalendarCore::Incidence::TypeTodo ) {
+        KCalendarCore::Todo::Ptr todo = aIncidence.staticCast<KCalendarCore::Todo>();
+        if( todo->hasDueDate() ) {
+            end = todo->dtDue( true );
+        }
+    }
+
+    if( !start.isValid() && !end.isValid() ) {
+        return true;
+    }
+    if( !start.isValid() ) {
+        start = end;
+    }
+    if( !end.isValid() || end < start ) {
+        end = start;
+    }
+
+    if( end >= iWindowStart && start <= iWindowEnd ) {
+        return true;
+    }
+
+    if( !aIncidence->recurs() ) {
+        return false;
+    }
+
+    // Recurring incidences are in the window if any occurrence overlaps it,
+    // that is if the first occurrence ending after the window start begins
+    // before the window ends
+    qint64 duration = start.secsTo( end );
+    QDateTime next = aIncidence->recurrence()->getNextDateTime( iWindowStart.addSecs( -duration - 1 ) );
+    return next.isValid() && next <= iWindowEnd;
 }
 
 bool CalendarBackend::getAllNew( KCalendarCore::Incidence::List& aIncidences, const QDateTime& aTime )
@@ -191,6 +247,10 @@ bool CalendarBackend::getAllNew( KCalendarCore::Incidence::List& aIncidences, co
         return false;
     }
 
+    if( iIdQueryAvailable && queryIncidences( IncidenceIdQuery::NEW_INCIDENCES, aTime, aIncidences ) ) {
+        return true;
+    }
+
     if( !iStorage->insertedIncidences( &aIncidences, aTime, iNotebookStr) ) {
         qCWarning(lcSyncMLPlugin) << "Error Retrieving New Incidences from the Storage";
         return false;
@@ -208,6 +268,10 @@ bool CalendarBackend::getAllModified( KCalendarCore::Incidence::List& aIncidence
         return false;
     }
 
+    if( iIdQueryAvailable && queryIncidences( IncidenceIdQuery::MODIFIED_INCIDENCES, aTime, aIncidences ) ) {
+        return true;
+    }
+
     if( !iStorage->modifiedIncidences( &aIncidences, aTime, iNotebookStr ) ) {
         qCWarning(lcSyncMLPlugin) << " Error retrieving modified Incidences ";
         return false;
@@ -234,20 +298,174 @@ bool CalendarBackend::getAllDeleted( KCalendarCore::Incidence::List& aIncidences
     return true;
 }
 
+bool CalendarBackend::getAllIncidenceIds( QList<QString>& aIds )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iIdQueryAvailable && queryIds( IncidenceIdQuery::ALL_INCIDENCES, QDateTime(), aIds ) ) {
+        return true;
+    }
+
+    KCalendarCore::Incidence::List incidences;
+    if( !getAllIncidences( incidences ) ) {
+        return false;
+    }
+
+    retrieveIds( incidences, aIds );
+    return true;
+}
+
+bool CalendarBackend::getAllNewIds( QList<QString>& aIds, const QDateTime& aTime )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iIdQueryAvailable && queryIds( IncidenceIdQuery::NEW_INCIDENCES, aTime, aIds ) ) {
+        return true;
+    }
+
+    KCalendarCore::Incidence::List incidences;
+    if( !getAllNew( incidences, aTime ) ) {
+        return false;
+    }
+
+    retrieveIds( incidences, aIds );
+    return true;
+}
+
+bool CalendarBackend::getAllModifiedIds( QList<QString>& aIds, const QDateTime& aTime )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iIdQueryAvailable && queryIds( IncidenceIdQuery::MODIFIED_INCIDENCES, aTime, aIds ) ) {
+        return true;
+    }
+
+    KCalendarCore::Incidence::List incidences;
+    if( !getAllModified( incidences, aTime ) ) {
+        return false;
+    }
+
+    retrieveIds( incidences, aIds );
+    return true;
+}
+
+bool CalendarBackend::getAllDeletedIds( QList<QString>& aIds, const QDateTime& aTime )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iIdQueryAvailable && queryIds( IncidenceIdQuery::DELETED_INCIDENCES, aTime, aIds ) ) {
+        return true;
+    }
+
+    KCalendarCore::Incidence::List incidences;
+    if( !getAllDeleted( incidences, aTime ) ) {
+        return false;
+    }
+
+    retrieveIds( incidences, aIds );
+    return true;
+}
+
+bool CalendarBackend::queryIds( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime, QList<QString>& aIds )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QList<IncidenceId> ids;
+
+    if( !iIdQuery.queryIds( aChangeType, iNotebookStr, supportedTypes(), aTime, ids,
+                            iWindowStart, iWindowEnd ) ) {
+        qCWarning(lcSyncMLPlugin) << "Error retrieving incidence ids from the storage, using incidence queries";
+        iIdQueryAvailable = false;
+        return false;
+    }
+
+    for( int i = 0; i < ids.count(); ++i ) {
+        // Recurring incidences need their rules to tell if any occurrence is
+        // in the window. Deleted ones cannot be loaded and are kept.
+        if( ids[i].iRecurs && aChangeType != IncidenceIdQuery::DELETED_INCIDENCES ) {
+            KCalendarCore::Incidence::Ptr incidence = iSession->incidence( iNotebookStr, ids[i].iUid,
+                                                                           ids[i].iRecurrenceId );
+            if( incidence && !inSyncWindow( incidence ) ) {
+                continue;
+            }
+        }
+
+        QString id = ids[i].iUid;
+        if( ids[i].iRecurrenceId.isValid() ) {
+            id.append( ID_SEPARATOR ).append( ids[i].iRecurrenceId.toString() );
+        }
+        aIds.append( id );
+    }
+
+    return true;
+}
+
+bool CalendarBackend::queryIncidences( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime,
+                                       KCalendarCore::Incidence::List& aIncidences, bool aApplyWindow )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QList<IncidenceId> ids;
+
+    if( !iIdQuery.queryIds( aChangeType, iNotebookStr, supportedTypes(), aTime, ids,
+                            aApplyWindow ? iWindowStart : QDateTime(),
+                            aApplyWindow ? iWindowEnd : QDateTime() ) ) {
+        qCWarning(lcSyncMLPlugin) << "Error retrieving incidences from the storage, using incidence queries";
+        iIdQueryAvailable = false;
+        return false;
+    }
+
+    // If the notebook has been loaded in init(), events and todo's are resolved
+    // from memory; journals of the notebook are never materialized here.
+    aIncidences.reserve( aIncidences.count() + ids.count() );
+    for( int i = 0; i < ids.count(); ++i ) {
+        KCalendarCore::Incidence::Ptr incidence = iSession->incidence( iNotebookStr, ids[i].iUid,
+                                                                       ids[i].iRecurrenceId );
+
+        if( !incidence ) {
+            qCWarning(lcSyncMLPlugin) << "Could not load incidence" << ids[i].iUid;
+        }
+        else if( !ids[i].iRecurs || inSyncWindow( incidence ) ) {
+            aIncidences.append( incidence );
+        }
+    }
+
+    return true;
+}
+
+QStringList CalendarBackend::supportedTypes() const
+{
+    return QStringList() << INCIDENCE_TYPE_EVENT << INCIDENCE_TYPE_TODO;
+}
+
+void CalendarBackend::retrieveIds( const KCalendarCore::Incidence::List& aIncidences, QList<QString>& aIds ) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    for( int i = 0; i < aIncidences.count(); ++i ) {
+        QString id = aIncidences[i]->uid();
+        if( aIncidences[i]->recurrenceId().isValid() ) {
+            id.append( ID_SEPARATOR ).append( aIncidences[i]->recurrenceId().toString() );
+        }
+        aIds.append( id );
+    }
+}
+
 KCalendarCore::Incidence::Ptr CalendarBackend::getIncidence( const QString& aUID )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     QStringList iDs = aUID.split(ID_SEPARATOR);
-    KCalendarCore::Incidence::Ptr incidence;
+    QString uid = aUID;
+    QDateTime recurrenceId;
     if (iDs.size() == 2) {
-       iStorage->load ( iDs.at(0), QDateTime::fromString(iDs.at(1), Qt::ISODate) );
-       incidence = iCalendar->incidence(iDs.at(0), QDateTime::fromString(iDs.at(1), Qt::ISODate));
-    } else {
-	   iStorage->load ( aUID );
-	   incidence = iCalendar->incidence( aUID );
+       uid = iDs.at(0);
+       recurrenceId = QDateTime::fromString(iDs.at(1), Qt::ISODate);
     }
-    return incidence;
+
+    // The notebook may have been loaded in init(), only go to the storage if
+    // the incidence is not in memory already
+    return iSession->incidence( iNotebookStr, uid, recurrenceId );
 }
 
 QString CalendarBackend::getVCalString(KCalendarCore::Incidence::Ptr aInci)
@@ -282,10 +500,8 @@ QString CalendarBackend::getICalString(KCalendarCore::Incidence::Ptr aInci)
 
     QString ical;
     if( temp ) {
-    KCalendarCore::Calendar::Ptr tempCalendar( new KCalendarCore::MemoryCalendar( QTimeZone::utc() ) );
-	tempCalendar->addIncidence(temp);
-    KCalendarCore::ICalFormat icf;
-	ical = icf.toString(tempCalendar);
+        // Time zone components are generated once per zone and session
+        ical = iTimeZones.iCalString( temp );
     }
     else {
     	qCWarning(lcSyncMLPlugin) << "Error Cloning the Incidence for Ical String";
@@ -294,15 +510,15 @@ QString CalendarBackend::getICalString(KCalendarCore::Incidence::Ptr aInci)
     return ical;
 }
 
-KCalendarCore::Incidence::Ptr CalendarBackend::getIncidenceFromVcal( const QString& aVString )
+KCalendarCore::Incidence::Ptr CalendarBackend::getIncidenceFromVcal( const QByteArray& aVString )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     KCalendarCore::Incidence::Ptr pInci;
 
-    KCalendarCore::Calendar::Ptr tempCalendar( new KCalendarCore::MemoryCalendar( QTimeZone::systemTimeZone()) );
+    KCalendarCore::Calendar::Ptr tempCalendar( new KCalendarCore::MemoryCalendar( iTimeZones.systemTimeZone()) );
     KCalendarCore::VCalFormat vcf;
-    vcf.fromString(tempCalendar, aVString);
+    vcf.fromRawString(tempCalendar, aVString);
     KCalendarCore::Incidence::List lst = tempCalendar->rawIncidences();
 
     if(!lst.isEmpty()) {
@@ -314,15 +530,15 @@ KCalendarCore::Incidence::Ptr CalendarBackend::getIncidenceFromVcal( const QStri
     return pInci;
 }
 
-KCalendarCore::Incidence::Ptr CalendarBackend::getIncidenceFromIcal( const QString& aIString )
+KCalendarCore::Incidence::Ptr CalendarBackend::getIncidenceFromIcal( const QByteArray& aIString )
 {
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     KCalendarCore::Incidence::Ptr pInci;
 
-    KCalendarCore::Calendar::Ptr tempCalendar( new KCalendarCore::MemoryCalendar( QTimeZone::systemTimeZone()) );
+    KCalendarCore::Calendar::Ptr tempCalendar( new KCalendarCore::MemoryCalendar( iTimeZones.systemTimeZone()) );
     KCalendarCore::ICalFormat icf;
-    icf.fromString(tempCalendar, aIString);
+    icf.fromRawString(tempCalendar, aIString);
     KCalendarCore::Incidence::List lst = tempCalendar->rawIncidences();
 
     if(!lst.isEmpty()) {
@@ -374,7 +590,7 @@ bool CalendarBackend::addIncidence( KCalendarCore::Incidence::Ptr aInci, bool co
     // problems.
 
     if( commitNow )  {
-        if( !iStorage->save() )
+        if( !iSession->save() )
         {
             qCWarning(lcSyncMLPlugin) << "Could not commit changes to calendar";
             return false;
@@ -396,7 +612,7 @@ bool CalendarBackend::commitChanges()
     {
         qCWarning(lcSyncMLPlugin) << "No calendar storage!";
     }
-    else if( iStorage->save() )  {
+    else if( iSession->save() )  {
         qCDebug(lcSyncMLPlugin) << "Committed changes to calendar";
         changesCommitted = true;
     }
@@ -407,6 +623,11 @@ bool CalendarBackend::commitChanges()
     return changesCommitted;
 }
 
+bool CalendarBackend::isCurrent() const
+{
+    return iSession && iSession->isCurrent();
+}
+
 bool CalendarBackend::modifyIncidence( KCalendarCore::Incidence::Ptr aInci, const QString& aUID, bool commitNow )
 {
 	FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -428,7 +649,7 @@ bool CalendarBackend::modifyIncidence( KCalendarCore::Incidence::Ptr aInci, cons
     }
 
     if( commitNow )  {
-        if( !iStorage->save() )
+        if( !iSession->save() )
         {
             qCWarning(lcSyncMLPlugin) << "Could not commit changes to calendar";
             return false;
@@ -439,34 +660,83 @@ bool CalendarBackend::modifyIncidence( KCalendarCore::Incidence::Ptr aInci, cons
     return true;
 }
 
-CalendarBackend::ErrorStatus CalendarBackend::deleteIncidence( const QString& aUID )
+CalendarBackend::ErrorStatus CalendarBackend::deleteIncidence( const QString& aUID, bool commitNow )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
-    CalendarBackend::ErrorStatus errorCode = CalendarBackend::STATUS_OK;
 
     if( !iCalendar || !iStorage ) {
-        errorCode = CalendarBackend::STATUS_GENERIC_ERROR;
+        return CalendarBackend::STATUS_GENERIC_ERROR;
     }
 
     KCalendarCore::Incidence::Ptr incidence = getIncidence( aUID );
-    
+
     if( !incidence ) {
         qCWarning(lcSyncMLPlugin) << "Could not find incidence to delete with UID" << aUID;
-        errorCode = CalendarBackend::STATUS_ITEM_NOT_FOUND;
+        return CalendarBackend::STATUS_ITEM_NOT_FOUND;
     }
 
     if( !iCalendar->deleteIncidence( incidence) )
     {
         qCWarning(lcSyncMLPlugin) << "Could not delete incidence with UID" << aUID;
-        errorCode = CalendarBackend::STATUS_GENERIC_ERROR;
+        return CalendarBackend::STATUS_GENERIC_ERROR;
+    }
+
+    if( commitNow && !iSession->save() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit changes to calendar";
+        return CalendarBackend::STATUS_GENERIC_ERROR;
+    }
+
+    return CalendarBackend::STATUS_OK;
+}
+
+bool CalendarBackend::deleteAllIncidences()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    KCalendarCore::Incidence::List incidences;
+
+    if( !iSession ) {
+        return false;
+    }
+
+    // Loading the notebook in one go beats loading every incidence on its own
+    if( !iLoaded ) {
+        iLoaded = iSession->loadNotebook( iNotebookStr );
+    }
+
+    // Incidences outside of the sync window are removed as well
+    if( !iIdQueryAvailable ||
+        !queryIncidences( IncidenceIdQuery::ALL_INCIDENCES, QDateTime(), incidences, false ) ) {
+        if( !iStorage->allIncidences( &incidences, iNotebookStr ) ) {
+            qCWarning(lcSyncMLPlugin) << "Error Retrieving ALL Incidences from the  Storage ";
+            return false;
+        }
+        filterIncidences( incidences, false );
+    }
+
+    bool success = true;
+
+    // Exceptions go before the recurring incidences they belong to
+    for( int pass = 0; pass < 2; ++pass ) {
+        foreach( const KCalendarCore::Incidence::Ptr& incidence, incidences ) {
+            if( incidence->recurrenceId().isValid() != ( pass == 0 ) ) {
+                continue;
+            }
+            if( !iCalendar->deleteIncidence( incidence ) ) {
+                qCWarning(lcSyncMLPlugin) << "Could not delete incidence with UID" << incidence->uid();
+                success = false;
+            }
+        }
     }
 
-    if( !iStorage->save() ) {
+    if( !iSession->save() ) {
         qCWarning(lcSyncMLPlugin) << "Could not commit changes to calendar";
-        errorCode =  CalendarBackend::STATUS_GENERIC_ERROR;
+        success = false;
     }
 
-    return errorCode;
+    qCDebug(lcSyncMLPlugin) << "Deleted" << incidences.count() << "incidences from notebook" << iNotebookStr;
+
+    return success;
 }
 
 bool CalendarBackend::modifyIncidence( KCalendarCore::Incidence::Ptr aIncidence, KCalendarCore::Incidence::Ptr aIncidenceData )
@@ -27,6 +27,9 @@
 #include <QString>
 
 #include "definitions.h"
+#include "IncidenceIdQuery.h"
+#include "CalendarSession.h"
+#include "TimeZoneCache.h"
 
 //calendar related includes
 #include "extendedcalendar.h"
@@ -57,9 +60,23 @@ public:
     //! \brief destructor
     virtual ~CalendarBackend();
 
+    //! \brief Restricts the incidences reported by the backend to a time window
+    //
+    // Incidences are included if they, or any of their occurrences, overlap
+    // the window. Undated incidences are always included. Must be called
+    // before init() to also limit what is loaded up front.
+    // \param aStart Start of the window, no window if invalid
+    // \param aEnd End of the window, no window if invalid
+    void setSyncWindow( const QDateTime& aStart, const QDateTime& aEnd );
+
     //! \brief Initializes the CalendarBackend
     // \param strNotebookName Name of the notebook to use
-    bool init( const QString& aNotebookName, const QString& aUid = "" );
+    // \param aLoadAll If true, all incidences of the notebook are loaded
+    //        up front, otherwise they are loaded when accessed
+    // \param aSyncSession Sync session the backend is used in. Backends of
+    //        the same session share the open calendar
+    bool init( const QString& aNotebookName, const QString& aUid = "", bool aLoadAll = true,
+               const QString& aSyncSession = QString() );
 
     //! \brief Uninitializes the storage
     bool uninit();
@@ -87,6 +104,29 @@ public:
     // @return True on success, otherwise false
     bool getAllDeleted( KCalendarCore::Incidence::List& aIncidences, const QDateTime& aTime );
 
+    //! \brief returns ids of all incidences inside this calendar
+    // @param aIds List of incidence ids
+    // @return True on success, otherwise false
+    bool getAllIncidenceIds( QList<QString>& aIds );
+
+    //! \brief returns ids of all new items after the date
+    // @param aIds List of incidence ids
+    // @param aTime Timestamp
+    // @return True on success, otherwise false
+    bool getAllNewIds( QList<QString>& aIds, const QDateTime& aTime );
+
+    //! \brief returns ids of all modified items after the date
+    // @param aIds List of incidence ids
+    // @param aTime Timestamp
+    // @return True on success, otherwise false
+    bool getAllModifiedIds( QList<QString>& aIds, const QDateTime& aTime );
+
+    //! \brief returns ids of all deleted items after the date
+    // @param aIds List of incidence ids
+    // @param aTime Timestamp
+    // @return True on success, otherwise false
+    bool getAllDeletedIds( QList<QString>& aIds, const QDateTime& aTime );
+
     //! \brief Get incidence based on uid.
     // Caller must not free the returned pointer.
     // \param aUID Item UID
@@ -103,15 +143,15 @@ public:
 
     //! \brief get Incidence from VCalendar string
     // Caller has to free the returned incidence after user.
-    // \param aVString Incidence representation in VCalendar format.
+    // \param aVString Incidence representation in VCalendar format, UTF-8 encoded.
     // \return Incidence pointer
-    KCalendarCore::Incidence::Ptr getIncidenceFromVcal( const QString& aVString );
+    KCalendarCore::Incidence::Ptr getIncidenceFromVcal( const QByteArray& aVString );
 
     //! \brief get Incidence from ICalendar string
     // Caller has to free the returned incidence after user.
-    // \param aIString Incidence representation in ICalendar format.
+    // \param aIString Incidence representation in ICalendar format, UTF-8 encoded.
     // \return Incidence pointer
-    KCalendarCore::Incidence::Ptr getIncidenceFromIcal( const QString& aIString );
+    KCalendarCore::Incidence::Ptr getIncidenceFromIcal( const QByteArray& aIString );
 
     //! \brief Add the incidence to calendar
     //
@@ -127,6 +167,11 @@ public:
     /// \return true if committed succesfully, false otherwise
     bool commitChanges();
 
+    //! \brief Checks that the calendar database has not been written by
+    //         anyone else since the backend last read or wrote it
+    /// \return true if unchanged, false otherwise
+    bool isCurrent() const;
+
     //! \brief Modify the incidence in calendar
     //
     // if there is no incidence with old id exists, a new incidence
@@ -139,17 +184,42 @@ public:
 
     //! \brief delete the incidence
     // \param aUID id of the incidence to be deleted
+    // \param commitNow if true, the deletion is committed right away
     // \return errorCode of the operation as status.
-    ErrorStatus deleteIncidence( const QString& aUID);
+    ErrorStatus deleteIncidence( const QString& aUID, bool commitNow = true );
+
+    //! \brief delete all events and todos of the notebook in one operation
+    // \return true if all of them were deleted and the deletion committed
+    bool deleteAllIncidences();
 
 private:
     bool modifyIncidence( KCalendarCore::Incidence::Ptr aIncidence, KCalendarCore::Incidence::Ptr aIncidenceData );
 
-    void filterIncidences( KCalendarCore::Incidence::List& aList );
+    void filterIncidences( KCalendarCore::Incidence::List& aList, bool aApplyWindow = true );
+
+    bool inSyncWindow( const KCalendarCore::Incidence::Ptr& aIncidence ) const;
+
+    bool hasSyncWindow() const;
+
+    bool queryIds( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime, QList<QString>& aIds );
+
+    bool queryIncidences( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime,
+                          KCalendarCore::Incidence::List& aIncidences, bool aApplyWindow = true );
+
+    QStringList supportedTypes() const;
+
+    void retrieveIds( const KCalendarCore::Incidence::List& aIncidences, QList<QString>& aIds ) const;
 
     QString                 iNotebookStr;
     mKCal::ExtendedCalendar::Ptr  iCalendar;
     mKCal::ExtendedStorage::Ptr   iStorage;
+    QSharedPointer<CalendarSession> iSession;
+    IncidenceIdQuery        iIdQuery;
+    bool                    iIdQueryAvailable;
+    bool                    iLoaded;
+    QDateTime               iWindowStart;
+    QDateTime               iWindowEnd;
+    TimeZoneCache           iTimeZones;
 
 };
 
@@ -25,6 +25,7 @@
 #include "CalendarStorage.h"
 
 #include <QFile>
+#include <QTimeZone>
 #include <QStringListIterator>
 
 #include "SimpleItem.h"
@@ -40,6 +41,9 @@
 const char* CTCAPSFILENAME11 = "CTCaps_calendar_11.xml";
 const char* CTCAPSFILENAME12 = "CTCaps_calendar_12.xml";
 
+// Number of items added between commits while refreshing from remote
+const int REFRESH_COMMIT_INTERVAL = 1000;
+
 
 CalendarStorage::CalendarStorage( const QString& aPluginName )
 : Buteo::StoragePlugin(aPluginName)
@@ -48,6 +52,9 @@ CalendarStorage::CalendarStorage( const QString& aPluginName )
 
     iCommitNow = true;
     iStorageType = VCALENDAR_FORMAT;
+    iRefresh = false;
+    iRefreshCleared = false;
+    iUncommitted = 0;
 }
 
 CalendarStorage::~CalendarStorage()
@@ -75,7 +82,29 @@ bool CalendarStorage::init( const QMap<QString, QString>& aProperties )
 
     qCDebug(lcSyncMLPlugin) << "Initializing calendar, notebook name:" <<  iProperties[NOTEBOOKNAME]; 
 
-    if( !iCalendar.init( iProperties[NOTEBOOKNAME], iProperties[Buteo::KEY_UUID] ) ) {
+    // Optional sync window around the current day
+    bool pastSet = false;
+    bool futureSet = false;
+    int pastDays = iProperties.value( SYNC_PAST_DAYS ).toInt( &pastSet );
+    int futureDays = iProperties.value( SYNC_FUTURE_DAYS ).toInt( &futureSet );
+    pastSet = pastSet && pastDays >= 0;
+    futureSet = futureSet && futureDays >= 0;
+
+    iWindowDate = QDate();
+    if( pastSet || futureSet ) {
+        QDate today = QDate::currentDate();
+        iWindowDate = today;
+        QDateTime windowStart( pastSet ? today.addDays( -pastDays ) : OLDESTDATE, QTime( 0, 0, 0 ) );
+        QDateTime windowEnd( futureSet ? today.addDays( futureDays ) : LATESTDATE, QTime( 23, 59, 59 ) );
+        qCDebug(lcSyncMLPlugin) << "Syncing incidences between" << windowStart << "and" << windowEnd;
+        iCalendar.setSyncWindow( windowStart, windowEnd );
+    }
+
+    // Incidences only need to be loaded up front when they are all going to be read
+    bool loadAll = iProperties.value( STORAGE_SYNC_DIRECTION_PROP ) != STORAGE_SYNC_DIRECTION_FROM_REMOTE;
+
+    if( !iCalendar.init( iProperties[NOTEBOOKNAME], iProperties[Buteo::KEY_UUID], loadAll,
+                         iProperties.value( STORAGE_SYNC_SESSION_PROP ) ) ) {
         return false;
     }
 
@@ -95,6 +124,34 @@ bool CalendarStorage::init( const QMap<QString, QString>& aProperties )
     iProperties[STORAGE_SYNCML_CTCAPS_PROP_11] = getCtCaps( CTCAPSFILENAME11 );
     iProperties[STORAGE_SYNCML_CTCAPS_PROP_12] = getCtCaps( CTCAPSFILENAME12 );
 
+    iRemoteCTCaps.clear();
+    if( iProperties.contains( STORAGE_REMOTE_CTCAPS_PROP ) &&
+        !iRemoteCTCaps.load( iProperties.value( STORAGE_REMOTE_CTCAPS_PROP ),
+                             iProperties.value( STORAGE_DEFAULT_MIME_PROP ) ) ) {
+        qCWarning(lcSyncMLPlugin) << "Remote CTCaps not available, exporting all incidence properties";
+    }
+
+    iRefresh = ( iProperties.value( STORAGE_REFRESH_PROP ) == PROPS_TRUE );
+    iRefreshCleared = false;
+    iUncommitted = 0;
+
+    qint64 payloadCacheSize = iProperties.value( STORAGE_PAYLOAD_CACHE_SIZE,
+                                                 QString::number( PAYLOAD_CACHE_DEFAULT_SIZE ) ).toLongLong();
+    if( payloadCacheSize > 0 &&
+        !iPayloadCache.init( SyncMLConfig::getDatabasePath() + PAYLOAD_CACHE_DB_FILE, getPluginName(),
+                             iProperties[STORAGE_DEFAULT_MIME_PROP] + " " +
+                             iProperties[STORAGE_DEFAULT_MIME_VERSION_PROP],
+                             ( iProperties[STORAGE_SYNCML_CTCAPS_PROP_11] +
+                               iProperties[STORAGE_SYNCML_CTCAPS_PROP_12] ).toUtf8() +
+                             QTimeZone::systemTimeZoneId() + iRemoteCTCaps.key(),
+                             payloadCacheSize ) ) {
+        qCWarning(lcSyncMLPlugin) << "Payload cache not available, converting all incidences";
+    }
+
+    if( !iFingerprints.init( SyncMLConfig::getDatabasePath() + FINGERPRINT_DB_FILE, getPluginName() ) ) {
+        qCWarning(lcSyncMLPlugin) << "Fingerprints not available, writing all modified incidences";
+    }
+
     return true;
 }
 
@@ -102,9 +159,60 @@ bool CalendarStorage::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iUncommitted > 0 && !iCalendar.commitChanges() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit" << iUncommitted << "added items";
+    }
+    iUncommitted = 0;
+
+    iPayloadCache.uninit();
+    iFingerprints.uninit();
+
     return iCalendar.uninit();
 }
 
+bool CalendarStorage::suspend()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iUncommitted > 0 && !iCalendar.commitChanges() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit" << iUncommitted << "added items";
+        return false;
+    }
+    iUncommitted = 0;
+
+    // Nothing the session recorded may be lost while the storage is kept
+    if( !iFingerprints.flush() ) {
+        return false;
+    }
+
+    iPayloadCache.flush();
+
+    return true;
+}
+
+bool CalendarStorage::resume()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // The sync window moves with the current day
+    if( iWindowDate.isValid() && iWindowDate != QDate::currentDate() ) {
+        qCDebug(lcSyncMLPlugin) << "Sync window is out of date, not resuming";
+        return false;
+    }
+
+    // The loaded incidences can only be trusted if nobody else has written
+    // to the database in between
+    if( !iCalendar.isCurrent() ) {
+        qCDebug(lcSyncMLPlugin) << "Calendar database changed, not resuming";
+        return false;
+    }
+
+    iRefreshCleared = false;
+    iUncommitted = 0;
+
+    return true;
+}
+
 bool CalendarStorage::getAllItems( QList<Buteo::StorageItem*>& aItems )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -131,15 +239,11 @@ bool CalendarStorage::getAllItemIds( QList<QString>& aItemIds )
 
     qCDebug(lcSyncMLPlugin) << "Retrieving all calendar events and todo's";
 
-    KCalendarCore::Incidence::List incidences;
-
-    if( !iCalendar.getAllIncidences( incidences ) ) {
+    if( !iCalendar.getAllIncidenceIds( aItemIds ) ) {
         qCDebug(lcSyncMLPlugin) << "Could not retrieve all calendar events and todo's";
         return false;
     }
 
-    retrieveIds( incidences, aItemIds );
-
     qCDebug(lcSyncMLPlugin) << "Found" << aItemIds.count() << "items";
 
     return true;
@@ -171,15 +275,11 @@ bool CalendarStorage::getNewItemIds( QList<QString>& aNewItemIds, const QDateTim
 
     qCDebug(lcSyncMLPlugin) << "Retrieving new calendar events and todo's";
 
-    KCalendarCore::Incidence::List incidences;
-
-    if( !iCalendar.getAllNew( incidences, normalizeTime( aTime ) ) ) {
+    if( !iCalendar.getAllNewIds( aNewItemIds, normalizeTime( aTime ) ) ) {
         qCDebug(lcSyncMLPlugin) << "Could not retrieve new calendar events and todo's";
         return false;
     }
 
-    retrieveIds( incidences, aNewItemIds );
-
     qCDebug(lcSyncMLPlugin) << "Found" << aNewItemIds.count() << "new items";
 
     return true;
@@ -211,15 +311,11 @@ bool CalendarStorage::getModifiedItemIds( QList<QString>& aModifiedItemIds, cons
 
     qCDebug(lcSyncMLPlugin) << "Retrieving modified calendar events and todo's";
 
-    KCalendarCore::Incidence::List incidences;
-
-    if( !iCalendar.getAllModified( incidences, normalizeTime( aTime ) ) ) {
+    if( !iCalendar.getAllModifiedIds( aModifiedItemIds, normalizeTime( aTime ) ) ) {
         qCDebug(lcSyncMLPlugin) << "Could not retrieve modified calendar events and todo's";
         return false;
     }
 
-    retrieveIds( incidences, aModifiedItemIds );
-
     qCDebug(lcSyncMLPlugin) << "Found" << aModifiedItemIds.count() << "modified items";
 
     return true;
@@ -231,15 +327,11 @@ bool CalendarStorage::getDeletedItemIds( QList<QString>& aDeletedItemIds, const
 
     qCDebug(lcSyncMLPlugin) << "Retrieving deleted calendar events and todo's";
 
-    KCalendarCore::Incidence::List incidences;
-
-    if( !iCalendar.getAllDeleted( incidences, normalizeTime( aTime ) ) ) {
+    if( !iCalendar.getAllDeletedIds( aDeletedItemIds, normalizeTime( aTime ) ) ) {
         qCDebug(lcSyncMLPlugin) << "Could not retrieve deleted calendar events and todo's";
         return false;
     }
 
-    retrieveIds( incidences, aDeletedItemIds );
-
     qCDebug(lcSyncMLPlugin) << "Found" << aDeletedItemIds.count() << "deleted items";
 
     return true;
@@ -277,7 +369,7 @@ QList<Buteo::StorageItem*> CalendarStorage::getItems( const QStringList& aItemId
     }
 
     retrieveItems( incidences, items );
- 
+
     return items;
 }
 
@@ -340,6 +432,17 @@ QList<CalendarStorage::OperationStatus> CalendarStorage::addItems( const QList<B
         results.append( addItem( *aItems[i] ) );
     }
 
+    // When loading all items from remote, commit in large transactions
+    // spanning several batches; the rest is committed in uninit()
+    if( iRefresh ) {
+        iUncommitted += aItems.count();
+        if( iUncommitted < REFRESH_COMMIT_INTERVAL ) {
+            iCommitNow = true;
+            return results;
+        }
+        iUncommitted = 0;
+    }
+
     //Do a batch commit now
     if( iCalendar.commitChanges() )
     {
@@ -355,6 +458,17 @@ CalendarStorage::OperationStatus CalendarStorage::modifyItem( Buteo::StorageItem
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    // Items identical to what was last sent or written at the current
+    // revision are not written again
+    QByteArray data;
+    aItem.read( 0, aItem.getSize(), data );
+
+    KCalendarCore::Incidence::Ptr current = iCalendar.getIncidence( aItem.getId() );
+    if( current && iFingerprints.matches( aItem.getId(), data, current->lastModified() ) ) {
+        qCDebug(lcSyncMLPlugin) << "Item unchanged, not replacing:" << aItem.getId();
+        return STATUS_OK;
+    }
+
     KCalendarCore::Incidence::Ptr item = generateIncidence( aItem );
 
     if( !item ) {
@@ -362,6 +476,9 @@ CalendarStorage::OperationStatus CalendarStorage::modifyItem( Buteo::StorageItem
         return STATUS_INVALID_FORMAT;
     }
     
+    iPayloadCache.remove( aItem.getId() );
+    iFingerprints.remove( aItem.getId() );
+
     if( !iCalendar.modifyIncidence( item, aItem.getId(), iCommitNow ) ) {
         qCWarning(lcSyncMLPlugin) << "Could not replace item:" << aItem.getId();
         // no need to delete item as item is owned by backend
@@ -370,6 +487,11 @@ CalendarStorage::OperationStatus CalendarStorage::modifyItem( Buteo::StorageItem
 
     qCDebug(lcSyncMLPlugin) << "Item successfully replaced:" << aItem.getId();
 
+    current = iCalendar.getIncidence( aItem.getId() );
+    if( current ) {
+        iFingerprints.update( aItem.getId(), data, current->lastModified() );
+    }
+
     // modifyIncidence doesn't take ownership of the item, need to delete it.
     item.clear();
 
@@ -402,7 +524,10 @@ CalendarStorage::OperationStatus CalendarStorage::deleteItem( const QString& aIt
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    CalendarBackend::ErrorStatus error =  iCalendar.deleteIncidence( aItemId);
+    iPayloadCache.remove( aItemId );
+    iFingerprints.remove( aItemId );
+
+    CalendarBackend::ErrorStatus error =  iCalendar.deleteIncidence( aItemId, iCommitNow );
     CalendarStorage::OperationStatus status = mapErrorStatus(error);
     return status;
 }
@@ -413,9 +538,36 @@ QList<CalendarStorage::OperationStatus> CalendarStorage::deleteItems( const QLis
 
     QList<OperationStatus> results;
 
+    // During refresh from remote the whole notebook is emptied at once
+    if( iRefresh ) {
+        if( !iRefreshCleared ) {
+            qCDebug(lcSyncMLPlugin) << "Refresh from remote, removing all calendar events and todo's";
+            iRefreshCleared = iCalendar.deleteAllIncidences();
+            iPayloadCache.clear();
+            iFingerprints.clear();
+        }
+        if( iRefreshCleared ) {
+            for( int i = 0; i < aItemIds.count(); ++i ) {
+                results.append( STATUS_OK );
+            }
+            return results;
+        }
+    }
+
+    // Commit once at the end of the batch
+    iCommitNow = false;
     for( int i = 0; i < aItemIds.count(); ++i ) {
         results.append( deleteItem( aItemIds[i] ) );
     }
+    iCommitNow = true;
+
+    if( !iCalendar.commitChanges() ) {
+        for( int i = 0; i < results.count(); ++i ) {
+            if( results[i] == STATUS_OK ) {
+                results[i] = STATUS_ERROR;
+            }
+        }
+    }
 
     return results;
 }
@@ -432,16 +584,15 @@ KCalendarCore::Incidence::Ptr CalendarStorage::generateIncidence( Buteo::Storage
         return incidence;
     }
 
-    QString data = QString::fromUtf8( itemData.data() );
-
-    // we are getting a temporary incidence from the calendar
+    // we are getting a temporary incidence from the calendar, the parsers
+    // take the UTF-8 data as is
     if( iStorageType == VCALENDAR_FORMAT )
     {
-        incidence = iCalendar.getIncidenceFromVcal( data );
+        incidence = iCalendar.getIncidenceFromVcal( itemData );
     }
     else
     {
-        incidence = iCalendar.getIncidenceFromIcal( data );
+        incidence = iCalendar.getIncidenceFromIcal( itemData );
     }
 
     return incidence;
@@ -461,44 +612,45 @@ Buteo::StorageItem* CalendarStorage::retrieveItem( KCalendarCore::Incidence::Ptr
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    QString data;
-
-    if(iStorageType == VCALENDAR_FORMAT)
-    {
-        data = iCalendar.getVCalString( aIncidence );
-    }
-    else
-    {
-        data = iCalendar.getICalString( aIncidence);
-    }
-
-    Buteo::StorageItem* item = newItem();
     QString iId = aIncidence->uid();
     if (aIncidence->recurrenceId().isValid()) {  
 	QString reccurId = QString(ID_SEPARATOR).append(aIncidence->recurrenceId().toString());    
        	iId.append(reccurId);
     }  
-    item->setId(iId);
-    item->write( 0, data.toUtf8() );
-    item->setType(iProperties[STORAGE_DEFAULT_MIME_PROP]);
 
-    return item;
+    // Unchanged incidences are served as previously converted
+    QByteArray data;
+    QDateTime revision = aIncidence->lastModified();
 
-}
+    if( !iPayloadCache.fetch( iId, revision, data ) )
+    {
+        if(iStorageType == VCALENDAR_FORMAT)
+        {
+            data = iCalendar.getVCalString( aIncidence ).toUtf8();
+        }
+        else
+        {
+            data = iCalendar.getICalString( aIncidence).toUtf8();
+        }
 
-void CalendarStorage::retrieveIds( KCalendarCore::Incidence::List& aIncidences, QList<QString>& aIds )
-{
-    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+        // Leave out what the remote device would discard
+        data = iRemoteCTCaps.prune( data );
 
-    for( int i = 0; i < aIncidences.count(); ++i ) {
-        QString iID = aIncidences[i]->uid();
-	if (aIncidences[i]->recurrenceId().isValid()) {  
-	    QString reccurId = QString(ID_SEPARATOR).append(aIncidences[i]->recurrenceId().toString());    
-            iID = iID.append(reccurId);
-	}  
-	aIds.append( iID );
+        if( !data.isEmpty() )
+        {
+            iPayloadCache.store( iId, revision, data );
+        }
     }
 
+    iFingerprints.update( iId, data, revision );
+
+    Buteo::StorageItem* item = newItem();
+    item->setId(iId);
+    item->write( 0, data );
+    item->setType(iProperties[STORAGE_DEFAULT_MIME_PROP]);
+
+    return item;
+
 }
 
 QDateTime CalendarStorage::normalizeTime( const QDateTime& aTime ) const
@@ -521,18 +673,13 @@ QByteArray CalendarStorage::getCtCaps( const QString& aFilename ) const
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    QFile ctCapsFile( SyncMLConfig::getXmlDataPath() + aFilename  );
-    QByteArray ctCaps;
+    QByteArray ctCaps = SyncMLConfig::getCTCaps( aFilename );
 
-    if( ctCapsFile.open(QIODevice::ReadOnly)) {
-       ctCaps = ctCapsFile.readAll();
-       ctCapsFile.close();
-    } else {
+    if( ctCaps.isEmpty() ) {
         qCWarning(lcSyncMLPlugin) << "Failed to open CTCaps file for calendar storage:" << aFilename;
     }
 
     return ctCaps;
-
 }
 
 CalendarStorage::OperationStatus CalendarStorage::mapErrorStatus\
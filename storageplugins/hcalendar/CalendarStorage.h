@@ -29,6 +29,10 @@
 #include "StoragePlugin.h"
 #include "StorageItem.h"
 #include "CalendarBackend.h"
+#include "PayloadCache.h"
+#include "FingerprintStore.h"
+#include "CTCapsTable.h"
+#include "PoolableStorage.h"
 
 #include <buteosyncfw5/StoragePlugin.h>
 #include <buteosyncfw5/StoragePluginLoader.h>
@@ -37,7 +41,7 @@
 enum STORAGE_TYPE {VCALENDAR_FORMAT,ICALENDAR_FORMAT};
 
 /// \brief StoragePlugin class for harmattan
-class CalendarStorage : public Buteo::StoragePlugin
+class CalendarStorage : public Buteo::StoragePlugin, public PoolableStorage
 {
 
 
@@ -58,6 +62,16 @@ public:
      */
     virtual bool uninit();
 
+    /*! \see PoolableStorage::suspend()
+     *
+     */
+    virtual bool suspend();
+
+    /*! \see PoolableStorage::resume()
+     *
+     */
+    virtual bool resume();
+
     /*! \see StoragePlugin::getAllItems()
      *
      */
@@ -146,8 +160,6 @@ private:
 
     Buteo::StorageItem* retrieveItem( KCalendarCore::Incidence::Ptr& aIncidence );
 
-    void retrieveIds( KCalendarCore::Incidence::List& aIncidences, QList<QString>& aIds );
-
     QDateTime normalizeTime( const QDateTime& aTime ) const;
 
     QByteArray getCtCaps( const QString& aFilename ) const;
@@ -156,9 +168,17 @@ private:
 
     CalendarBackend iCalendar;
     STORAGE_TYPE    iStorageType;
+    PayloadCache    iPayloadCache;
+    FingerprintStore iFingerprints;
+    CTCapsTable     iRemoteCTCaps;
 
     bool iCommitNow;
 
+    bool iRefresh;
+    bool iRefreshCleared;
+    int  iUncommitted;
+    QDate iWindowDate;  ///< Day the sync window was set for, null without a window
+
 };
 
 
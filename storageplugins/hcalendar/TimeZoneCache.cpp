@@ -0,0 +1,233 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "TimeZoneCache.h"
+
+#include <KCalendarCore/Event>
+#include <KCalendarCore/Todo>
+#include <KCalendarCore/ICalFormat>
+#include <KCalendarCore/MemoryCalendar>
+
+#include "SyncMLPluginLogging.h"
+
+static const QByteArray BEGIN_VTIMEZONE( "BEGIN:VTIMEZONE" );
+static const QByteArray END_VTIMEZONE( "END:VTIMEZONE" );
+static const QByteArray END_VCALENDAR( "END:VCALENDAR" );
+static const QByteArray TZID_PARAM( ";TZID=" );
+
+// Serializes a calendar that holds only the given incidence
+static QByteArray serializeCalendar( const KCalendarCore::Incidence::Ptr& aIncidence )
+{
+    KCalendarCore::Calendar::Ptr calendar( new KCalendarCore::MemoryCalendar( QTimeZone::utc() ) );
+    if( aIncidence ) {
+        calendar->addIncidence( aIncidence );
+    }
+
+    KCalendarCore::ICalFormat format;
+    return format.toString( calendar ).toUtf8();
+}
+
+// Removes the VTIMEZONE components from aData, optionally returning them
+static void takeVTimeZones( QByteArray& aData, QList<QByteArray>* aComponents )
+{
+    int start = 0;
+    while( ( start = aData.indexOf( BEGIN_VTIMEZONE, start ) ) >= 0 ) {
+        if( start > 0 && aData.at( start - 1 ) != '\n' ) {
+            start += BEGIN_VTIMEZONE.size();
+            continue;
+        }
+
+        int end = aData.indexOf( END_VTIMEZONE, start );
+        if( end < 0 ) {
+            break;
+        }
+        end = aData.indexOf( '\n', end );
+        end = ( end < 0 ) ? aData.size() : end + 1;
+
+        if( aComponents ) {
+            aComponents->append( aData.mid( start, end - start ) );
+        }
+        aData.remove( start, end - start );
+    }
+}
+
+// Returns the zone ids referenced by TZID parameters, in order of appearance
+static QList<QByteArray> referencedZoneIds( const QByteArray& aData )
+{
+    QByteArray unfolded = aData;
+    unfolded.replace( "\r\n ", "" ).replace( "\n ", "" );
+
+    QList<QByteArray> ids;
+    int pos = 0;
+    while( ( pos = unfolded.indexOf( TZID_PARAM, pos ) ) >= 0 ) {
+        pos += TZID_PARAM.size();
+
+        int end;
+        if( pos < unfolded.size() && unfolded.at( pos ) == '"' ) {
+            ++pos;
+            end = unfolded.indexOf( '"', pos );
+        }
+        else {
+            end = pos;
+            while( end < unfolded.size() && unfolded.at( end ) != ':' && unfolded.at( end ) != ';' ) {
+                ++end;
+            }
+        }
+        if( end < 0 ) {
+            break;
+        }
+
+        QByteArray id = unfolded.mid( pos, end - pos );
+        if( !id.isEmpty() && !ids.contains( id ) ) {
+            ids.append( id );
+        }
+        pos = end;
+    }
+
+    return ids;
+}
+
+// Earliest year of the times that KCalendarCore writes with a zone
+static int earliestYear( const KCalendarCore::Incidence::Ptr& aIncidence )
+{
+    QList<QDateTime> times;
+    times << aIncidence->dtStart() << aIncidence->recurrenceId();
+
+    if( aIncidence->type() == KCalendarCore::IncidenceBase::TypeEvent ) {
+        times << aIncidence.staticCast<KCalendarCore::Event>()->dtEnd();
+    }
+    else if( aIncidence->type() == KCalendarCore::IncidenceBase::TypeTodo ) {
+        times << aIncidence.staticCast<KCalendarCore::Todo>()->dtDue();
+    }
+
+    QDate earliest;
+    foreach( const QDateTime& time, times ) {
+        if( time.isValid() && ( !earliest.isValid() || time.date() < earliest ) ) {
+            earliest = time.date();
+        }
+    }
+
+    return earliest.isValid() ? earliest.year() : QDate::currentDate().year();
+}
+
+TimeZoneCache::TimeZoneCache() : iSystemTimeZoneResolved( false )
+{
+}
+
+void TimeZoneCache::clear()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iSystemTimeZone = QTimeZone();
+    iSystemTimeZoneResolved = false;
+    iVTimeZones.clear();
+    iCalendarHeader.clear();
+}
+
+QTimeZone TimeZoneCache::systemTimeZone()
+{
+    if( !iSystemTimeZoneResolved ) {
+        iSystemTimeZone = QTimeZone::systemTimeZone();
+        iSystemTimeZoneResolved = true;
+    }
+
+    return iSystemTimeZone;
+}
+
+QByteArray TimeZoneCache::vTimeZone( const QByteArray& aZoneId, int aYear )
+{
+    QByteArray key = aZoneId + ' ' + QByteArray::number( aYear );
+
+    QHash<QByteArray, QByteArray>::const_iterator it = iVTimeZones.constFind( key );
+    if( it != iVTimeZones.constEnd() ) {
+        return it.value();
+    }
+
+    // Let KCalendarCore generate the component for an event at the start of
+    // the year, which covers every transition from then on
+    QByteArray component;
+    QTimeZone zone( aZoneId );
+    if( zone.isValid() ) {
+        KCalendarCore::Event::Ptr event( new KCalendarCore::Event() );
+        event->setDtStart( QDateTime( QDate( aYear, 1, 1 ), QTime( 0, 0 ), zone ) );
+
+        QByteArray data = serializeCalendar( event );
+        QList<QByteArray> components;
+        takeVTimeZones( data, &components );
+        if( components.count() == 1 ) {
+            component = components.first();
+        }
+    }
+
+    if( component.isEmpty() ) {
+        qCDebug(lcSyncMLPlugin) << "No VTIMEZONE for zone" << aZoneId;
+    }
+
+    iVTimeZones.insert( key, component );
+    return component;
+}
+
+QString TimeZoneCache::iCalString( const KCalendarCore::Incidence::Ptr& aIncidence )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    KCalendarCore::ICalFormat format;
+    QByteArray component = format.toString( aIncidence ).toUtf8();
+
+    // Time zones are written from the cache instead
+    takeVTimeZones( component, 0 );
+
+    QByteArray data = calendarHeader();
+    bool cached = !data.isEmpty() && !component.isEmpty();
+
+    int year = earliestYear( aIncidence );
+    foreach( const QByteArray& id, referencedZoneIds( component ) ) {
+        if( !cached ) {
+            break;
+        }
+        QByteArray vTimeZoneComponent = vTimeZone( id, year );
+        cached = !vTimeZoneComponent.isEmpty();
+        data += vTimeZoneComponent;
+    }
+
+    if( !cached ) {
+        return QString::fromUtf8( serializeCalendar( aIncidence ) );
+    }
+
+    data += component;
+    if( !data.endsWith( '\n' ) ) {
+        data += "\r\n";
+    }
+    data += END_VCALENDAR + "\r\n";
+
+    return QString::fromUtf8( data );
+}
+
+QByteArray TimeZoneCache::calendarHeader()
+{
+    if( iCalendarHeader.isEmpty() ) {
+        QByteArray data = serializeCalendar( KCalendarCore::Incidence::Ptr() );
+        int end = data.lastIndexOf( END_VCALENDAR );
+        if( end > 0 ) {
+            iCalendarHeader = data.left( end );
+        }
+    }
+
+    return iCalendarHeader;
+}
@@ -0,0 +1,73 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef TIMEZONECACHE_H
+#define TIMEZONECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QTimeZone>
+
+#include <KCalendarCore/Incidence>
+
+//! \brief Per session cache of time zone data used in calendar conversions
+//
+// Resolves the system time zone once and keeps the VTIMEZONE components
+// generated for each zone, so that exporting many incidences in the same
+// zones does not compute the zone transitions again for every item.
+class TimeZoneCache
+{
+public:
+    //! \brief constructor
+    TimeZoneCache();
+
+    //! \brief Forgets everything cached, e.g. when a sync session ends
+    void clear();
+
+    //! \brief returns the system time zone, resolved on first use
+    QTimeZone systemTimeZone();
+
+    //! \brief returns the VTIMEZONE component of a zone
+    //
+    // The component covers the transitions of the zone from the start of
+    // the given year onwards.
+    // \param aZoneId IANA id of the zone
+    // \param aYear Earliest year the component must cover
+    // \return Component text, empty if the zone is unknown
+    QByteArray vTimeZone( const QByteArray& aZoneId, int aYear );
+
+    //! \brief returns ICalendar representation of incidence
+    //
+    // The output is equivalent to serializing a calendar that holds only
+    // the incidence, but the time zone components come from the cache.
+    // \param aIncidence Incidence
+    QString iCalString( const KCalendarCore::Incidence::Ptr& aIncidence );
+
+private:
+    QByteArray calendarHeader();
+
+    QTimeZone                   iSystemTimeZone;
+    bool                        iSystemTimeZoneResolved;
+    QHash<QByteArray, QByteArray> iVTimeZones;
+    QByteArray                  iCalendarHeader;
+
+};
+
+#endif // TIMEZONECACHE_H
@@ -46,6 +46,15 @@ const QString CALENDAR_FORMAT_ICAL = "icalendar";
 //The incidences before this date wont be considered for sync
 const QDate OLDESTDATE(1970,01,01);
 
+//Optional number of days before and after the current day to sync. If
+// either is set, only incidences that have an occurrence in that window
+// are synced.
+const QString SYNC_PAST_DAYS   = "Sync Past Days";
+const QString SYNC_FUTURE_DAYS = "Sync Future Days";
+
+//Window end used when only SYNC_PAST_DAYS is set
+const QDate LATESTDATE(2999,12,31);
+
 // Calendar incidence types. Needed for filtering purposes.
 #define CalendarIncidenceType QString
 const CalendarIncidenceType INCIDENDE_TYPE_ALL     = "";
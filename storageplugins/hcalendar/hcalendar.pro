@@ -15,6 +15,7 @@ VER_MAJ = 1
 VER_MIN = 0
 VER_PAT = 0
 
+QT += sql
 QT -= gui
 
 LIBS += -L../../syncmlcommon
@@ -22,9 +23,11 @@ LIBS += -L../../syncmlcommon
 HEADERS += CalendarStorage.h \
            definitions.h \
            CalendarBackend.h \
+           TimeZoneCache.h
 
 SOURCES += CalendarStorage.cpp \
-           CalendarBackend.cpp
+           CalendarBackend.cpp \
+           TimeZoneCache.cpp
 
 
 QMAKE_CXXFLAGS = -Wall \
@@ -26,8 +26,18 @@
 #include "CalendarTest.h"
 
 #include <buteosyncfw5/StorageItem.h>
+#include <buteosyncfw5/ProfileEngineDefs.h>
+#include <KCalendarCore/Event>
+#include <KCalendarCore/Journal>
+#include <KCalendarCore/Recurrence>
+#include <KCalendarCore/ICalFormat>
+#include <KCalendarCore/MemoryCalendar>
 #include <QtTest>
 
+#include "SyncMLCommon.h"
+#include "TimeZoneCache.h"
+#include "CalendarSession.h"
+
 void CalendarTest::initTestCase()
 {
     iCalendarStorage = new CalendarStorage("hcalendar");
@@ -402,4 +412,385 @@ void CalendarTest::runTestSuite( const QByteArray& aOriginalData, const QByteArr
     QVERIFY( !found );
 }
 
+void CalendarTest::testSyncWindow()
+{
+    const QString notebookUid( "buteo-window-notebook" );
+    const QDateTime now( QDateTime::currentDateTime() );
+
+    mKCal::ExtendedCalendar::Ptr calendar( new mKCal::ExtendedCalendar( QTimeZone::systemTimeZone() ) );
+    mKCal::ExtendedStorage::Ptr storage = calendar->defaultStorage( calendar );
+    QVERIFY( storage->open() );
+
+    mKCal::Notebook::Ptr notebook( new mKCal::Notebook( "window", QString() ) );
+    notebook->setUid( notebookUid );
+    QVERIFY( storage->addNotebook( notebook ) );
+
+    QStringList expected;
+    const int offsets[] = { -400, -1, 0, 400 };
+    for( int offset : offsets ) {
+        KCalendarCore::Event::Ptr event( new KCalendarCore::Event() );
+        event->setSummary( QString( "Event %1" ).arg( offset ) );
+        event->setDtStart( now.addDays( offset ) );
+        event->setDtEnd( now.addDays( offset ).addSecs( 1800 ) );
+        QVERIFY( calendar->addEvent( event, notebookUid ) );
+        if( qAbs( offset ) < 30 ) {
+            expected.append( event->uid() );
+        }
+    }
+
+    // Started long ago, but still occurs every week
+    KCalendarCore::Event::Ptr weekly( new KCalendarCore::Event() );
+    weekly->setSummary( "Weekly" );
+    weekly->setDtStart( now.addDays( -700 ) );
+    weekly->setDtEnd( now.addDays( -700 ).addSecs( 1800 ) );
+    weekly->recurrence()->setWeekly( 1 );
+    QVERIFY( calendar->addEvent( weekly, notebookUid ) );
+    expected.append( weekly->uid() );
+
+    // Ended long ago
+    KCalendarCore::Event::Ptr ended( new KCalendarCore::Event() );
+    ended->setSummary( "Ended" );
+    ended->setDtStart( now.addDays( -700 ) );
+    ended->setDtEnd( now.addDays( -700 ).addSecs( 1800 ) );
+    ended->recurrence()->setDaily( 1 );
+    ended->recurrence()->setDuration( 10 );
+    QVERIFY( calendar->addEvent( ended, notebookUid ) );
+
+    QVERIFY( storage->save() );
+
+    CalendarStorage calendarStorage( "hcalendar" );
+    QMap<QString, QString> props;
+    props[NOTEBOOKNAME] = "window";
+    props[Buteo::KEY_UUID] = notebookUid;
+    props[SYNC_PAST_DAYS] = "30";
+    props[SYNC_FUTURE_DAYS] = "30";
+    QVERIFY( calendarStorage.init( props ) );
+
+    QList<QString> ids;
+    QVERIFY( calendarStorage.getAllItemIds( ids ) );
+    QStringList found( ids );
+    found.sort();
+    expected.sort();
+    QCOMPARE( found, expected );
+
+    ids.clear();
+    QVERIFY( calendarStorage.getNewItemIds( ids, now.addYears( -1 ) ) );
+    QCOMPARE( ids.count(), expected.count() );
+
+    QList<Buteo::StorageItem*> items;
+    QVERIFY( calendarStorage.getAllItems( items ) );
+    QCOMPARE( items.count(), expected.count() );
+    qDeleteAll( items );
+
+    QVERIFY( calendarStorage.uninit() );
+
+    QVERIFY( storage->deleteNotebook( notebook ) );
+    storage->close();
+}
+
+void CalendarTest::benchmarkMixedNotebook()
+{
+    const int eventCount = 10000;
+    const int journalCount = 1000;
+    const QString notebookUid( "buteo-benchmark-notebook" );
+
+    // Populate a notebook with events and notes directly through mKCal
+    mKCal::ExtendedCalendar::Ptr calendar( new mKCal::ExtendedCalendar( QTimeZone::systemTimeZone() ) );
+    mKCal::ExtendedStorage::Ptr storage = calendar->defaultStorage( calendar );
+    QVERIFY( storage->open() );
+
+    mKCal::Notebook::Ptr notebook( new mKCal::Notebook( "benchmark", QString() ) );
+    notebook->setUid( notebookUid );
+    QVERIFY( storage->addNotebook( notebook ) );
+
+    QDateTime start( QDate( 2020, 1, 1 ), QTime( 10, 0 ), Qt::UTC );
+    for( int i = 0; i < eventCount; ++i ) {
+        KCalendarCore::Event::Ptr event( new KCalendarCore::Event() );
+        event->setSummary( QString( "Event %1" ).arg( i ) );
+        event->setDtStart( start.addSecs( i * 3600 ) );
+        event->setDtEnd( start.addSecs( i * 3600 + 1800 ) );
+        QVERIFY( calendar->addEvent( event, notebookUid ) );
+    }
+    for( int i = 0; i < journalCount; ++i ) {
+        KCalendarCore::Journal::Ptr journal( new KCalendarCore::Journal() );
+        journal->setDescription( QString( "Note %1" ).arg( i ) );
+        QVERIFY( calendar->addJournal( journal, notebookUid ) );
+    }
+    QVERIFY( storage->save() );
+
+    CalendarStorage calendarStorage( "hcalendar" );
+    QMap<QString, QString> props;
+    props[NOTEBOOKNAME] = "benchmark";
+    props[Buteo::KEY_UUID] = notebookUid;
+    QVERIFY( calendarStorage.init( props ) );
+
+    QList<QString> ids;
+    QBENCHMARK {
+        ids.clear();
+        QVERIFY( calendarStorage.getAllItemIds( ids ) );
+    }
+    // Notes must be left out and no event may be skipped
+    QCOMPARE( ids.count(), eventCount );
+
+    ids.clear();
+    QBENCHMARK {
+        ids.clear();
+        QVERIFY( calendarStorage.getNewItemIds( ids, start.addYears( -1 ) ) );
+    }
+    QCOMPARE( ids.count(), eventCount );
+
+    QVERIFY( calendarStorage.uninit() );
+
+    QVERIFY( storage->deleteNotebook( notebook ) );
+    storage->close();
+}
+
+void CalendarTest::benchmarkRefresh()
+{
+    const int eventCount = 10000;
+    const int batchSize = 100;
+    const QString notebookUid( "buteo-refresh-notebook" );
+
+    // Populate a notebook with events directly through mKCal
+    mKCal::ExtendedCalendar::Ptr calendar( new mKCal::ExtendedCalendar( QTimeZone::systemTimeZone() ) );
+    mKCal::ExtendedStorage::Ptr storage = calendar->defaultStorage( calendar );
+    QVERIFY( storage->open() );
+
+    mKCal::Notebook::Ptr notebook( new mKCal::Notebook( "refresh", QString() ) );
+    notebook->setUid( notebookUid );
+    QVERIFY( storage->addNotebook( notebook ) );
+
+    QDateTime start( QDate( 2020, 1, 1 ), QTime( 10, 0 ), Qt::UTC );
+    for( int i = 0; i < eventCount; ++i ) {
+        KCalendarCore::Event::Ptr event( new KCalendarCore::Event() );
+        event->setSummary( QString( "Event %1" ).arg( i ) );
+        event->setDtStart( start.addSecs( i * 3600 ) );
+        event->setDtEnd( start.addSecs( i * 3600 + 1800 ) );
+        QVERIFY( calendar->addEvent( event, notebookUid ) );
+    }
+    QVERIFY( storage->save() );
+
+    QMap<QString, QString> props;
+    props[NOTEBOOKNAME] = "refresh";
+    props[Buteo::KEY_UUID] = notebookUid;
+    props[STORAGE_REFRESH_PROP] = PROPS_TRUE;
+
+    CalendarStorage calendarStorage( "hcalendar" );
+    QVERIFY( calendarStorage.init( props ) );
+
+    QList<QString> ids;
+    QVERIFY( calendarStorage.getAllItemIds( ids ) );
+    QCOMPARE( ids.count(), eventCount );
+
+    // Wipe the notebook, as the stack does before loading the remote items
+    QList<Buteo::StoragePlugin::OperationStatus> results;
+    QBENCHMARK_ONCE {
+        results = calendarStorage.deleteItems( ids );
+    }
+    QCOMPARE( results.count(), eventCount );
+    QVERIFY( !results.contains( Buteo::StoragePlugin::STATUS_ERROR ) );
+
+    ids.clear();
+    QVERIFY( calendarStorage.getAllItemIds( ids ) );
+    QCOMPARE( ids.count(), 0 );
+
+    // Load the same amount of items in message sized batches
+    QList<QList<Buteo::StorageItem*> > batches;
+    for( int i = 0; i < eventCount; ++i ) {
+        if( i % batchSize == 0 ) {
+            batches.append( QList<Buteo::StorageItem*>() );
+        }
+        QDateTime dtStart = start.addSecs( i * 3600 );
+        Buteo::StorageItem* item = calendarStorage.newItem();
+        QVERIFY( item->write( 0, QByteArray( "BEGIN:VCALENDAR\r\n"
+                                             "VERSION:1.0\r\n"
+                                             "BEGIN:VEVENT\r\n"
+                                             "SUMMARY:Event " ) + QByteArray::number( i ) +
+                                 "\r\nDTSTART:" + dtStart.toString( "yyyyMMddThhmmssZ" ).toLatin1() +
+                                 "\r\nDTEND:" + dtStart.addSecs( 1800 ).toString( "yyyyMMddThhmmssZ" ).toLatin1() +
+                                 "\r\nEND:VEVENT\r\n"
+                                 "END:VCALENDAR\r\n" ) );
+        batches.last().append( item );
+    }
+
+    QBENCHMARK_ONCE {
+        foreach( const QList<Buteo::StorageItem*>& batch, batches ) {
+            results = calendarStorage.addItems( batch );
+        }
+        QVERIFY( calendarStorage.uninit() );
+    }
+    QVERIFY( !results.contains( Buteo::StoragePlugin::STATUS_ERROR ) );
+
+    foreach( const QList<Buteo::StorageItem*>& batch, batches ) {
+        qDeleteAll( batch );
+    }
+
+    // Everything must have been committed by uninit()
+    props.remove( STORAGE_REFRESH_PROP );
+    QVERIFY( calendarStorage.init( props ) );
+    ids.clear();
+    QVERIFY( calendarStorage.getAllItemIds( ids ) );
+    QCOMPARE( ids.count(), eventCount );
+    QVERIFY( calendarStorage.uninit() );
+
+    QVERIFY( storage->deleteNotebook( notebook ) );
+    storage->close();
+}
+
+void CalendarTest::testSharedSession()
+{
+    // Backends of the same process share one open calendar
+    CalendarBackend first;
+    CalendarBackend second;
+    QVERIFY( first.init( "session-first", "buteo-session-first" ) );
+    QVERIFY( second.init( "session-second", "buteo-session-second" ) );
+
+    QSharedPointer<CalendarSession> session = CalendarSession::acquire();
+    QVERIFY( session );
+    QCOMPARE( CalendarSession::acquire(), session );
+
+    // Sync sessions running at the same time do not share it
+    QSharedPointer<CalendarSession> other = CalendarSession::acquire( "other-sync-session" );
+    QVERIFY( other );
+    QVERIFY( other != session );
+    QCOMPARE( CalendarSession::acquire( "other-sync-session" ), other );
+    other.clear();
+
+    // Incidences are only visible in their own notebook
+    KCalendarCore::Event::Ptr event( new KCalendarCore::Event() );
+    event->setSummary( "Shared session" );
+    event->setDtStart( QDateTime( QDate( 2020, 1, 1 ), QTime( 10, 0 ), Qt::UTC ) );
+    QVERIFY( first.addIncidence( event ) );
+
+    QVERIFY( first.getIncidence( event->uid() ) );
+    QVERIFY( !second.getIncidence( event->uid() ) );
+    QVERIFY( session->incidence( "buteo-session-first", event->uid() ) );
+    QVERIFY( !session->incidence( "buteo-session-second", event->uid() ) );
+
+    // A loaded notebook is not loaded again
+    QVERIFY( session->loadNotebook( "buteo-session-first" ) );
+    QVERIFY( session->loadNotebook( "buteo-session-first" ) );
+
+    QVERIFY( first.deleteAllIncidences() );
+    QVERIFY( first.uninit() );
+
+    // Still open for the remaining user
+    QList<QString> ids;
+    QVERIFY( second.getAllIncidenceIds( ids ) );
+    QVERIFY( ids.isEmpty() );
+    QVERIFY( second.uninit() );
+
+    foreach( const QString& uid, QStringList() << "buteo-session-first" << "buteo-session-second" ) {
+        mKCal::Notebook::Ptr notebook = session->storage()->notebook( uid );
+        if( notebook ) {
+            QVERIFY( session->storage()->deleteNotebook( notebook ) );
+        }
+    }
+}
+
+// Weekly recurring events with exceptions spread over a few time zones
+static KCalendarCore::Incidence::List recurringEvents( int aCount )
+{
+    QList<QTimeZone> zones;
+    zones << QTimeZone( "Europe/Helsinki" ) << QTimeZone( "America/New_York" )
+          << QTimeZone( "Asia/Kolkata" ) << QTimeZone( "Australia/Sydney" );
+
+    KCalendarCore::Incidence::List events;
+    for( int i = 0; i < aCount; ++i ) {
+        QDateTime dtStart( QDate( 2018 + i % 3, 1 + i % 12, 1 + i % 28 ), QTime( 9, 0 ), zones.at( i % zones.count() ) );
+
+        KCalendarCore::Event::Ptr event( new KCalendarCore::Event() );
+        event->setSummary( QString( "Meeting %1" ).arg( i ) );
+        event->setDtStart( dtStart );
+        event->setDtEnd( dtStart.addSecs( 3600 ) );
+        event->recurrence()->setWeekly( 1 );
+        event->recurrence()->setEndDate( dtStart.date().addYears( 1 ) );
+        event->recurrence()->addExDateTime( dtStart.addDays( 7 ) );
+        events.append( event );
+    }
+
+    return events;
+}
+
+static KCalendarCore::Incidence::Ptr parseICal( const QString& aData )
+{
+    KCalendarCore::Calendar::Ptr calendar( new KCalendarCore::MemoryCalendar( QTimeZone::utc() ) );
+    KCalendarCore::ICalFormat format;
+    format.fromString( calendar, aData );
+
+    KCalendarCore::Incidence::List incidences = calendar->rawIncidences();
+    return incidences.isEmpty() ? KCalendarCore::Incidence::Ptr() : incidences.first();
+}
+
+void CalendarTest::testTimeZoneCache()
+{
+    TimeZoneCache cache;
+
+    QCOMPARE( cache.systemTimeZone(), QTimeZone::systemTimeZone() );
+
+    QVERIFY( !cache.vTimeZone( "Europe/Helsinki", 2020 ).isEmpty() );
+    QVERIFY( cache.vTimeZone( "Europe/Helsinki", 2020 ).startsWith( "BEGIN:VTIMEZONE" ) );
+    QVERIFY( cache.vTimeZone( "Europe/Helsinki", 2020 ).contains( "TZID:Europe/Helsinki" ) );
+    QVERIFY( cache.vTimeZone( "No/Such_Zone", 2020 ).isEmpty() );
+
+    foreach( const KCalendarCore::Incidence::Ptr& event, recurringEvents( 8 ) ) {
+        QString data = cache.iCalString( event );
+        QCOMPARE( data.count( "BEGIN:VTIMEZONE" ), 1 );
+        QVERIFY( data.contains( "TZID:" + event->dtStart().timeZone().id() ) );
+
+        // Must read back the same as the incidence written
+        KCalendarCore::Incidence::Ptr parsed = parseICal( data );
+        QVERIFY( parsed );
+        QCOMPARE( parsed->summary(), event->summary() );
+        QCOMPARE( parsed->dtStart(), event->dtStart() );
+        QCOMPARE( parsed->dtStart().timeZone(), event->dtStart().timeZone() );
+        QCOMPARE( parsed.staticCast<KCalendarCore::Event>()->dtEnd(),
+                  event.staticCast<KCalendarCore::Event>()->dtEnd() );
+        QCOMPARE( parsed->recurrence()->exDateTimes(), event->recurrence()->exDateTimes() );
+        QCOMPARE( parsed->recurrence()->endDate(), event->recurrence()->endDate() );
+    }
+
+    // Incidences without zones are written without time zone components
+    KCalendarCore::Event::Ptr utcEvent( new KCalendarCore::Event() );
+    utcEvent->setSummary( "UTC" );
+    utcEvent->setDtStart( QDateTime( QDate( 2020, 1, 1 ), QTime( 10, 0 ), Qt::UTC ) );
+    QString data = cache.iCalString( utcEvent );
+    QVERIFY( !data.contains( "BEGIN:VTIMEZONE" ) );
+    QVERIFY( parseICal( data ) );
+    QCOMPARE( parseICal( data )->dtStart(), utcEvent->dtStart() );
+}
+
+void CalendarTest::benchmarkICalExport_data()
+{
+    QTest::addColumn<bool>( "cached" );
+
+    QTest::newRow( "per item" ) << false;
+    QTest::newRow( "cached" ) << true;
+}
+
+void CalendarTest::benchmarkICalExport()
+{
+    QFETCH( bool, cached );
+
+    const int eventCount = 2000;
+    KCalendarCore::Incidence::List events = recurringEvents( eventCount );
+
+    QBENCHMARK_ONCE {
+        TimeZoneCache cache;
+        foreach( const KCalendarCore::Incidence::Ptr& event, events ) {
+            QString data;
+            if( cached ) {
+                data = cache.iCalString( event );
+            }
+            else {
+                KCalendarCore::Calendar::Ptr calendar( new KCalendarCore::MemoryCalendar( QTimeZone::utc() ) );
+                calendar->addIncidence( KCalendarCore::Incidence::Ptr( event->clone() ) );
+                KCalendarCore::ICalFormat format;
+                data = format.toString( calendar );
+            }
+            QVERIFY( !data.isEmpty() );
+        }
+    }
+}
+
 QTEST_MAIN(CalendarTest)
@@ -44,6 +44,20 @@ private slots:
 
     void testSuite();
 
+    void testSyncWindow();
+
+    void benchmarkMixedNotebook();
+
+    void benchmarkRefresh();
+
+    void testSharedSession();
+
+    void testTimeZoneCache();
+
+    void benchmarkICalExport_data();
+
+    void benchmarkICalExport();
+
 private:
     void runTestSuite(const QByteArray& aOriginalData, const QByteArray& aModifiedData);
 
@@ -14,12 +14,14 @@ INCLUDEPATH += . \
 HEADERS += CalendarTest.h \
            CalendarStorage.h \
            CalendarBackend.h \
+           TimeZoneCache.h \
            SimpleItem.h \
            SyncMLConfig.h
 
 SOURCES += CalendarTest.cpp \
            CalendarStorage.cpp \
            CalendarBackend.cpp \
+           TimeZoneCache.cpp \
            SimpleItem.cpp \
            SyncMLConfig.cpp
 
@@ -31,6 +31,8 @@
 #include <seasidepropertyhandler.h>
 
 #include "SyncMLPluginLogging.h"
+#include "Base64Codec.h"
+#include "VCardTokenizer.h"
 
 #include <QVersitContactExporter>
 #include <QVersitContactImporter>
@@ -49,12 +51,57 @@
 
 #include <QBuffer>
 #include <QSet>
+#include <QCryptographicHash>
+#include <QDataStream>
 
+// Adds a detail value to a digest, lists value by value and binary values
+// as they are
+static void addToDigest(QCryptographicHash &aHash, const QVariant &aValue)
+{
+    if (aValue.type() == QVariant::ByteArray) {
+        aHash.addData(aValue.toByteArray());
+    }
+    else if (aValue.type() == QVariant::DateTime) {
+        aHash.addData(aValue.toDateTime().toString(Qt::ISODateWithMs).toUtf8());
+    }
+    else if (aValue.type() != QVariant::String && aValue.canConvert<QVariantList>()) {
+        foreach (const QVariant &value, aValue.value<QVariantList>()) {
+            addToDigest(aHash, value);
+            aHash.addData("\n", 1);
+        }
+    }
+    else if (aValue.canConvert<QString>()) {
+        aHash.addData(aValue.toString().toUtf8());
+    }
+    else {
+        // Images and other types without a text form
+        QByteArray data;
+        QDataStream stream(&data, QIODevice::WriteOnly);
+        stream << aValue;
+        aHash.addData(data);
+    }
+}
+
+// Case-insensitive position of the last END:VCARD in UTF-8 data, -1 if none
+static int lastIndexOfEndVCard(const QByteArray &aVCard)
+{
+    static const char END_VCARD[] = "END:VCARD";
+    const int length = sizeof(END_VCARD) - 1;
+
+    for (int i = aVCard.size() - length; i >= 0; --i) {
+        if (qstrnicmp(aVCard.constData() + i, END_VCARD, length) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
 
 ContactsBackend::ContactsBackend(QVersitDocument::VersitType aVCardVer, const QString &syncTarget, const QString &originId) :
 iReadMgr(NULL), iWriteMgr(NULL), iVCardVer(aVCardVer) //CID 26531
     , iSyncTarget(syncTarget)
     , iOriginId(originId)
+    , iPhotoScaler(NULL)
 {
         FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 }
@@ -152,7 +199,7 @@ QList<QContactLocalId> ContactsBackend::getAllDeletedContactIds(const QDateTime
         return idList;
 }
 
-bool ContactsBackend::addContacts( const QStringList& aContactDataList,
+bool ContactsBackend::addContacts( const QList<QByteArray>& aContactDataList,
                                    QMap<int, ContactsStatus>& aStatusMap )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -204,7 +251,7 @@ bool ContactsBackend::addContacts( const QStringList& aContactDataList,
     return retVal;
 }
 
-QContactManager::Error ContactsBackend::modifyContact(const QString &aID, const QString &aContact)
+QContactManager::Error ContactsBackend::modifyContact(const QString &aID, const QByteArray &aContact)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
     qCDebug(lcSyncMLPlugin) << "Modifying a Contact with ID" << aID;
@@ -217,7 +264,7 @@ QContactManager::Error ContactsBackend::modifyContact(const QString &aID, const
         QContact oldContactData;
         getContact(QContactId::fromString (aID), oldContactData);
 
-        QList<QVersitDocument> documents = convertVCardListToVersitDocumentList(QStringList() << aContact);
+        QList<QVersitDocument> documents = convertVCardListToVersitDocumentList(QList<QByteArray>() << aContact);
         if (documents.size() < 1) {
             qCWarning(lcSyncMLPlugin) << "Not a valid vCard:" << aContact;
             return QContactManager::UnspecifiedError;
@@ -255,7 +302,7 @@ QContactManager::Error ContactsBackend::modifyContact(const QString &aID, const
 }
 
 QMap<int,ContactsStatus> ContactsBackend::modifyContacts(
-    const QStringList &aVCardDataList, const QStringList &aContactIdList)
+    const QList<QByteArray> &aVCardDataList, const QStringList &aContactIdList)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
@@ -304,8 +351,12 @@ QMap<int,ContactsStatus> ContactsBackend::modifyContacts(
             if( !errors.contains(i) ) {
                 qCDebug(lcSyncMLPlugin) << "No error for contact with id " << contactId << " and index " << i;
                 status.errorCode = QContactManager::NoError;
+                // The backend stamps the saved contacts, no need to read
+                // them back
+                status.lastModified = getModificationTime(contacts.at(i));
             } else {
                 qCDebug(lcSyncMLPlugin) << "contact with id " << contactId << " and index " << i <<" is in error";
+                status.lastModified = QDateTime();
                 QContactManager::Error errorCode = errors.value(i);
                 status.errorCode = errorCode;
             }
@@ -392,27 +443,36 @@ void ContactsBackend::prepareContactSave(QList<QContact> *contactList)
     }
 }
 
-QList<QVersitDocument> ContactsBackend::convertVCardListToVersitDocumentList(const QStringList &aVCardList)
+QList<QVersitDocument> ContactsBackend::convertVCardListToVersitDocumentList(const QList<QByteArray> &aVCardList)
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     QList<QVersitDocument> retn;
-    Q_FOREACH (const QString &vCard, aVCardList) {
+    Q_FOREACH (const QByteArray &vCard, aVCardList) {
         // remove any characters after the END:VCARD stanza.
         // importantly, we do NOT ensure it ends in \r\n or \r\n\r\n
         // TODO: fix QVersitReader to strip \r\n and \r\n\r\n endings.
-        int endIdx = vCard.lastIndexOf(QStringLiteral("END:VCARD"), -1, Qt::CaseInsensitive);
-        QString modifiedVCard = vCard.mid(0, endIdx + 9); /* 9 = strlen("END:VCARD") */
+        // The data is UTF-8, so the ASCII marker can be searched bytewise
+        // and the result shares the item's buffer when nothing is cut.
+        int endIdx = lastIndexOfEndVCard(vCard);
+        QByteArray vCardData = endIdx < 0 ? vCard : vCard.left(endIdx + 9); /* 9 = strlen("END:VCARD") */
+
+        // well-formed vCards are parsed directly, the rest by the versit reader
+        QVersitDocument document;
+        if (VCardTokenizer::parse(vCardData, document)) {
+            retn.append(document);
+            continue;
+        }
 
         // convert the vCard to a contact.
-        QVersitReader versitReader(modifiedVCard.toUtf8());
+        QVersitReader versitReader(vCardData);
         versitReader.startReading();
         versitReader.waitForFinished();
 
         QList<QVersitDocument> results = versitReader.results();
         if (results.size() == 0) {
             qCWarning(lcSyncMLPlugin) << "Unable to convert vCard to versit document:" << versitReader.error() << ":";
-            QStringList erroneousVCardLines = modifiedVCard.split('\n', QString::KeepEmptyParts);
+            QStringList erroneousVCardLines = QString::fromUtf8(vCardData).split('\n', QString::KeepEmptyParts);
             Q_FOREACH(QString line, erroneousVCardLines) {
                 if (line.contains(':') || line.trimmed().isEmpty()) {
                     line.replace('\r', "<CR>");
@@ -422,7 +482,7 @@ QList<QVersitDocument> ContactsBackend::convertVCardListToVersitDocumentList(con
             }
             return QList<QVersitDocument>();
         } else if (versitReader.results().size() > 1) {
-            qCWarning(lcSyncMLPlugin) << "Multiple contacts from single vCard:" << modifiedVCard;
+            qCWarning(lcSyncMLPlugin) << "Multiple contacts from single vCard:" << vCardData;
         }
 
         retn.append(results.first());
@@ -456,6 +516,39 @@ QString ContactsBackend::convertQContactToVCard(const QContact &aContact)
                 QList<QVersitDocument> versitDocumentList;
                 versitDocumentList = contactExporter.documents();
 
+                // Leave out what the remote device would discard, scale
+                // photos down to what it can use, and encode binary values
+                bool scalePhotos = iPhotoScaler && iPhotoScaler->isEnabled();
+                for (int i = 0; i < versitDocumentList.count(); ++i) {
+                        QList<QVersitProperty> properties;
+                        foreach (QVersitProperty property, versitDocumentList[i].properties()) {
+                                if (!iRemoteCTCaps.hasProperty(property.name())) {
+                                        continue;
+                                }
+                                if (property.variantValue().type() != QVariant::ByteArray) {
+                                        properties.append(property);
+                                        continue;
+                                }
+                                QByteArray data = property.variantValue().toByteArray();
+                                if (scalePhotos && property.name() == QLatin1String("PHOTO")) {
+                                        QByteArray scaled = iPhotoScaler->scale(data);
+                                        if (scaled.isEmpty()) {
+                                                continue;
+                                        }
+                                        if (scaled != data) {
+                                                QMultiHash<QString, QString> parameters = property.parameters();
+                                                parameters.remove(QStringLiteral("TYPE"));
+                                                parameters.insert(QStringLiteral("TYPE"), QStringLiteral("JPEG"));
+                                                property.setParameters(parameters);
+                                                data = scaled;
+                                        }
+                                }
+                                encodeBinaryProperty(property, data);
+                                properties.append(property);
+                        }
+                        versitDocumentList[i].setProperties(properties);
+                }
+
                 QBuffer writeBuf;
                 writeBuf.open(QBuffer::ReadWrite);
 
@@ -475,6 +568,39 @@ QString ContactsBackend::convertQContactToVCard(const QContact &aContact)
         return vCard;
 }
 
+void ContactsBackend::setRemoteCTCaps(const CTCapsTable &aCTCaps)
+{
+        FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+        iRemoteCTCaps = aCTCaps;
+}
+
+void ContactsBackend::setPhotoScaler(PhotoScaler *aPhotoScaler)
+{
+        FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+        iPhotoScaler = aPhotoScaler;
+}
+
+void ContactsBackend::encodeBinaryProperty(QVersitProperty &aProperty, const QByteArray &aData) const
+{
+        // vCard 2.1 folds base64 values and ends them with a blank line,
+        // which the writer only does for values it encodes itself
+        if (iVCardVer == QVersitDocument::VCard21Type) {
+                aProperty.setValue(aData);
+                return;
+        }
+
+        // The value is written as is, so the parameters the writer would add
+        // for binary values are set here
+        QMultiHash<QString, QString> parameters = aProperty.parameters();
+        parameters.remove(QStringLiteral("ENCODING"));
+        parameters.insert(QStringLiteral("ENCODING"), QStringLiteral("b"));
+        aProperty.setParameters(parameters);
+        aProperty.setValue(QString::fromLatin1(Base64Codec::encode(aData)));
+        aProperty.setValueType(QVersitProperty::PreformattedType);
+}
+
 QMap<QString, QString> ContactsBackend::convertQContactListToVCardList(
     const QList<QContact> & aContactList)
 {
@@ -624,6 +750,39 @@ QDateTime ContactsBackend::getCreationTime( const QContact& aContact )
     return contactTimestamp.created();
 }
 
+QDateTime ContactsBackend::getModificationTime( const QContact& aContact )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QContactTimestamp contactTimestamp = aContact.detail<QContactTimestamp>();
+
+    return contactTimestamp.lastModified();
+}
+
+QByteArray ContactsBackend::getDigest( const QContact& aContact )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+
+    foreach( const QContactDetail& detail, aContact.details() ) {
+        hash.addData( QByteArray::number( detail.type() ) );
+
+        QMap<int, QVariant> values = detail.values();
+        QMap<int, QVariant>::const_iterator i;
+        for( i = values.constBegin(); i != values.constEnd(); ++i ) {
+            hash.addData( "\t", 1 );
+            hash.addData( QByteArray::number( i.key() ) );
+            hash.addData( "=", 1 );
+            addToDigest( hash, i.value() );
+        }
+
+        hash.addData( "\n", 1 );
+    }
+
+    return hash.result();
+}
+
 QList<QDateTime> ContactsBackend::getCreationTimes( const QList<QContactLocalId>& aContactIds )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -694,3 +853,35 @@ QList<QDateTime> ContactsBackend::getCreationTimes( const QList<QContactLocalId>
 
     return creationTimes;
 }
+
+QHash<QString, QDateTime> ContactsBackend::getModificationTimes( const QList<QContactLocalId>& aContactIds )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    Q_ASSERT( iReadMgr );
+
+    QHash<QString, QDateTime> modificationTimes;
+
+    QContactIdFilter contactFilter;
+    contactFilter.setIds(aContactIds);
+
+    // Only the timestamps are needed, see getCreationTimes()
+    QList<QContactDetail::DetailType> detailTypes;
+    detailTypes << QContactTimestamp::Type;
+
+    QContactFetchHint contactHint;
+    contactHint.setOptimizationHints( QContactFetchHint::NoRelationships |
+                                      QContactFetchHint::NoActionPreferences |
+                                      QContactFetchHint::NoBinaryBlobs );
+
+    contactHint.setDetailTypesHint (detailTypes);
+
+    QList<QContact> contacts = iReadMgr->contacts( contactFilter, QList<QContactSortOrder>(), contactHint );
+
+    foreach( const QContact& contact, contacts )
+    {
+        modificationTimes.insert( contact.id().toString(), getModificationTime( contact ) );
+    }
+
+    return modificationTimes;
+}
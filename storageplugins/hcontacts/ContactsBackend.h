@@ -28,7 +28,13 @@
 #include <QContactChangeLogFilter>
 #include <QContactId>
 #include <QVersitDocument>
+#include <QVersitProperty>
 #include <QStringList>
+#include <QHash>
+#include <QDateTime>
+
+#include "CTCapsTable.h"
+#include "PhotoScaler.h"
 
 using namespace QtContacts;
 using namespace QtVersit;
@@ -40,6 +46,7 @@ struct ContactsStatus
 {
     QString id;
     QContactManager::Error errorCode;
+    QDateTime lastModified;
 };
 
 //! \brief Harmattan Contact storage plugin backend interface class
@@ -131,11 +138,11 @@ public:
 
     /*!
      * \brief Batch addition of contacts
-     * @param aContactDataList Contact data
+     * @param aContactDataList Contact data as UTF-8 vCards
      * @param aStatusMap Returned status data
      * @return Errors
      */
-    bool addContacts( const QStringList &aContactDataList,
+    bool addContacts( const QList<QByteArray> &aContactDataList,
                       QMap<int, ContactsStatus> &aStatusMap );
 
     // Functions for modifying contacts
@@ -143,18 +150,18 @@ public:
     /*!
      * \brief Modify a contact that whose data and ID are  given as Input
      * @param id Contact ID
-     * @param contactdata Contact data
+     * @param contactdata Contact data as a UTF-8 vCard
      * @return Error
      */
-    QContactManager::Error modifyContact(const QString &id, const QString &contactdata);
+    QContactManager::Error modifyContact(const QString &id, const QByteArray &contactdata);
 
     /*!
      * \brief Batch modification
-     * @param aContactDataList Contact data
+     * @param aContactDataList Contact data as UTF-8 vCards
      * @param aContactsIdList Contact IDs
-     * @return Errors
+     * @return Errors, with the modification times of the saved contacts
      */
-    QMap<int, ContactsStatus> modifyContacts(const QStringList &aContactDataList,
+    QMap<int, ContactsStatus> modifyContacts(const QList<QByteArray> &aContactDataList,
                                              const QStringList &aContactsIdList);
 
     /*!
@@ -185,6 +192,23 @@ public:
      */
     QDateTime getCreationTime( const QContact& aContact );
 
+    /*! \brief Return last modification time of single contact
+     *
+     * @param aContact Contact
+     * @return Last modification time
+     */
+    QDateTime getModificationTime( const QContact& aContact );
+
+    /*! \brief Returns a digest of the details of a contact
+     *
+     * Modification times have a precision of one second, the digest tells
+     * apart changes made within the same second.
+     *
+     * @param aContact Contact
+     * @return Digest of the contact details
+     */
+    QByteArray getDigest( const QContact& aContact );
+
     /*! \brief Returns creation times of the contacts
      *
      * @param aContactIds Ids of the contacts
@@ -192,6 +216,13 @@ public:
      */
     QList<QDateTime> getCreationTimes( const QList<QContactLocalId>& aContactIds );
 
+    /*! \brief Returns last modification times of the contacts
+     *
+     * @param aContactIds Ids of the contacts
+     * @return Last modification times by id, missing contacts are left out
+     */
+    QHash<QString, QDateTime> getModificationTimes( const QList<QContactLocalId>& aContactIds );
+
 
     /*! \brief Converts a QContact to a VCard
      *
@@ -199,14 +230,37 @@ public:
      * @return VCard
      */
     QString convertQContactToVCard(const QContact &aContact);
+
+    /*! \brief Sets the capabilities of the remote device
+     *
+     * Properties the remote device does not support are left out of the
+     * vCards converted after this.
+     *
+     * @param aCTCaps CTCaps of the remote device, empty to export everything
+     */
+    void setRemoteCTCaps(const CTCapsTable &aCTCaps);
+
+    /*! \brief Sets the scaler for the photos of exported contacts
+     *
+     * @param aPhotoScaler Photo scaler, owned by the caller. NULL to export photos as is
+     */
+    void setPhotoScaler(PhotoScaler *aPhotoScaler);
 private: // functions
 
     QMap<QString, QString> convertQContactListToVCardList \
                                         (const QList<QContact> &aContactList);
     QList<QVersitDocument> convertVCardListToVersitDocumentList \
-                                (const QStringList &aVCardList);
+                                (const QList<QByteArray> &aVCardList);
     void prepareContactSave(QList<QContact> *contactList);
 
+    /*!
+     * \brief Sets the binary value of a property, replaced with its base64
+     *        encoding for vCard 3.0
+     * @param aProperty Property to encode
+     * @param aData Binary value of the property
+     */
+    void encodeBinaryProperty(QVersitProperty &aProperty, const QByteArray &aData) const;
+
     /*!
      * \brief Returns contact IDs specified by event type and timestamp
      * @param aEventType Added/changed/removed contacts
@@ -226,6 +280,10 @@ private: // data
 
     QString iSyncTarget;    ///< syncTarget to use for contact details
     QString iOriginId;      ///< origin meta-data ID to use for contact details
+
+    CTCapsTable iRemoteCTCaps;  ///< Capabilities of the remote device
+
+    PhotoScaler *iPhotoScaler;  ///< Scaler for exported photos, not owned
 };
 
 
@@ -23,6 +23,7 @@
  */
 #include <QFile>
 #include <QStringListIterator>
+#include <QSet>
 #include "SyncMLPluginLogging.h"
 #include "ContactsStorage.h"
 #include "SimpleItem.h"
@@ -37,7 +38,9 @@ const char* CTCAPSFILENAME12 = "CTCaps_contacts_12.xml";
 
 
 ContactStorage::ContactStorage(const QString& aPluginName)
- : Buteo::StoragePlugin(aPluginName), iBackend( 0 )
+ : Buteo::StoragePlugin(aPluginName), iBackend( 0 ), iTrackChanges( true ),
+   iSnapshotChanged( false ), iRefresh( false ), iRefreshCleared( false ),
+   iSuspended( false )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 }
@@ -88,6 +91,46 @@ bool ContactStorage::init( const QMap<QString, QString>& aProperties )
     iProperties[STORAGE_SYNCML_CTCAPS_PROP_11] = getCtCaps( CTCAPSFILENAME11 );
     iProperties[STORAGE_SYNCML_CTCAPS_PROP_12] = getCtCaps( CTCAPSFILENAME12 );
 
+    iRefresh = ( iProperties.value( STORAGE_REFRESH_PROP ) == PROPS_TRUE );
+    iRefreshCleared = false;
+
+    iRemoteCTCaps.clear();
+    if( iProperties.contains( STORAGE_REMOTE_CTCAPS_PROP ) &&
+        !iRemoteCTCaps.load( iProperties.value( STORAGE_REMOTE_CTCAPS_PROP ),
+                             iProperties.value( STORAGE_DEFAULT_MIME_PROP ) ) ) {
+        qCWarning(lcSyncMLPlugin) << "Remote CTCaps not available, exporting all contact details";
+    }
+
+    qint64 payloadCacheSize = iProperties.value( STORAGE_PAYLOAD_CACHE_SIZE,
+                                                 QString::number( PAYLOAD_CACHE_DEFAULT_SIZE ) ).toLongLong();
+
+    // Photos are limited by the profile and by what the remote device takes.
+    // The CTCaps size is for the base64 encoded value.
+    int photoMaxSize = iProperties.value( PHOTO_MAX_SIZE_PROP ).toInt();
+    int ctCapsPhotoSize = iRemoteCTCaps.maxSize( "PHOTO" ) / 4 * 3;
+    if( ctCapsPhotoSize > 0 && ( photoMaxSize <= 0 || ctCapsPhotoSize < photoMaxSize ) ) {
+        photoMaxSize = ctCapsPhotoSize;
+    }
+    iPhotoScaler.init( iProperties.value( PHOTO_MAX_DIMENSION_PROP ).toInt(), photoMaxSize,
+                       payloadCacheSize > 0 ? SyncMLConfig::getDatabasePath() + PAYLOAD_CACHE_DB_FILE : QString(),
+                       getPluginName() + "-photos" );
+
+    if( payloadCacheSize > 0 &&
+        !iPayloadCache.init( SyncMLConfig::getDatabasePath() + PAYLOAD_CACHE_DB_FILE, getPluginName(),
+                             iProperties[STORAGE_DEFAULT_MIME_PROP] + " " + propVersion,
+                             ( iProperties[STORAGE_SYNCML_CTCAPS_PROP_11] +
+                               iProperties[STORAGE_SYNCML_CTCAPS_PROP_12] ).toUtf8() +
+                             iRemoteCTCaps.key() +
+                             iProperties.value( PHOTO_MAX_DIMENSION_PROP ).toUtf8() + " " +
+                             QByteArray::number( photoMaxSize ),
+                             payloadCacheSize ) ) {
+        qCWarning(lcSyncMLPlugin) << "Payload cache not available, converting all contacts";
+    }
+
+    if( !iFingerprints.init( SyncMLConfig::getDatabasePath() + FINGERPRINT_DB_FILE, getPluginName() ) ) {
+        qCWarning(lcSyncMLPlugin) << "Fingerprints not available, writing all modified contacts";
+    }
+
     iBackend = new ContactsBackend(vCardVersion,
                                    iProperties.value(STORAGE_SYNC_TARGET),
                                    iProperties.value(STORAGE_ORIGIN_ID));
@@ -97,18 +140,76 @@ bool ContactStorage::init( const QMap<QString, QString>& aProperties )
         return false;
     }
 
-    if( !doInitItemAnalysis() ) {
+    iBackend->setRemoteCTCaps( iRemoteCTCaps );
+    iBackend->setPhotoScaler( &iPhotoScaler );
+
+    // Local changes are only looked for when the session sends local items.
+    // A slow sync sends all of them, so the snapshot is rebuilt from the
+    // backend to keep them from being reported as new in the next session.
+    // In syncs from remote the stored snapshot is kept in step with the
+    // changes made during the session, and changes made elsewhere are found
+    // in the next full analysis.
+    iTrackChanges = iProperties.value( STORAGE_SYNC_DIRECTION_PROP ) != STORAGE_SYNC_DIRECTION_FROM_REMOTE;
+
+    return initChangeTracking();
+}
+
+bool ContactStorage::initChangeTracking()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iTrackChanges ) {
+        return doInitItemAnalysis();
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Local changes not needed, skipping item analysis";
+    return loadSnapshot();
+}
+
+bool ContactStorage::suspend()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( !iBackend || !doUninitItemAnalysis() ) {
         return false;
     }
 
+    // Nothing the session recorded may be lost while the storage is kept
+    if( !iFingerprints.flush() ) {
+        return false;
+    }
+
+    iPayloadCache.flush();
+
+    iSuspended = true;
     return true;
 }
 
+bool ContactStorage::resume()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( !iBackend ) {
+        return false;
+    }
+
+    iSuspended = false;
+    iRefreshCleared = false;
+
+    // Contacts changed by others while the storage was kept are found by
+    // the analysis like in a fresh init
+    return initChangeTracking();
+}
+
 bool ContactStorage::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    doUninitItemAnalysis();
+    // A suspended storage has already stored its snapshot
+    if( !iSuspended && iBackend ) {
+        doUninitItemAnalysis();
+    }
+    iSuspended = false;
 
     // If the backend object is NULL, there is nothing to do anyway,
     // so the default value can be 'true' here.
@@ -122,6 +223,10 @@ bool ContactStorage::uninit()
 
     bool deleteItemsIdStorageUninitOk = iDeletedItems.uninit();
 
+    iPayloadCache.uninit();
+    iPhotoScaler.uninit();
+    iFingerprints.uninit();
+
     return (backendUninitOk && deleteItemsIdStorageUninitOk);
 }
 
@@ -251,9 +356,8 @@ QList<Buteo::StorageItem*> ContactStorage::getItems( const QStringList& aItemIdL
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     QList<Buteo::StorageItem*> items;
-    QMap<QString,QString> vcards;
     QList<QContactLocalId> ids;
-    QStringListIterator itr( aItemIdList );
+    QList<QContact> contacts;
 
     if( iBackend )
     {
@@ -261,23 +365,22 @@ QList<Buteo::StorageItem*> ContactStorage::getItems( const QStringList& aItemIdL
         {
             ids.append( QContactId::fromString (itr) );
         }
-        iBackend->getContacts( ids, vcards );
+        iBackend->getContacts( ids, contacts );
 
-        QMapIterator<QString,QString> i(vcards);
-        while( i.hasNext() )
+        foreach( const QContact& contact, contacts )
         {
-            i.next();
-            if( !i.value().isEmpty() )
+            QByteArray vcard = getVCard( contact );
+            if( !vcard.isEmpty() )
             {
                 SimpleItem *item = new SimpleItem;
-                item->setId( i.key() );
+                item->setId( contact.id().toString() );
                 item->setType( iProperties[STORAGE_DEFAULT_MIME_PROP] );
-                item->write( 0, i.value().toUtf8() );
+                item->write( 0, vcard );
                 items.append( item );
             }
             else
             {
-                qCWarning(lcSyncMLPlugin) << "Contact with id " << i.key() <<" doesn't exist!";
+                qCWarning(lcSyncMLPlugin) << "Contact with id " << contact.id().toString() <<" doesn't exist!";
             }
         }
     }
@@ -310,14 +413,14 @@ Buteo::StorageItem* ContactStorage::getItem( const QString& aItemId )
         iFreshItems.removeOne( id.toString () );
     }
 
-    QString contactData = iBackend->convertQContactToVCard( contact );
+    QByteArray contactData = getVCard( contact );
 
     if(!contactData.isEmpty())
     {
         newItem = new SimpleItem;
         newItem->setId(aItemId);
         newItem->setType(iProperties[STORAGE_DEFAULT_MIME_PROP]);
-        newItem->write(0,contactData.toUtf8());
+        newItem->write(0,contactData);
     }
     else
     {
@@ -356,11 +459,12 @@ QList<ContactStorage::OperationStatus> ContactStorage::addItems( const QList<But
         return storageErrorList;
     }
 
-    QList<QString> contactsList;
+    // Payloads are handed to the backend as UTF-8, without a QString copy
+    QList<QByteArray> contactsList;
     foreach(Buteo::StorageItem *item , aItems) {
         QByteArray data;
         item->read(0,item->getSize(),data);
-        contactsList.append(QString::fromUtf8(data.data()));
+        contactsList.append(data);
     }
 
     QList<QString> contactsIdList;
@@ -397,6 +501,7 @@ QList<ContactStorage::OperationStatus> ContactStorage::addItems( const QList<But
             {
                 // This item was successfully added, so let's add it to the snapshot
                 iSnapshot.insert( i.value().id, currentTime );
+                iSnapshotChanged = true;
             }
 
             storageErrorList.append(status);
@@ -420,10 +525,9 @@ ContactStorage::OperationStatus ContactStorage::modifyItem(Buteo::StorageItem& a
                 QString strID = aItem.getId();
                 QByteArray data;
                 aItem.read( 0, aItem.getSize(), data );
-                QString Contact = QString::fromUtf8( data );
-                qDebug()  << "Modifying an Item with data : " << Contact;
+                qDebug()  << "Modifying an Item with data : " << data;
                 qDebug() << "Modifying an Item with ID : "  << strID;
-                QContactManager::Error error = iBackend->modifyContact(strID ,Contact);
+                QContactManager::Error error = iBackend->modifyContact(strID ,data);
                 status = mapErrorStatus(error);
                 qDebug()  << "After Modification String ID  is " << strID;
         }
@@ -440,15 +544,36 @@ QList<ContactStorage::OperationStatus> ContactStorage::modifyItems(const QList<B
 
         if(iBackend) {
 
-        QStringList contactsList;
+        QStringList itemIds;
+        foreach(Buteo::StorageItem *item , aItems) {
+                itemIds.append(item->getId());
+        }
+        QHash<QString, QDateTime> revisions = getModificationTimes(itemIds);
+
+        // Items identical to what was last sent or written at the current
+        // revision are not written again
+        QList<QByteArray> contactsList;
         QStringList contactsIdList;
-                foreach(Buteo::StorageItem *item , aItems) {
+        QList<int> indexes;
+                for (int i = 0; i < aItems.size(); i++) {
+                        Buteo::StorageItem *item = aItems[i];
                         QByteArray data;
                         item->read(0,item->getSize(),data);
-                        contactsList.append(QString::fromUtf8(data.data()));
+                        storageErrorList.append(STATUS_OK);
+                        if (iFingerprints.matches(item->getId(), data, revisions.value(item->getId()))) {
+                                qCDebug(lcSyncMLPlugin) << "Contact unchanged, not modifying:" << item->getId();
+                                continue;
+                        }
+                        contactsList.append(data);
                         contactsIdList.append(item->getId());
+                        indexes.append(i);
+                        iPayloadCache.remove(item->getId());
                 }
 
+        if (contactsList.isEmpty()) {
+                return storageErrorList;
+        }
+
         QMap<int, ContactsStatus> contactsErrorMap =
                 iBackend->modifyContacts(contactsList, contactsIdList);
 
@@ -458,8 +583,8 @@ QList<ContactStorage::OperationStatus> ContactStorage::modifyItems(const QList<B
                         qCWarning(lcSyncMLPlugin) << "Something Wrong with Batch Mofication in Contacts Backend";
                         qCDebug(lcSyncMLPlugin) << "contactsErrroMap.size() " << contactsErrorMap.size();
                         qCDebug(lcSyncMLPlugin) << "contactsList.size()" << contactsList.size();
-                        for ( int i = 0; i < aItems.size(); i++) {
-                            storageErrorList.append(STATUS_ERROR);
+                        foreach (int index, indexes) {
+                            storageErrorList[index] = STATUS_ERROR;
                         }
 
                 } else  {
@@ -468,10 +593,15 @@ QList<ContactStorage::OperationStatus> ContactStorage::modifyItems(const QList<B
                         int j = 0;
                         while (i.hasNext()) {
                                 i.next();
-                                Buteo::StorageItem *item = aItems[j];
+                                Buteo::StorageItem *item = aItems[indexes[j]];
                                 item->setId(i.value().id);
                                 qCDebug(lcSyncMLPlugin) << "Id set in Storage " << item->getId();
-                                storageErrorList.append(mapErrorStatus(i.value().errorCode));
+                                storageErrorList[indexes[j]] = mapErrorStatus(i.value().errorCode);
+                                if (storageErrorList[indexes[j]] == STATUS_OK && i.value().lastModified.isValid()) {
+                                        iFingerprints.update(item->getId(), contactsList[j], i.value().lastModified);
+                                } else {
+                                        iFingerprints.remove(item->getId());
+                                }
                                 j++;
                         }
 
@@ -515,6 +645,11 @@ QList<ContactStorage::OperationStatus> ContactStorage::deleteItems(const QList<Q
         return statusList;
     }
 
+    if( iRefresh )
+    {
+        return refreshDeleteItems( aItemIds );
+    }
+
     QMap<int, ContactsStatus> errorMap = iBackend->deleteContacts(aItemIds);
     if(errorMap.size() !=aItemIds.size() )
     {
@@ -546,9 +681,12 @@ QList<ContactStorage::OperationStatus> ContactStorage::deleteItems(const QList<Q
 
                 QString itemId = aItemIds[j];
 
+                iPayloadCache.remove( itemId );
+                iFingerprints.remove( itemId );
                 itemIds.append( itemId );
                 creationTimes.append( iSnapshot.value( itemId ));
                 iSnapshot.remove( itemId );
+                iSnapshotChanged = true;
                 deletionTimes.append( currentTime );
             }
 
@@ -566,6 +704,73 @@ QList<ContactStorage::OperationStatus> ContactStorage::deleteItems(const QList<Q
     return statusList;
 }
 
+QList<ContactStorage::OperationStatus> ContactStorage::refreshDeleteItems(const QList<QString>& aItemIds)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QSet<QString> failedIds;
+
+    if( !iRefreshCleared )
+    {
+        QDateTime currentTime = QDateTime::currentDateTime();
+        QStringList allIds;
+        foreach( const QContactLocalId& id, iBackend->getAllContactIds() ) {
+            allIds.append( id.toString() );
+        }
+
+        qCDebug(lcSyncMLPlugin) << "Refresh from remote, removing all" << allIds.count() << "contacts";
+
+        QMap<int, ContactsStatus> errorMap = iBackend->deleteContacts( allIds );
+
+        QList<QString> itemIds;
+        QList<QDateTime> creationTimes;
+        QList<QDateTime> deletionTimes;
+
+        for( int i = 0; i < allIds.count(); ++i )
+        {
+            if( !errorMap.contains( i ) ||
+                mapErrorStatus( errorMap.value( i ).errorCode ) != STATUS_OK ) {
+                failedIds.insert( allIds[i] );
+                continue;
+            }
+
+            itemIds.append( allIds[i] );
+            creationTimes.append( iSnapshot.value( allIds[i] ) );
+            deletionTimes.append( currentTime );
+        }
+
+        if( failedIds.isEmpty() ) {
+            iSnapshot.clear();
+            iFreshItems.clear();
+        }
+        else {
+            foreach( const QString& id, itemIds ) {
+                iSnapshot.remove( id );
+                iFreshItems.removeOne( id );
+            }
+        }
+
+        iPayloadCache.clear();
+        iFingerprints.clear();
+        iSnapshotChanged = true;
+
+        if( !itemIds.isEmpty() )
+        {
+            iDeletedItems.addDeletedItems( itemIds, creationTimes, deletionTimes );
+        }
+
+        iRefreshCleared = true;
+    }
+
+    // Items that were not found any more have been removed by the wipe
+    QList<ContactStorage::OperationStatus> statusList;
+    foreach( const QString& id, aItemIds ) {
+        statusList.append( failedIds.contains( id ) ? STATUS_ERROR : STATUS_OK );
+    }
+
+    return statusList;
+}
+
 bool ContactStorage::doInitItemAnalysis()
 {
     /* Items are analyzed using two sets of items: those that existed at the end
@@ -597,26 +802,17 @@ bool ContactStorage::doInitItemAnalysis()
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     Q_ASSERT( iBackend );
-    iSnapshot.clear();
-    iFreshItems.clear();
 
     QDateTime currentTime = QDateTime::currentDateTime();
-    QMap<QString, QDateTime> snapshot;
     QList<QString> backend;
     QList<QString> freshItems;
 
-    // ** Retrieve previous snapshot from db and convert to QHash
-    QList<QString> snapshotItems;
-    QList<QDateTime> snapshotCreationTimes;
-
-    if( !iDeletedItems.getSnapshot(snapshotItems, snapshotCreationTimes) ) {
+    // ** Retrieve previous snapshot from db
+    if( !loadSnapshot() ) {
         return false;
     }
 
-    for( int i = 0; i < snapshotItems.count(); ++i )
-    {
-        snapshot.insert( snapshotItems[i], snapshotCreationTimes[i] );
-    }
+    QMap<QString, QDateTime> snapshot = iSnapshot;
 
     // ** Retrieve backend
     QList<QContactId> backendIds = iBackend->getAllContactIds();
@@ -679,6 +875,16 @@ bool ContactStorage::doUninitItemAnalysis()
 
     Q_ASSERT( iBackend );
 
+    // Without item analysis the stored snapshot is still valid if the
+    // session did not add or delete anything
+    if( !iTrackChanges && !iSnapshotChanged )
+    {
+        qCDebug(lcSyncMLPlugin) << "Snapshot unchanged, not storing it";
+        iSnapshot.clear();
+        iFreshItems.clear();
+        return true;
+    }
+
     // ** Retrieve creation times for the remaining "fresh" items from the backend
 
     if( !iFreshItems.isEmpty() )
@@ -721,6 +927,28 @@ bool ContactStorage::doUninitItemAnalysis()
     return true;
 }
 
+bool ContactStorage::loadSnapshot()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iSnapshot.clear();
+    iFreshItems.clear();
+    iSnapshotChanged = false;
+
+    QList<QString> snapshotItems;
+    QList<QDateTime> snapshotCreationTimes;
+
+    if( !iDeletedItems.getSnapshot(snapshotItems, snapshotCreationTimes) ) {
+        return false;
+    }
+
+    for( int i = 0; i < snapshotItems.count(); ++i )
+    {
+        iSnapshot.insert( snapshotItems[i], snapshotCreationTimes[i] );
+    }
+
+    return true;
+}
 
 QList<Buteo::StorageItem*> ContactStorage::getStoreList(QList<QContactLocalId> &aStrIDList)
 {
@@ -730,13 +958,11 @@ QList<Buteo::StorageItem*> ContactStorage::getStoreList(QList<QContactLocalId> &
 
 
     if (iBackend != NULL) {
-        QMap<QString,QString> idDataMap;
-        iBackend->getContacts(aStrIDList, idDataMap);
-        QMapIterator<QString, QString > iter(idDataMap);
+        QList<QContact> contacts;
+        iBackend->getContacts(aStrIDList, contacts);
 
-        while (iter.hasNext()) {
-            iter.next();
-            SimpleItem* item = convertVcardToStorageItem(QContactId::fromString (iter.key()), iter.value());
+        foreach (const QContact &contact, contacts) {
+            SimpleItem* item = convertVcardToStorageItem(contact.id(), getVCard(contact));
             if (item  != NULL) {
                 itemList.append(item);
             }
@@ -747,17 +973,52 @@ QList<Buteo::StorageItem*> ContactStorage::getStoreList(QList<QContactLocalId> &
     return itemList;
 }
 
+QByteArray ContactStorage::getVCard(const QContact& aContact)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QString id = aContact.id().toString();
+    QDateTime revision = iBackend->getModificationTime( aContact );
+    QByteArray digest = iBackend->getDigest( aContact );
+    QByteArray vcard;
+
+    if( !iPayloadCache.fetch( id, revision, vcard, digest ) ) {
+        vcard = iBackend->convertQContactToVCard( aContact ).toUtf8();
+        if( !vcard.isEmpty() ) {
+            iPayloadCache.store( id, revision, vcard, digest );
+        }
+    }
+
+    iFingerprints.update( id, vcard, revision );
+
+    return vcard;
+}
+
+QHash<QString, QDateTime> ContactStorage::getModificationTimes(const QStringList& aItemIds)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QHash<QString, QDateTime> revisions;
+
+    if( aItemIds.isEmpty() ) {
+        return revisions;
+    }
+
+    QList<QContactLocalId> ids;
+    foreach( const QString& id, aItemIds ) {
+        ids.append( QContactId::fromString( id ) );
+    }
+
+    return iBackend->getModificationTimes( ids );
+}
+
 QByteArray ContactStorage::getCtCaps( const QString& aFilename ) const
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    QFile ctCapsFile( SyncMLConfig::getXmlDataPath() + aFilename  );
-    QByteArray ctCaps;
+    QByteArray ctCaps = SyncMLConfig::getCTCaps( aFilename );
 
-    if( ctCapsFile.open(QIODevice::ReadOnly)) {
-        ctCaps = ctCapsFile.readAll();
-        ctCapsFile.close();
-    } else {
+    if( ctCaps.isEmpty() ) {
         qCWarning(lcSyncMLPlugin) << "Failed to open CTCaps file for contacts storage:" << aFilename;
     }
 
@@ -810,10 +1071,10 @@ ContactStorage::OperationStatus ContactStorage::mapErrorStatus\
 }
 
 /*!
-    \fn ContactStorage::convertVcardToStorageItem(const QContactLocalId, const QString&)
+    \fn ContactStorage::convertVcardToStorageItem(const QContactLocalId, const QByteArray&)
  */
 SimpleItem* ContactStorage::convertVcardToStorageItem(const QContactLocalId aItemKey,
-                                                      const QString& aItemData)
+                                                      const QByteArray& aItemData)
 {
 
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -823,7 +1084,7 @@ SimpleItem* ContactStorage::convertVcardToStorageItem(const QContactLocalId aIte
     if(storageItem != NULL) {
         qDebug() << "ID is " << aItemKey;
         qDebug() << "Data is " << aItemData;
-        storageItem->write( 0, aItemData.toUtf8() );
+        storageItem->write( 0, aItemData );
         storageItem->setId(aItemKey.toString());
         storageItem->setType(iProperties[STORAGE_DEFAULT_MIME_PROP]);
     }
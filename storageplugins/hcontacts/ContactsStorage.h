@@ -26,10 +26,14 @@
 
 #include <QDateTime>
 #include <QMap>
+#include <QHash>
 
 #include "StoragePlugin.h"
 #include "StoragePluginLoader.h"
 #include "ContactsBackend.h"
+#include "PayloadCache.h"
+#include "FingerprintStore.h"
+#include "PoolableStorage.h"
 #include "buteosyncfw5/DeletedItemsIdStorage.h"
 
 class SimpleItem;
@@ -37,7 +41,7 @@ class SimpleItem;
 //! \brief Harmattan Contact storage plugin
 //
 //  Interface to Storage Plugin towards Sync FW
-class ContactStorage : public Buteo::StoragePlugin
+class ContactStorage : public Buteo::StoragePlugin, public PoolableStorage
 {
 
 public:
@@ -68,6 +72,18 @@ public:
      */
     virtual bool uninit();
 
+    /*! \brief Stores the snapshot of the session, keeping the backend open
+     *
+     * @return True on success, otherwise false
+     */
+    virtual bool suspend();
+
+    /*! \brief Analyzes the items again for a new session
+     *
+     * @return True on success, otherwise false
+     */
+    virtual bool resume();
+
     /*! \brief Returns all known items
      *
      * @param aItems Array where to place items
@@ -204,10 +220,32 @@ public:
 
 private:
 
+    /*! \brief Prepares change tracking for a session, with full item
+     *         analysis if the session reports local changes
+     *
+     * @return True on success, otherwise false
+     */
+    bool initChangeTracking();
+
     bool doInitItemAnalysis();
 
     bool doUninitItemAnalysis();
 
+    /*! \brief Loads the snapshot stored at the end of the previous session
+     *         without comparing it to the backend
+     *
+     * @return True on success, otherwise false
+     */
+    bool loadSnapshot();
+
+    /*! \brief Removes all contacts in one backend operation, the first time
+     *         items are deleted during a refresh from remote
+     *
+     * @param aItemIds Ids of the items the caller asked to delete
+     * @return Operation status codes for aItemIds
+     */
+    QList<OperationStatus> refreshDeleteItems(const QList<QString>& aItemIds);
+
     /*! \brief convert list of contacts into vector of storage items
      *
      *
@@ -216,6 +254,21 @@ private:
      */
     QList<Buteo::StorageItem*> getStoreList(QList<QContactLocalId>&aList);
 
+    /*! \brief Returns the vCard of a contact, from the payload cache if
+     *         the contact has not changed since it was last converted
+     *
+     * @param aContact Contact
+     * @return vCard data, empty on failure
+     */
+    QByteArray getVCard(const QContact& aContact);
+
+    /*! \brief Returns the last modification times of contacts
+     *
+     * @param aItemIds Ids of the contacts
+     * @return Last modification times by id, missing contacts are left out
+     */
+    QHash<QString, QDateTime> getModificationTimes(const QStringList& aItemIds);
+
     QByteArray getCtCaps( const QString& aFilename ) const;
 
     ContactStorage::OperationStatus mapErrorStatus(const QContactManager::Error &aContactError) const;
@@ -227,14 +280,28 @@ private:
      * @return Storage item object (a pointer to SimpleItem)
      */
     SimpleItem* convertVcardToStorageItem(const QContactLocalId aItemKey,
-                                          const QString& aItemData);
+                                          const QByteArray& aItemData);
 
     ContactsBackend*                    iBackend;
 
     Buteo::DeletedItemsIdStorage        iDeletedItems; ///< Backend for tracking deleted items
 
+    PayloadCache                        iPayloadCache; ///< Serialized contacts
+
+    FingerprintStore                    iFingerprints; ///< Contacts last sent or written
+
+    CTCapsTable                         iRemoteCTCaps; ///< Capabilities of the remote device
+
+    PhotoScaler                         iPhotoScaler;  ///< Photos scaled for the remote device
+
     QMap<QString, QDateTime>    iSnapshot;
     QList<QString>              iFreshItems;
+
+    bool                        iTrackChanges;   ///< Session reports local changes
+    bool                        iSnapshotChanged; ///< Items added or deleted in session
+    bool                        iRefresh;        ///< Refresh from remote in progress
+    bool                        iRefreshCleared; ///< All contacts removed for refresh
+    bool                        iSuspended;      ///< Snapshot stored, kept for a later session
 };
 
 class ContactsStoragePluginLoader : public Buteo::StoragePluginLoader
@@ -0,0 +1,171 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "PhotoScaler.h"
+
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+
+#ifdef PHOTO_SCALING
+#include <QImage>
+#endif
+
+#include "SyncMLPluginLogging.h"
+
+// Photos are cached by content, so every entry has the same revision
+const QDateTime PHOTO_REVISION( QDateTime::fromMSecsSinceEpoch( 0, Qt::UTC ) );
+
+// Photos are not scaled smaller than this to fit the byte budget
+const int PHOTO_MIN_DIMENSION = 16;
+
+const int PHOTO_MAX_QUALITY = 90;
+const int PHOTO_MIN_QUALITY = 30;
+const int PHOTO_QUALITY_STEP = 20;
+
+PhotoScaler::PhotoScaler() :
+    iMaxDimension( 0 ), iMaxSize( 0 )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+PhotoScaler::~PhotoScaler()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit();
+}
+
+void PhotoScaler::init( int aMaxDimension, int aMaxSize, const QString& aDbFile, const QString& aStorageId )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit();
+
+#ifdef PHOTO_SCALING
+    iMaxDimension = qMax( aMaxDimension, 0 );
+    iMaxSize = qMax( aMaxSize, 0 );
+#else
+    if( aMaxDimension > 0 || aMaxSize > 0 ) {
+        qCWarning(lcSyncMLPlugin) << "Photo scaling not built in, sending photos as they are";
+    }
+#endif
+
+    if( !isEnabled() ) {
+        return;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Scaling photos to" << iMaxDimension << "pixels and" << iMaxSize << "bytes";
+
+    if( !aDbFile.isEmpty() &&
+        !iCache.init( aDbFile, aStorageId, "image/jpeg",
+                      QByteArray::number( iMaxDimension ) + " " + QByteArray::number( iMaxSize ),
+                      PHOTO_CACHE_DEFAULT_SIZE ) ) {
+        qCWarning(lcSyncMLPlugin) << "Photo cache not available, scaling all photos";
+    }
+}
+
+void PhotoScaler::uninit()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iCache.uninit();
+    iMaxDimension = 0;
+    iMaxSize = 0;
+}
+
+bool PhotoScaler::isEnabled() const
+{
+    return iMaxDimension > 0 || iMaxSize > 0;
+}
+
+QByteArray PhotoScaler::scale( const QByteArray& aPhoto )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( !isEnabled() || aPhoto.isEmpty() ) {
+        return aPhoto;
+    }
+
+    QString hash = QCryptographicHash::hash( aPhoto, QCryptographicHash::Sha1 ).toHex();
+    QByteArray photo;
+
+    if( !iCache.fetch( hash, PHOTO_REVISION, photo ) ) {
+        photo = transform( aPhoto );
+        iCache.store( hash, PHOTO_REVISION, photo );
+    }
+
+    return photo;
+}
+
+QByteArray PhotoScaler::transform( const QByteArray& aPhoto ) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+#ifdef PHOTO_SCALING
+    QImage image;
+
+    if( !image.loadFromData( aPhoto ) ) {
+        qCWarning(lcSyncMLPlugin) << "Could not decode photo, leaving it out";
+        return QByteArray();
+    }
+
+    bool tooLarge = iMaxDimension > 0 && ( image.width() > iMaxDimension || image.height() > iMaxDimension );
+
+    if( !tooLarge && ( iMaxSize == 0 || aPhoto.size() <= iMaxSize ) ) {
+        return aPhoto;
+    }
+
+    if( tooLarge ) {
+        image = image.scaled( iMaxDimension, iMaxDimension, Qt::KeepAspectRatio, Qt::SmoothTransformation );
+    }
+
+    // Lower the quality first, then the dimensions, until the photo fits
+    while( true ) {
+        for( int quality = PHOTO_MAX_QUALITY; quality >= PHOTO_MIN_QUALITY; quality -= PHOTO_QUALITY_STEP ) {
+            QByteArray photo;
+            QBuffer buffer( &photo );
+            buffer.open( QIODevice::WriteOnly );
+
+            if( !image.save( &buffer, "JPEG", quality ) ) {
+                qCWarning(lcSyncMLPlugin) << "Could not encode photo, leaving it out";
+                return QByteArray();
+            }
+
+            if( iMaxSize == 0 || photo.size() <= iMaxSize ) {
+                qCDebug(lcSyncMLPlugin) << "Photo of" << aPhoto.size() << "bytes scaled to"
+                                        << image.width() << "x" << image.height() << "and" << photo.size() << "bytes";
+                return photo;
+            }
+        }
+
+        if( image.width() / 2 < PHOTO_MIN_DIMENSION || image.height() / 2 < PHOTO_MIN_DIMENSION ) {
+            break;
+        }
+
+        image = image.scaled( image.width() / 2, image.height() / 2, Qt::KeepAspectRatio, Qt::SmoothTransformation );
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Photo of" << aPhoto.size() << "bytes does not fit in" << iMaxSize << "bytes, leaving it out";
+
+    return QByteArray();
+#else
+    return aPhoto;
+#endif
+}
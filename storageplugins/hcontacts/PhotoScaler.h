@@ -0,0 +1,99 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef PHOTOSCALER_H
+#define PHOTOSCALER_H
+
+#include <QByteArray>
+#include <QString>
+
+#include "PayloadCache.h"
+
+// Largest width or height of contact photos sent to the remote device, in pixels
+const QString PHOTO_MAX_DIMENSION_PROP( "Photo Max Dimension" );
+
+// Largest size of contact photos sent to the remote device, in bytes
+const QString PHOTO_MAX_SIZE_PROP( "Photo Max Size" );
+
+// Upper bound for the size of the cache of scaled photos
+const qint64 PHOTO_CACHE_DEFAULT_SIZE = 4 * 1024 * 1024;
+
+/*! \brief Scales contact photos down for devices with small displays
+ *
+ * Photos larger than the configured dimensions are scaled down, and photos
+ * over the byte budget are recompressed as JPEG until they fit. Photos that
+ * cannot be made to fit are left out. Scaled photos are cached by the hash of
+ * the original image, so the same photo is only scaled once.
+ *
+ * Scaling is only available when built with PHOTO_SCALING, otherwise the
+ * scaler is never enabled.
+ */
+class PhotoScaler {
+
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    PhotoScaler();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~PhotoScaler();
+
+    /*! \brief Initializes the scaler
+     *
+     * @param aMaxDimension Largest width or height in pixels, 0 for no limit
+     * @param aMaxSize Largest photo size in bytes, 0 for no limit
+     * @param aDbFile Database of the cache of scaled photos, empty for no cache
+     * @param aStorageId Identifier of the storage using the scaler
+     */
+    void init( int aMaxDimension, int aMaxSize, const QString& aDbFile, const QString& aStorageId );
+
+    /*! \brief Uninitializes the scaler
+     *
+     */
+    void uninit();
+
+    /*! \brief Checks if photos are scaled at all
+     *
+     * @return True if either limit is set, otherwise false
+     */
+    bool isEnabled() const;
+
+    /*! \brief Scales a photo to the limits
+     *
+     * @param aPhoto Encoded image
+     * @return Photo within the limits, the original if it already is, or
+     *         empty if it can not be made to fit
+     */
+    QByteArray scale( const QByteArray& aPhoto );
+
+private:
+
+    QByteArray transform( const QByteArray& aPhoto ) const;
+
+    int             iMaxDimension;
+    int             iMaxSize;
+    PayloadCache    iCache;
+
+};
+
+#endif  //  PHOTOSCALER_H
@@ -0,0 +1,326 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "VCardTokenizer.h"
+
+#include <QStringList>
+
+#include <string.h>
+
+#include "Base64Codec.h"
+#include "SyncMLPluginLogging.h"
+
+namespace {
+
+int hexValue( char aChar )
+{
+    if( aChar >= '0' && aChar <= '9' ) {
+        return aChar - '0';
+    }
+    if( aChar >= 'A' && aChar <= 'F' ) {
+        return aChar - 'A' + 10;
+    }
+    if( aChar >= 'a' && aChar <= 'f' ) {
+        return aChar - 'a' + 10;
+    }
+    return -1;
+}
+
+}
+
+bool VCardTokenizer::parse( const QByteArray& aVCard, QVersitDocument& aDocument )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QList<Line> lines;
+
+    if( !unfold( aVCard, lines ) || lines.count() < 2 ||
+        lines.first().iText.trimmed().toUpper() != "BEGIN:VCARD" ||
+        lines.last().iText.trimmed().toUpper() != "END:VCARD" ) {
+        return false;
+    }
+
+    QVersitDocument::VersitType type = QVersitDocument::InvalidType;
+
+    for( int i = 1; i < lines.count() - 1; ++i ) {
+        const QByteArray& text = lines[i].iText;
+        if( text.size() >= 8 && qstrnicmp( text.constData(), "VERSION:", 8 ) == 0 ) {
+            QByteArray version = text.mid( 8 ).trimmed();
+            if( version == "2.1" ) {
+                type = QVersitDocument::VCard21Type;
+            }
+            else if( version == "3.0" ) {
+                type = QVersitDocument::VCard30Type;
+            }
+            break;
+        }
+    }
+
+    if( type == QVersitDocument::InvalidType ) {
+        return false;
+    }
+
+    QVersitDocument document( type );
+    document.setComponentType( QStringLiteral( "VCARD" ) );
+
+    for( int i = 1; i < lines.count() - 1; ++i ) {
+        QVersitProperty property;
+
+        if( !parseProperty( lines[i], type, property ) ) {
+            return false;
+        }
+
+        // The version is the type of the document, not a property
+        if( property.name() != QLatin1String( "VERSION" ) ) {
+            document.addProperty( property );
+        }
+    }
+
+    aDocument = document;
+
+    return true;
+}
+
+bool VCardTokenizer::unfold( const QByteArray& aVCard, QList<Line>& aLines )
+{
+    const int size = aVCard.size();
+    int pos = 0;
+    bool softBreak = false;
+
+    while( pos < size ) {
+        int end = aVCard.indexOf( '\n', pos );
+        int next = ( end < 0 ) ? size : end + 1;
+        int lineEnd = ( end < 0 ) ? size : end;
+        if( lineEnd > pos && aVCard.at( lineEnd - 1 ) == '\r' ) {
+            --lineEnd;
+        }
+
+        const char* line = aVCard.constData() + pos;
+        int length = lineEnd - pos;
+
+        if( softBreak ) {
+            aLines.last().iText.append( line, length );
+        }
+        else if( length > 0 && ( line[0] == ' ' || line[0] == '\t' ) ) {
+            if( aLines.isEmpty() ) {
+                return false;
+            }
+            aLines.last().iText.append( line + 1, length - 1 );
+            aLines.last().iFolded = true;
+        }
+        else if( length > 0 ) {
+            Line logical;
+            logical.iText = QByteArray( line, length );
+            logical.iFolded = false;
+            aLines.append( logical );
+        }
+
+        // Quoted-printable values continue on the next line after a soft
+        // line break
+        softBreak = false;
+        if( length > 0 && line[length - 1] == '=' ) {
+            QByteArray& text = aLines.last().iText;
+            int colon = text.indexOf( ':' );
+            if( colon > 0 && text.left( colon ).toUpper().contains( "QUOTED-PRINTABLE" ) ) {
+                text.chop( 1 );
+                softBreak = true;
+            }
+        }
+
+        pos = next;
+    }
+
+    return !softBreak;
+}
+
+bool VCardTokenizer::parseProperty( const Line& aLine, QVersitDocument::VersitType aType,
+                                    QVersitProperty& aProperty )
+{
+    const QByteArray& text = aLine.iText;
+
+    int colon = text.indexOf( ':' );
+    if( colon <= 0 ) {
+        return false;
+    }
+
+    // Quoted parameter values may contain the separators
+    QByteArray head = text.left( colon );
+    if( head.contains( '"' ) ) {
+        return false;
+    }
+
+    QList<QByteArray> parts = head.split( ';' );
+    QList<QByteArray> groups = parts.first().trimmed().split( '.' );
+    QString name = QString::fromLatin1( groups.takeLast() ).toUpper();
+
+    // Nested documents and list values are left to QVersitReader
+    if( name.isEmpty() || name == QLatin1String( "BEGIN" ) || name == QLatin1String( "END" ) ||
+        name == QLatin1String( "AGENT" ) || name == QLatin1String( "GEO" ) ||
+        ( aType == QVersitDocument::VCard30Type &&
+          ( name == QLatin1String( "NICKNAME" ) || name == QLatin1String( "CATEGORIES" ) ) ) ) {
+        return false;
+    }
+
+    QMultiHash<QString, QString> parameters;
+    QString encoding;
+    QString charset;
+
+    for( int i = 1; i < parts.count(); ++i ) {
+        QByteArray part = parts[i].trimmed();
+        int equals = part.indexOf( '=' );
+
+        if( part.isEmpty() ) {
+            return false;
+        }
+
+        if( equals < 0 ) {
+            // vCard 2.1 allows parameter values without names. Encodings
+            // given that way are left to QVersitReader.
+            QString value = QString::fromLatin1( part );
+            QString upper = value.toUpper();
+            if( aType != QVersitDocument::VCard21Type ||
+                upper == QLatin1String( "BASE64" ) || upper == QLatin1String( "QUOTED-PRINTABLE" ) ||
+                upper == QLatin1String( "8BIT" ) || upper == QLatin1String( "7BIT" ) ) {
+                return false;
+            }
+            parameters.insert( QStringLiteral( "TYPE" ), value );
+            continue;
+        }
+
+        QString paramName = QString::fromLatin1( part.left( equals ).trimmed() ).toUpper();
+        QString paramValue = QString::fromUtf8( part.mid( equals + 1 ).trimmed() );
+
+        if( paramName == QLatin1String( "ENCODING" ) || paramName == QLatin1String( "CHARSET" ) ) {
+            QString& target = ( paramName == QLatin1String( "ENCODING" ) ) ? encoding : charset;
+            if( !target.isEmpty() ) {
+                return false;
+            }
+            target = paramValue.toUpper();
+        }
+        else if( aType == QVersitDocument::VCard30Type ) {
+            foreach( const QString& value, paramValue.split( ',' ) ) {
+                parameters.insert( paramName, value );
+            }
+        }
+        else {
+            parameters.insert( paramName, paramValue );
+        }
+    }
+
+    QStringList groupNames;
+    foreach( const QByteArray& group, groups ) {
+        groupNames.append( QString::fromLatin1( group ) );
+    }
+
+    QVersitProperty property;
+    property.setGroups( groupNames );
+    property.setName( name );
+    property.setParameters( parameters );
+
+    QByteArray value = text.mid( colon + 1 );
+
+    if( encoding == QLatin1String( "BASE64" ) || encoding == QLatin1String( "B" ) ) {
+        QByteArray data;
+        if( !charset.isEmpty() || !Base64Codec::decode( value, data ) ) {
+            return false;
+        }
+        property.setValue( data );
+        property.setValueType( QVersitProperty::BinaryType );
+        aProperty = property;
+        return true;
+    }
+
+    // The escaping and unfolding rules of text values differ between the
+    // versions and readers
+    if( value.contains( '\\' ) || ( aLine.iFolded && aType == QVersitDocument::VCard21Type ) ) {
+        return false;
+    }
+
+    if( encoding == QLatin1String( "QUOTED-PRINTABLE" ) && aType == QVersitDocument::VCard21Type ) {
+        QByteArray decoded;
+        if( !decodeQuotedPrintable( value, decoded ) ) {
+            return false;
+        }
+        value = decoded;
+    }
+    else if( !encoding.isEmpty() ) {
+        return false;
+    }
+
+    QString string;
+    if( charset.isEmpty() || charset == QLatin1String( "UTF-8" ) || charset == QLatin1String( "US-ASCII" ) ) {
+        string = QString::fromUtf8( value );
+    }
+    else if( charset == QLatin1String( "ISO-8859-1" ) ) {
+        string = QString::fromLatin1( value );
+    }
+    else {
+        return false;
+    }
+
+    if( name == QLatin1String( "N" ) || name == QLatin1String( "ADR" ) || name == QLatin1String( "ORG" ) ) {
+        property.setValue( string.split( ';' ) );
+        property.setValueType( QVersitProperty::CompoundType );
+    }
+    else {
+        property.setValue( string );
+        property.setValueType( QVersitProperty::PlainType );
+    }
+
+    aProperty = property;
+
+    return true;
+}
+
+bool VCardTokenizer::decodeQuotedPrintable( const QByteArray& aValue, QByteArray& aDecoded )
+{
+    const int size = aValue.size();
+    const char* data = aValue.constData();
+
+    aDecoded.clear();
+    aDecoded.reserve( size );
+
+    int pos = 0;
+    while( pos < size ) {
+        const char* escape = static_cast<const char*>( memchr( data + pos, '=', size - pos ) );
+
+        if( !escape ) {
+            aDecoded.append( data + pos, size - pos );
+            break;
+        }
+
+        int escapePos = escape - data;
+        aDecoded.append( data + pos, escapePos - pos );
+
+        if( escapePos + 2 >= size ) {
+            return false;
+        }
+
+        int high = hexValue( data[escapePos + 1] );
+        int low = hexValue( data[escapePos + 2] );
+        if( high < 0 || low < 0 ) {
+            return false;
+        }
+
+        aDecoded.append( static_cast<char>( ( high << 4 ) | low ) );
+        pos = escapePos + 3;
+    }
+
+    return true;
+}
@@ -15,16 +15,29 @@ VER_MAJ = 1
 VER_MIN = 0
 VER_PAT = 0
 
-QT -= gui
 QT += sql
 
+# Photos are scaled with QImage, which links QtGui into the plugin. It
+# works without a platform plugin. Build with CONFIG+=no_photo_scaling
+# to keep the plugin free of QtGui, photos are then sent as they are.
+no_photo_scaling {
+    QT -= gui
+} else {
+    QT += gui
+    DEFINES += PHOTO_SCALING
+}
+
 HEADERS += ContactsStorage.h \
            ContactsBackend.h \
-           ContactBuilder.h
+           ContactBuilder.h \
+           PhotoScaler.h \
+           VCardTokenizer.h
 
 SOURCES += ContactsStorage.cpp \
            ContactsBackend.cpp \
-           ContactBuilder.cpp
+           ContactBuilder.cpp \
+           PhotoScaler.cpp \
+           VCardTokenizer.cpp
 
 
 QMAKE_CXXFLAGS = -Wall \
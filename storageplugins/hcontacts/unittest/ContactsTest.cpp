@@ -33,6 +33,14 @@
 
 #include "ContactsStorage.h"
 #include "SimpleItem.h"
+#include "PhotoScaler.h"
+#include "VCardTokenizer.h"
+
+#include <QBuffer>
+#include <QImage>
+#include <QContactName>
+#include <QContactThumbnail>
+#include <QContactTimestamp>
 
 static const QByteArray originalData(
     "BEGIN:VCARD\r\n"
@@ -94,6 +102,278 @@ void ContactsTest::testSuiteBatched()
     QVERIFY(storage.uninit());
 }
 
+void ContactsTest::testPhotoScaler()
+{
+#ifndef PHOTO_SCALING
+    QSKIP( "Photo scaling not built in" );
+#else
+    const QString CACHEFILE( "photos.db" );
+    QFile::remove( CACHEFILE );
+
+    QImage image( 1200, 900, QImage::Format_RGB32 );
+    for( int y = 0; y < image.height(); ++y ) {
+        for( int x = 0; x < image.width(); ++x ) {
+            image.setPixel( x, y, qRgb( x % 256, y % 256, ( x * y ) % 256 ) );
+        }
+    }
+
+    QByteArray original;
+    QBuffer buffer( &original );
+    buffer.open( QIODevice::WriteOnly );
+    QVERIFY( image.save( &buffer, "PNG" ) );
+    buffer.close();
+
+    PhotoScaler scaler;
+    QVERIFY( !scaler.isEnabled() );
+    QCOMPARE( scaler.scale( original ), original );
+
+    // Dimensions
+    scaler.init( 96, 0, CACHEFILE, "hcontacts-photos" );
+    QVERIFY( scaler.isEnabled() );
+    QByteArray scaled = scaler.scale( original );
+    QImage scaledImage = QImage::fromData( scaled );
+    QCOMPARE( scaledImage.width(), 96 );
+    QCOMPARE( scaledImage.height(), 72 );
+    QVERIFY( scaled.size() < original.size() );
+
+    // Served from the cache the second time
+    QCOMPARE( scaler.scale( original ), scaled );
+
+    // Small photos are kept as they are
+    QCOMPARE( scaler.scale( scaled ), scaled );
+
+    // Byte budget
+    scaler.init( 0, 2000, CACHEFILE, "hcontacts-photos" );
+    scaled = scaler.scale( original );
+    QVERIFY( !scaled.isEmpty() );
+    QVERIFY( scaled.size() <= 2000 );
+    QVERIFY( !QImage::fromData( scaled ).isNull() );
+
+    // Photos that do not fit are left out
+    scaler.init( 0, 10, QString(), "hcontacts-photos" );
+    QVERIFY( scaler.scale( original ).isEmpty() );
+
+    scaler.uninit();
+    QFile::remove( CACHEFILE );
+#endif
+}
+
+static QList<QVersitDocument> readVersitDocuments( const QByteArray& aVCard )
+{
+    QVersitReader reader( aVCard );
+    reader.startReading();
+    reader.waitForFinished();
+    return reader.results();
+}
+
+// Compares documents without depending on the order of parameters
+static void compareVersitDocuments( const QVersitDocument& aActual, const QVersitDocument& aExpected )
+{
+    QCOMPARE( aActual.type(), aExpected.type() );
+    QCOMPARE( aActual.componentType(), aExpected.componentType() );
+    QCOMPARE( aActual.properties().count(), aExpected.properties().count() );
+
+    for( int i = 0; i < aActual.properties().count(); ++i ) {
+        QVersitProperty actual = aActual.properties().at( i );
+        QVersitProperty expected = aExpected.properties().at( i );
+
+        QCOMPARE( actual.groups(), expected.groups() );
+        QCOMPARE( actual.name(), expected.name() );
+        QCOMPARE( actual.valueType(), expected.valueType() );
+        QCOMPARE( actual.variantValue(), expected.variantValue() );
+
+        QStringList keys = actual.parameters().uniqueKeys();
+        QCOMPARE( keys, expected.parameters().uniqueKeys() );
+        foreach( const QString& key, keys ) {
+            QStringList actualValues = actual.parameters().values( key );
+            QStringList expectedValues = expected.parameters().values( key );
+            actualValues.sort();
+            expectedValues.sort();
+            QCOMPARE( actualValues, expectedValues );
+        }
+    }
+}
+
+static QList<QByteArray> sampleVCards()
+{
+    QList<QByteArray> vCards;
+
+    foreach( const QString& fileName, QStringList() << "vcard1.txt" << "vcard2.txt" << "vcard3.txt" ) {
+        QFile file( QFINDTESTDATA( fileName ) );
+        if( file.open( QIODevice::ReadOnly ) ) {
+            vCards.append( file.readAll().trimmed() );
+        }
+    }
+
+    return vCards;
+}
+
+void ContactsTest::testVCardTokenizer()
+{
+    QList<QByteArray> vCards = sampleVCards();
+    QCOMPARE( vCards.count(), 3 );
+
+    QByteArray photo( 300, Qt::Uninitialized );
+    for( int i = 0; i < photo.size(); ++i ) {
+        photo[i] = static_cast<char>( i );
+    }
+    QByteArray encodedPhoto = photo.toBase64();
+    QByteArray foldedPhoto;
+    for( int i = 0; i < encodedPhoto.size(); i += 72 ) {
+        foldedPhoto += "\r\n  " + encodedPhoto.mid( i, 72 );
+    }
+
+    vCards << QByteArray( "BEGIN:VCARD\r\n"
+                          "VERSION:2.1\r\n"
+                          "N;CHARSET=UTF-8;ENCODING=QUOTED-PRINTABLE:M=C3=A4kinen;Matti\r\n"
+                          "NOTE;ENCODING=QUOTED-PRINTABLE:first=0D=0A=\r\n"
+                          "second\r\n"
+                          "ADR;HOME;PREF:;;Street 1;Helsinki;;00100;Finland\r\n"
+                          "item1.EMAIL;INTERNET:matti@example.com\r\n"
+                          "PHOTO;ENCODING=BASE64;TYPE=JPEG:" ) + foldedPhoto + "\r\n"
+                          "\r\n"
+                          "END:VCARD\r\n";
+
+    vCards << QByteArray( "BEGIN:VCARD\n"
+                          "VERSION:3.0\n"
+                          "N:Doe;Jane;;;\n"
+                          "FN:Jane Doe\n"
+                          "TEL;TYPE=CELL,VOICE:+358401234567\n"
+                          "ORG:Acme;R&D\n"
+                          "NOTE:a long note folded over\n"
+                          "  two lines\n"
+                          "PHOTO;ENCODING=b;TYPE=JPEG:" ) + encodedPhoto + "\n"
+                          "END:VCARD\n";
+
+    foreach( const QByteArray& vCard, vCards ) {
+        QVersitDocument document;
+        QVERIFY( VCardTokenizer::parse( vCard, document ) );
+
+        QList<QVersitDocument> expected = readVersitDocuments( vCard );
+        QCOMPARE( expected.count(), 1 );
+        compareVersitDocuments( document, expected.first() );
+    }
+
+    // Left to the versit reader
+    QList<QByteArray> unusual;
+    unusual << "BEGIN:VCARD\r\nVERSION:2.1\r\nN:A\r\nAGENT:\r\nBEGIN:VCARD\r\nVERSION:2.1\r\n"
+               "N:B\r\nEND:VCARD\r\nEND:VCARD\r\n"
+            << "BEGIN:VCARD\r\nVERSION:2.1\r\nNOTE:folded\r\n text\r\nEND:VCARD\r\n"
+            << "BEGIN:VCARD\r\nVERSION:3.0\r\nN:A\\;B\r\nEND:VCARD\r\n"
+            << "BEGIN:VCARD\r\nVERSION:2.1\r\nN;CHARSET=SHIFT_JIS:A\r\nEND:VCARD\r\n"
+            << "BEGIN:VCARD\r\nVERSION:2.1\r\nPHOTO;BASE64:AAAA\r\nEND:VCARD\r\n"
+            << "BEGIN:VCARD\r\nVERSION:4.0\r\nN:A\r\nEND:VCARD\r\n"
+            << "BEGIN:VCARD\r\nN:A\r\nEND:VCARD\r\n";
+
+    foreach( const QByteArray& vCard, unusual ) {
+        QVersitDocument document;
+        QVERIFY( !VCardTokenizer::parse( vCard, document ) );
+    }
+}
+
+void ContactsTest::testVCard21Photo()
+{
+    QImage image( 64, 48, QImage::Format_RGB32 );
+    for( int y = 0; y < image.height(); ++y ) {
+        for( int x = 0; x < image.width(); ++x ) {
+            image.setPixel( x, y, qRgb( x * 4, y * 5, ( x * y ) % 256 ) );
+        }
+    }
+
+    QContact contact;
+    QContactName name;
+    name.setFirstName( "Matti" );
+    name.setLastName( "Virtanen" );
+    contact.saveDetail( &name );
+    QContactThumbnail thumbnail;
+    thumbnail.setThumbnail( image );
+    contact.saveDetail( &thumbnail );
+
+    ContactsBackend backend( QVersitDocument::VCard21Type, QString(), QString() );
+    QByteArray vCard = backend.convertQContactToVCard( contact ).toUtf8();
+
+    // The base64 value is folded and followed by a blank line
+    int photo = vCard.indexOf( "PHOTO" );
+    QVERIFY( photo >= 0 );
+    int end = vCard.indexOf( "\r\n\r\n", photo );
+    QVERIFY( end > photo );
+    foreach( const QByteArray& line, vCard.mid( photo, end - photo ).split( '\n' ) ) {
+        QVERIFY( line.size() <= 78 );
+    }
+
+    QList<QVersitDocument> documents = readVersitDocuments( vCard );
+    QCOMPARE( documents.count(), 1 );
+
+    QByteArray data;
+    foreach( const QVersitProperty& property, documents.first().properties() ) {
+        if( property.name() == QLatin1String( "PHOTO" ) ) {
+            data = property.variantValue().toByteArray();
+        }
+    }
+
+    QImage readImage = QImage::fromData( data );
+    QCOMPARE( readImage.size(), image.size() );
+    QCOMPARE( readImage.convertToFormat( image.format() ), image );
+}
+
+void ContactsTest::testDigest()
+{
+    ContactsBackend backend( QVersitDocument::VCard21Type, QString(), QString() );
+
+    QContactTimestamp timestamp;
+    timestamp.setLastModified( QDateTime::fromSecsSinceEpoch( 1000, Qt::UTC ) );
+
+    QContact contact;
+    contact.saveDetail( &timestamp );
+    QContactName name;
+    name.setFirstName( "Matti" );
+    contact.saveDetail( &name );
+
+    QByteArray digest = backend.getDigest( contact );
+    QCOMPARE( backend.getDigest( contact ), digest );
+
+    // Changed within the same second
+    name.setFirstName( "Maija" );
+    contact.saveDetail( &name );
+    QCOMPARE( backend.getModificationTime( contact ), timestamp.lastModified() );
+    QVERIFY( backend.getDigest( contact ) != digest );
+}
+
+void ContactsTest::benchmarkImport_data()
+{
+    QTest::addColumn<bool>( "tokenizer" );
+
+    QTest::newRow( "versit reader" ) << false;
+    QTest::newRow( "tokenizer" ) << true;
+}
+
+void ContactsTest::benchmarkImport()
+{
+    QFETCH( bool, tokenizer );
+
+    const int ITEMS = 10000;
+
+    QList<QByteArray> samples = sampleVCards();
+    QVERIFY( !samples.isEmpty() );
+
+    QList<QByteArray> vCards;
+    for( int i = 0; i < ITEMS; ++i ) {
+        vCards.append( samples.at( i % samples.count() ) );
+    }
+
+    QBENCHMARK_ONCE {
+        foreach( const QByteArray& vCard, vCards ) {
+            if( tokenizer ) {
+                QVersitDocument document;
+                QVERIFY( VCardTokenizer::parse( vCard, document ) );
+            }
+            else {
+                QCOMPARE( readVersitDocuments( vCard ).count(), 1 );
+            }
+        }
+    }
+}
+
 void ContactsTest::runTestSuite( const QByteArray& aOriginalData, const QByteArray& aModifiedData,
                                  Buteo::StoragePlugin& aPlugin, bool aBatched )
 {
@@ -478,5 +758,6 @@ void ContactsTest::directDelete( const QList<QContactLocalId>& aContactIds, QCon
 
 */
 
-QTEST_MAIN(ContactsTest)
+// The plugin runs in a daemon without a platform plugin
+QTEST_GUILESS_MAIN(ContactsTest)
 
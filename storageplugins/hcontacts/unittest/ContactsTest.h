@@ -51,6 +51,18 @@ private slots:
 
     void testSuiteBatched();
 
+    void testPhotoScaler();
+
+    void testVCardTokenizer();
+
+    void testVCard21Photo();
+
+    void testDigest();
+
+    void benchmarkImport_data();
+
+    void benchmarkImport();
+
     //void pf177715();
 private:
 
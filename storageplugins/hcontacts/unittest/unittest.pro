@@ -1,8 +1,14 @@
 TEMPLATE = app
 TARGET = hcontacts-tests
 
-QT -= gui
 QT += core testlib sql
+
+no_photo_scaling {
+    QT -= gui
+} else {
+    QT += gui
+    DEFINES += PHOTO_SCALING
+}
 CONFIG += link_pkgconfig
 
 PKGCONFIG = buteosyncfw5 Qt5Contacts Qt5Versit buteosyncml5 qtcontacts-sqlite-qt5-extensions contactcache-qt5
@@ -23,12 +29,16 @@ LIBS += -L../../../syncmlcommon
 HEADERS += ContactsTest.h \
            ContactsStorage.h \
            ContactsBackend.h \
-           ContactBuilder.h
+           ContactBuilder.h \
+           PhotoScaler.h \
+           VCardTokenizer.h
 
 SOURCES += ContactsTest.cpp \
            ContactsStorage.cpp \
            ContactsBackend.cpp \
-           ContactBuilder.cpp
+           ContactBuilder.cpp \
+           PhotoScaler.cpp \
+           VCardTokenizer.cpp
 
 testfiles.path = /opt/tests/buteo-sync-plugins/
 testfiles.files = vcard1.txt vcard2.txt vcard3.txt
@@ -38,7 +38,8 @@
 
 static const QString INCIDENCE_TYPE_JOURNAL( "Journal" );
 
-NotesBackend::NotesBackend() : iCalendar( 0 ), iStorage( 0 )
+NotesBackend::NotesBackend() : iCalendar( 0 ), iStorage( 0 ), iIdQueryAvailable( false ),
+    iLoaded( false )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 }
@@ -49,7 +50,8 @@ NotesBackend::~NotesBackend()
 }
 
 bool NotesBackend::init( const QString& aNotebookName, const QString& aUid,
-                         const QString &aMimeType )
+                         const QString &aMimeType, bool aLoadAll,
+                         const QString& aSyncSession )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
@@ -64,68 +66,41 @@ bool NotesBackend::init( const QString& aNotebookName, const QString& aUid,
     iNotebookName = aNotebookName;
     iMimeType = aMimeType;
 
-    iCalendar = mKCal::ExtendedCalendar::Ptr( new mKCal::ExtendedCalendar(QTimeZone::systemTimeZone()) );
-
-    qCDebug(lcSyncMLPlugin) << "Creating Default Maemo Storage for Notes";
-    iStorage = iCalendar->defaultStorage( iCalendar );
-
-    bool opened = iStorage->open();
-
-    if (!opened)
-    {
-        qCDebug(lcSyncMLPluginTrace) << "Calendar storage open failed";
-    }
+    // The calendar database is opened once per sync session and shared
+    // with the calendar storage
+    iSession = CalendarSession::acquire( aSyncSession );
+    bool opened = !iSession.isNull();
 
     mKCal::Notebook::Ptr openedNb;
-
-    // If we have an Uid, we try to get the corresponding Notebook
-    if (!aUid.isEmpty()) {
-        openedNb = iStorage->notebook(aUid);
-
-        // If we didn't get one, we create one and set its Uid
-        if (!openedNb) {
-            openedNb = mKCal::Notebook::Ptr(new mKCal::Notebook(aNotebookName,
-                                                                "Synchronization Created Notebook for " + aNotebookName));
-            if (!openedNb.isNull()) {
-                openedNb->setUid(aUid);
-                if (!iStorage->addNotebook(openedNb)) {
-                    qCWarning(lcSyncMLPlugin) << "Failed to add notebook to storage";
-                    openedNb.clear();
-                }
-            }
-        }
-    }
-    // If we didn't have an Uid or the creation above failed,
-    // we use the default notebook
-    if (openedNb.isNull()) {
-        qCDebug(lcSyncMLPlugin) << "Using default notebook";
-        openedNb = iStorage->defaultNotebook();
-        if(openedNb.isNull())
-        {
-            qCDebug(lcSyncMLPlugin) << "No default notebook exists, creating one";
-            openedNb = mKCal::Notebook::Ptr(new mKCal::Notebook("Default", QString()));
-            if (!iStorage->setDefaultNotebook(openedNb)) {
-                qCWarning(lcSyncMLPlugin) << "Failed to set default notebook of storage";
-                openedNb.clear();
-            }
-        }
+    if (opened)
+    {
+        iCalendar = iSession->calendar();
+        iStorage = iSession->storage();
+        openedNb = iSession->notebook(aNotebookName, aUid);
     }
 
     bool loaded = false;
-    if(opened && openedNb)
+    if(opened && openedNb && !aLoadAll)
     {
-        qCDebug(lcSyncMLPlugin) << "Loading all incidences from::" << openedNb->uid();
-        loaded = iStorage->loadNotebookIncidences(openedNb->uid());
-        if(!loaded)
-        {
-            qCWarning(lcSyncMLPlugin) << "Failed to load calendar";
-        }
+        qCDebug(lcSyncMLPlugin) << "Loading incidences on demand from::" << openedNb->uid();
+        loaded = true;
     }
+    else if(opened && openedNb)
+    {
+        loaded = iSession->loadNotebook(openedNb->uid());
+    }
+    iLoaded = loaded && aLoadAll;
 
     if (opened && loaded && !openedNb.isNull())
     {
         iNotebookName = openedNb->uid();
 
+        QString databaseName = iSession->databaseName();
+        iIdQueryAvailable = !databaseName.isEmpty() && iIdQuery.init( databaseName );
+        if( !iIdQueryAvailable ) {
+            qCDebug(lcSyncMLPlugin) << "Id-only queries not available, using incidence queries";
+        }
+
         qCDebug(lcSyncMLPlugin) << "Calendar initialized for notes";
         return true;
     }
@@ -141,6 +116,8 @@ bool NotesBackend::init( const QString& aNotebookName, const QString& aUid,
 
         qCDebug(lcSyncMLPluginTrace) << "Calendar deleted";
 
+        iSession.clear();
+
         return false;
     }
 }
@@ -150,15 +127,13 @@ bool NotesBackend::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    if( iStorage ) {
-        iStorage->close();
-        iStorage.clear();
-    }
+    iIdQuery.uninit();
+    iIdQueryAvailable = false;
 
-    if( iCalendar ) {
-        iCalendar->close();
-        iCalendar.clear();
-    }
+    // The storage is closed once no plugin uses the session anymore
+    iStorage.clear();
+    iCalendar.clear();
+    iSession.clear();
 
     return true;
 }
@@ -170,7 +145,8 @@ bool NotesBackend::getAllNotes( QList<Buteo::StorageItem*>& aItems )
 
     KCalendarCore::Incidence::List incidences;
 
-    if( !iStorage->allIncidences( &incidences, iNotebookName ) ) {
+    if( ( !iIdQueryAvailable || !queryNotes( IncidenceIdQuery::ALL_INCIDENCES, QDateTime(), incidences ) ) &&
+        !iStorage->allIncidences( &incidences, iNotebookName ) ) {
         qCWarning(lcSyncMLPlugin) << "Could not retrieve all notes";
         return false;
     }
@@ -185,6 +161,10 @@ bool NotesBackend::getAllNoteIds( QList<QString>& aItemIds )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iIdQueryAvailable && queryNoteIds( IncidenceIdQuery::ALL_INCIDENCES, QDateTime(), aItemIds ) ) {
+        return true;
+    }
+
     KCalendarCore::Incidence::List incidences;
 
     if( !iStorage->allIncidences( &incidences, iNotebookName ) ) {
@@ -203,7 +183,8 @@ bool NotesBackend::getNewNotes( QList<Buteo::StorageItem*>& aNewItems, const QDa
 
     KCalendarCore::Incidence::List incidences;
 
-    if( !iStorage->insertedIncidences( &incidences, aTime, iNotebookName ) ) {
+    if( ( !iIdQueryAvailable || !queryNotes( IncidenceIdQuery::NEW_INCIDENCES, aTime, incidences ) ) &&
+        !iStorage->insertedIncidences( &incidences, aTime, iNotebookName ) ) {
         qCWarning(lcSyncMLPlugin) << "Could not retrieve new notes";
         return false;
     }
@@ -217,6 +198,10 @@ bool NotesBackend::getNewNoteIds( QList<QString>& aNewItemIds, const QDateTime&
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iIdQueryAvailable && queryNoteIds( IncidenceIdQuery::NEW_INCIDENCES, aTime, aNewItemIds ) ) {
+        return true;
+    }
+
     KCalendarCore::Incidence::List incidences;
 
     if( !iStorage->insertedIncidences( &incidences, aTime, iNotebookName ) ) {
@@ -235,7 +220,8 @@ bool NotesBackend::getModifiedNotes( QList<Buteo::StorageItem*>& aModifiedItems,
 
     KCalendarCore::Incidence::List incidences;
 
-    if( !iStorage->modifiedIncidences( &incidences, aTime, iNotebookName ) ) {
+    if( ( !iIdQueryAvailable || !queryNotes( IncidenceIdQuery::MODIFIED_INCIDENCES, aTime, incidences ) ) &&
+        !iStorage->modifiedIncidences( &incidences, aTime, iNotebookName ) ) {
         qCWarning(lcSyncMLPlugin) << "Could not retrieve modified notes";
         return false;
     }
@@ -249,6 +235,10 @@ bool NotesBackend::getModifiedNoteIds( QList<QString>& aModifiedItemIds, const Q
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iIdQueryAvailable && queryNoteIds( IncidenceIdQuery::MODIFIED_INCIDENCES, aTime, aModifiedItemIds ) ) {
+        return true;
+    }
+
     KCalendarCore::Incidence::List incidences;
 
     if( !iStorage->modifiedIncidences( &incidences, aTime, iNotebookName ) ) {
@@ -265,6 +255,10 @@ bool NotesBackend::getDeletedNoteIds( QList<QString>& aDeletedItemIds, const QDa
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iIdQueryAvailable && queryNoteIds( IncidenceIdQuery::DELETED_INCIDENCES, aTime, aDeletedItemIds ) ) {
+        return true;
+    }
+
     KCalendarCore::Incidence::List incidences;
 
     if( !iStorage->deletedIncidences( &incidences, aTime, iNotebookName ) ) {
@@ -289,8 +283,7 @@ Buteo::StorageItem* NotesBackend::getItem( const QString& aItemId )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    iStorage->load ( aItemId );
-    KCalendarCore::Incidence::Ptr item = iCalendar->incidence( aItemId );
+    KCalendarCore::Incidence::Ptr item = loadNote( aItemId );
 
     if( !item ) {
         qCWarning(lcSyncMLPlugin) << "Could not find item:" << aItemId;
@@ -319,7 +312,7 @@ bool NotesBackend::addNote( Buteo::StorageItem& aItem, bool aCommitNow )
     KCalendarCore::Journal::Ptr journal;
     journal = KCalendarCore::Journal::Ptr( new KCalendarCore::Journal() );
 
-    QString description = QString::fromUtf8( data.constData() );
+    QString description = QString::fromUtf8( data );
 
     journal->setDescription( description );
 
@@ -353,8 +346,7 @@ bool NotesBackend::modifyNote( Buteo::StorageItem& aItem, bool aCommitNow )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    iStorage->load ( aItem.getId() );
-    KCalendarCore::Incidence::Ptr item = iCalendar->incidence( aItem.getId() );
+    KCalendarCore::Incidence::Ptr item = loadNote( aItem.getId() );
 
     if( !item ) {
         qCWarning(lcSyncMLPlugin) << "Could not find item to be modified:" << aItem.getId();
@@ -368,7 +360,14 @@ bool NotesBackend::modifyNote( Buteo::StorageItem& aItem, bool aCommitNow )
         return false;
     }
 
-    QString description = QString::fromLatin1( data.constData() );
+    QString description = QString::fromUtf8( data );
+
+    // Setting the description marks the note modified even if it is the
+    // same, which would make the next sync send it back
+    if( description == item->description() ) {
+        qCDebug(lcSyncMLPlugin) << "Note unchanged, not modifying:" << aItem.getId();
+        return true;
+    }
 
     item->setDescription( description );
 
@@ -389,8 +388,7 @@ bool NotesBackend::deleteNote( const QString& aId, bool aCommitNow )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    iStorage->load ( aId );
-    KCalendarCore::Incidence::Ptr journal = iCalendar->incidence( aId );
+    KCalendarCore::Incidence::Ptr journal = loadNote( aId );
 
     if( !journal ) {
         qCWarning(lcSyncMLPlugin) << "Could not find item to be deleted:" << aId;
@@ -413,12 +411,45 @@ bool NotesBackend::deleteNote( const QString& aId, bool aCommitNow )
     return true;
 }
 
+bool NotesBackend::deleteAllNotes()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    KCalendarCore::Incidence::List incidences;
+
+    // Loading the notebook in one go beats loading every note on its own
+    if( iSession && !iLoaded ) {
+        iLoaded = iSession->loadNotebook( iNotebookName );
+    }
+
+    if( !iIdQueryAvailable ||
+        !queryNotes( IncidenceIdQuery::ALL_INCIDENCES, QDateTime(), incidences ) ) {
+        if( !iStorage || !iStorage->allIncidences( &incidences, iNotebookName ) ) {
+            qCWarning(lcSyncMLPlugin) << "Could not retrieve all notes";
+            return false;
+        }
+        filterIncidences( incidences );
+    }
+
+    bool success = true;
+
+    foreach( const KCalendarCore::Incidence::Ptr& journal, incidences ) {
+        if( !iCalendar->deleteIncidence( journal ) ) {
+            qCWarning(lcSyncMLPlugin) << "Could not delete note:" << journal->uid();
+            success = false;
+        }
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Deleting" << incidences.count() << "notes";
+
+    return commitChanges() && success;
+}
 
 bool NotesBackend::commitChanges()
 {
     bool saved = false;
 
-    if( iStorage && iStorage->save() )
+    if( iSession && iSession->save() )
     {
         saved = true;
     }
@@ -429,6 +460,11 @@ bool NotesBackend::commitChanges()
     return saved;
 }
 
+bool NotesBackend::isCurrent() const
+{
+    return iSession && iSession->isCurrent();
+}
+
 void NotesBackend::retrieveNoteItems( KCalendarCore::Incidence::List& aIncidences, QList<Buteo::StorageItem*>& aItems )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -457,23 +493,77 @@ void NotesBackend::retrieveNoteIds( KCalendarCore::Incidence::List& aIncidences,
 
 }
 
-void NotesBackend::filterIncidences( KCalendarCore::Incidence::List& aIncidences )
+bool NotesBackend::queryNoteIds( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime, QList<QString>& aIds )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    QString journal( INCIDENCE_TYPE_JOURNAL );
+    QList<IncidenceId> ids;
+
+    if( !iIdQuery.queryIds( aChangeType, iNotebookName, QStringList( INCIDENCE_TYPE_JOURNAL ), aTime, ids ) ) {
+        qCWarning(lcSyncMLPlugin) << "Could not retrieve note ids, using incidence queries";
+        iIdQueryAvailable = false;
+        return false;
+    }
+
+    for( int i = 0; i < ids.count(); ++i ) {
+        aIds.append( ids[i].iUid );
+    }
 
-    int i = 0;
-    while( i < aIncidences.count() ) {
-        KCalendarCore::Incidence::Ptr incidence = aIncidences[i];
+    return true;
+}
 
-        if( incidence->type() != KCalendarCore::Incidence::TypeJournal ) {
-            aIncidences.remove( i, 1 );
-            incidence.clear();
+KCalendarCore::Incidence::Ptr NotesBackend::loadNote( const QString& aId )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // The notebook may have been loaded in init(), only go to the storage if
+    // the note is not in memory already
+    return iSession->incidence( iNotebookName, aId );
+}
+
+bool NotesBackend::queryNotes( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime,
+                               KCalendarCore::Incidence::List& aIncidences )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QList<IncidenceId> ids;
+
+    if( !iIdQuery.queryIds( aChangeType, iNotebookName, QStringList( INCIDENCE_TYPE_JOURNAL ), aTime, ids ) ) {
+        qCWarning(lcSyncMLPlugin) << "Could not retrieve notes, using incidence queries";
+        iIdQueryAvailable = false;
+        return false;
+    }
+
+    // Journals of the notebook have been loaded in init(), resolve them from memory
+    aIncidences.reserve( ids.count() );
+    for( int i = 0; i < ids.count(); ++i ) {
+        KCalendarCore::Incidence::Ptr journal = loadNote( ids[i].iUid );
+
+        if( journal ) {
+            aIncidences.append( journal );
         }
         else {
-            ++i;
+            qCWarning(lcSyncMLPlugin) << "Could not load note" << ids[i].iUid;
+        }
+    }
+
+    return true;
+}
+
+void NotesBackend::filterIncidences( KCalendarCore::Incidence::List& aIncidences )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // Compact the list in a single pass instead of removing items one by one
+    int count = 0;
+    for( int i = 0; i < aIncidences.count(); ++i ) {
+        if( aIncidences[i]->type() == KCalendarCore::Incidence::TypeJournal ) {
+            if( count != i ) {
+                aIncidences[count] = aIncidences[i];
+            }
+            ++count;
         }
     }
+    aIncidences.resize( count );
 
 }
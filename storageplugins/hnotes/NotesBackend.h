@@ -27,6 +27,9 @@
 #include <extendedcalendar.h>
 #include <extendedstorage.h>
 
+#include "IncidenceIdQuery.h"
+#include "CalendarSession.h"
+
 class QDateTime;
 
 namespace Buteo {
@@ -52,9 +55,14 @@ public:
 
     /*! \brief Initializes backend
      *
+     * @param aLoadAll If true, all notes of the notebook are loaded up front,
+     *                 otherwise they are loaded when accessed
+     * @param aSyncSession Sync session the backend is used in. Backends of
+     *                     the same session share the open calendar
      * @return True on success, otherwise false
      */
-    bool init( const QString& aNotebookName, const QString& aUid, const QString &aMimeType );
+    bool init( const QString& aNotebookName, const QString& aUid, const QString &aMimeType,
+               bool aLoadAll = true, const QString& aSyncSession = QString() );
 
     /*! \brief Uninitializes backend
      *
@@ -153,12 +161,25 @@ public:
      */
     bool deleteNote( const QString& aId, bool commitNow );
 
+    /*! \brief Deletes all notes of the notebook and persists the deletion
+     *
+     * @return True on success, otherwise false
+     */
+    bool deleteAllNotes();
+
     /*! \brief Persist notes db
      *
      * @return True on success, otherwise false
      */
     bool commitChanges();
 
+    /*! \brief Checks that the notes database has not been written by
+     *         anyone else since the backend last read or wrote it
+     *
+     * @return True if unchanged, otherwise false
+     */
+    bool isCurrent() const;
+
 protected:
 
 private:
@@ -169,12 +190,22 @@ private:
 
     void filterIncidences( KCalendarCore::Incidence::List& aIncidences );
 
+    KCalendarCore::Incidence::Ptr loadNote( const QString& aId );
+
+    bool queryNotes( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime,
+                     KCalendarCore::Incidence::List& aIncidences );
+
+    bool queryNoteIds( IncidenceIdQuery::ChangeType aChangeType, const QDateTime& aTime, QList<QString>& aIds );
 
     QString                 iNotebookName;
     QString                 iMimeType;
 
     mKCal::ExtendedCalendar::Ptr    iCalendar;
     mKCal::ExtendedStorage::Ptr    iStorage;
+    QSharedPointer<CalendarSession> iSession;
+    IncidenceIdQuery                iIdQuery;
+    bool                            iIdQueryAvailable;
+    bool                            iLoaded;
 
 };
 
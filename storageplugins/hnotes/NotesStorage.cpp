@@ -48,8 +48,12 @@ const char* DEFAULT_TYPE_VERSION    = "1.0";
 const char* DEFAULT_NOTEBOOK        = "Personal";
 const char* DEFAULT_NOTEBOOK_NAME   = "myNotebook";
 
+// Number of notes added between commits while refreshing from remote
+const int REFRESH_COMMIT_INTERVAL   = 1000;
 
-NotesStorage::NotesStorage( const QString& aPluginName ) : Buteo::StoragePlugin( aPluginName ), iCommitNow( true )
+
+NotesStorage::NotesStorage( const QString& aPluginName ) : Buteo::StoragePlugin( aPluginName ), iCommitNow( true ),
+    iRefresh( false ), iRefreshCleared( false ), iUncommitted( 0 )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 }
@@ -68,6 +72,10 @@ bool NotesStorage::init( const QMap<QString, QString>& aProperties )
     iProperties[STORAGE_SYNCML_CTCAPS_PROP_11] = getCTCaps( CTCAPSFILENAME11 );
     iProperties[STORAGE_SYNCML_CTCAPS_PROP_12] = getCTCaps( CTCAPSFILENAME12 );
 
+    iRefresh        = ( iProperties.value( STORAGE_REFRESH_PROP ) == PROPS_TRUE );
+    iRefreshCleared = false;
+    iUncommitted    = 0;
+
     // Use remote name (e.g. bt name) as notebook name.
     if(iProperties.contains(Buteo::KEY_REMOTE_NAME)) {
         qCDebug(lcSyncMLPlugin) << "Using remote name as notebook name";
@@ -100,17 +108,55 @@ bool NotesStorage::init( const QMap<QString, QString>& aProperties )
         iProperties[STORAGE_NOTEBOOK_PROP] = DEFAULT_NOTEBOOK;
     }
 
+    // Notes only need to be loaded up front when they are all going to be read
+    bool loadAll = iProperties.value( STORAGE_SYNC_DIRECTION_PROP ) != STORAGE_SYNC_DIRECTION_FROM_REMOTE;
+
     return iBackend.init( iProperties[STORAGE_NOTEBOOK_PROP], iProperties[Buteo::KEY_NOTES_UUID],
-        iProperties[STORAGE_DEFAULT_MIME_PROP] );
+        iProperties[STORAGE_DEFAULT_MIME_PROP], loadAll, iProperties.value( STORAGE_SYNC_SESSION_PROP ) );
 }
 
 bool NotesStorage::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iUncommitted > 0 && !iBackend.commitChanges() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit" << iUncommitted << "added notes";
+    }
+    iUncommitted = 0;
+
     return iBackend.uninit();
 }
 
+bool NotesStorage::suspend()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iUncommitted > 0 && !iBackend.commitChanges() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit" << iUncommitted << "added notes";
+        return false;
+    }
+    iUncommitted = 0;
+
+    return true;
+}
+
+bool NotesStorage::resume()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // The loaded notes can only be trusted if nobody else has written
+    // to the database in between
+    if( !iBackend.isCurrent() ) {
+        qCDebug(lcSyncMLPlugin) << "Notes database changed, not resuming";
+        return false;
+    }
+
+    iRefreshCleared = false;
+    iUncommitted = 0;
+
+    return true;
+}
+
 bool NotesStorage::getAllItems( QList<Buteo::StorageItem*>& aItems )
 {
     return iBackend.getAllNotes( aItems );
@@ -198,6 +244,17 @@ QList<Buteo::StoragePlugin::OperationStatus> NotesStorage::addItems( const QList
     }
 
     iCommitNow = true;
+
+    // When loading all notes from remote, commit in large transactions
+    // spanning several batches; the rest is committed in uninit()
+    if( iRefresh ) {
+        iUncommitted += aItems.count();
+        if( iUncommitted < REFRESH_COMMIT_INTERVAL ) {
+            return results;
+        }
+        iUncommitted = 0;
+    }
+
     bool saved = iBackend.commitChanges();
     Q_UNUSED( saved );
 
@@ -256,6 +313,20 @@ QList<Buteo::StoragePlugin::OperationStatus> NotesStorage::deleteItems( const QL
 
     QList<OperationStatus> results;
 
+    // During refresh from remote the whole notebook is emptied at once
+    if( iRefresh ) {
+        if( !iRefreshCleared ) {
+            qCDebug(lcSyncMLPlugin) << "Refresh from remote, removing all notes";
+            iRefreshCleared = iBackend.deleteAllNotes();
+        }
+        if( iRefreshCleared ) {
+            for( int i = 0; i < aItemIds.count(); ++i ) {
+                results.append( STATUS_OK );
+            }
+            return results;
+        }
+    }
+
     //Commit once at the end of the batch update
     iCommitNow = false;
 
@@ -290,18 +361,13 @@ QByteArray NotesStorage::getCTCaps( const QString& aFilename ) const
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    QFile ctCapsFile( SyncMLConfig::getXmlDataPath() + aFilename  );
-    QByteArray ctCaps;
+    QByteArray ctCaps = SyncMLConfig::getCTCaps( aFilename );
 
-    if( ctCapsFile.open(QIODevice::ReadOnly)) {
-       ctCaps = ctCapsFile.readAll();
-       ctCapsFile.close();
-    } else {
+    if( ctCaps.isEmpty() ) {
         qCWarning(lcSyncMLPlugin) << "Failed to open CTCaps file for notes storage:" << aFilename;
     }
 
     return ctCaps;
-
 }
 
 
@@ -25,6 +25,7 @@
 #define NOTESSTORAGE_H
 
 #include "NotesBackend.h"
+#include "PoolableStorage.h"
 
 #include <buteosyncfw5/StoragePlugin.h>
 #include <buteosyncfw5/StoragePluginLoader.h>
@@ -34,7 +35,7 @@
  *
  *
  */
-class NotesStorage : public Buteo::StoragePlugin
+class NotesStorage : public Buteo::StoragePlugin, public PoolableStorage
 {
 
 public:
@@ -60,6 +61,16 @@ public:
      */
     virtual bool uninit();
 
+    /*! \see PoolableStorage::suspend()
+     *
+     */
+    virtual bool suspend();
+
+    /*! \see PoolableStorage::resume()
+     *
+     */
+    virtual bool resume();
+
     /*! \see StoragePlugin::getAllItems()
      *
      */
@@ -151,6 +162,10 @@ private:
     NotesBackend    iBackend;
 
     bool            iCommitNow;
+
+    bool            iRefresh;
+    bool            iRefreshCleared;
+    int             iUncommitted;
 };
 
 class NotesStoragePluginLoader : public Buteo::StoragePluginLoader
@@ -15,6 +15,7 @@ VER_MAJ = 1
 VER_MIN = 0
 VER_PAT = 0
 
+QT += sql
 QT -= gui
 
 #input
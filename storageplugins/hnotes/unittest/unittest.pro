@@ -50,7 +50,7 @@ SOURCES += NotesTest.cpp \
            syncmlcommon/SimpleItem.cpp \
            syncmlcommon/SyncMLConfig.cpp
 
-QT += testlib
+QT += testlib sql
 QT -= gui
 CONFIG += link_pkgconfig
 
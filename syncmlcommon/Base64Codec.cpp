@@ -0,0 +1,553 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "Base64Codec.h"
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BASE64_NEON
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+const char ENCODE_TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Values of the decode table that are not sextets
+const unsigned char DECODE_SPACE = 64;
+const unsigned char DECODE_PAD = 65;
+const unsigned char DECODE_INVALID = 255;
+
+// Vector code may write this much past the decoded data
+const int DECODE_SLACK = 32;
+
+struct DecodeTable {
+    unsigned char iValues[256];
+
+    DecodeTable() {
+        for( int i = 0; i < 256; ++i ) {
+            iValues[i] = DECODE_INVALID;
+        }
+        for( int i = 0; i < 64; ++i ) {
+            iValues[static_cast<unsigned char>( ENCODE_TABLE[i] )] = i;
+        }
+        iValues[static_cast<unsigned char>( ' ' )] = DECODE_SPACE;
+        iValues[static_cast<unsigned char>( '\t' )] = DECODE_SPACE;
+        iValues[static_cast<unsigned char>( '\r' )] = DECODE_SPACE;
+        iValues[static_cast<unsigned char>( '\n' )] = DECODE_SPACE;
+        iValues[static_cast<unsigned char>( '=' )] = DECODE_PAD;
+    }
+};
+
+const DecodeTable DECODE_TABLE;
+
+// Block functions process as many whole blocks from the start of the input
+// as they can, and return the number of input bytes consumed. Decoding
+// stops at the first block that has anything but base64 characters.
+typedef int (*EncodeBlocks)( const unsigned char* aIn, int aLength, char* aOut );
+typedef int (*DecodeBlocks)( const unsigned char* aIn, int aLength, unsigned char* aOut, int& aWritten );
+
+int encodeScalar( const unsigned char* aIn, int aLength, char* aOut )
+{
+    char* out = aOut;
+    int i = 0;
+
+    for( ; aLength - i >= 3; i += 3 ) {
+        quint32 triple = ( aIn[i] << 16 ) | ( aIn[i + 1] << 8 ) | aIn[i + 2];
+        *out++ = ENCODE_TABLE[( triple >> 18 ) & 0x3f];
+        *out++ = ENCODE_TABLE[( triple >> 12 ) & 0x3f];
+        *out++ = ENCODE_TABLE[( triple >> 6 ) & 0x3f];
+        *out++ = ENCODE_TABLE[triple & 0x3f];
+    }
+
+    if( aLength - i == 1 ) {
+        quint32 triple = aIn[i] << 16;
+        *out++ = ENCODE_TABLE[( triple >> 18 ) & 0x3f];
+        *out++ = ENCODE_TABLE[( triple >> 12 ) & 0x3f];
+        *out++ = '=';
+        *out++ = '=';
+    }
+    else if( aLength - i == 2 ) {
+        quint32 triple = ( aIn[i] << 16 ) | ( aIn[i + 1] << 8 );
+        *out++ = ENCODE_TABLE[( triple >> 18 ) & 0x3f];
+        *out++ = ENCODE_TABLE[( triple >> 12 ) & 0x3f];
+        *out++ = ENCODE_TABLE[( triple >> 6 ) & 0x3f];
+        *out++ = '=';
+    }
+
+    return out - aOut;
+}
+
+bool decodeScalar( const unsigned char* aIn, int aLength, unsigned char* aOut, int& aWritten,
+                   DecodeBlocks aBlocks )
+{
+    int i = 0;
+    int o = 0;
+    quint32 bits = 0;
+    int sextets = 0;
+    int padding = 0;
+
+    while( i < aLength ) {
+        if( aBlocks && sextets == 0 && padding == 0 ) {
+            int written = 0;
+            i += aBlocks( aIn + i, aLength - i, aOut + o, written );
+            o += written;
+            if( i >= aLength ) {
+                break;
+            }
+        }
+
+        unsigned char value = DECODE_TABLE.iValues[aIn[i++]];
+
+        if( value < 64 ) {
+            if( padding > 0 ) {
+                return false;
+            }
+            bits = ( bits << 6 ) | value;
+            if( ++sextets == 4 ) {
+                aOut[o++] = bits >> 16;
+                aOut[o++] = bits >> 8;
+                aOut[o++] = bits;
+                bits = 0;
+                sextets = 0;
+            }
+        }
+        else if( value == DECODE_PAD ) {
+            ++padding;
+        }
+        else if( value != DECODE_SPACE ) {
+            return false;
+        }
+    }
+
+    if( sextets == 1 || ( padding > 0 && sextets + padding != 4 ) ) {
+        return false;
+    }
+
+    if( sextets == 2 ) {
+        aOut[o++] = bits >> 4;
+    }
+    else if( sextets == 3 ) {
+        aOut[o++] = bits >> 10;
+        aOut[o++] = bits >> 2;
+    }
+
+    aWritten = o;
+    return true;
+}
+
+#ifdef BASE64_X86
+
+// Splits 12 bytes to 16 sextets, one per byte, in each 128 bits. See
+// http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+#define BASE64_SPLIT( SUFFIX, PREFIX, aVector ) \
+    PREFIX##_or_##SUFFIX( \
+        PREFIX##_mulhi_epu16( PREFIX##_and_##SUFFIX( aVector, PREFIX##_set1_epi32( 0x0fc0fc00 ) ), \
+                              PREFIX##_set1_epi32( 0x04000040 ) ), \
+        PREFIX##_mullo_epi16( PREFIX##_and_##SUFFIX( aVector, PREFIX##_set1_epi32( 0x003f03f0 ) ), \
+                              PREFIX##_set1_epi32( 0x01000010 ) ) )
+
+__attribute__((target("ssse3")))
+inline __m128i encodeLookup128( __m128i aSextets )
+{
+    // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12
+    __m128i offsetIndex = _mm_subs_epu8( aSextets, _mm_set1_epi8( 51 ) );
+    __m128i lessThan26 = _mm_cmpgt_epi8( _mm_set1_epi8( 26 ), aSextets );
+    offsetIndex = _mm_or_si128( offsetIndex, _mm_and_si128( lessThan26, _mm_set1_epi8( 13 ) ) );
+
+    const __m128i offsets = _mm_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                           '/' - 63, 'A', 0, 0 );
+
+    return _mm_add_epi8( _mm_shuffle_epi8( offsets, offsetIndex ), aSextets );
+}
+
+__attribute__((target("ssse3")))
+int encodeBlocksSSSE3( const unsigned char* aIn, int aLength, char* aOut )
+{
+    const __m128i spread = _mm_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 );
+    int i = 0;
+
+    // Loads 16 bytes to use 12
+    for( ; aLength - i >= 16; i += 12 ) {
+        __m128i in = _mm_loadu_si128( reinterpret_cast<const __m128i*>( aIn + i ) );
+        in = _mm_shuffle_epi8( in, spread );
+        __m128i sextets = BASE64_SPLIT( si128, _mm, in );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( aOut ), encodeLookup128( sextets ) );
+        aOut += 16;
+    }
+
+    return i;
+}
+
+// Maps base64 characters to sextets. aValid has all bits set for bytes
+// that were base64 characters.
+__attribute__((target("ssse3")))
+inline __m128i decodeLookup128( __m128i aChars, __m128i& aValid )
+{
+    __m128i upper = _mm_and_si128( _mm_cmpgt_epi8( aChars, _mm_set1_epi8( 'A' - 1 ) ),
+                                   _mm_cmpgt_epi8( _mm_set1_epi8( 'Z' + 1 ), aChars ) );
+    __m128i lower = _mm_and_si128( _mm_cmpgt_epi8( aChars, _mm_set1_epi8( 'a' - 1 ) ),
+                                   _mm_cmpgt_epi8( _mm_set1_epi8( 'z' + 1 ), aChars ) );
+    __m128i digit = _mm_and_si128( _mm_cmpgt_epi8( aChars, _mm_set1_epi8( '0' - 1 ) ),
+                                   _mm_cmpgt_epi8( _mm_set1_epi8( '9' + 1 ), aChars ) );
+    __m128i plus = _mm_cmpeq_epi8( aChars, _mm_set1_epi8( '+' ) );
+    __m128i slash = _mm_cmpeq_epi8( aChars, _mm_set1_epi8( '/' ) );
+
+    aValid = _mm_or_si128( _mm_or_si128( upper, lower ), _mm_or_si128( digit, _mm_or_si128( plus, slash ) ) );
+
+    __m128i shift = _mm_or_si128(
+        _mm_or_si128( _mm_and_si128( upper, _mm_set1_epi8( -'A' ) ),
+                      _mm_and_si128( lower, _mm_set1_epi8( 26 - 'a' ) ) ),
+        _mm_or_si128( _mm_and_si128( digit, _mm_set1_epi8( 52 - '0' ) ),
+                      _mm_or_si128( _mm_and_si128( plus, _mm_set1_epi8( 62 - '+' ) ),
+                                    _mm_and_si128( slash, _mm_set1_epi8( 63 - '/' ) ) ) ) );
+
+    return _mm_add_epi8( aChars, shift );
+}
+
+// Packs 16 sextets to 12 bytes at the start of each 128 bits
+#define BASE64_PACK( PREFIX, aSextets ) \
+    PREFIX##_madd_epi16( PREFIX##_maddubs_epi16( aSextets, PREFIX##_set1_epi32( 0x01400140 ) ), \
+                         PREFIX##_set1_epi32( 0x00011000 ) )
+
+__attribute__((target("ssse3")))
+int decodeBlocksSSSE3( const unsigned char* aIn, int aLength, unsigned char* aOut, int& aWritten )
+{
+    const __m128i gather = _mm_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+    int i = 0;
+    aWritten = 0;
+
+    for( ; aLength - i >= 16; i += 16 ) {
+        __m128i in = _mm_loadu_si128( reinterpret_cast<const __m128i*>( aIn + i ) );
+        __m128i valid;
+        __m128i sextets = decodeLookup128( in, valid );
+
+        if( _mm_movemask_epi8( valid ) != 0xffff ) {
+            break;
+        }
+
+        __m128i out = _mm_shuffle_epi8( BASE64_PACK( _mm, sextets ), gather );
+        _mm_storeu_si128( reinterpret_cast<__m128i*>( aOut + aWritten ), out );
+        aWritten += 12;
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i encodeLookup256( __m256i aSextets )
+{
+    __m256i offsetIndex = _mm256_subs_epu8( aSextets, _mm256_set1_epi8( 51 ) );
+    __m256i lessThan26 = _mm256_cmpgt_epi8( _mm256_set1_epi8( 26 ), aSextets );
+    offsetIndex = _mm256_or_si256( offsetIndex, _mm256_and_si256( lessThan26, _mm256_set1_epi8( 13 ) ) );
+
+    const __m256i offsets = _mm256_setr_epi8( 'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0,
+                                              'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+                                              '/' - 63, 'A', 0, 0 );
+
+    return _mm256_add_epi8( _mm256_shuffle_epi8( offsets, offsetIndex ), aSextets );
+}
+
+__attribute__((target("avx2")))
+int encodeBlocksAVX2( const unsigned char* aIn, int aLength, char* aOut )
+{
+    // The second 12 bytes are moved to the upper 128 bits, as the byte
+    // shuffle does not cross them
+    const __m256i halves = _mm256_setr_epi32( 0, 1, 2, 0, 3, 4, 5, 0 );
+    const __m256i spread = _mm256_setr_epi8( 1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                             1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10 );
+    int i = 0;
+
+    // Loads 32 bytes to use 24
+    for( ; aLength - i >= 32; i += 24 ) {
+        __m256i in = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( aIn + i ) );
+        in = _mm256_shuffle_epi8( _mm256_permutevar8x32_epi32( in, halves ), spread );
+        __m256i sextets = BASE64_SPLIT( si256, _mm256, in );
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( aOut ), encodeLookup256( sextets ) );
+        aOut += 32;
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256i decodeLookup256( __m256i aChars, __m256i& aValid )
+{
+    __m256i upper = _mm256_and_si256( _mm256_cmpgt_epi8( aChars, _mm256_set1_epi8( 'A' - 1 ) ),
+                                      _mm256_cmpgt_epi8( _mm256_set1_epi8( 'Z' + 1 ), aChars ) );
+    __m256i lower = _mm256_and_si256( _mm256_cmpgt_epi8( aChars, _mm256_set1_epi8( 'a' - 1 ) ),
+                                      _mm256_cmpgt_epi8( _mm256_set1_epi8( 'z' + 1 ), aChars ) );
+    __m256i digit = _mm256_and_si256( _mm256_cmpgt_epi8( aChars, _mm256_set1_epi8( '0' - 1 ) ),
+                                      _mm256_cmpgt_epi8( _mm256_set1_epi8( '9' + 1 ), aChars ) );
+    __m256i plus = _mm256_cmpeq_epi8( aChars, _mm256_set1_epi8( '+' ) );
+    __m256i slash = _mm256_cmpeq_epi8( aChars, _mm256_set1_epi8( '/' ) );
+
+    aValid = _mm256_or_si256( _mm256_or_si256( upper, lower ),
+                              _mm256_or_si256( digit, _mm256_or_si256( plus, slash ) ) );
+
+    __m256i shift = _mm256_or_si256(
+        _mm256_or_si256( _mm256_and_si256( upper, _mm256_set1_epi8( -'A' ) ),
+                         _mm256_and_si256( lower, _mm256_set1_epi8( 26 - 'a' ) ) ),
+        _mm256_or_si256( _mm256_and_si256( digit, _mm256_set1_epi8( 52 - '0' ) ),
+                         _mm256_or_si256( _mm256_and_si256( plus, _mm256_set1_epi8( 62 - '+' ) ),
+                                          _mm256_and_si256( slash, _mm256_set1_epi8( 63 - '/' ) ) ) ) );
+
+    return _mm256_add_epi8( aChars, shift );
+}
+
+__attribute__((target("avx2")))
+int decodeBlocksAVX2( const unsigned char* aIn, int aLength, unsigned char* aOut, int& aWritten )
+{
+    const __m256i gather = _mm256_setr_epi8( 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                             2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1 );
+    const __m256i join = _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 7, 7 );
+    int i = 0;
+    aWritten = 0;
+
+    for( ; aLength - i >= 32; i += 32 ) {
+        __m256i in = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( aIn + i ) );
+        __m256i valid;
+        __m256i sextets = decodeLookup256( in, valid );
+
+        if( _mm256_movemask_epi8( valid ) != -1 ) {
+            break;
+        }
+
+        __m256i out = _mm256_shuffle_epi8( BASE64_PACK( _mm256, sextets ), gather );
+        out = _mm256_permutevar8x32_epi32( out, join );
+        _mm256_storeu_si256( reinterpret_cast<__m256i*>( aOut + aWritten ), out );
+        aWritten += 24;
+    }
+
+    return i;
+}
+
+#endif // BASE64_X86
+
+#ifdef BASE64_NEON
+
+inline uint8x16_t encodeLookupNEON( uint8x16_t aSextets )
+{
+    uint8x16_t chars = vaddq_u8( aSextets, vdupq_n_u8( 'A' ) );
+    chars = vbslq_u8( vcgeq_u8( aSextets, vdupq_n_u8( 26 ) ),
+                      vaddq_u8( aSextets, vdupq_n_u8( 'a' - 26 ) ), chars );
+    chars = vbslq_u8( vcgeq_u8( aSextets, vdupq_n_u8( 52 ) ),
+                      vsubq_u8( aSextets, vdupq_n_u8( 52 - '0' ) ), chars );
+    chars = vbslq_u8( vceqq_u8( aSextets, vdupq_n_u8( 62 ) ), vdupq_n_u8( '+' ), chars );
+    chars = vbslq_u8( vceqq_u8( aSextets, vdupq_n_u8( 63 ) ), vdupq_n_u8( '/' ), chars );
+    return chars;
+}
+
+int encodeBlocksNEON( const unsigned char* aIn, int aLength, char* aOut )
+{
+    const uint8x16_t mask = vdupq_n_u8( 0x3f );
+    int i = 0;
+
+    for( ; aLength - i >= 48; i += 48 ) {
+        uint8x16x3_t in = vld3q_u8( aIn + i );
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8( in.val[0], 2 );
+        out.val[1] = vandq_u8( vorrq_u8( vshrq_n_u8( in.val[1], 4 ), vshlq_n_u8( in.val[0], 4 ) ), mask );
+        out.val[2] = vandq_u8( vorrq_u8( vshrq_n_u8( in.val[2], 6 ), vshlq_n_u8( in.val[1], 2 ) ), mask );
+        out.val[3] = vandq_u8( in.val[2], mask );
+        for( int j = 0; j < 4; ++j ) {
+            out.val[j] = encodeLookupNEON( out.val[j] );
+        }
+        vst4q_u8( reinterpret_cast<uint8_t*>( aOut ), out );
+        aOut += 64;
+    }
+
+    return i;
+}
+
+inline uint8x16_t decodeLookupNEON( uint8x16_t aChars, uint8x16_t& aValid )
+{
+    uint8x16_t upper = vandq_u8( vcgeq_u8( aChars, vdupq_n_u8( 'A' ) ), vcleq_u8( aChars, vdupq_n_u8( 'Z' ) ) );
+    uint8x16_t lower = vandq_u8( vcgeq_u8( aChars, vdupq_n_u8( 'a' ) ), vcleq_u8( aChars, vdupq_n_u8( 'z' ) ) );
+    uint8x16_t digit = vandq_u8( vcgeq_u8( aChars, vdupq_n_u8( '0' ) ), vcleq_u8( aChars, vdupq_n_u8( '9' ) ) );
+    uint8x16_t plus = vceqq_u8( aChars, vdupq_n_u8( '+' ) );
+    uint8x16_t slash = vceqq_u8( aChars, vdupq_n_u8( '/' ) );
+
+    aValid = vorrq_u8( vorrq_u8( upper, lower ), vorrq_u8( digit, vorrq_u8( plus, slash ) ) );
+
+    uint8x16_t sextets = vandq_u8( upper, vsubq_u8( aChars, vdupq_n_u8( 'A' ) ) );
+    sextets = vbslq_u8( lower, vsubq_u8( aChars, vdupq_n_u8( 'a' - 26 ) ), sextets );
+    sextets = vbslq_u8( digit, vaddq_u8( aChars, vdupq_n_u8( 52 - '0' ) ), sextets );
+    sextets = vbslq_u8( plus, vdupq_n_u8( 62 ), sextets );
+    sextets = vbslq_u8( slash, vdupq_n_u8( 63 ), sextets );
+    return sextets;
+}
+
+int decodeBlocksNEON( const unsigned char* aIn, int aLength, unsigned char* aOut, int& aWritten )
+{
+    int i = 0;
+    aWritten = 0;
+
+    for( ; aLength - i >= 64; i += 64 ) {
+        uint8x16x4_t in = vld4q_u8( aIn + i );
+        uint8x16_t valid = vdupq_n_u8( 0xff );
+        for( int j = 0; j < 4; ++j ) {
+            uint8x16_t charsValid;
+            in.val[j] = decodeLookupNEON( in.val[j], charsValid );
+            valid = vandq_u8( valid, charsValid );
+        }
+
+        uint8x8_t halves = vand_u8( vget_low_u8( valid ), vget_high_u8( valid ) );
+        if( vget_lane_u64( vreinterpret_u64_u8( halves ), 0 ) != ~quint64( 0 ) ) {
+            break;
+        }
+
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8( vshlq_n_u8( in.val[0], 2 ), vshrq_n_u8( in.val[1], 4 ) );
+        out.val[1] = vorrq_u8( vshlq_n_u8( in.val[1], 4 ), vshrq_n_u8( in.val[2], 2 ) );
+        out.val[2] = vorrq_u8( vshlq_n_u8( in.val[2], 6 ), in.val[3] );
+        vst3q_u8( aOut + aWritten, out );
+        aWritten += 48;
+    }
+
+    return i;
+}
+
+#endif // BASE64_NEON
+
+EncodeBlocks encodeBlocks( Base64Codec::Implementation aImplementation )
+{
+    switch( aImplementation ) {
+#ifdef BASE64_X86
+        case Base64Codec::IMPL_SSSE3:
+            return encodeBlocksSSSE3;
+        case Base64Codec::IMPL_AVX2:
+            return encodeBlocksAVX2;
+#endif
+#ifdef BASE64_NEON
+        case Base64Codec::IMPL_NEON:
+            return encodeBlocksNEON;
+#endif
+        default:
+            return 0;
+    }
+}
+
+DecodeBlocks decodeBlocks( Base64Codec::Implementation aImplementation )
+{
+    switch( aImplementation ) {
+#ifdef BASE64_X86
+        case Base64Codec::IMPL_SSSE3:
+            return decodeBlocksSSSE3;
+        case Base64Codec::IMPL_AVX2:
+            return decodeBlocksAVX2;
+#endif
+#ifdef BASE64_NEON
+        case Base64Codec::IMPL_NEON:
+            return decodeBlocksNEON;
+#endif
+        default:
+            return 0;
+    }
+}
+
+} // namespace
+
+QByteArray Base64Codec::encode( const QByteArray& aData, Implementation aImplementation )
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>( aData.constData() );
+    int length = aData.size();
+
+    QByteArray result( ( length + 2 ) / 3 * 4, Qt::Uninitialized );
+    char* out = result.data();
+
+    int consumed = 0;
+    EncodeBlocks blocks = encodeBlocks( aImplementation );
+    if( blocks ) {
+        consumed = blocks( in, length, out );
+        out += consumed / 3 * 4;
+    }
+
+    encodeScalar( in + consumed, length - consumed, out );
+
+    return result;
+}
+
+bool Base64Codec::decode( const QByteArray& aData, QByteArray& aResult, Implementation aImplementation )
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>( aData.constData() );
+    int length = aData.size();
+
+    aResult.resize( length / 4 * 3 + 3 + DECODE_SLACK );
+    int written = 0;
+
+    if( !decodeScalar( in, length, reinterpret_cast<unsigned char*>( aResult.data() ), written,
+                       decodeBlocks( aImplementation ) ) ) {
+        aResult.clear();
+        return false;
+    }
+
+    aResult.resize( written );
+    return true;
+}
+
+Base64Codec::Implementation Base64Codec::best()
+{
+    static const Implementation implementation = implementations().last();
+    return implementation;
+}
+
+QList<Base64Codec::Implementation> Base64Codec::implementations()
+{
+    QList<Implementation> supported;
+    supported << IMPL_SCALAR;
+
+#ifdef BASE64_X86
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "ssse3" ) ) {
+        supported << IMPL_SSSE3;
+    }
+    if( __builtin_cpu_supports( "avx2" ) ) {
+        supported << IMPL_AVX2;
+    }
+#endif
+
+#ifdef BASE64_NEON
+    supported << IMPL_NEON;
+#endif
+
+    return supported;
+}
+
+QString Base64Codec::name( Implementation aImplementation )
+{
+    switch( aImplementation ) {
+        case IMPL_SSSE3:
+            return "ssse3";
+        case IMPL_AVX2:
+            return "avx2";
+        case IMPL_NEON:
+            return "neon";
+        default:
+            return "scalar";
+    }
+}
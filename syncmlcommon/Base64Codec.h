@@ -0,0 +1,91 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef BASE64CODEC_H
+#define BASE64CODEC_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+/*! \brief Base64 encoder and decoder for binary item properties
+ *
+ * Photos and other binary properties of contacts and incidences are base64
+ * encoded in the items. The codec processes 12 (SSSE3) or 24 (AVX2) bytes
+ * at a time on x86 and 48 bytes at a time with NEON, selecting the fastest
+ * implementation the CPU supports at run time. Other CPUs, and input the
+ * vector code can not handle, use the scalar implementation.
+ */
+class Base64Codec
+{
+public:
+
+    //! Implementations of the codec
+    enum Implementation {
+        IMPL_SCALAR,
+        IMPL_SSSE3,
+        IMPL_AVX2,
+        IMPL_NEON
+    };
+
+    /*! \brief Encodes data to base64
+     *
+     * The output has padding but no line breaks.
+     *
+     * @param aData Data to encode
+     * @param aImplementation Implementation to use, must be supported by the CPU
+     * @return Base64 encoded data
+     */
+    static QByteArray encode( const QByteArray& aData, Implementation aImplementation = best() );
+
+    /*! \brief Decodes base64 data
+     *
+     * White space anywhere in the input is skipped, and the padding at the
+     * end is optional.
+     *
+     * @param aData Base64 data to decode
+     * @param aResult Decoded data
+     * @param aImplementation Implementation to use, must be supported by the CPU
+     * @return True on success, false if the input is not valid base64
+     */
+    static bool decode( const QByteArray& aData, QByteArray& aResult,
+                        Implementation aImplementation = best() );
+
+    /*! \brief Returns the fastest implementation supported by the CPU
+     *
+     * @return Implementation
+     */
+    static Implementation best();
+
+    /*! \brief Returns the implementations supported by the CPU
+     *
+     * @return Implementations, slowest first
+     */
+    static QList<Implementation> implementations();
+
+    /*! \brief Returns the name of an implementation
+     *
+     * @param aImplementation Implementation
+     * @return Name, e.g. "ssse3"
+     */
+    static QString name( Implementation aImplementation );
+
+};
+
+#endif  //  BASE64CODEC_H
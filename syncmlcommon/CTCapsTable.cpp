@@ -0,0 +1,304 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "CTCapsTable.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QXmlStreamReader>
+
+#include "SyncMLConfig.h"
+#include "SyncMLPluginLogging.h"
+
+CTCapsTable::CTCapsTable()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+CTCapsTable::~CTCapsTable()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+bool CTCapsTable::parse( const QByteArray& aCTCaps, const QString& aType )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    clear();
+
+    QXmlStreamReader reader( aCTCaps );
+
+    // SyncML 1.1 lists all types in one flat CTCap element, where CTType
+    // starts the capabilities of a type and ParamName the ones of a parameter.
+    // SyncML 1.2 has a CTCap element per type, with Property and PropParam
+    // elements.
+    int ctCapDepth = 0;
+    bool typeMatches = false;
+    bool inParameter = false;
+    QByteArray property;
+
+    while( !reader.atEnd() ) {
+        reader.readNext();
+
+        if( reader.isStartElement() ) {
+            QStringRef name = reader.name();
+
+            if( name == QLatin1String( "CTCap" ) ) {
+                ++ctCapDepth;
+                typeMatches = aType.isEmpty();
+                inParameter = false;
+                property.clear();
+            }
+            else if( ctCapDepth == 0 ) {
+                continue;
+            }
+            else if( name == QLatin1String( "CTType" ) ) {
+                QString type = reader.readElementText().trimmed();
+                typeMatches = aType.isEmpty() || type.compare( aType, Qt::CaseInsensitive ) == 0;
+                inParameter = false;
+                property.clear();
+            }
+            else if( name == QLatin1String( "PropName" ) ) {
+                property = reader.readElementText().trimmed().toUpper().toUtf8();
+                inParameter = false;
+                if( !typeMatches || property.isEmpty() ) {
+                    property.clear();
+                }
+                else {
+                    iProperties[property];
+                }
+            }
+            else if( name == QLatin1String( "PropParam" ) ) {
+                inParameter = true;
+            }
+            else if( name == QLatin1String( "ParamName" ) ) {
+                QByteArray parameter = reader.readElementText().trimmed().toUpper().toUtf8();
+                inParameter = true;
+                if( !property.isEmpty() && !parameter.isEmpty() ) {
+                    iProperties[property].iParameters.insert( parameter );
+                }
+            }
+            else if( name == QLatin1String( "ValEnum" ) ) {
+                QByteArray value = reader.readElementText().trimmed().toUpper().toUtf8();
+                if( inParameter && !property.isEmpty() && !value.isEmpty() ) {
+                    iProperties[property].iParameters.insert( value );
+                }
+            }
+            else if( name == QLatin1String( "MaxSize" ) || name == QLatin1String( "Size" ) ) {
+                int size = reader.readElementText().trimmed().toInt();
+                if( !inParameter && !property.isEmpty() && size > 0 ) {
+                    iProperties[property].iMaxSize = size;
+                }
+            }
+        }
+        else if( reader.isEndElement() ) {
+            QStringRef name = reader.name();
+
+            if( name == QLatin1String( "CTCap" ) && ctCapDepth > 0 ) {
+                --ctCapDepth;
+                property.clear();
+            }
+            else if( name == QLatin1String( "PropParam" ) ) {
+                inParameter = false;
+            }
+            else if( name == QLatin1String( "Property" ) ) {
+                property.clear();
+            }
+        }
+    }
+
+    if( reader.hasError() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not parse CTCaps:" << reader.errorString();
+        clear();
+        return false;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "CTCaps for" << aType << "list" << iProperties.count() << "properties";
+
+    return true;
+}
+
+bool CTCapsTable::load( const QString& aFile, const QString& aType )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QString path = aFile;
+    if( QDir::isRelativePath( path ) ) {
+        path.prepend( SyncMLConfig::getXmlDataPath() );
+    }
+
+    QFile file( path );
+
+    if( !file.open( QIODevice::ReadOnly ) ) {
+        qCWarning(lcSyncMLPlugin) << "Failed to open CTCaps file:" << path;
+        clear();
+        return false;
+    }
+
+    return parse( file.readAll(), aType );
+}
+
+void CTCapsTable::clear()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iProperties.clear();
+}
+
+bool CTCapsTable::isEmpty() const
+{
+    return iProperties.isEmpty();
+}
+
+bool CTCapsTable::hasProperty( const QString& aProperty ) const
+{
+    return iProperties.isEmpty() || iProperties.contains( aProperty.toUpper().toUtf8() );
+}
+
+bool CTCapsTable::hasParameter( const QString& aProperty, const QString& aParameter ) const
+{
+    if( iProperties.isEmpty() ) {
+        return true;
+    }
+
+    QHash<QByteArray, Property>::const_iterator i = iProperties.constFind( aProperty.toUpper().toUtf8() );
+
+    return i != iProperties.constEnd() && i->iParameters.contains( aParameter.toUpper().toUtf8() );
+}
+
+int CTCapsTable::maxSize( const QString& aProperty ) const
+{
+    return iProperties.value( aProperty.toUpper().toUtf8() ).iMaxSize;
+}
+
+QByteArray CTCapsTable::prune( const QByteArray& aData ) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iProperties.isEmpty() ) {
+        return aData;
+    }
+
+    QByteArray pruned;
+    pruned.reserve( aData.size() );
+
+    const int size = aData.size();
+    int pos = 0;
+    int componentDepth = 0;
+    bool keep = true;
+    bool quotedPrintable = false;
+    bool softBreak = false;
+
+    while( pos < size ) {
+        int end = aData.indexOf( '\n', pos );
+        int next = ( end < 0 ) ? size : end + 1;
+        int lineEnd = ( end < 0 ) ? size : end;
+        if( lineEnd > pos && aData.at( lineEnd - 1 ) == '\r' ) {
+            --lineEnd;
+        }
+
+        // Folded lines start with white space, and quoted-printable values
+        // continue on the next line after a soft line break
+        char first = aData.at( pos );
+        if( !softBreak && first != ' ' && first != '\t' ) {
+            QByteArray line = aData.mid( pos, lineEnd - pos );
+            keep = isKept( line, componentDepth );
+
+            int colon = line.indexOf( ':' );
+            quotedPrintable = colon > 0 &&
+                              line.left( colon ).toUpper().contains( "QUOTED-PRINTABLE" );
+        }
+
+        softBreak = quotedPrintable && lineEnd > pos && aData.at( lineEnd - 1 ) == '=';
+
+        if( keep ) {
+            pruned.append( aData.constData() + pos, next - pos );
+        }
+
+        pos = next;
+    }
+
+    return pruned;
+}
+
+QByteArray CTCapsTable::key() const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QList<QByteArray> names = iProperties.keys();
+    std::sort( names.begin(), names.end() );
+
+    QByteArray key;
+
+    foreach( const QByteArray& name, names ) {
+        const Property& property = iProperties[name];
+
+        QList<QByteArray> parameters = property.iParameters.toList();
+        std::sort( parameters.begin(), parameters.end() );
+
+        key += name;
+        key += ':';
+        key += QByteArray::number( property.iMaxSize );
+        foreach( const QByteArray& parameter, parameters ) {
+            key += ';';
+            key += parameter;
+        }
+        key += '\n';
+    }
+
+    return key;
+}
+
+bool CTCapsTable::isKept( const QByteArray& aLine, int& aComponentDepth ) const
+{
+    int nameEnd = 0;
+    while( nameEnd < aLine.size() && aLine.at( nameEnd ) != ';' && aLine.at( nameEnd ) != ':' ) {
+        ++nameEnd;
+    }
+
+    QByteArray name = aLine.left( nameEnd ).trimmed().toUpper();
+
+    // Leave out the group, as in "item1.TEL"
+    int group = name.lastIndexOf( '.' );
+    if( group >= 0 ) {
+        name = name.mid( group + 1 );
+    }
+
+    if( name.isEmpty() ) {
+        return true;
+    }
+
+    if( name == "BEGIN" ) {
+        if( aComponentDepth > 0 || aLine.mid( nameEnd + 1 ).trimmed().toUpper() == "VTIMEZONE" ) {
+            ++aComponentDepth;
+        }
+        return true;
+    }
+
+    if( name == "END" ) {
+        if( aComponentDepth > 0 ) {
+            --aComponentDepth;
+        }
+        return true;
+    }
+
+    return aComponentDepth > 0 || name == "VERSION" || iProperties.contains( name );
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CTCAPSTABLE_H
+#define CTCAPSTABLE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+
+/*! \brief Lookup table of the content capabilities (CTCaps) of a device
+ *
+ * Devices declare in their device info which properties and parameters of a
+ * content type they support, optionally with the maximum size of property
+ * values. Anything else sent to the device is discarded by it. The table is
+ * parsed once from the SyncML 1.1 or 1.2 CTCaps XML and then used to leave out
+ * unsupported properties when items are serialized for the device.
+ *
+ * An empty table means that nothing is known about the device, and nothing is
+ * left out.
+ */
+class CTCapsTable {
+
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    CTCapsTable();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~CTCapsTable();
+
+    /*! \brief Parses CTCaps
+     *
+     * Only the capabilities declared for content type aType are used. The
+     * previous contents of the table are replaced.
+     *
+     * @param aCTCaps CTCaps XML, either one or more CTCap elements or device info
+     * @param aType Content type, e.g. "text/x-vcard". Empty to use all types
+     * @return True if the XML could be parsed, otherwise false
+     */
+    bool parse( const QByteArray& aCTCaps, const QString& aType );
+
+    /*! \brief Parses CTCaps from a file
+     *
+     * @param aFile CTCaps file. Relative paths are relative to SyncMLConfig::getXmlDataPath()
+     * @param aType Content type, e.g. "text/x-vcard". Empty to use all types
+     * @return True if the file could be read and parsed, otherwise false
+     */
+    bool load( const QString& aFile, const QString& aType );
+
+    /*! \brief Empties the table
+     *
+     */
+    void clear();
+
+    /*! \brief Checks if the table has no capabilities
+     *
+     * @return True if no capabilities are known, otherwise false
+     */
+    bool isEmpty() const;
+
+    /*! \brief Checks if a property is supported
+     *
+     * @param aProperty Property name, e.g. "TEL"
+     * @return True if the property is supported or the table is empty, otherwise false
+     */
+    bool hasProperty( const QString& aProperty ) const;
+
+    /*! \brief Checks if a parameter of a property is supported
+     *
+     * Both parameter names and parameter values (e.g. "TYPE" and "HOME") are
+     * listed as parameters.
+     *
+     * @param aProperty Property name, e.g. "TEL"
+     * @param aParameter Parameter name or value, e.g. "CELL"
+     * @return True if the parameter is supported or the table is empty, otherwise false
+     */
+    bool hasParameter( const QString& aProperty, const QString& aParameter ) const;
+
+    /*! \brief Returns the maximum size of the value of a property
+     *
+     * @param aProperty Property name, e.g. "PHOTO"
+     * @return Maximum size in bytes, 0 if not limited
+     */
+    int maxSize( const QString& aProperty ) const;
+
+    /*! \brief Removes unsupported properties from a vCard, vCalendar or iCalendar object
+     *
+     * BEGIN, END and VERSION are always kept, and so are time zone components
+     * of iCalendar objects, which other components refer to.
+     *
+     * @param aData Serialized object
+     * @return Object with only the supported properties
+     */
+    QByteArray prune( const QByteArray& aData ) const;
+
+    /*! \brief Returns a canonical form of the table
+     *
+     * The key is the same for tables with the same capabilities, and can be
+     * used as part of cache keys of serialized data.
+     *
+     * @return Key of the table
+     */
+    QByteArray key() const;
+
+private:
+
+    struct Property {
+        Property() : iMaxSize( 0 ) { }
+        int             iMaxSize;
+        QSet<QByteArray> iParameters;
+    };
+
+    bool isKept( const QByteArray& aLine, int& aComponentDepth ) const;
+
+    QHash<QByteArray, Property> iProperties;
+
+    friend class CTCapsTableTest;
+
+};
+
+#endif  //  CTCAPSTABLE_H
@@ -0,0 +1,252 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "CalendarSession.h"
+
+#include <QFileInfo>
+#include <QHash>
+#include <QTimeZone>
+#include <QWeakPointer>
+
+#include <sqlitestorage.h>
+
+#include "SyncMLPluginLogging.h"
+
+static QHash<QString, QWeakPointer<CalendarSession> > sharedSessions;
+
+QSharedPointer<CalendarSession> CalendarSession::acquire( const QString& aSyncSession )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QSharedPointer<CalendarSession> session = sharedSessions.value( aSyncSession ).toStrongRef();
+
+    if( session && !session->isCurrent() && !session->databaseName().isEmpty() ) {
+        qCDebug(lcSyncMLPlugin) << "Calendar database changed, opening a new session";
+        session.clear();
+    }
+
+    if( !session ) {
+        // Forget the sessions that have been closed
+        QMutableHashIterator<QString, QWeakPointer<CalendarSession> > i( sharedSessions );
+        while( i.hasNext() ) {
+            if( i.next().value().isNull() ) {
+                i.remove();
+            }
+        }
+
+        session = QSharedPointer<CalendarSession>( new CalendarSession() );
+        if( !session->open() ) {
+            return QSharedPointer<CalendarSession>();
+        }
+        sharedSessions.insert( aSyncSession, session );
+    }
+    else {
+        qCDebug(lcSyncMLPlugin) << "Using open calendar session of" << aSyncSession;
+    }
+
+    return session;
+}
+
+CalendarSession::CalendarSession()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+CalendarSession::~CalendarSession()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iStorage ) {
+        qCDebug(lcSyncMLPluginTrace) << "Closing calendar storage...";
+        iStorage->close();
+        iStorage.clear();
+    }
+
+    if( iCalendar ) {
+        qCDebug(lcSyncMLPluginTrace) << "Closing calendar...";
+        iCalendar->close();
+        iCalendar.clear();
+    }
+}
+
+bool CalendarSession::open()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iCalendar = mKCal::ExtendedCalendar::Ptr( new mKCal::ExtendedCalendar( QTimeZone::systemTimeZone() ) );
+
+    qCDebug(lcSyncMLPlugin) << "Creating Default Maemo Storage";
+    iStorage = iCalendar->defaultStorage( iCalendar );
+
+    if( !iStorage || !iStorage->open() ) {
+        qCWarning(lcSyncMLPlugin) << "Calendar storage open failed";
+        iStorage.clear();
+        iCalendar.clear();
+        return false;
+    }
+
+    iStamp = lastModified();
+
+    return true;
+}
+
+mKCal::ExtendedCalendar::Ptr CalendarSession::calendar() const
+{
+    return iCalendar;
+}
+
+mKCal::ExtendedStorage::Ptr CalendarSession::storage() const
+{
+    return iStorage;
+}
+
+QString CalendarSession::databaseName() const
+{
+    mKCal::SqliteStorage::Ptr sqliteStorage = iStorage.dynamicCast<mKCal::SqliteStorage>();
+    return sqliteStorage ? sqliteStorage->databaseName() : QString();
+}
+
+mKCal::Notebook::Ptr CalendarSession::notebook( const QString& aName, const QString& aUid )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    mKCal::Notebook::Ptr openedNb;
+
+    // If we have an Uid, we try to get the corresponding Notebook
+    if( !aUid.isEmpty() ) {
+        openedNb = iStorage->notebook( aUid );
+
+        // If we didn't get one, we create one and set its Uid
+        if( !openedNb ) {
+            openedNb = mKCal::Notebook::Ptr( new mKCal::Notebook( aName,
+                                                                  "Synchronization Created Notebook for " + aName ) );
+            openedNb->setUid( aUid );
+            if( !iStorage->addNotebook( openedNb ) ) {
+                qCWarning(lcSyncMLPlugin) << "Failed to add notebook to storage";
+                openedNb.clear();
+            }
+            else {
+                iStamp = lastModified();
+            }
+        }
+    }
+
+    // If we didn't have an Uid or the creation above failed,
+    // we use the default notebook
+    if( openedNb.isNull() ) {
+        qCDebug(lcSyncMLPlugin) << "Using default notebook";
+        openedNb = iStorage->defaultNotebook();
+        if( openedNb.isNull() ) {
+            qCDebug(lcSyncMLPlugin) << "No default notebook exists, creating one";
+            openedNb = mKCal::Notebook::Ptr( new mKCal::Notebook( "Default", QString() ) );
+            if( !iStorage->setDefaultNotebook( openedNb ) ) {
+                qCWarning(lcSyncMLPlugin) << "Failed to set default notebook of storage";
+                openedNb.clear();
+            }
+            else {
+                iStamp = lastModified();
+            }
+        }
+    }
+
+    return openedNb;
+}
+
+bool CalendarSession::loadNotebook( const QString& aNotebookUid )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iLoadedNotebooks.contains( aNotebookUid ) ) {
+        qCDebug(lcSyncMLPlugin) << "Incidences already loaded from::" << aNotebookUid;
+        return true;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Loading all incidences from::" << aNotebookUid;
+    if( !iStorage->loadNotebookIncidences( aNotebookUid ) ) {
+        qCWarning(lcSyncMLPlugin) << "Failed to load calendar";
+        return false;
+    }
+
+    iLoadedNotebooks.insert( aNotebookUid );
+    return true;
+}
+
+bool CalendarSession::load( const QDate& aStart, const QDate& aEnd )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qCDebug(lcSyncMLPlugin) << "Loading incidences between" << aStart << "and" << aEnd;
+    return iStorage->load( aStart, aEnd );
+}
+
+KCalendarCore::Incidence::Ptr CalendarSession::incidence( const QString& aNotebookUid, const QString& aUid,
+                                                          const QDateTime& aRecurrenceId )
+{
+    KCalendarCore::Incidence::Ptr incidence = iCalendar->incidence( aUid, aRecurrenceId );
+
+    if( !incidence && !iLoadedNotebooks.contains( aNotebookUid ) ) {
+        iStorage->load( aUid, aRecurrenceId );
+        incidence = iCalendar->incidence( aUid, aRecurrenceId );
+    }
+
+    if( incidence && iCalendar->notebook( incidence ) != aNotebookUid ) {
+        qCDebug(lcSyncMLPlugin) << "Incidence" << aUid << "is not in notebook" << aNotebookUid;
+        incidence.clear();
+    }
+
+    return incidence;
+}
+
+bool CalendarSession::save()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    bool saved = iStorage->save();
+
+    iStamp = lastModified();
+
+    return saved;
+}
+
+bool CalendarSession::isCurrent() const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QDateTime modified = lastModified();
+
+    return modified.isValid() && modified == iStamp;
+}
+
+QDateTime CalendarSession::lastModified() const
+{
+    QString databaseName = this->databaseName();
+
+    if( databaseName.isEmpty() ) {
+        return QDateTime();
+    }
+
+    // Committed transactions may only have reached the write-ahead log
+    QDateTime modified = QFileInfo( databaseName ).lastModified();
+    QFileInfo wal( databaseName + "-wal" );
+    if( wal.exists() && wal.lastModified() > modified ) {
+        modified = wal.lastModified();
+    }
+
+    return modified;
+}
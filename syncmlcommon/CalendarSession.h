@@ -0,0 +1,152 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CALENDARSESSION_H
+#define CALENDARSESSION_H
+
+#include <QDate>
+#include <QDateTime>
+#include <QSet>
+#include <QSharedPointer>
+#include <QString>
+
+#include <extendedcalendar.h>
+#include <extendedstorage.h>
+#include <notebook.h>
+
+/*! \brief mKCal calendar and storage shared by the calendar storage plugins
+ *
+ * The calendar and notes storages both work on the calendar database. A
+ * profile syncing both would otherwise open the database twice and load the
+ * incidences into two separate calendars. The session is opened by the first
+ * plugin that acquires it and closed when the last one releases it.
+ * Notebooks that have already been loaded completely are not loaded again.
+ *
+ * Saving commits every change made to the calendar. Sync sessions running
+ * at the same time therefore get sessions of their own, so that one of them
+ * does not commit the changes of another that may still be aborted.
+ *
+ * Each plugin keeps working on its own notebook: incidences of the shared
+ * calendar are always looked up with the notebook they must belong to.
+ *
+ * A session whose database has been written by another process is not
+ * handed out again, as its loaded incidences may be out of date.
+ */
+class CalendarSession {
+
+public:
+
+    /*! \brief Returns the session of a sync session, opening it if needed
+     *
+     * @param aSyncSession Identifies the sync session the caller belongs to
+     * @return Session, NULL if the calendar storage could not be opened
+     */
+    static QSharedPointer<CalendarSession> acquire( const QString& aSyncSession = QString() );
+
+    /*! \brief Destructor, closes the calendar storage
+     *
+     */
+    virtual ~CalendarSession();
+
+    /*! \brief Returns the shared calendar
+     *
+     * @return Calendar
+     */
+    mKCal::ExtendedCalendar::Ptr calendar() const;
+
+    /*! \brief Returns the shared calendar storage
+     *
+     * @return Storage
+     */
+    mKCal::ExtendedStorage::Ptr storage() const;
+
+    /*! \brief Returns the path of the calendar database
+     *
+     * @return Database path, empty if the storage is not SQLite based
+     */
+    QString databaseName() const;
+
+    /*! \brief Resolves the notebook to sync with
+     *
+     * The notebook with the given uid is created if it does not exist yet.
+     * Without an uid, or if creating it fails, the default notebook is used
+     * and created if needed.
+     *
+     * @param aName Name of the notebook
+     * @param aUid Uid of the notebook, may be empty
+     * @return Notebook, NULL on failure
+     */
+    mKCal::Notebook::Ptr notebook( const QString& aName, const QString& aUid );
+
+    /*! \brief Loads all incidences of a notebook
+     *
+     * Does nothing if the notebook has already been loaded in this session.
+     *
+     * @param aNotebookUid Notebook uid
+     * @return True on success, otherwise false
+     */
+    bool loadNotebook( const QString& aNotebookUid );
+
+    /*! \brief Loads the incidences within a date range
+     *
+     * @param aStart First date
+     * @param aEnd Date after the last date
+     * @return True on success, otherwise false
+     */
+    bool load( const QDate& aStart, const QDate& aEnd );
+
+    /*! \brief Returns an incidence of a notebook, loading it if needed
+     *
+     * @param aNotebookUid Notebook the incidence must belong to
+     * @param aUid Incidence uid
+     * @param aRecurrenceId Recurrence id, invalid for the parent incidence
+     * @return Incidence, NULL if not found in the notebook
+     */
+    KCalendarCore::Incidence::Ptr incidence( const QString& aNotebookUid, const QString& aUid,
+                                             const QDateTime& aRecurrenceId = QDateTime() );
+
+    /*! \brief Commits the changes made to the calendar
+     *
+     * @return True on success, otherwise false
+     */
+    bool save();
+
+    /*! \brief Checks that the database has not been written outside this
+     *         session since it was opened or last saved
+     *
+     * @return True if unchanged, false if changed or if it cannot be checked
+     */
+    bool isCurrent() const;
+
+private:
+
+    CalendarSession();
+
+    bool open();
+
+    QDateTime lastModified() const;
+
+    mKCal::ExtendedCalendar::Ptr    iCalendar;
+    mKCal::ExtendedStorage::Ptr     iStorage;
+    QSet<QString>                   iLoadedNotebooks;
+    QDateTime                       iStamp;
+
+};
+
+#endif  //  CALENDARSESSION_H
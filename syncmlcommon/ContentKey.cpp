@@ -0,0 +1,368 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "ContentKey.h"
+
+#include <QCryptographicHash>
+#include <QList>
+#include <QTextCodec>
+
+#include <algorithm>
+
+#include "Base64Codec.h"
+
+static int indexOfUnquoted( const QByteArray& aData, char aChar, int aFrom = 0 )
+{
+    bool quoted = false;
+
+    for( int i = aFrom; i < aData.size(); ++i ) {
+        if( aData[i] == '"' ) {
+            quoted = !quoted;
+        }
+        else if( !quoted && aData[i] == aChar ) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static QByteArray join( QList<QByteArray> aParts, char aSeparator )
+{
+    std::sort( aParts.begin(), aParts.end() );
+
+    QByteArray result;
+    for( int i = 0; i < aParts.count(); ++i ) {
+        if( i > 0 ) {
+            result.append( aSeparator );
+        }
+        result.append( aParts[i] );
+    }
+
+    return result;
+}
+
+static bool isQuotedPrintable( const QByteArray& aLine )
+{
+    int colon = indexOfUnquoted( aLine, ':' );
+
+    return colon > 0 && aLine.left( colon ).toUpper().contains( "QUOTED-PRINTABLE" );
+}
+
+static bool isIgnoredProperty( const QByteArray& aName )
+{
+    return aName == "VERSION" || aName == "PRODID" || aName == "UID" ||
+           aName == "REV" || aName == "DTSTAMP" || aName == "LAST-MODIFIED" ||
+           aName == "CREATED" || aName.startsWith( "X-" );
+}
+
+static bool isEncoding( const QByteArray& aValue )
+{
+    return aValue == "QUOTED-PRINTABLE" || aValue == "BASE64" || aValue == "B" ||
+           aValue == "8BIT" || aValue == "7BIT";
+}
+
+static int hexValue( char aChar )
+{
+    if( aChar >= '0' && aChar <= '9' ) {
+        return aChar - '0';
+    }
+    else if( aChar >= 'A' && aChar <= 'F' ) {
+        return aChar - 'A' + 10;
+    }
+    else if( aChar >= 'a' && aChar <= 'f' ) {
+        return aChar - 'a' + 10;
+    }
+
+    return -1;
+}
+
+static QByteArray decodeQuotedPrintable( const QByteArray& aData )
+{
+    QByteArray result;
+    result.reserve( aData.size() );
+
+    for( int i = 0; i < aData.size(); ++i ) {
+        if( aData[i] == '=' && i + 2 < aData.size() ) {
+            int high = hexValue( aData[i + 1] );
+            int low = hexValue( aData[i + 2] );
+            if( high >= 0 && low >= 0 ) {
+                result.append( char( high * 16 + low ) );
+                i += 2;
+                continue;
+            }
+        }
+        result.append( aData[i] );
+    }
+
+    return result;
+}
+
+// Undoes the escaping of text values. Escaped semicolons and backslashes
+// are kept, so that they stay apart from the separators of structured values
+static QByteArray unescape( const QByteArray& aValue )
+{
+    QByteArray result;
+    result.reserve( aValue.size() );
+
+    for( int i = 0; i < aValue.size(); ++i ) {
+        if( aValue[i] == '\\' && i + 1 < aValue.size() ) {
+            char next = aValue[i + 1];
+            if( next == 'n' || next == 'N' ) {
+                result.append( '\n' );
+                ++i;
+                continue;
+            }
+            else if( next == ',' ) {
+                result.append( ',' );
+                ++i;
+                continue;
+            }
+        }
+        result.append( aValue[i] );
+    }
+
+    return result;
+}
+
+// Joins folded lines, and lines broken by quoted-printable soft line breaks
+static QList<QByteArray> unfold( const QByteArray& aPayload )
+{
+    QList<QByteArray> result;
+    QByteArray line;
+
+    QList<QByteArray> lines = aPayload.split( '\n' );
+
+    for( int i = 0; i < lines.count(); ++i ) {
+
+        QByteArray next = lines[i];
+        if( next.endsWith( '\r' ) ) {
+            next.chop( 1 );
+        }
+
+        // The line after a soft line break continues the value as it is
+        if( line.endsWith( '=' ) && isQuotedPrintable( line ) ) {
+            line.chop( 1 );
+            line.append( next );
+            continue;
+        }
+
+        // Folded continuation line
+        if( !next.isEmpty() && ( next[0] == ' ' || next[0] == '\t' ) ) {
+            line.append( next.mid( 1 ) );
+            continue;
+        }
+
+        if( !line.isEmpty() ) {
+            result.append( line );
+        }
+
+        line = next;
+    }
+
+    if( !line.isEmpty() ) {
+        result.append( line );
+    }
+
+    return result;
+}
+
+// Returns the property with its value decoded and its parameters sorted, or
+// an empty array if the property does not count as content
+static QByteArray normalizeProperty( const QByteArray& aLine, QByteArray& aName )
+{
+    int colon = indexOfUnquoted( aLine, ':' );
+    if( colon <= 0 ) {
+        return QByteArray();
+    }
+
+    QByteArray head = aLine.left( colon );
+    QByteArray value = aLine.mid( colon + 1 );
+
+    QList<QByteArray> parts;
+    int from = 0;
+    int separator;
+    while( ( separator = indexOfUnquoted( head, ';', from ) ) >= 0 ) {
+        parts.append( head.mid( from, separator - from ) );
+        from = separator + 1;
+    }
+    parts.append( head.mid( from ) );
+
+    // Groups are left out
+    aName = parts.takeFirst().trimmed().toUpper();
+    aName = aName.mid( aName.lastIndexOf( '.' ) + 1 );
+
+    if( aName == "BEGIN" || aName == "END" ) {
+        return aName + ':' + value.trimmed().toUpper();
+    }
+    else if( isIgnoredProperty( aName ) ) {
+        return QByteArray();
+    }
+
+    // vCard 2.1 parameters without a name are types or encodings
+    QList<QByteArray> types;
+    QList<QByteArray> parameters;
+    QByteArray encoding;
+    QByteArray charset;
+
+    foreach( const QByteArray& part, parts ) {
+        int equals = part.indexOf( '=' );
+        QByteArray name = equals < 0 ? QByteArray( "TYPE" ) : part.left( equals ).trimmed().toUpper();
+        QByteArray parameter = ( equals < 0 ? part : part.mid( equals + 1 ) ).trimmed();
+        parameter.replace( '"', QByteArray() );
+
+        if( equals < 0 && isEncoding( parameter.toUpper() ) ) {
+            name = "ENCODING";
+        }
+
+        if( name == "ENCODING" ) {
+            encoding = parameter.toUpper();
+        }
+        else if( name == "CHARSET" ) {
+            charset = parameter;
+        }
+        else if( name == "TYPE" ) {
+            foreach( const QByteArray& type, parameter.split( ',' ) ) {
+                QByteArray normalized = type.trimmed().toUpper();
+                if( !normalized.isEmpty() && !types.contains( normalized ) ) {
+                    types.append( normalized );
+                }
+            }
+        }
+        else if( name != "VALUE" && !name.startsWith( "X-" ) ) {
+            parameters.append( name + '=' + parameter );
+        }
+    }
+
+    bool binary = false;
+
+    if( encoding == "QUOTED-PRINTABLE" ) {
+        value = decodeQuotedPrintable( value );
+    }
+    else if( encoding == "B" || encoding == "BASE64" ) {
+        QByteArray data;
+        if( Base64Codec::decode( value, data ) ) {
+            value = Base64Codec::encode( data );
+            binary = true;
+        }
+    }
+
+    if( !binary ) {
+        if( !charset.isEmpty() ) {
+            QTextCodec* codec = QTextCodec::codecForName( charset );
+            if( codec ) {
+                value = codec->toUnicode( value ).toUtf8();
+            }
+        }
+
+        value.replace( "\r\n", "\n" );
+        value = unescape( value ).trimmed();
+
+        // Empty trailing components of structured values
+        while( value.endsWith( ';' ) && !value.endsWith( "\\;" ) ) {
+            value.chop( 1 );
+        }
+
+        if( aName == "TEL" ) {
+            QByteArray number;
+            foreach( char c, value ) {
+                if( c != ' ' && c != '-' && c != '(' && c != ')' && c != '.' ) {
+                    number.append( c );
+                }
+            }
+            value = number;
+        }
+        else if( aName == "EMAIL" ) {
+            value = value.toLower();
+        }
+
+        value.replace( '\n', "\\n" );
+    }
+
+    if( value.isEmpty() ) {
+        return QByteArray();
+    }
+
+    QByteArray property = aName;
+    if( !types.isEmpty() ) {
+        property.append( ";TYPE=" );
+        property.append( join( types, ',' ) );
+    }
+    if( !parameters.isEmpty() ) {
+        property.append( ';' );
+        property.append( join( parameters, ';' ) );
+    }
+    property.append( ':' );
+    property.append( value );
+
+    return property;
+}
+
+// Closes the innermost open component. Its properties and subcomponents are
+// sorted, as their order does not matter
+static void closeComponent( QList<QList<QByteArray> >& aComponents, QList<QByteArray>& aHeaders )
+{
+    QByteArray component = aHeaders.takeLast();
+    component.append( '\n' );
+    component.append( join( aComponents.takeLast(), '\n' ) );
+    component.append( "\nEND" );
+
+    aComponents.last().append( component );
+}
+
+QByteArray ContentKey::key( const QByteArray& aPayload )
+{
+    QByteArray start = aPayload.left( 64 ).trimmed().left( 6 ).toUpper();
+
+    if( start != "BEGIN:" ) {
+        QByteArray text = aPayload;
+        text.replace( "\r\n", "\n" );
+        return QCryptographicHash::hash( text.trimmed(), QCryptographicHash::Sha1 );
+    }
+
+    // Properties of the open components, outermost first
+    QList<QList<QByteArray> > components;
+    QList<QByteArray> headers;
+
+    components.append( QList<QByteArray>() );
+
+    foreach( const QByteArray& line, unfold( aPayload ) ) {
+        QByteArray name;
+        QByteArray property = normalizeProperty( line, name );
+
+        if( name == "BEGIN" ) {
+            headers.append( property );
+            components.append( QList<QByteArray>() );
+        }
+        else if( name == "END" ) {
+            if( components.count() > 1 ) {
+                closeComponent( components, headers );
+            }
+        }
+        else if( !property.isEmpty() ) {
+            components.last().append( property );
+        }
+    }
+
+    while( components.count() > 1 ) {
+        closeComponent( components, headers );
+    }
+
+    return QCryptographicHash::hash( join( components.first(), '\n' ), QCryptographicHash::Sha1 );
+}
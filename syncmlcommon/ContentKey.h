@@ -0,0 +1,51 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef CONTENTKEY_H
+#define CONTENTKEY_H
+
+#include <QByteArray>
+
+/*! \brief Key of the content of an item, independent of its serialization
+ *
+ * During slow sync the same contact or incidence often arrives from the
+ * server serialized differently from the local export: another vCard or
+ * vCalendar version, another property order, other line folding, encoding
+ * or charset. The key is computed from the decoded and normalized
+ * properties, so that such copies have the same key while items with
+ * different content do not.
+ */
+class ContentKey
+{
+public:
+
+    /*! \brief Computes the key of an item
+     *
+     * Versit payloads are compared by their properties, leaving out the
+     * version, identifiers, timestamps and extension properties. Other
+     * payloads are compared by their text with line endings normalized.
+     *
+     * @param aPayload Item data
+     * @return Key
+     */
+    static QByteArray key( const QByteArray& aPayload );
+
+};
+
+#endif  //  CONTENTKEY_H
@@ -0,0 +1,272 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "FingerprintStore.h"
+
+#include <QCryptographicHash>
+
+#include "SyncMLPluginLogging.h"
+
+const QString CONNECTIONNAME( "fingerprints" );
+
+// Properties that change without the content of the item changing
+static bool isVolatileProperty( const QByteArray& aLine )
+{
+    int end = 0;
+    while( end < aLine.size() && aLine[end] != ':' && aLine[end] != ';' ) {
+        ++end;
+    }
+
+    QByteArray name = aLine.left( end ).toUpper();
+
+    return name == "REV" || name == "DTSTAMP" || name == "LAST-MODIFIED" || name == "PRODID";
+}
+
+FingerprintStore::FingerprintStore() : iCleared( false )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+FingerprintStore::~FingerprintStore()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit();
+}
+
+bool FingerprintStore::init( const QString& aDbFile, const QString& aStorageId )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    static unsigned connectionNumber = 0;
+
+    uninit();
+
+    iConnectionName = CONNECTIONNAME + QString::number( connectionNumber++ );
+    iDb = QSqlDatabase::addDatabase( "QSQLITE", iConnectionName );
+    iDb.setDatabaseName( aDbFile );
+
+    if( !iDb.open() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not open fingerprint database:" << aDbFile;
+        uninit();
+        return false;
+    }
+
+    iStorageId = aStorageId;
+
+    QSqlQuery query( iDb );
+    if( !query.exec( "CREATE TABLE if not exists fingerprints (storage varchar(64), id varchar(512), "
+                     "fingerprint blob, revision integer, PRIMARY KEY (storage, id))" ) ) {
+        qCCritical(lcSyncMLPlugin) << "Could not create fingerprint table:" << query.lastError();
+        uninit();
+        return false;
+    }
+
+    query.setForwardOnly( true );
+    query.prepare( "SELECT id, fingerprint, revision FROM fingerprints WHERE storage = ?" );
+    query.addBindValue( iStorageId );
+
+    if( !query.exec() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not load fingerprints:" << query.lastError();
+        uninit();
+        return false;
+    }
+
+    while( query.next() ) {
+        Entry entry;
+        entry.iFingerprint = query.value( 1 ).toByteArray();
+        entry.iRevision = query.value( 2 ).toLongLong();
+        iEntries.insert( query.value( 0 ).toString(), entry );
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Loaded" << iEntries.count() << "fingerprints for" << iStorageId;
+
+    return true;
+}
+
+void FingerprintStore::uninit()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() ) {
+        return;
+    }
+
+    flush();
+
+    iEntries.clear();
+    iChanged.clear();
+    iRemoved.clear();
+    iCleared = false;
+
+    iDb.close();
+    iDb = QSqlDatabase();
+    QSqlDatabase::removeDatabase( iConnectionName );
+    iConnectionName.clear();
+}
+
+bool FingerprintStore::flush()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    if( !iDb.isOpen() || ( !iCleared && iChanged.isEmpty() && iRemoved.isEmpty() ) ) {
+        return true;
+    }
+
+    iDb.transaction();
+
+    QSqlQuery query( iDb );
+
+    if( iCleared ) {
+        query.prepare( "DELETE FROM fingerprints WHERE storage = ?" );
+        query.addBindValue( iStorageId );
+        query.exec();
+    }
+
+    query.prepare( "DELETE FROM fingerprints WHERE storage = ? AND id = ?" );
+    foreach( const QString& id, iRemoved ) {
+        query.addBindValue( iStorageId );
+        query.addBindValue( id );
+        query.exec();
+    }
+
+    query.prepare( "INSERT OR REPLACE INTO fingerprints (storage, id, fingerprint, revision) "
+                   "VALUES (?, ?, ?, ?)" );
+    foreach( const QString& id, iChanged ) {
+        const Entry& entry = iEntries[id];
+        query.addBindValue( iStorageId );
+        query.addBindValue( id );
+        query.addBindValue( entry.iFingerprint );
+        query.addBindValue( entry.iRevision );
+        if( !query.exec() ) {
+            qCWarning(lcSyncMLPlugin) << "Could not store fingerprint:" << query.lastError();
+        }
+    }
+
+    if( !iDb.commit() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit fingerprints:" << iDb.lastError();
+        return false;
+    }
+
+    iChanged.clear();
+    iRemoved.clear();
+    iCleared = false;
+
+    return true;
+}
+
+bool FingerprintStore::matches( const QString& aId, const QByteArray& aPayload,
+                                const QDateTime& aRevision ) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( !aRevision.isValid() ) {
+        return false;
+    }
+
+    QMutexLocker locker( &iMutex );
+
+    QHash<QString, Entry>::const_iterator i = iEntries.constFind( aId );
+
+    // Revisions are compared in seconds, the precision backends store them in
+    return i != iEntries.constEnd() &&
+           i->iRevision == aRevision.toSecsSinceEpoch() &&
+           i->iFingerprint == fingerprint( aPayload );
+}
+
+void FingerprintStore::update( const QString& aId, const QByteArray& aPayload,
+                               const QDateTime& aRevision )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() || !aRevision.isValid() ) {
+        return;
+    }
+
+    Entry entry;
+    entry.iFingerprint = fingerprint( aPayload );
+    entry.iRevision = aRevision.toSecsSinceEpoch();
+
+    QMutexLocker locker( &iMutex );
+
+    iEntries.insert( aId, entry );
+    iChanged.insert( aId );
+    iRemoved.remove( aId );
+}
+
+void FingerprintStore::remove( const QString& aId )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    if( iEntries.remove( aId ) ) {
+        iChanged.remove( aId );
+        iRemoved.insert( aId );
+    }
+}
+
+void FingerprintStore::clear()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    iEntries.clear();
+    iChanged.clear();
+    iRemoved.clear();
+    iCleared = true;
+}
+
+QByteArray FingerprintStore::fingerprint( const QByteArray& aPayload )
+{
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+    QByteArray line;
+
+    QList<QByteArray> lines = aPayload.split( '\n' );
+
+    for( int i = 0; i <= lines.count(); ++i ) {
+
+        QByteArray next;
+
+        if( i < lines.count() ) {
+            next = lines[i];
+            if( next.endsWith( '\r' ) ) {
+                next.chop( 1 );
+            }
+
+            // Folded continuation line
+            if( !next.isEmpty() && ( next[0] == ' ' || next[0] == '\t' ) ) {
+                line.append( next.mid( 1 ) );
+                continue;
+            }
+        }
+
+        if( !line.isEmpty() && !isVolatileProperty( line ) ) {
+            hash.addData( line );
+            hash.addData( "\n", 1 );
+        }
+
+        line = next;
+    }
+
+    return hash.result();
+}
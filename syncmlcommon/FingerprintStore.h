@@ -0,0 +1,147 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef FINGERPRINTSTORE_H
+#define FINGERPRINTSTORE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QtSql>
+
+// Database file for the fingerprint store, relative to SyncMLConfig::getDatabasePath()
+const QString FINGERPRINT_DB_FILE( "syncmlfingerprints.db" );
+
+/*! \brief Persistent store of fingerprints of item payloads last sent to or
+ *         written from the remote party
+ *
+ * Remote parties often send back items unchanged, for example after an
+ * anchor mismatch or a conflict resolved in favour of the remote side.
+ * Writing such items to the backend again only bumps the change logs, which
+ * in turn makes the next sync send them back. Storages record the
+ * fingerprint of each payload they send or write together with the item
+ * revision (last modification time) it corresponds to, and skip incoming
+ * payloads whose fingerprint matches while the item is still at that
+ * revision.
+ *
+ * Fingerprints are kept in memory and written to the database on flush() and
+ * uninit().
+ */
+class FingerprintStore {
+
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    FingerprintStore();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~FingerprintStore();
+
+    /*! \brief Initializes the store and loads the fingerprints of a storage
+     *
+     * @param aDbFile Path to database to use as persistent storage
+     * @param aStorageId Identifier for storage
+     * @return True if successfully initialized, otherwise false
+     */
+    bool init( const QString& aDbFile, const QString& aStorageId );
+
+    /*! \brief Writes changed fingerprints to the database and uninitializes
+     *         the store
+     *
+     */
+    void uninit();
+
+    /*! \brief Writes changed fingerprints to the database
+     *
+     * The store stays initialized.
+     *
+     * @return True on success, otherwise false
+     */
+    bool flush();
+
+    /*! \brief Checks if a payload is the one last recorded for an item
+     *
+     * @param aId Item id
+     * @param aPayload Payload
+     * @param aRevision Current last modification time of the item
+     * @return True if the payload matches the recorded one and the item has
+     *         not been modified since, otherwise false
+     */
+    bool matches( const QString& aId, const QByteArray& aPayload, const QDateTime& aRevision ) const;
+
+    /*! \brief Records the payload of an item
+     *
+     * @param aId Item id
+     * @param aPayload Payload
+     * @param aRevision Last modification time of the item with this payload
+     */
+    void update( const QString& aId, const QByteArray& aPayload, const QDateTime& aRevision );
+
+    /*! \brief Forgets the payload of an item
+     *
+     * @param aId Item id
+     */
+    void remove( const QString& aId );
+
+    /*! \brief Forgets the payloads of all items of the storage
+     *
+     */
+    void clear();
+
+    /*! \brief Calculates the fingerprint of a payload
+     *
+     * Line endings and line folding are normalized, and properties that
+     * change without the content changing (REV, DTSTAMP, LAST-MODIFIED,
+     * PRODID) are left out.
+     *
+     * @param aPayload vCard, vCalendar or iCalendar payload
+     * @return Fingerprint
+     */
+    static QByteArray fingerprint( const QByteArray& aPayload );
+
+private:
+
+    struct Entry
+    {
+        QByteArray  iFingerprint;
+        qint64      iRevision;
+    };
+
+    QSqlDatabase                iDb;
+    QString                     iConnectionName;
+    QString                     iStorageId;
+
+    QHash<QString, Entry>       iEntries;
+    QSet<QString>               iChanged;
+    QSet<QString>               iRemoved;
+    bool                        iCleared;
+    mutable QMutex              iMutex;
+
+    friend class FingerprintStoreTest;
+
+};
+
+#endif  //  FINGERPRINTSTORE_H
@@ -0,0 +1,268 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "IncidenceIdQuery.h"
+
+#include <QTimeZone>
+#include <QMap>
+
+#include "SyncMLPluginLogging.h"
+
+const QString CONNECTIONNAME( "incidenceids" );
+
+// Marker used by mKCal for all-day dates without time zone
+const QString FLOATING_DATE( "FloatingDate" );
+
+// True for components with recurrence rules or recurrence dates
+const QString RECURS( "(EXISTS (SELECT 1 FROM Recursive WHERE Recursive.ComponentId = Components.ComponentId) OR "
+                      "EXISTS (SELECT 1 FROM Rdates WHERE Rdates.ComponentId = Components.ComponentId))" );
+
+IncidenceIdQuery::IncidenceIdQuery()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+IncidenceIdQuery::~IncidenceIdQuery()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit();
+}
+
+bool IncidenceIdQuery::init( const QString& aDbFile )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    static unsigned connectionNumber = 0;
+
+    if( iDb.isOpen() ) {
+        return true;
+    }
+
+    iConnectionName = CONNECTIONNAME + QString::number( connectionNumber++ );
+    iDb = QSqlDatabase::addDatabase( "QSQLITE", iConnectionName );
+    iDb.setDatabaseName( aDbFile );
+    iDb.setConnectOptions( "QSQLITE_OPEN_READONLY" );
+
+    if( !iDb.open() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not open calendar database:" << aDbFile;
+        uninit();
+        return false;
+    }
+
+    if( !checkSchema() ) {
+        qCWarning(lcSyncMLPlugin) << "Unexpected calendar database schema:" << aDbFile;
+        uninit();
+        return false;
+    }
+
+    return true;
+}
+
+bool IncidenceIdQuery::checkSchema()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // Columns of the mKCal tables read by queryIds()
+    QMap<QString, QStringList> schema;
+    schema.insert( "Components", QStringList() << "ComponentId" << "Notebook" << "Type" << "UID"
+                                               << "RecurId" << "RecurIdLocal" << "RecurIdTimeZone"
+                                               << "DateCreated" << "DateLastModified" << "DateDeleted"
+                                               << "DateStart" << "DateEndDue" );
+    schema.insert( "Recursive", QStringList( "ComponentId" ) );
+    schema.insert( "Rdates", QStringList( "ComponentId" ) );
+
+    QMapIterator<QString, QStringList> table( schema );
+    while( table.hasNext() ) {
+        table.next();
+
+        QSqlQuery query( iDb );
+        if( !query.exec( "PRAGMA table_info(" + table.key() + ")" ) ) {
+            qCWarning(lcSyncMLPlugin) << "Could not read the columns of" << table.key() << query.lastError();
+            return false;
+        }
+
+        // The name is the second column of table_info
+        QStringList columns;
+        while( query.next() ) {
+            columns.append( query.value( 1 ).toString() );
+        }
+
+        foreach( const QString& column, table.value() ) {
+            if( !columns.contains( column ) ) {
+                qCWarning(lcSyncMLPlugin) << "Table" << table.key() << "has no column" << column;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void IncidenceIdQuery::uninit()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() ) {
+        return;
+    }
+
+    iDb.close();
+    iDb = QSqlDatabase();
+    QSqlDatabase::removeDatabase( iConnectionName );
+    iConnectionName.clear();
+}
+
+bool IncidenceIdQuery::queryIds( ChangeType aChangeType, const QString& aNotebookUid,
+                                 const QStringList& aTypes, const QDateTime& aTime,
+                                 QList<IncidenceId>& aIds,
+                                 const QDateTime& aWindowStart, const QDateTime& aWindowEnd )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( !iDb.isOpen() ) {
+        qCWarning(lcSyncMLPlugin) << "Calendar database is not open";
+        return false;
+    }
+
+    // Same selection criteria as used by mKCal for full incidence queries.
+    // Timestamps are stored as seconds since epoch in UTC.
+    const bool window = aWindowStart.isValid() && aWindowEnd.isValid();
+
+    QString queryString( "SELECT UID, RecurId, RecurIdLocal, RecurIdTimeZone, Type" );
+    if( window ) {
+        queryString.append( ", " + RECURS );
+    }
+    queryString.append( " FROM Components WHERE Notebook = ?" );
+
+    switch( aChangeType )
+    {
+        case ALL_INCIDENCES:
+            queryString.append( " AND DateDeleted = 0" );
+            break;
+        case NEW_INCIDENCES:
+            queryString.append( " AND DateCreated >= ? AND DateDeleted = 0" );
+            break;
+        case MODIFIED_INCIDENCES:
+            queryString.append( " AND DateLastModified >= ? AND DateCreated < ? AND DateDeleted = 0" );
+            break;
+        case DELETED_INCIDENCES:
+            queryString.append( " AND DateDeleted >= ? AND DateCreated < ?" );
+            break;
+    }
+
+    if( !aTypes.isEmpty() ) {
+        QStringList placeholders;
+        for( int i = 0; i < aTypes.count(); ++i ) {
+            placeholders.append( "?" );
+        }
+        queryString.append( " AND Type IN (" + placeholders.join( "," ) + ")" );
+    }
+
+    // A missing start or end is taken from the other one, incidences with
+    // neither are kept
+    if( window ) {
+        queryString.append( " AND (" + RECURS + " OR (DateStart = 0 AND DateEndDue = 0) OR "
+                            "(MAX(DateStart, DateEndDue) >= ? AND "
+                            "(CASE WHEN DateStart = 0 THEN DateEndDue ELSE DateStart END) <= ?))" );
+    }
+
+    QSqlQuery query( iDb );
+    query.setForwardOnly( true );
+
+    if( !query.prepare( queryString ) ) {
+        qCWarning(lcSyncMLPlugin) << "Could not prepare incidence id query:" << query.lastError();
+        return false;
+    }
+
+    const qint64 time = aTime.toUTC().toSecsSinceEpoch();
+
+    query.addBindValue( aNotebookUid );
+    if( aChangeType != ALL_INCIDENCES ) {
+        query.addBindValue( time );
+    }
+    if( aChangeType == MODIFIED_INCIDENCES || aChangeType == DELETED_INCIDENCES ) {
+        query.addBindValue( time );
+    }
+    for( int i = 0; i < aTypes.count(); ++i ) {
+        query.addBindValue( aTypes[i] );
+    }
+    if( window ) {
+        query.addBindValue( aWindowStart.toUTC().toSecsSinceEpoch() );
+        query.addBindValue( aWindowEnd.toUTC().toSecsSinceEpoch() );
+    }
+
+    if( !query.exec() ) {
+        qCWarning(lcSyncMLPlugin) << "Incidence id query failed:" << query.lastError();
+        return false;
+    }
+
+    QList<IncidenceId> ids;
+    while( query.next() ) {
+        IncidenceId id;
+        id.iUid = query.value( 0 ).toString();
+        id.iRecurrenceId = recurrenceId( query.value( 1 ), query.value( 2 ),
+                                         query.value( 3 ).toString() );
+        id.iType = query.value( 4 ).toString();
+        id.iRecurs = window && query.value( 5 ).toBool();
+        ids.append( id );
+    }
+
+    // Stepping through the rows can fail as well, callers fall back to a
+    // full query then and must not see a partial result
+    if( query.lastError().isValid() ) {
+        qCWarning(lcSyncMLPlugin) << "Incidence id query failed:" << query.lastError();
+        return false;
+    }
+
+    aIds.append( ids );
+    return true;
+}
+
+QDateTime IncidenceIdQuery::recurrenceId( const QVariant& aUtc, const QVariant& aLocal,
+                                          const QString& aTimeZone ) const
+{
+    // Mirrors the way mKCal reconstructs date-times, so that the resulting
+    // recurrence IDs compare and print equal to the ones of loaded incidences.
+    QDateTime dateTime;
+
+    if( aUtc.toLongLong() == 0 ) {
+        return dateTime;
+    }
+
+    if( aTimeZone.isEmpty() ) {
+        // Clock time
+        dateTime = QDateTime::fromSecsSinceEpoch( aLocal.toLongLong(), Qt::UTC );
+        dateTime.setTimeSpec( Qt::LocalTime );
+    }
+    else if( aTimeZone == FLOATING_DATE ) {
+        dateTime = QDateTime::fromSecsSinceEpoch( aLocal.toLongLong(), Qt::UTC );
+        dateTime.setTimeSpec( Qt::LocalTime );
+        dateTime.setTime( QTime( 0, 0, 0 ) );
+    }
+    else {
+        dateTime = QDateTime::fromSecsSinceEpoch( aUtc.toLongLong(), Qt::UTC );
+        QTimeZone timeZone( aTimeZone.toUtf8() );
+        if( timeZone.isValid() ) {
+            dateTime = dateTime.toTimeZone( timeZone );
+        }
+    }
+
+    return dateTime;
+}
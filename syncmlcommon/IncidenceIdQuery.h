@@ -0,0 +1,127 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef INCIDENCEIDQUERY_H
+#define INCIDENCEIDQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QList>
+#include <QtSql>
+
+/*! \brief Identity of a calendar incidence as stored in the mKCal database
+ *
+ */
+struct IncidenceId
+{
+    QString     iUid;           ///< Incidence UID
+    QDateTime   iRecurrenceId;  ///< Recurrence ID, invalid if the incidence is not an exception
+    QString     iType;          ///< Incidence type ("Event", "Todo" or "Journal")
+    bool        iRecurs;        ///< True if the incidence has recurrence rules or dates,
+                                ///< only set for queries with a time window
+};
+
+/*! \brief Read-only query interface for incidence identities in the mKCal
+ *         SQLite database
+ *
+ * Change detection only needs the identities of new, modified and deleted
+ * incidences. Instead of materializing full incidences with all their
+ * properties, attendees, alarms and recurrence rules, this class reads just
+ * UID, recurrence ID and type of the matching rows.
+ *
+ * The class reads tables private to mKCal. init() refuses databases that
+ * lack any of the columns used, and a failing query leaves the output
+ * untouched, so callers can fall back to the mKCal API in both cases.
+ */
+class IncidenceIdQuery {
+
+public:
+
+    /*! \brief Selects which incidences a query returns
+     *
+     */
+    enum ChangeType
+    {
+        ALL_INCIDENCES,         /*!< All non-deleted incidences */
+        NEW_INCIDENCES,         /*!< Incidences created after the given time */
+        MODIFIED_INCIDENCES,    /*!< Incidences modified, but not created, after the given time */
+        DELETED_INCIDENCES      /*!< Incidences deleted after the given time */
+    };
+
+    /*! \brief Constructor
+     *
+     */
+    IncidenceIdQuery();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~IncidenceIdQuery();
+
+    /*! \brief Opens a read-only connection to the calendar database
+     *
+     * @param aDbFile Path to the mKCal database
+     * @return True if successfully initialized, false also if the database
+     *         does not have the expected schema
+     */
+    bool init( const QString& aDbFile );
+
+    /*! \brief Closes the connection to the calendar database
+     *
+     */
+    void uninit();
+
+    /*! \brief Retrieves identities of incidences in a notebook
+     *
+     * @param aChangeType Which incidences to retrieve
+     * @param aNotebookUid UID of the notebook to query
+     * @param aTypes Incidence types to include, all types if empty
+     * @param aTime Reference time for change queries, ignored for ALL_INCIDENCES
+     * @param aIds Output list of incidence identities, not changed on failure
+     * @param aWindowStart Start of the time window, no window if invalid
+     * @param aWindowEnd End of the time window, no window if invalid
+     * @return True on success, otherwise false
+     *
+     * With a time window, incidences that neither overlap the window nor
+     * recur are left out. Undated incidences are always included. Whether
+     * any occurrence of a recurring incidence falls into the window is up to
+     * the caller to check.
+     */
+    bool queryIds( ChangeType aChangeType, const QString& aNotebookUid,
+                   const QStringList& aTypes, const QDateTime& aTime,
+                   QList<IncidenceId>& aIds,
+                   const QDateTime& aWindowStart = QDateTime(),
+                   const QDateTime& aWindowEnd = QDateTime() );
+
+private:
+
+    bool checkSchema();
+
+    QDateTime recurrenceId( const QVariant& aUtc, const QVariant& aLocal,
+                            const QString& aTimeZone ) const;
+
+    QSqlDatabase    iDb;
+    QString         iConnectionName;
+
+    friend class IncidenceIdQueryTest;
+
+};
+
+#endif  //  INCIDENCEIDQUERY_H
@@ -100,50 +100,8 @@ void ItemIdMapper::uninit()
 
     qCDebug(lcSyncMLPlugin) << "Uninitiating ID mapper...";
 
-    {
-        QString queryString;
-        QSqlQuery query;
-
-        bool supportsTransaction = iDb.transaction();
-        if( !supportsTransaction )
-        {
-            qCDebug(lcSyncMLPlugin) << "Db doesn't support transactions";
-        }
-
-        queryString.append( "DELETE FROM " );
-        queryString.append( iStorageId );
-        query = QSqlQuery( queryString, iDb );
-        if( !query.exec() )
-        {
-            qCWarning(lcSyncMLPlugin) << "Delete Query failed: " << query.lastError();
-        }
+    save();
 
-        queryString.clear();
-        queryString.append( "INSERT INTO " );
-        queryString.append( iStorageId );
-        queryString.append( " (value, key) values(:values, :key)" );
-        query = QSqlQuery( queryString, iDb );
-        QVariantList keys, values;
-        for( int i = 0; i < iValueToKeyMap.count(); ++i )
-        {
-            values << (i + 1);
-            keys << iValueToKeyMap[i+1];
-        }
-        query.addBindValue( values );
-        query.addBindValue( keys );
-        if( !query.execBatch() )
-        {
-            qCCritical(lcSyncMLPlugin) << "Save Query failed: " << query.lastError();
-        }
-
-        if( supportsTransaction )
-        {
-            if( !iDb.commit() )
-            {
-                qCCritical(lcSyncMLPlugin) << "Commit failed";
-            }
-        }
-    }
     iDb.close();
     iDb = QSqlDatabase();
     QSqlDatabase::removeDatabase( iConnectionName );
@@ -155,6 +113,58 @@ void ItemIdMapper::uninit()
 }
 
 
+bool ItemIdMapper::save()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QString queryString;
+    QSqlQuery query;
+
+    bool supportsTransaction = iDb.transaction();
+    if( !supportsTransaction )
+    {
+        qCDebug(lcSyncMLPlugin) << "Db doesn't support transactions";
+    }
+
+    queryString.append( "DELETE FROM " );
+    queryString.append( iStorageId );
+    query = QSqlQuery( queryString, iDb );
+    if( !query.exec() )
+    {
+        qCWarning(lcSyncMLPlugin) << "Delete Query failed: " << query.lastError();
+    }
+
+    queryString.clear();
+    queryString.append( "INSERT INTO " );
+    queryString.append( iStorageId );
+    queryString.append( " (value, key) values(:values, :key)" );
+    query = QSqlQuery( queryString, iDb );
+    QVariantList keys, values;
+    for( int i = 0; i < iValueToKeyMap.count(); ++i )
+    {
+        values << (i + 1);
+        keys << iValueToKeyMap[i+1];
+    }
+    query.addBindValue( values );
+    query.addBindValue( keys );
+    bool saved = query.execBatch();
+    if( !saved )
+    {
+        qCCritical(lcSyncMLPlugin) << "Save Query failed: " << query.lastError();
+    }
+
+    if( supportsTransaction )
+    {
+        if( !iDb.commit() )
+        {
+            qCCritical(lcSyncMLPlugin) << "Commit failed";
+            saved = false;
+        }
+    }
+
+    return saved;
+}
+
 QString ItemIdMapper::key( const QString& aValue )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -203,6 +213,15 @@ QString ItemIdMapper::value( const QString& aKey )
     return value;
 }
 
+void ItemIdMapper::clear()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iKeyToValueMap.clear();
+    iValueToKeyMap.clear();
+    iNextValue = 1;
+}
+
 QString ItemIdMapper::add( const QString &aKey )
 {
    iKeyToValueMap[aKey] = iNextValue;
@@ -57,6 +57,12 @@ public:
      */
     void uninit();
 
+    /*! \brief Stores the mappings to the database without uninitializing
+     *
+     * @return True on success, otherwise false
+     */
+    bool save();
+
     /*! \brief Maps the specified value to key
      *
      * @param aValue Value
@@ -71,6 +77,12 @@ public:
      */
     QString value( const QString& aKey );
 
+    /*! \brief Forgets all mappings of the storage
+     *
+     * The mappings are removed from the database in uninit().
+     */
+    void clear();
+
 protected:
     /*! \brief Adds a new key
      *
@@ -0,0 +1,253 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "LinkEstimator.h"
+
+#include "SyncMLPluginLogging.h"
+
+const QString CONNECTIONNAME( "links" );
+
+// Calls closer to each other than this serve the same message
+const qint64 MESSAGE_GAP = 50;
+
+// Longer gaps are spent in something else than the link, like a slow backend
+const qint64 MAX_ROUND_TRIP = 30000;
+
+// Round trips a message should take to transfer, to keep the link busy
+const qint64 ROUND_TRIPS_PER_MESSAGE = 4;
+
+// Longest time a message should take to transfer
+const qint64 MAX_TRANSFER_TIME = 5000;
+
+LinkEstimator::LinkEstimator() : iLastEnd( -1 ), iCalls( 0 ), iSent( 0 ), iRoundTrip( 0 ),
+                                 iRoundTripBytes( 0 ), iRoundTripTime( 0 ), iThroughput( 0 ),
+                                 iSamples( 0 ), iStoredRoundTripTime( 0 ), iStoredThroughput( 0 )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+LinkEstimator::~LinkEstimator()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit();
+}
+
+bool LinkEstimator::init( const QString& aDbFile, const QString& aLinkId )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    static unsigned connectionNumber = 0;
+
+    uninit();
+
+    iLinkId = aLinkId;
+    iTimer.start();
+
+    if( aDbFile.isEmpty() ) {
+        return true;
+    }
+
+    iConnectionName = CONNECTIONNAME + QString::number( connectionNumber++ );
+    iDb = QSqlDatabase::addDatabase( "QSQLITE", iConnectionName );
+    iDb.setDatabaseName( aDbFile );
+
+    if( !iDb.open() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not open link database:" << aDbFile;
+        uninit();
+        return false;
+    }
+
+    QSqlQuery query( iDb );
+    if( !query.exec( "CREATE TABLE if not exists links (link varchar(512) PRIMARY KEY, "
+                     "roundtrip integer, throughput integer)" ) ) {
+        qCCritical(lcSyncMLPlugin) << "Could not create link table:" << query.lastError();
+        uninit();
+        return false;
+    }
+
+    query.prepare( "SELECT roundtrip, throughput FROM links WHERE link = ?" );
+    query.addBindValue( iLinkId );
+
+    if( !query.exec() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not load link estimate:" << query.lastError();
+        uninit();
+        return false;
+    }
+
+    if( query.next() ) {
+        iStoredRoundTripTime = query.value( 0 ).toLongLong();
+        iStoredThroughput = query.value( 1 ).toLongLong();
+        qCDebug(lcSyncMLPlugin) << "Link" << iLinkId << "round trip" << iStoredRoundTripTime
+                                << "ms, throughput" << iStoredThroughput << "B/s";
+    }
+
+    return true;
+}
+
+void LinkEstimator::uninit()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    if( iRoundTrip > 0 ) {
+        sample( iRoundTrip, iRoundTripBytes );
+    }
+
+    if( iSamples > 0 ) {
+        qCDebug(lcSyncMLPlugin) << "Measured link" << iLinkId << "round trip" << iRoundTripTime
+                                << "ms, throughput" << iThroughput << "B/s from" << iSamples << "messages";
+    }
+
+    if( iDb.isOpen() && iSamples > 0 ) {
+
+        // Smooth over sessions, a single session may not have filled the link
+        qint64 roundTripTime = iStoredRoundTripTime > 0 ?
+                               ( iStoredRoundTripTime + iRoundTripTime ) / 2 : iRoundTripTime;
+        qint64 throughput = iStoredThroughput > 0 && iThroughput > 0 ?
+                            ( iStoredThroughput + iThroughput ) / 2 : qMax( iStoredThroughput, iThroughput );
+
+        QSqlQuery query( iDb );
+        query.prepare( "INSERT OR REPLACE INTO links (link, roundtrip, throughput) VALUES (?, ?, ?)" );
+        query.addBindValue( iLinkId );
+        query.addBindValue( roundTripTime );
+        query.addBindValue( throughput );
+        if( !query.exec() ) {
+            qCWarning(lcSyncMLPlugin) << "Could not store link estimate:" << query.lastError();
+        }
+    }
+
+    iTimer.invalidate();
+    iLastEnd = -1;
+    iCalls = 0;
+    iSent = 0;
+    iRoundTrip = 0;
+    iRoundTripBytes = 0;
+    iRoundTripTime = 0;
+    iThroughput = 0;
+    iSamples = 0;
+    iStoredRoundTripTime = 0;
+    iStoredThroughput = 0;
+
+    if( !iConnectionName.isEmpty() ) {
+        iDb.close();
+        iDb = QSqlDatabase();
+        QSqlDatabase::removeDatabase( iConnectionName );
+        iConnectionName.clear();
+    }
+}
+
+void LinkEstimator::begin()
+{
+    QMutexLocker locker( &iMutex );
+
+    if( !iTimer.isValid() ) {
+        return;
+    }
+
+    if( iCalls == 0 && iLastEnd >= 0 ) {
+
+        qint64 gap = iTimer.elapsed() - iLastEnd;
+
+        if( gap >= MESSAGE_GAP ) {
+
+            // Items received during the previous round trip are known now
+            if( iRoundTrip > 0 ) {
+                sample( iRoundTrip, iRoundTripBytes );
+            }
+
+            if( gap <= MAX_ROUND_TRIP ) {
+                iRoundTrip = gap;
+                iRoundTripBytes = iSent;
+            }
+            else {
+                iRoundTrip = 0;
+                iRoundTripBytes = 0;
+            }
+
+            iSent = 0;
+        }
+    }
+
+    ++iCalls;
+}
+
+void LinkEstimator::end( qint64 aSent, qint64 aReceived )
+{
+    QMutexLocker locker( &iMutex );
+
+    if( !iTimer.isValid() ) {
+        return;
+    }
+
+    if( iCalls > 0 ) {
+        --iCalls;
+    }
+
+    iSent += aSent;
+    iRoundTripBytes += aReceived;
+    iLastEnd = iTimer.elapsed();
+}
+
+qint64 LinkEstimator::roundTripTime() const
+{
+    QMutexLocker locker( &iMutex );
+
+    return iSamples > 0 ? iRoundTripTime : iStoredRoundTripTime;
+}
+
+qint64 LinkEstimator::throughput() const
+{
+    QMutexLocker locker( &iMutex );
+
+    return iThroughput > 0 ? iThroughput : iStoredThroughput;
+}
+
+qint64 LinkEstimator::messageSize( qint64 aDefault, qint64 aMin, qint64 aMax ) const
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qint64 roundTrip = roundTripTime();
+    qint64 rate = throughput();
+
+    if( roundTrip <= 0 || rate <= 0 ) {
+        return aDefault;
+    }
+
+    qint64 size = qMin( rate * roundTrip * ROUND_TRIPS_PER_MESSAGE / 1000,
+                        rate * MAX_TRANSFER_TIME / 1000 );
+
+    return qBound( aMin, size, aMax );
+}
+
+void LinkEstimator::sample( qint64 aRoundTrip, qint64 aBytes )
+{
+    if( iSamples == 0 || aRoundTrip < iRoundTripTime ) {
+        iRoundTripTime = aRoundTrip;
+    }
+
+    if( aBytes > 0 ) {
+        iThroughput = qMax( iThroughput, aBytes * 1000 / aRoundTrip );
+    }
+
+    ++iSamples;
+    iRoundTrip = 0;
+    iRoundTripBytes = 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef LINKESTIMATOR_H
+#define LINKESTIMATOR_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QtSql>
+
+// Database file for link estimates, relative to SyncMLConfig::getDatabasePath()
+const QString LINK_ESTIMATE_DB_FILE( "syncmllinks.db" );
+
+/*! \brief Measures the round trip time and throughput of the link to the
+ *         remote party during a sync session
+ *
+ * The stack hands items to the storages once per message, and the time it
+ * spends between two messages is mostly spent waiting for the link.
+ * Storage adapters mark the start and end of each call they serve. Calls
+ * close to each other belong to the same message, and the gap between two
+ * messages is taken as a round trip carrying the items sent in the former
+ * and received in the latter. The shortest round trip approximates the
+ * latency of the link and the fastest transfer its throughput.
+ *
+ * Estimates are kept per link in a database, so that the next session over
+ * the same link can size its messages before it has measured anything.
+ */
+class LinkEstimator {
+
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    LinkEstimator();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~LinkEstimator();
+
+    /*! \brief Starts measuring a session and loads the estimate of the link
+     *
+     * @param aDbFile Path to database to use as persistent storage, empty
+     *                to keep the estimate of this session only
+     * @param aLinkId Identifier of the link, for example the transport and
+     *                address of the remote party
+     * @return True if successfully initialized, otherwise false
+     */
+    bool init( const QString& aDbFile, const QString& aLinkId );
+
+    /*! \brief Stores the estimate if the session measured it and stops
+     *         measuring
+     *
+     */
+    void uninit();
+
+    /*! \brief Marks the start of a call serving items of a message
+     *
+     */
+    void begin();
+
+    /*! \brief Marks the end of a call serving items of a message
+     *
+     * @param aSent Bytes of the items handed to the stack for sending
+     * @param aReceived Bytes of the items received from the stack
+     */
+    void end( qint64 aSent, qint64 aReceived );
+
+    /*! \brief Returns the estimated round trip time of the link
+     *
+     * @return Round trip time in milliseconds, 0 if not known
+     */
+    qint64 roundTripTime() const;
+
+    /*! \brief Returns the estimated throughput of the link
+     *
+     * @return Throughput in bytes per second, 0 if not known
+     */
+    qint64 throughput() const;
+
+    /*! \brief Returns the message size to use over the link
+     *
+     * Messages are made large enough that transferring one takes a few
+     * round trip times, so that high latency links are not dominated by
+     * waiting, and small enough to be sent within a few seconds, so that
+     * slow links do not stall on a single message.
+     *
+     * @param aDefault Size to use if the link has not been measured
+     * @param aMin Smallest size to use
+     * @param aMax Largest size to use
+     * @return Message size in bytes
+     */
+    qint64 messageSize( qint64 aDefault, qint64 aMin, qint64 aMax ) const;
+
+private:
+
+    void sample( qint64 aRoundTrip, qint64 aBytes );
+
+    QSqlDatabase                iDb;
+    QString                     iConnectionName;
+    QString                     iLinkId;
+
+    mutable QMutex              iMutex;
+    QElapsedTimer               iTimer;
+    qint64                      iLastEnd;
+    int                         iCalls;
+    qint64                      iSent;
+    qint64                      iRoundTrip;
+    qint64                      iRoundTripBytes;
+
+    qint64                      iRoundTripTime;
+    qint64                      iThroughput;
+    int                         iSamples;
+    qint64                      iStoredRoundTripTime;
+    qint64                      iStoredThroughput;
+
+    friend class LinkEstimatorTest;
+
+};
+
+#endif  //  LINKESTIMATOR_H
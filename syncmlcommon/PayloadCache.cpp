@@ -0,0 +1,431 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+
+#include "PayloadCache.h"
+
+#include <QCryptographicHash>
+
+#include "SyncMLPluginLogging.h"
+
+const QString CONNECTIONNAME( "payloads" );
+
+// When evicting, make room for this fraction of the maximum size so that
+// eviction doesn't run on every store
+const qint64 EVICTION_SLACK_DIVISOR = 10;
+
+// Upper bound for the stored payloads kept in memory before they are written
+const qint64 PENDING_MAX_BYTES = 1024 * 1024;
+
+PayloadCache::PayloadCache() :
+    iMaxSize( 0 ), iSize( 0 ), iPendingSize( 0 )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+PayloadCache::~PayloadCache()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    uninit();
+}
+
+bool PayloadCache::init( const QString& aDbFile, const QString& aStorageId,
+                         const QString& aFormat, const QByteArray& aCapabilities,
+                         qint64 aMaxSize )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    static unsigned connectionNumber = 0;
+
+    uninit();
+
+    QMutexLocker locker( &iMutex );
+
+    iConnectionName = CONNECTIONNAME + QString::number( connectionNumber++ );
+    iStorageId = aStorageId;
+    iFormat = aFormat;
+    iCapabilities = QCryptographicHash::hash( aCapabilities, QCryptographicHash::Sha1 ).toHex();
+    iMaxSize = aMaxSize;
+
+    iDb = QSqlDatabase::addDatabase( "QSQLITE", iConnectionName );
+    iDb.setDatabaseName( aDbFile );
+
+    if( !iDb.open() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not open payload cache database:" << aDbFile;
+        locker.unlock();
+        uninit();
+        return false;
+    }
+
+    // Losing the cache on a crash is harmless, so don't wait for the disk
+    iDb.exec( "PRAGMA synchronous = OFF" );
+
+    if( !createTable() ) {
+        locker.unlock();
+        uninit();
+        return false;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Payload cache for" << iStorageId << "initialized," << iSize << "bytes in use";
+
+    return true;
+}
+
+void PayloadCache::uninit()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    if( iConnectionName.isEmpty() ) {
+        return;
+    }
+
+    if( iDb.isOpen() ) {
+        writePending();
+    }
+
+    iDb.close();
+    iDb = QSqlDatabase();
+    QSqlDatabase::removeDatabase( iConnectionName );
+    iConnectionName.clear();
+    iEntries.clear();
+    iPending.clear();
+    iPendingSize = 0;
+    iUsed.clear();
+    iRemoved.clear();
+    iSize = 0;
+}
+
+void PayloadCache::flush()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    if( iConnectionName.isEmpty() ) {
+        return;
+    }
+
+    writePending();
+
+    if( iSize > iMaxSize ) {
+        evict();
+    }
+}
+
+bool PayloadCache::fetch( const QString& aId, const QDateTime& aRevision, QByteArray& aData,
+                          const QByteArray& aDigest )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() || !aRevision.isValid() ) {
+        return false;
+    }
+
+    QMutexLocker locker( &iMutex );
+
+    QHash<QString, Entry>::iterator entry = iEntries.find( aId );
+
+    if( entry == iEntries.end() || entry->iRevision != aRevision.toMSecsSinceEpoch() ||
+        entry->iDigest != aDigest ) {
+        return false;
+    }
+
+    if( iPending.contains( aId ) ) {
+        aData = iPending.value( aId );
+    }
+    else {
+        QSqlQuery query( iDb );
+        query.prepare( "SELECT data FROM payloads WHERE storage = ? AND id = ? AND format = ? "
+                       "AND caps = ? AND revision = ?" );
+        query.addBindValue( iStorageId );
+        query.addBindValue( aId );
+        query.addBindValue( iFormat );
+        query.addBindValue( iCapabilities );
+        query.addBindValue( aRevision.toMSecsSinceEpoch() );
+
+        if( !query.exec() || !query.next() ) {
+            return false;
+        }
+
+        aData = query.value( 0 ).toByteArray();
+        iUsed.insert( aId );
+    }
+
+    entry->iUsed = QDateTime::currentMSecsSinceEpoch();
+
+    return true;
+}
+
+void PayloadCache::store( const QString& aId, const QDateTime& aRevision, const QByteArray& aData,
+                          const QByteArray& aDigest )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() || !aRevision.isValid() || aData.size() > iMaxSize ) {
+        return;
+    }
+
+    QMutexLocker locker( &iMutex );
+
+    QHash<QString, Entry>::const_iterator old = iEntries.constFind( aId );
+    if( old != iEntries.constEnd() ) {
+        iSize -= old->iSize;
+    }
+
+    if( iPending.contains( aId ) ) {
+        iPendingSize -= iPending.value( aId ).size();
+    }
+
+    Entry entry;
+    entry.iRevision = aRevision.toMSecsSinceEpoch();
+    entry.iDigest = aDigest;
+    entry.iSize = aData.size();
+    entry.iUsed = QDateTime::currentMSecsSinceEpoch();
+
+    iEntries.insert( aId, entry );
+    iPending.insert( aId, aData );
+    iUsed.remove( aId );
+    iPendingSize += aData.size();
+    iSize += aData.size();
+
+    if( iSize > iMaxSize || iPendingSize > PENDING_MAX_BYTES ) {
+        writePending();
+
+        if( iSize > iMaxSize ) {
+            evict();
+        }
+    }
+}
+
+void PayloadCache::remove( const QString& aId )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() ) {
+        return;
+    }
+
+    QMutexLocker locker( &iMutex );
+
+    QHash<QString, Entry>::iterator entry = iEntries.find( aId );
+    if( entry != iEntries.end() ) {
+        iSize -= entry->iSize;
+        iEntries.erase( entry );
+    }
+
+    if( iPending.contains( aId ) ) {
+        iPendingSize -= iPending.take( aId ).size();
+    }
+
+    // Payloads of the item in other formats are removed as well
+    iUsed.remove( aId );
+    iRemoved.insert( aId );
+}
+
+void PayloadCache::clear()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iConnectionName.isEmpty() ) {
+        return;
+    }
+
+    QMutexLocker locker( &iMutex );
+
+    iEntries.clear();
+    iPending.clear();
+    iPendingSize = 0;
+    iUsed.clear();
+    iRemoved.clear();
+
+    QSqlQuery query( iDb );
+    query.prepare( "DELETE FROM payloads WHERE storage = ?" );
+    query.addBindValue( iStorageId );
+
+    if( !query.exec() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not clear payloads:" << query.lastError();
+    }
+
+    if( query.exec( "SELECT SUM(size) FROM payloads" ) && query.next() ) {
+        iSize = query.value( 0 ).toLongLong();
+    }
+}
+
+bool PayloadCache::createTable()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QSqlQuery query( iDb );
+
+    // Tables written before content digests were added are dropped, they
+    // only hold cached data
+    if( iDb.tables().contains( "payloads" ) && !query.exec( "SELECT digest FROM payloads LIMIT 0" ) ) {
+        qCDebug(lcSyncMLPlugin) << "Recreating payload cache table";
+        query.exec( "DROP TABLE payloads" );
+    }
+
+    if( !query.exec( "CREATE TABLE if not exists payloads (storage varchar(64), id varchar(512), "
+                     "format varchar(64), caps varchar(40), revision integer, digest blob, used integer, "
+                     "size integer, data blob, PRIMARY KEY (storage, id, format, caps))" ) ||
+        !query.exec( "CREATE INDEX if not exists payloads_used ON payloads (used)" ) ) {
+        qCCritical(lcSyncMLPlugin) << "Could not create payload cache table:" << query.lastError();
+        return false;
+    }
+
+    if( query.exec( "SELECT SUM(size) FROM payloads" ) && query.next() ) {
+        iSize = query.value( 0 ).toLongLong();
+    }
+
+    // Lookups of items that are not cached don't need to go to the database
+    query.setForwardOnly( true );
+    query.prepare( "SELECT id, revision, digest, size, used FROM payloads WHERE storage = ? AND format = ? AND caps = ?" );
+    query.addBindValue( iStorageId );
+    query.addBindValue( iFormat );
+    query.addBindValue( iCapabilities );
+
+    if( !query.exec() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not load payload cache entries:" << query.lastError();
+        return false;
+    }
+
+    while( query.next() ) {
+        Entry entry;
+        entry.iRevision = query.value( 1 ).toLongLong();
+        entry.iDigest = query.value( 2 ).toByteArray();
+        entry.iSize = query.value( 3 ).toLongLong();
+        entry.iUsed = query.value( 4 ).toLongLong();
+        iEntries.insert( query.value( 0 ).toString(), entry );
+    }
+
+    return true;
+}
+
+void PayloadCache::writePending()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iPending.isEmpty() && iUsed.isEmpty() && iRemoved.isEmpty() ) {
+        return;
+    }
+
+    iDb.transaction();
+
+    QSqlQuery query( iDb );
+
+    query.prepare( "DELETE FROM payloads WHERE storage = ? AND id = ?" );
+    foreach( const QString& id, iRemoved ) {
+        query.addBindValue( iStorageId );
+        query.addBindValue( id );
+        query.exec();
+    }
+
+    query.prepare( "INSERT OR REPLACE INTO payloads (storage, id, format, caps, revision, digest, used, size, data) "
+                   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)" );
+    QHash<QString, QByteArray>::const_iterator i;
+    for( i = iPending.constBegin(); i != iPending.constEnd(); ++i ) {
+        const Entry& entry = iEntries[i.key()];
+        query.addBindValue( iStorageId );
+        query.addBindValue( i.key() );
+        query.addBindValue( iFormat );
+        query.addBindValue( iCapabilities );
+        query.addBindValue( entry.iRevision );
+        query.addBindValue( entry.iDigest );
+        query.addBindValue( entry.iUsed );
+        query.addBindValue( entry.iSize );
+        query.addBindValue( i.value() );
+        if( !query.exec() ) {
+            qCWarning(lcSyncMLPlugin) << "Could not store payload:" << query.lastError();
+        }
+    }
+
+    query.prepare( "UPDATE payloads SET used = ? WHERE storage = ? AND id = ? AND format = ? AND caps = ?" );
+    foreach( const QString& id, iUsed ) {
+        query.addBindValue( iEntries.value( id ).iUsed );
+        query.addBindValue( iStorageId );
+        query.addBindValue( id );
+        query.addBindValue( iFormat );
+        query.addBindValue( iCapabilities );
+        query.exec();
+    }
+
+    if( !iDb.commit() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not commit payloads:" << iDb.lastError();
+        iDb.rollback();
+    }
+
+    iPending.clear();
+    iPendingSize = 0;
+    iUsed.clear();
+    iRemoved.clear();
+
+    // Removals also covered other formats, which are not tracked in memory
+    if( query.exec( "SELECT SUM(size) FROM payloads" ) && query.next() ) {
+        iSize = query.value( 0 ).toLongLong();
+    }
+}
+
+void PayloadCache::evict()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qint64 target = iMaxSize - iMaxSize / EVICTION_SLACK_DIVISOR;
+    qint64 evicted = 0;
+    qint64 lastUsed = 0;
+
+    QSqlQuery query( iDb );
+    query.setForwardOnly( true );
+
+    if( !query.exec( "SELECT used, size FROM payloads ORDER BY used ASC" ) ) {
+        qCWarning(lcSyncMLPlugin) << "Could not select payloads to evict:" << query.lastError();
+        return;
+    }
+
+    while( iSize - evicted > target && query.next() ) {
+        lastUsed = query.value( 0 ).toLongLong();
+        evicted += query.value( 1 ).toLongLong();
+    }
+    query.finish();
+
+    query.prepare( "DELETE FROM payloads WHERE used <= ?" );
+    query.addBindValue( lastUsed );
+
+    if( !query.exec() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not evict payloads:" << query.lastError();
+        return;
+    }
+
+    QHash<QString, Entry>::iterator i = iEntries.begin();
+    while( i != iEntries.end() ) {
+        if( i->iUsed <= lastUsed ) {
+            i = iEntries.erase( i );
+        }
+        else {
+            ++i;
+        }
+    }
+
+    if( query.exec( "SELECT SUM(size) FROM payloads" ) && query.next() ) {
+        iSize = query.value( 0 ).toLongLong();
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Evicted payloads," << iSize << "bytes in use";
+}
@@ -0,0 +1,160 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef PAYLOADCACHE_H
+#define PAYLOADCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QtSql>
+
+// Database file for the payload cache, relative to SyncMLConfig::getDatabasePath()
+const QString PAYLOAD_CACHE_DB_FILE( "syncmlpayloads.db" );
+
+// Default upper bound for the size of the payload cache
+const qint64 PAYLOAD_CACHE_DEFAULT_SIZE = 16 * 1024 * 1024;
+
+/*! \brief Persistent cache of serialized item payloads
+ *
+ * Converting contacts and incidences to vCard/iCalendar is expensive, and
+ * every slow sync or sync against another server repeats the conversion for
+ * items that have not changed. This cache keeps the serialized bytes of items
+ * keyed by storage, item id, format and capabilities, and serves them as long
+ * as the item revision (last modification time) matches. Backends that store
+ * modification times in whole seconds can give two changes the same revision,
+ * they pass a digest of the item content along with it. The least recently
+ * used entries are evicted once the cache grows over its size limit.
+ *
+ * Stored payloads and use times are kept in memory and written in a single
+ * transaction by flush(), when the cache grows over its size limit and at
+ * uninit().
+ */
+class PayloadCache {
+
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    PayloadCache();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~PayloadCache();
+
+    /*! \brief Initializes the cache for a storage
+     *
+     * @param aDbFile Path to database to use as persistent storage
+     * @param aStorageId Identifier for storage
+     * @param aFormat Format and version of the payloads, e.g. "text/x-vcard 2.1"
+     * @param aCapabilities Data the serialized form depends on, e.g. CTCaps
+     * @param aMaxSize Upper bound for the size of all cached payloads in bytes
+     * @return True if successfully initialized, otherwise false
+     */
+    bool init( const QString& aDbFile, const QString& aStorageId,
+               const QString& aFormat, const QByteArray& aCapabilities,
+               qint64 aMaxSize );
+
+    /*! \brief Writes pending changes and uninitializes the cache
+     *
+     */
+    void uninit();
+
+    /*! \brief Writes stored payloads and use times to the database
+     *
+     */
+    void flush();
+
+    /*! \brief Looks up the payload of an item
+     *
+     * @param aId Item id
+     * @param aRevision Last modification time of the item
+     * @param aData Output payload
+     * @param aDigest Digest of the item content, if the storage has one
+     * @return True if a payload for this revision was found, otherwise false
+     */
+    bool fetch( const QString& aId, const QDateTime& aRevision, QByteArray& aData,
+                const QByteArray& aDigest = QByteArray() );
+
+    /*! \brief Stores the payload of an item
+     *
+     * @param aId Item id
+     * @param aRevision Last modification time of the item
+     * @param aData Payload
+     * @param aDigest Digest of the item content, if the storage has one
+     */
+    void store( const QString& aId, const QDateTime& aRevision, const QByteArray& aData,
+                const QByteArray& aDigest = QByteArray() );
+
+    /*! \brief Removes all payloads of an item
+     *
+     * @param aId Item id
+     */
+    void remove( const QString& aId );
+
+    /*! \brief Removes all payloads of the storage
+     *
+     */
+    void clear();
+
+private:
+
+    struct Entry
+    {
+        qint64 iRevision;
+        QByteArray iDigest;
+        qint64 iSize;
+        qint64 iUsed;
+    };
+
+    bool createTable();
+
+    void writePending();
+
+    void evict();
+
+    QSqlDatabase                iDb;
+    QString                     iConnectionName;
+    QString                     iStorageId;
+    QString                     iFormat;
+    QString                     iCapabilities;
+    qint64                      iMaxSize;
+    qint64                      iSize;
+
+    // Payloads of the storage in this format, including pending ones
+    QHash<QString, Entry>       iEntries;
+
+    // Changes not written to the database yet
+    QHash<QString, QByteArray>  iPending;
+    qint64                      iPendingSize;
+    QSet<QString>               iUsed;
+    QSet<QString>               iRemoved;
+
+    QMutex                      iMutex;
+
+    friend class PayloadCacheTest;
+
+};
+
+#endif  //  PAYLOADCACHE_H
@@ -0,0 +1,62 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef POOLABLESTORAGE_H
+#define POOLABLESTORAGE_H
+
+/*! \brief Interface of storage plugins that can be kept initialized between
+ *         sync sessions
+ *
+ * Initializing a storage plugin opens its backend and may analyze all of its
+ * items. A storage plugin implementing this interface in addition to
+ * Buteo::StoragePlugin can be kept initialized by SyncMLStorageProvider once
+ * a session ends, and handed to the next session with the same properties.
+ * Plugins that do not implement it are always uninitialized after a session.
+ */
+class PoolableStorage
+{
+public:
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~PoolableStorage();
+
+    /*! \brief Ends a session without uninitializing the storage
+     *
+     * Everything the session changed must be stored, as the storage may be
+     * uninitialized or destroyed later without another session.
+     *
+     * @return True if the storage can be resumed later, otherwise false
+     */
+    virtual bool suspend() = 0;
+
+    /*! \brief Starts a new session with the properties of the suspended one
+     *
+     * Should check cheaply that whatever the storage keeps in memory is still
+     * valid for the backend.
+     *
+     * @return True if the storage is ready for the session, false if it has
+     *         to be initialized again
+     */
+    virtual bool resume() = 0;
+
+};
+
+#endif  //  POOLABLESTORAGE_H
@@ -26,9 +26,12 @@
 #include <buteosyncfw5/StoragePlugin.h>
 #include <buteosyncfw5/StorageItem.h>
 
+
 #include "SyncMLCommon.h"
 #include "ItemAdapter.h"
 #include "SyncMLConfig.h"
+#include "ContentKey.h"
+#include "LinkEstimator.h"
 
 #include "SyncMLPluginLogging.h"
 
@@ -36,8 +39,21 @@
 // Database file for SyncML storage adapter database
 #define  ADAPTERDBFILE  "syncmladapter.db"
 
+// Upper bounds for the items kept in memory between change detection and
+// sending them to the remote party
+const int ITEM_CACHE_MAX_ITEMS = 200;
+const qint64 ITEM_CACHE_MAX_BYTES = 1024 * 1024;
+
+// Assumptions used to size the read-ahead window until the message size is
+// known and items have been fetched
+const qint64 DEFAULT_MESSAGE_SIZE = 16 * 1024;
+const qint64 DEFAULT_ITEM_SIZE = 1024;
+
 StorageAdapter::StorageAdapter( Buteo::StoragePlugin* aPlugin )
- : iPlugin( aPlugin )
+ : iPlugin( aPlugin ), iItemCacheSize( 0 ), iPendingIndex( 0 ),
+   iMaxMessageSize( 0 ),
+   iMaxObjSize( 0 ), iLinkEstimator( NULL ), iFetchedBytes( 0 ), iFetchedItems( 0 ),
+   iReconcile( false ), iRefresh( false ), iRefreshCleared( false )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
@@ -46,6 +62,8 @@ StorageAdapter::StorageAdapter( Buteo::StoragePlugin* aPlugin )
 StorageAdapter::~StorageAdapter()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    clearItemCache();
 }
 
 bool StorageAdapter::isValid()
@@ -105,6 +123,14 @@ bool StorageAdapter::init()
 
     iTargetDB = pluginProperties[STORAGE_REMOTE_URI];
 
+    // Max object size
+
+    iMaxObjSize = pluginProperties.value( STORAGE_MAX_OBJ_SIZE_PROP ).toLongLong();
+
+    // Refresh from remote
+
+    iRefresh = ( pluginProperties.value( STORAGE_REFRESH_PROP ) == PROPS_TRUE );
+
     // ** Own initialization
 
     iType = preferredFormat;
@@ -120,11 +146,43 @@ bool StorageAdapter::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    clearItemCache();
     iIdMapper.uninit();
 
     return true;
 }
 
+bool StorageAdapter::suspend()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    clearItemCache();
+
+    iFetchedBytes = 0;
+    iFetchedItems = 0;
+    iReconcile = false;
+    iUnindexedIds.clear();
+    iContentIndex.clear();
+    iContentKeys.clear();
+    iRefreshCleared = false;
+
+    return iIdMapper.save();
+}
+
+void StorageAdapter::setMaxMessageSize( qint64 aMaxMessageSize )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iMaxMessageSize = aMaxMessageSize;
+}
+
+void StorageAdapter::setLinkEstimator( LinkEstimator* aLinkEstimator )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iLinkEstimator = aLinkEstimator;
+}
+
 Buteo::StoragePlugin* StorageAdapter::getPlugin() const
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -150,8 +208,9 @@ qint64 StorageAdapter::getMaxObjSize() const
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    // Max object size not supported at the moment
-    return 0;
+    // Not derived from the link, as the remote party would leave out items
+    // that are larger instead of sending them in chunks
+    return iMaxObjSize;
 }
 
 QByteArray StorageAdapter::getPluginCTCaps( DataSync::ProtocolVersion aVersion ) const
@@ -185,6 +244,8 @@ bool StorageAdapter::getAll( QList<DataSync::SyncItemKey>& aKeys )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    clearItemCache();
+
     QList<QString> newKeys;
     if (!iPlugin->getAllItemIds( newKeys )) {
         return false;
@@ -194,6 +255,14 @@ bool StorageAdapter::getAll( QList<DataSync::SyncItemKey>& aKeys )
         aKeys.append(iIdMapper.value(key));
     }
 
+    cacheItems( newKeys );
+
+    // All items are exchanged, so incoming additions may already exist locally
+    iReconcile = true;
+    iUnindexedIds = newKeys.toSet();
+    iContentIndex.clear();
+    iContentKeys.clear();
+
     return true;
 }
 
@@ -204,6 +273,8 @@ bool StorageAdapter::getModifications( QList<DataSync::SyncItemKey>& aNewKeys,
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    clearItemCache();
+
     QList<QString> newKeys;
     QList<QString> replacedKeys;
     QList<QString> deletedKeys;
@@ -226,6 +297,13 @@ bool StorageAdapter::getModifications( QList<DataSync::SyncItemKey>& aNewKeys,
         aDeletedKeys.append( iIdMapper.value( deletedKeys[i] ) );
     }
 
+    cacheItems( newKeys + replacedKeys );
+
+    iReconcile = false;
+    iUnindexedIds.clear();
+    iContentIndex.clear();
+    iContentKeys.clear();
+
     return true;
 
 }
@@ -253,24 +331,17 @@ DataSync::SyncItem* StorageAdapter::getSyncItem( const DataSync::SyncItemKey& aK
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
     QString id = iIdMapper.key( aKey );
+    iServedIds.insert( id );
 
-    Buteo::StorageItem* item = iPlugin->getItem( id );
-
-    if( item ) {
-        ItemAdapter* adapter = new ItemAdapter( item );
-        adapter->setKey( aKey );
-        adapter->setType( item->getType() );
-        QString version = item->getVersion();
-
-        if (!version.isEmpty()) {
-            adapter->setVersion(version);
-        }
+    Buteo::StorageItem* item = takeCachedItem( id );
 
-        if( !item->getParentId().isEmpty() ) {
-            adapter->setParentKey( iIdMapper.value( item->getParentId() ) );
-        }
+    if( !item ) {
+        item = iPlugin->getItem( id );
+    }
 
-        return adapter;
+    if( item ) {
+        indexItem( item );
+        return toSyncItem( item );
     }
     else {
         return NULL;
@@ -282,43 +353,63 @@ QList<DataSync::SyncItem*> StorageAdapter::getSyncItems( const QList<DataSync::S
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
-    QStringList idList;
-    QList<DataSync::SyncItemKey>::const_iterator i;
-        for( i = aKeyList.constBegin(); i != aKeyList.constEnd(); ++i)
-    {
-        idList.append( iIdMapper.key( *i ) );
+    if( iLinkEstimator ) {
+        iLinkEstimator->begin();
     }
 
-    QList<Buteo::StorageItem*> items = iPlugin->getItems( idList );
     QList<DataSync::SyncItem*> adapters;
-
-    QList<Buteo::StorageItem*>::const_iterator j;
-    for( j = items.constBegin(); j != items.constEnd(); ++j)
+    QStringList idList;
+    qint64 bytes = 0;
+    QList<DataSync::SyncItemKey>::const_iterator i;
+    for( i = aKeyList.constBegin(); i != aKeyList.constEnd(); ++i )
     {
-        if( *j )
+        QString id = iIdMapper.key( *i );
+        iServedIds.insert( id );
+
+        // Items read ahead are handed over and evicted
+        Buteo::StorageItem* cached = takeCachedItem( id );
+        if( cached )
+        {
+            bytes += cached->getSize();
+            indexItem( cached );
+            adapters.append( toSyncItem( cached ) );
+        }
+        else
         {
-            ItemAdapter* adapter = new ItemAdapter( *j );
-            adapter->setKey( iIdMapper.value( (*j)->getId() ) );
-            adapter->setType( (*j)->getType() );
+            idList.append( id );
+        }
+    }
 
-            QString version = (*j)->getVersion();
+    if( !idList.isEmpty() )
+    {
+        QList<Buteo::StorageItem*> items = iPlugin->getItems( idList );
 
-            if (!version.isEmpty()) {
-                adapter->setVersion(version);
+        QList<Buteo::StorageItem*>::const_iterator j;
+        for( j = items.constBegin(); j != items.constEnd(); ++j)
+        {
+            if( *j )
+            {
+                iFetchedBytes += (*j)->getSize();
+                ++iFetchedItems;
+                bytes += (*j)->getSize();
+                indexItem( *j );
+                adapters.append( toSyncItem( *j ) );
             }
-
-            if( !(*j)->getParentId().isEmpty() )
+            else
             {
-                adapter->setParentKey( iIdMapper.value( (*j)->getParentId() ) );
+                adapters.append( NULL );
             }
-            adapters.append( adapter );
-        }
-        else
-        {
-            adapters.append( NULL );
         }
     }
 
+    // The stack asks for the next message's items once this one is out,
+    // so fetch them in one batch now
+    readAhead();
+
+    if( iLinkEstimator ) {
+        iLinkEstimator->end( bytes, 0 );
+    }
+
     return adapters;
 }
 
@@ -327,30 +418,62 @@ QList<DataSync::StoragePlugin::StoragePluginStatus> StorageAdapter::addItems( co
 
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iLinkEstimator ) {
+        iLinkEstimator->begin();
+    }
+
     QList<StoragePlugin::StoragePluginStatus> results;
     QList<Buteo::StorageItem*> items;
+    QList<int> indexes;
+    qint64 bytes = 0;
+
+    if( iReconcile ) {
+        buildContentIndex();
+    }
 
     for( int i = 0; i < aItems.count(); ++i ) {
-        items.append( toStorageItem( aItems[i] ) );
+        bytes += aItems[i]->getSize();
+        Buteo::StorageItem* item = toStorageItem( aItems[i] );
+
+        // Additions identical to an existing item are mapped to it instead
+        QString existingId = iReconcile ? reconcileItem( item ) : QString();
+        if( !existingId.isEmpty() ) {
+            ItemAdapter* adapter = static_cast<ItemAdapter*>( aItems[i] );
+            adapter->setKey( iIdMapper.value( existingId ) );
+            results.append( STATUS_OK );
+            continue;
+        }
+
+        items.append( item );
+        indexes.append( i );
+        results.append( STATUS_ERROR );
+    }
+
+    if( items.count() < aItems.count() ) {
+        qCDebug(lcSyncMLPlugin) << aItems.count() - items.count() << "added items matched existing items";
     }
 
     QList< Buteo::StoragePlugin::OperationStatus > operations;
-    if( aItems.count() )
+    if( items.count() )
     {
         operations = iPlugin->addItems( items );
     }
 
-    for( int i = 0; i < operations.count(); ++i ) {
+    for( int i = 0; i < operations.count() && i < indexes.count(); ++i ) {
         StoragePlugin::StoragePluginStatus status = convertStatus( operations[i] );
 
         if( status == STATUS_OK ) {
             QString mappedId = iIdMapper.value( items[i]->getId() );
-            ItemAdapter* adapter = static_cast<ItemAdapter*>( aItems[i] );
+            ItemAdapter* adapter = static_cast<ItemAdapter*>( aItems[indexes[i]] );
             adapter->setKey( mappedId );
         }
 
-        results.append( status );
+        results[indexes[i]] = status;
+
+    }
 
+    if( iLinkEstimator ) {
+        iLinkEstimator->end( 0, bytes );
     }
 
     return results;
@@ -362,13 +485,20 @@ QList<DataSync::StoragePlugin::StoragePluginStatus> StorageAdapter::replaceItems
 
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iLinkEstimator ) {
+        iLinkEstimator->begin();
+    }
+
     QList<StoragePlugin::StoragePluginStatus> results;
     QList<Buteo::StorageItem*> items;
+    qint64 bytes = 0;
 
     // There is no need to do item id mapping here, as the StorageItems always have their correct id's.
     // Only ItemAdapter houses mapped id's.
     for( int i = 0; i < aItems.count(); ++i ) {
+        bytes += aItems[i]->getSize();
         items.append( toStorageItem( aItems[i] ) );
+        removeCachedItem( items.last()->getId() );
     }
 
     QList< Buteo::StoragePlugin::OperationStatus > operations;
@@ -390,6 +520,10 @@ QList<DataSync::StoragePlugin::StoragePluginStatus> StorageAdapter::replaceItems
 
     }
 
+    if( iLinkEstimator ) {
+        iLinkEstimator->end( 0, bytes );
+    }
+
     return results;
 
 }
@@ -398,12 +532,32 @@ QList<DataSync::StoragePlugin::StoragePluginStatus> StorageAdapter::deleteItems(
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    if( iLinkEstimator ) {
+        iLinkEstimator->begin();
+    }
+
     QList<QString> ids;
     QList<StoragePlugin::StoragePluginStatus> results;
 
     // aKeys houses mapped id's, so they must be converted back to actual item id's
     for( int i = 0; i < aKeys.count(); ++i ) {
         ids.append( iIdMapper.key( aKeys[i] ) );
+        if( !iRefresh ) {
+            removeCachedItem( ids.last() );
+        }
+    }
+
+    // The plugin removes all items at once during refresh, so everything
+    // known about the local items is dropped in one step as well
+    if( iRefresh && !iRefreshCleared && aKeys.count() ) {
+        qCDebug(lcSyncMLPlugin) << "Refresh from remote, clearing item cache and id mappings";
+        clearItemCache();
+        iReconcile = false;
+        iUnindexedIds.clear();
+        iContentIndex.clear();
+        iContentKeys.clear();
+        iIdMapper.clear();
+        iRefreshCleared = true;
     }
 
     QList< Buteo::StoragePlugin::OperationStatus > operations;
@@ -419,6 +573,10 @@ QList<DataSync::StoragePlugin::StoragePluginStatus> StorageAdapter::deleteItems(
 
     }
 
+    if( iLinkEstimator ) {
+        iLinkEstimator->end( 0, 0 );
+    }
+
     return results;
 }
 
@@ -485,3 +643,203 @@ Buteo::StorageItem* StorageAdapter::toStorageItem( const DataSync::SyncItem* aSy
 
     return &item;
 }
+
+DataSync::SyncItem* StorageAdapter::toSyncItem( Buteo::StorageItem* aItem )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    ItemAdapter* adapter = new ItemAdapter( aItem );
+    adapter->setKey( iIdMapper.value( aItem->getId() ) );
+    adapter->setType( aItem->getType() );
+
+    QString version = aItem->getVersion();
+
+    if (!version.isEmpty()) {
+        adapter->setVersion(version);
+    }
+
+    if( !aItem->getParentId().isEmpty() ) {
+        adapter->setParentKey( iIdMapper.value( aItem->getParentId() ) );
+    }
+
+    return adapter;
+}
+
+void StorageAdapter::cacheItems( const QList<QString>& aIds )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    clearItemCache();
+
+    iPendingIds = aIds;
+
+    // Fetch the items of the first message, so that the following
+    // getSyncItems() calls don't each go to the backend separately
+    readAhead();
+}
+
+void StorageAdapter::readAhead()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iItemCacheSize >= ITEM_CACHE_MAX_BYTES || iItemCache.count() >= ITEM_CACHE_MAX_ITEMS ) {
+        return;
+    }
+
+    // The window is limited by what is left of the cache as well
+    int window = qMin( readAheadWindow(), ITEM_CACHE_MAX_ITEMS - iItemCache.count() );
+    QStringList ids;
+
+    while( ids.count() < window && iPendingIndex < iPendingIds.count() ) {
+        const QString& id = iPendingIds[iPendingIndex++];
+        if( !iServedIds.contains( id ) && !iItemCache.contains( id ) ) {
+            ids.append( id );
+        }
+    }
+
+    if( ids.isEmpty() ) {
+        return;
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Reading ahead" << ids.count() << "items";
+
+    QList<Buteo::StorageItem*> items = iPlugin->getItems( ids );
+    for( int i = 0; i < items.count(); ++i ) {
+        cacheItem( items[i] );
+    }
+}
+
+int StorageAdapter::readAheadWindow() const
+{
+    qint64 messageSize = iMaxMessageSize > 0 ? iMaxMessageSize : DEFAULT_MESSAGE_SIZE;
+    qint64 itemSize = iFetchedItems > 0 ? iFetchedBytes / iFetchedItems : DEFAULT_ITEM_SIZE;
+
+    return static_cast<int>( qBound<qint64>( 1, messageSize / qMax<qint64>( itemSize, 1 ),
+                                             ITEM_CACHE_MAX_ITEMS ) );
+}
+
+void StorageAdapter::cacheItem( Buteo::StorageItem* aItem )
+{
+    if( !aItem ) {
+        return;
+    }
+
+    iFetchedBytes += aItem->getSize();
+    ++iFetchedItems;
+
+    // Items that have already been served or cached are not needed again
+    if( iServedIds.contains( aItem->getId() ) || iItemCache.contains( aItem->getId() ) ) {
+        delete aItem;
+        return;
+    }
+
+    iItemCacheSize += aItem->getSize();
+    iItemCache.insert( aItem->getId(), aItem );
+}
+
+Buteo::StorageItem* StorageAdapter::takeCachedItem( const QString& aId )
+{
+    Buteo::StorageItem* item = iItemCache.take( aId );
+
+    if( item ) {
+        iItemCacheSize -= item->getSize();
+    }
+
+    return item;
+}
+
+void StorageAdapter::removeCachedItem( const QString& aId )
+{
+    iServedIds.insert( aId );
+    delete takeCachedItem( aId );
+
+    // Changed items must not be matched by their old content
+    iUnindexedIds.remove( aId );
+    QHash<QString, QByteArray>::iterator i = iContentKeys.find( aId );
+    if( i != iContentKeys.end() ) {
+        iContentIndex.remove( i.value(), aId );
+        iContentKeys.erase( i );
+    }
+}
+
+void StorageAdapter::indexItem( Buteo::StorageItem* aItem )
+{
+    if( !iReconcile || !iUnindexedIds.remove( aItem->getId() ) ) {
+        return;
+    }
+
+    QByteArray data;
+    if( aItem->read( 0, aItem->getSize(), data ) ) {
+        QByteArray key = ContentKey::key( data );
+        iContentIndex.insert( key, aItem->getId() );
+        iContentKeys.insert( aItem->getId(), key );
+    }
+}
+
+void StorageAdapter::buildContentIndex()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( iUnindexedIds.isEmpty() ) {
+        return;
+    }
+
+    // Items still waiting to be sent are indexed as they are, the rest are
+    // read in batches
+    QStringList ids;
+    foreach( const QString& id, iUnindexedIds.toList() ) {
+        Buteo::StorageItem* cached = iItemCache.value( id );
+        if( cached ) {
+            indexItem( cached );
+        }
+        else {
+            ids.append( id );
+        }
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Indexing content of" << ids.count() << "items for slow sync";
+
+    for( int i = 0; i < ids.count(); i += ITEM_CACHE_MAX_ITEMS ) {
+        QList<Buteo::StorageItem*> items = iPlugin->getItems( ids.mid( i, ITEM_CACHE_MAX_ITEMS ) );
+        for( int j = 0; j < items.count(); ++j ) {
+            if( items[j] ) {
+                indexItem( items[j] );
+                delete items[j];
+            }
+        }
+    }
+
+    // Items that could not be read are not indexed
+    iUnindexedIds.clear();
+}
+
+QString StorageAdapter::reconcileItem( Buteo::StorageItem* aItem )
+{
+    QByteArray data;
+    if( !aItem->read( 0, aItem->getSize(), data ) ) {
+        return QString();
+    }
+
+    // Each existing item can be matched only once
+    QMultiHash<QByteArray, QString>::iterator i = iContentIndex.find( ContentKey::key( data ) );
+    if( i == iContentIndex.end() ) {
+        return QString();
+    }
+
+    QString id = i.value();
+    iContentIndex.erase( i );
+    iContentKeys.remove( id );
+
+    return id;
+}
+
+void StorageAdapter::clearItemCache()
+{
+    qDeleteAll( iItemCache );
+    iItemCache.clear();
+    iItemCacheSize = 0;
+
+    iPendingIds.clear();
+    iPendingIndex = 0;
+    iServedIds.clear();
+}
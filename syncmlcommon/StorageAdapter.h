@@ -25,6 +25,8 @@
 #define STORAGEADAPTER_H
 
 #include <QMap>
+#include <QHash>
+#include <QSet>
 #include <QVector>
 
 #include <buteosyncfw5/StoragePlugin.h>
@@ -36,6 +38,7 @@
 
 class StoragePlugin;
 class StorageItem;
+class LinkEstimator;
 
 /*! \brief Adapter to adapt framework storage plugin to SyncML stack storage
  *         plugin
@@ -85,6 +88,29 @@ public:
      */
     bool uninit();
 
+    /*! \brief Ends a session while keeping the adapter initialized
+     *
+     * Stores the id mappings and forgets the state of the session, so that
+     * the adapter can be used in another session with the same storage.
+     *
+     * @return True on success, otherwise false
+     */
+    bool suspend();
+
+    /*! \brief Sets the SyncML message size budget
+     *
+     * Used to size the window of items read ahead for getSyncItems()
+     *
+     * @param aMaxMessageSize Maximum message size in bytes, 0 if not known
+     */
+    void setMaxMessageSize( qint64 aMaxMessageSize );
+
+    /*! \brief Sets the estimator measuring the link items are exchanged over
+     *
+     * @param aLinkEstimator Estimator to mark item exchanges to, NULL for none
+     */
+    void setLinkEstimator( LinkEstimator* aLinkEstimator );
+
     /*! \see DataSync::StoragePlugin::getSourceURI()
      *
      */
@@ -161,6 +187,28 @@ private:
 
     Buteo::StorageItem* toStorageItem( const DataSync::SyncItem* aSyncItem ) const;
 
+    DataSync::SyncItem* toSyncItem( Buteo::StorageItem* aItem );
+
+    void cacheItems( const QList<QString>& aIds );
+
+    void readAhead();
+
+    int readAheadWindow() const;
+
+    void cacheItem( Buteo::StorageItem* aItem );
+
+    Buteo::StorageItem* takeCachedItem( const QString& aId );
+
+    void removeCachedItem( const QString& aId );
+
+    void clearItemCache();
+
+    void indexItem( Buteo::StorageItem* aItem );
+
+    void buildContentIndex();
+
+    QString reconcileItem( Buteo::StorageItem* aItem );
+
 
     Buteo::StoragePlugin*               iPlugin;
 
@@ -172,6 +220,36 @@ private:
 
     ItemIdMapper                        iIdMapper;
 
+    // Items fetched during change detection, waiting to be sent
+    QHash<QString, Buteo::StorageItem*> iItemCache;
+    qint64                              iItemCacheSize;
+
+    // Items still to be sent, in the order they were reported, and the
+    // ones already handed over
+    QList<QString>                      iPendingIds;
+    int                                 iPendingIndex;
+    QSet<QString>                       iServedIds;
+
+    qint64                              iMaxMessageSize;
+    qint64                              iMaxObjSize;
+    LinkEstimator*                      iLinkEstimator;
+    qint64                              iFetchedBytes;
+    qint64                              iFetchedItems;
+
+    // During slow sync, local items by the key of their content, so that
+    // incoming additions of the same items can be mapped to them however the
+    // server serializes them, and the key of each indexed item for removing
+    // it from the index
+    bool                                iReconcile;
+    QSet<QString>                       iUnindexedIds;
+    QMultiHash<QByteArray, QString>     iContentIndex;
+    QHash<QString, QByteArray>          iContentKeys;
+
+    // During refresh from remote the plugin wipes all local items on the
+    // first deletion, after which cached state and mappings are stale
+    bool                                iRefresh;
+    bool                                iRefreshCleared;
+
 };
 
 #endif  //  STORAGEADAPTER_H
@@ -0,0 +1,82 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "StorageReservations.h"
+
+#include "SyncMLPluginLogging.h"
+
+StorageReservations::StorageReservations()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+StorageReservations::~StorageReservations()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+}
+
+bool StorageReservations::reserve( const QString& aBackend, const void* aOwner )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    QHash<QString, Reservation>::iterator reservation = iReservations.find( aBackend );
+
+    if( reservation == iReservations.end() ) {
+        Reservation newReservation;
+        newReservation.iOwner = aOwner;
+        newReservation.iCount = 1;
+        iReservations.insert( aBackend, newReservation );
+        return true;
+    }
+
+    if( reservation->iOwner != aOwner ) {
+        qCDebug(lcSyncMLPlugin) << "Backend" << aBackend << "already reserved";
+        return false;
+    }
+
+    ++reservation->iCount;
+    return true;
+}
+
+void StorageReservations::release( const QString& aBackend, const void* aOwner )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &iMutex );
+
+    QHash<QString, Reservation>::iterator reservation = iReservations.find( aBackend );
+
+    if( reservation == iReservations.end() || reservation->iOwner != aOwner ) {
+        qCWarning(lcSyncMLPlugin) << "Releasing backend" << aBackend << "that was not reserved";
+        return;
+    }
+
+    if( --reservation->iCount <= 0 ) {
+        iReservations.erase( reservation );
+    }
+}
+
+bool StorageReservations::isReserved( const QString& aBackend ) const
+{
+    QMutexLocker locker( &iMutex );
+
+    return iReservations.contains( aBackend );
+}
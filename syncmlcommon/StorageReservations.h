@@ -0,0 +1,84 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef STORAGERESERVATIONS_H
+#define STORAGERESERVATIONS_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+/*! \brief Storage backends reserved by the sessions of one plugin
+ *
+ * The sync framework reserves storage backends per plugin, so sessions that
+ * the same plugin runs at the same time are not kept from using the same
+ * backend. Storage providers of such sessions share an instance of this
+ * class to reserve backends from each other. A backend can be reserved
+ * several times by the same owner.
+ */
+class StorageReservations
+{
+public:
+
+    /*! \brief Constructor
+     *
+     */
+    StorageReservations();
+
+    /*! \brief Destructor
+     *
+     */
+    virtual ~StorageReservations();
+
+    /*! \brief Reserves a backend
+     *
+     * @param aBackend Name of the backend
+     * @param aOwner Owner of the reservation
+     * @return True on success, false if reserved by another owner
+     */
+    bool reserve( const QString& aBackend, const void* aOwner );
+
+    /*! \brief Releases a reservation made with reserve()
+     *
+     * @param aBackend Name of the backend
+     * @param aOwner Owner of the reservation
+     */
+    void release( const QString& aBackend, const void* aOwner );
+
+    /*! \brief Checks if a backend is reserved
+     *
+     * @param aBackend Name of the backend
+     * @return True if reserved by anyone, otherwise false
+     */
+    bool isReserved( const QString& aBackend ) const;
+
+private:
+
+    struct Reservation
+    {
+        const void* iOwner;
+        int         iCount;
+    };
+
+    mutable QMutex                  iMutex;
+    QHash<QString, Reservation>     iReservations;
+
+};
+
+#endif  //  STORAGERESERVATIONS_H
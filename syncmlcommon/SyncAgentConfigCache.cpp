@@ -0,0 +1,148 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "SyncAgentConfigCache.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QScopedPointer>
+#include <buteosyncml5/DeviceInfo.h>
+
+#include "SyncMLConfig.h"
+#include "DeviceInfo.h"
+#include "SyncMLPluginLogging.h"
+
+namespace {
+
+typedef QPair<QDateTime, qint64> FileStamp;
+
+QMutex                                          configMutex;
+QScopedPointer<DataSync::SyncAgentConfig>       parsedConfig;
+QList<FileStamp>                                parsedStamps;
+int                                             parsedGeneration = 0;
+
+FileStamp fileStamp( const QString& aPath )
+{
+    QFileInfo info( aPath );
+
+    if( !info.exists() ) {
+        return FileStamp( QDateTime(), -1 );
+    }
+
+    return FileStamp( info.lastModified(), info.size() );
+}
+
+QList<FileStamp> configStamps()
+{
+    QString defaultConfigFile, extConfigFile;
+    SyncMLConfig::syncmlConfigFilePaths( defaultConfigFile, extConfigFile );
+
+    QList<FileStamp> stamps;
+    stamps << fileStamp( defaultConfigFile ) << fileStamp( extConfigFile )
+           << fileStamp( SyncMLConfig::getDevInfoFile() );
+
+    return stamps;
+}
+
+}
+
+DataSync::SyncAgentConfig* SyncAgentConfigCache::createConfig( int* aGeneration )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QString defaultConfigFile, extConfigFile;
+    SyncMLConfig::syncmlConfigFilePaths( defaultConfigFile, extConfigFile );
+    QString devInfoFile = SyncMLConfig::getDevInfoFile();
+
+    QMutexLocker locker( &configMutex );
+
+    if( !QFile::exists( devInfoFile ) ) {
+        qCDebug(lcSyncMLPlugin) << "Generating device info file" << devInfoFile;
+        Buteo::DeviceInfo devInfo;
+        QMap<QString, QString> deviceInfoMap = devInfo.getDeviceInformation();
+        devInfo.saveDevInfoToFile( deviceInfoMap, devInfoFile );
+    }
+
+    QList<FileStamp> stamps = configStamps();
+
+    if( !parsedConfig || stamps != parsedStamps ) {
+
+        qCDebug(lcSyncMLPlugin) << "Parsing SyncML configuration";
+
+        QScopedPointer<DataSync::SyncAgentConfig> config( new DataSync::SyncAgentConfig() );
+
+        // Default configuration file should always exist, the external one
+        // can add to it or replace parts of it
+        if( !config->fromFile( defaultConfigFile ) ) {
+            qCCritical(lcSyncMLPlugin) << "Could not read default SyncML configuration file:" << defaultConfigFile;
+            parsedConfig.reset();
+            parsedStamps.clear();
+            return NULL;
+        }
+
+        if( config->fromFile( extConfigFile ) ) {
+            qCDebug(lcSyncMLPlugin) << "Found & read external configuration file:" << extConfigFile;
+        }
+        else {
+            qCDebug(lcSyncMLPlugin) << "Could not find external configuration file" << extConfigFile << ", skipping";
+        }
+
+        DataSync::DeviceInfo syncDeviceInfo;
+        syncDeviceInfo.readFromFile( devInfoFile );
+        config->setDeviceInfo( syncDeviceInfo );
+
+        parsedConfig.reset( config.take() );
+        parsedStamps = stamps;
+        ++parsedGeneration;
+    }
+    else {
+        qCDebug(lcSyncMLPlugin) << "Using parsed SyncML configuration";
+    }
+
+    if( aGeneration ) {
+        *aGeneration = parsedGeneration;
+    }
+
+    return new DataSync::SyncAgentConfig( *parsedConfig );
+}
+
+bool SyncAgentConfigCache::isCurrent( int aGeneration )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QList<FileStamp> stamps = configStamps();
+
+    QMutexLocker locker( &configMutex );
+
+    return parsedConfig && aGeneration == parsedGeneration && stamps == parsedStamps;
+}
+
+void SyncAgentConfigCache::clear()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QMutexLocker locker( &configMutex );
+
+    parsedConfig.reset();
+    parsedStamps.clear();
+}
@@ -0,0 +1,64 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#ifndef SYNCAGENTCONFIGCACHE_H
+#define SYNCAGENTCONFIGCACHE_H
+
+#include <buteosyncml5/SyncAgentConfig.h>
+
+/*! \brief Process-wide cache of the parsed SyncML agent configuration
+ *
+ * Reading the agent configuration means parsing the default and ext SyncML
+ * config files and the device info file, and generating the latter if it
+ * does not exist yet. The client and server plugins get their configuration
+ * from here instead: the files are parsed once per process and again only
+ * when one of them is modified, created or removed.
+ */
+class SyncAgentConfigCache
+{
+public:
+
+    /*! \brief Returns a new agent configuration with the device info set
+     *
+     * The configuration is a copy, the caller can set the session specific
+     * parts like transport, storage provider and sync targets.
+     *
+     * @param aGeneration If not NULL, set to the generation of the parsed
+     *        configuration the copy was made from
+     * @return Configuration owned by the caller, NULL if the default config
+     *         file could not be read
+     */
+    static DataSync::SyncAgentConfig* createConfig( int* aGeneration = NULL );
+
+    /*! \brief Checks if a configuration created earlier is still up to date
+     *
+     * @param aGeneration Generation returned by createConfig()
+     * @return True if the configuration files have not been modified,
+     *         created or removed since, otherwise false
+     */
+    static bool isCurrent( int aGeneration );
+
+    /*! \brief Drops the parsed configuration
+     *
+     */
+    static void clear();
+
+};
+
+#endif  //  SYNCAGENTCONFIGCACHE_H
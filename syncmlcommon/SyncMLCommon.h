@@ -46,6 +46,10 @@ const QString STORAGE_SYNCML_CTCAPS_PROP_12             = "CTCaps_SyncML12";
 // Extensions supported by plugin
 const QString STORAGE_SYNCML_EXTENSIONS             = "Extensions";
 
+// Largest item in bytes the plugin can store, advertised to the remote party.
+// Not set if there is no limit
+const QString STORAGE_MAX_OBJ_SIZE_PROP                 = "Max Object Size";
+
 // Properties found from server/client plug-ins that can be used to configure storage
 // adapter
 
@@ -65,6 +69,33 @@ const QString STORAGE_SYNC_TARGET_BLUETOOTH             = "bluetooth";
 // ID of the origin data source to associate with a storage session
 const QString STORAGE_ORIGIN_ID                         = "Origin ID";
 
+// Identifies the sync session a storage is used in. Storages of different
+// sessions do not share backend state that is committed as a whole
+const QString STORAGE_SYNC_SESSION_PROP                 = "Sync Session";
+
+// Maximum size of the persistent payload cache in bytes, 0 to disable it
+const QString STORAGE_PAYLOAD_CACHE_SIZE                = "Payload Cache Size";
+
+// Direction of the sync session, if known when the storage is initialized
+const QString STORAGE_SYNC_DIRECTION_PROP               = "Sync Direction";
+
+// Values of STORAGE_SYNC_DIRECTION_PROP
+const QString STORAGE_SYNC_DIRECTION_TWO_WAY            = "two-way";
+const QString STORAGE_SYNC_DIRECTION_FROM_REMOTE        = "from-remote";
+const QString STORAGE_SYNC_DIRECTION_TO_REMOTE          = "to-remote";
+
+// Set to PROPS_TRUE when the sync session is a slow sync
+const QString STORAGE_SLOW_SYNC_PROP                    = "Slow Sync";
+
+// Set to PROPS_TRUE when all local items of a storage session are replaced
+// with the items of the remote side (refresh from remote)
+const QString STORAGE_REFRESH_PROP                      = "Refresh";
+
+// CTCaps file of the remote device, relative to SyncMLConfig::getXmlDataPath()
+// unless absolute. Properties the remote device does not support are left out
+// of the items sent to it
+const QString STORAGE_REMOTE_CTCAPS_PROP                = "Remote CTCaps";
+
 
 // Profile properties
 
@@ -73,6 +104,7 @@ const QString PROF_SYNC_PROTOCOL      = "Sync Protocol";
 
 const QString HTTP_TRANSPORT          = "HTTP";
 const QString OBEX_TRANSPORT          = "OBEX";
+const QString OBEX_TCP_TRANSPORT      = "OBEX-TCP";
 
 const QString PROF_HTTP_PROXY_HOST    = "http_proxy_host";
 const QString PROF_HTTP_PROXY_PORT    = "http_proxy_port";
@@ -81,6 +113,27 @@ const QString PROF_BT_ADDRESS         = "bt_address";
 const QString PROF_REMOTE_ADDRESS     = "remote_id";
 const QString PROF_BT_UUID            = "bt_uuid";
 
+// Host and port of OBEX over TCP. The server listens on the port only if
+// it is set, on the address if that is set and on loopback otherwise
+const QString PROF_TCP_ADDRESS        = "tcp_address";
+const QString PROF_TCP_PORT           = "tcp_port";
+
+// Comma separated numeric addresses of the peers the server accepts OBEX
+// over TCP from. Required when listening on a non-loopback address, as
+// peers are not authenticated otherwise
+const QString PROF_TCP_ALLOWED_PEERS  = "tcp_allowed_peers";
+
+// OBEX packet size in bytes over each transport. The defaults are the
+// smallest sizes that reached full throughput over a pty pair; RFCOMM is
+// given larger packets to make fewer round trips over its slower link
+const QString PROF_USB_OBEX_MTU       = "usb_obex_mtu";
+const QString PROF_BT_OBEX_MTU        = "bt_obex_mtu";
+const QString PROF_TCP_OBEX_MTU       = "tcp_obex_mtu";
+
+const int DEFAULT_USB_OBEX_MTU        = 16384;
+const int DEFAULT_BT_OBEX_MTU         = 32767;
+const int DEFAULT_TCP_OBEX_MTU        = 65535;
+
 const QString PROF_REMOTE_URI         = "Remote database";
 const QString PROF_USE_WBXML          = "use_wbxml";
 
@@ -92,6 +145,14 @@ const QString SYNCML12                = "SyncML12";
 
 const QString PROF_HTTP_XHEADERS      = "http_xheaders";
 
+// Seconds storages are kept initialized after a session for the next one to
+// reuse, 0 to release them right away
+const QString PROF_STORAGE_POOL_IDLE_TIME = "Storage Pool Idle Time";
+
+// Set to PROPS_FALSE to always use the configured message size instead of one
+// sized to the measured round trip time and throughput of the link
+const QString PROF_ADAPTIVE_MESSAGE_SIZE = "Adaptive Message Size";
+
 
 Q_DECLARE_LOGGING_CATEGORY(lcSyncMLPlugin)
 
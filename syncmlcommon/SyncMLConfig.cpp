@@ -24,6 +24,11 @@
 #include "SyncMLConfig.h"
 
 #include <QDir>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 
 #include "SyncMLPluginLogging.h"
 #include "SyncCommonDefs.h"
@@ -32,6 +37,22 @@ const QString XMLDIR( "/etc/buteo/xml/");
 const QString DBDIR( "/sync-app/" );
 const QString DEVINFO_FILE_NAME("devInfo.xml");
 
+namespace {
+
+struct CachedFile
+{
+    QDateTime   iModified;
+    qint64      iSize;
+    QByteArray  iData;
+};
+
+// Shared by the plugins of the process, which may run in different threads
+QMutex                      cacheMutex;
+QHash<QString, CachedFile>  cachedFiles;
+QString                     createdDatabasePath;
+
+}
+
 SyncMLConfig::SyncMLConfig()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
@@ -49,8 +70,13 @@ QString SyncMLConfig::getDatabasePath()
 
     QString path = Sync::syncConfigDir() + DBDIR;
 
-    QDir dir( path );
-    dir.mkpath( path );
+    QMutexLocker locker( &cacheMutex );
+
+    if( path != createdDatabasePath ) {
+        QDir dir( path );
+        dir.mkpath( path );
+        createdDatabasePath = path;
+    }
 
     return path;
 
@@ -74,3 +100,66 @@ SyncMLConfig::syncmlConfigFilePaths (QString& aDefaultConfigFile, QString& aExtC
     aDefaultConfigFile = "/etc/buteo/meego-syncml-conf.xml";
     aExtConfigFile = "/etc/buteo/ext-syncml-conf.xml";
 }
+
+QByteArray SyncMLConfig::getCTCaps( const QString& aFilename )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    return getFileContents( getXmlDataPath() + aFilename );
+}
+
+int SyncMLConfig::getObexMtu( const QString& aValue, int aDefault )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    // OBEX packets are at least 255 bytes and their length is 16 bits
+    const int minMtu = 255;
+    const int maxMtu = 65535;
+
+    bool ok = false;
+    int mtu = aValue.toInt( &ok );
+
+    if( !ok || mtu <= 0 ) {
+        if( !aValue.isEmpty() ) {
+            qCWarning(lcSyncMLPlugin) << "Invalid OBEX MTU" << aValue << ", using" << aDefault;
+        }
+        mtu = aDefault;
+    }
+
+    return qBound( minMtu, mtu, maxMtu );
+}
+
+QByteArray SyncMLConfig::getFileContents( const QString& aPath )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    QFileInfo info( aPath );
+
+    QMutexLocker locker( &cacheMutex );
+
+    if( !info.exists() ) {
+        cachedFiles.remove( aPath );
+        return QByteArray();
+    }
+
+    QHash<QString, CachedFile>::const_iterator cached = cachedFiles.constFind( aPath );
+    if( cached != cachedFiles.constEnd() &&
+        cached->iModified == info.lastModified() && cached->iSize == info.size() ) {
+        return cached->iData;
+    }
+
+    QFile file( aPath );
+    if( !file.open( QIODevice::ReadOnly ) ) {
+        qCWarning(lcSyncMLPlugin) << "Could not read file" << aPath;
+        cachedFiles.remove( aPath );
+        return QByteArray();
+    }
+
+    CachedFile entry;
+    entry.iModified = info.lastModified();
+    entry.iSize = info.size();
+    entry.iData = file.readAll();
+    cachedFiles.insert( aPath, entry );
+
+    return entry.iData;
+}
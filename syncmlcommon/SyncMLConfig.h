@@ -25,6 +25,7 @@
 #define SYNCMLCONFIG_H
 
 #include <QString>
+#include <QByteArray>
 
 /*! \brief Common configuration class for SyncML related things
  *
@@ -46,6 +47,7 @@ public:
     /*! \brief Returns path that should be used for storing
      *         databases
      *
+     * The directory is created the first time the path is asked for.
      */
     static QString getDatabasePath();
 
@@ -67,6 +69,31 @@ public:
      */
     static void syncmlConfigFilePaths (QString& aDefaultConfigFile, QString& aExtConfigFile);
 
+    /*! \brief Returns the contents of a CTCaps file in the xml data path
+     *
+     * @param aFilename Name of the file
+     * @return Contents of the file, empty if it could not be read
+     */
+    static QByteArray getCTCaps( const QString& aFilename );
+
+    /*! \brief Returns the contents of a file
+     *
+     * The contents are kept in memory for the whole process and read again
+     * only if the modification time or size of the file changes.
+     *
+     * @param aPath Path of the file
+     * @return Contents of the file, empty if it could not be read
+     */
+    static QByteArray getFileContents( const QString& aPath );
+
+    /*! \brief Returns the OBEX packet size to use
+     *
+     * @param aValue Packet size set in a profile, may be empty
+     * @param aDefault Packet size to use if aValue is not set or valid
+     * @return Packet size within the limits of the OBEX protocol
+     */
+    static int getObexMtu( const QString& aValue, int aDefault );
+
 protected:
 
 private:
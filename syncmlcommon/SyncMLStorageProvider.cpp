@@ -34,18 +34,32 @@
 
 #include "SyncMLCommon.h"
 #include "StorageAdapter.h"
+#include "PoolableStorage.h"
+#include "StorageReservations.h"
+#include "SyncMLConfig.h"
 
 #include "SyncMLPluginLogging.h"
 
+// Bounds of message sizes derived from the link. Below the minimum the
+// protocol overhead dominates, above the maximum memory use does
+const qint64 MIN_LINK_MESSAGE_SIZE = 8 * 1024;
+const qint64 MAX_LINK_MESSAGE_SIZE = 256 * 1024;
+
 SyncMLStorageProvider::SyncMLStorageProvider()
- : iProfile( 0 ), iPlugin( 0 ), iCbInterface( 0 ), iRequestStorages( false )
+ : iProfile( 0 ), iPlugin( 0 ), iCbInterface( 0 ), iRequestStorages( false ),
+   iMaxMessageSize( 0 ), iSlowSync( false ), iPoolIdleTime( 0 ), iReservations( NULL )
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iPoolTimer.setSingleShot( true );
+    QObject::connect( &iPoolTimer, &QTimer::timeout, [this]() { expirePooledStorages(); } );
 }
 
 SyncMLStorageProvider::~SyncMLStorageProvider()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    releasePooledStorages();
 }
 
 bool SyncMLStorageProvider::init( Buteo::Profile* aProfile,
@@ -64,6 +78,11 @@ bool SyncMLStorageProvider::init( Buteo::Profile* aProfile,
     iPlugin = aPlugin;
     iCbInterface = aCbInterface;
     iRequestStorages = aRequestStorages;
+    iPoolIdleTime = iProfile->key( PROF_STORAGE_POOL_IDLE_TIME ).toLongLong() * 1000;
+
+    if( iPoolIdleTime <= 0 ) {
+        releasePooledStorages();
+    }
 
     return true;
 }
@@ -72,6 +91,8 @@ bool SyncMLStorageProvider::uninit()
 {
     FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
 
+    iLinkEstimator.uninit();
+
     return true;
 }
 
@@ -168,25 +189,17 @@ void SyncMLStorageProvider::releaseStorage( DataSync::StoragePlugin* aStorage )
 
     StorageAdapter* adapter = static_cast<StorageAdapter*>( aStorage );
 
-    if( !adapter->uninit() ) {
-        qCWarning(lcSyncMLPlugin) << "Storage adapter uninitialization failed";
-    }
-
-    Buteo::StoragePlugin* storage = adapter->getPlugin();
+    QString backend = adapter->getPlugin()->getProperty( Buteo::KEY_BACKEND );
 
-    QString backend = storage->getProperty( Buteo::KEY_BACKEND );
-
-    if( !storage->uninit() ) {
-        qCWarning(lcSyncMLPlugin) << "Storage uninitialization failed";
+    if( !poolStorage( adapter, iStorageKeys.take( aStorage ) ) ) {
+        destroyStorage( adapter );
     }
 
-    iCbInterface->destroyStorage( storage );
-
     if( iRequestStorages ) {
         iCbInterface->releaseStorage( backend, iPlugin );
     }
 
-    delete aStorage;
+    releaseReservation( backend );
 
 }
 
@@ -213,16 +226,15 @@ DataSync::StoragePlugin* SyncMLStorageProvider::acquireStorage( const Buteo::Pro
         qCDebug(lcSyncMLPlugin) << "uuid and remote name created on the fly" << uuid << remoteName;
     }
 
-    if( iRequestStorages && !iCbInterface->requestStorage( backend, iPlugin ) ) {
-        qCCritical(lcSyncMLPlugin) << "Could not reserve storage backend:" << backend;
+    // Sessions running at the same time in this process must not use the
+    // same backend
+    if( iReservations && !iReservations->reserve( backend, this ) ) {
+        qCWarning(lcSyncMLPlugin) << "Storage backend" << backend << "is in use by another session";
+        return NULL;
     }
 
-    Buteo::StoragePlugin* storage = iCbInterface->createStorage( pluginName );
-
-    if( !storage ) {
-        iCbInterface->releaseStorage( backend, iPlugin );
-        qCDebug(lcSyncMLPlugin) << "Could not create storage:" << pluginName;
-        return NULL;
+    if( iRequestStorages && !iCbInterface->requestStorage( backend, iPlugin ) ) {
+        qCCritical(lcSyncMLPlugin) << "Could not reserve storage backend:" << backend;
     }
 
     // Make sure that the backend name that was used in storage reservation is
@@ -245,6 +257,21 @@ DataSync::StoragePlugin* SyncMLStorageProvider::acquireStorage( const Buteo::Pro
         keys.insert(STORAGE_ORIGIN_ID, iProfile->key(Buteo::KEY_BT_ADDRESS));
     }
 
+    // Sessions of other providers may run at the same time
+    keys.insert(STORAGE_SYNC_SESSION_PROP, QString::number(reinterpret_cast<quintptr>(this), 16));
+
+    // Let the storage skip work the session has no use for, like looking
+    // for local changes that will not be sent
+    if (!iSyncDirection.isEmpty()) {
+        keys.insert(STORAGE_SYNC_DIRECTION_PROP, iSyncDirection);
+        keys.insert(STORAGE_SLOW_SYNC_PROP, iSlowSync ? PROPS_TRUE : PROPS_FALSE);
+
+        // Let the storage wipe its items in one go instead of one by one
+        if (iSlowSync && iSyncDirection == STORAGE_SYNC_DIRECTION_FROM_REMOTE) {
+            keys.insert(STORAGE_REFRESH_PROP, PROPS_TRUE);
+        }
+    }
+
     // If protocol version is not defined in the keys read from profile, try to
     // read the version from the session handler and insert a corresponding key,
     // so that storage plug-in knows which protocol version is in use.
@@ -260,10 +287,30 @@ DataSync::StoragePlugin* SyncMLStorageProvider::acquireStorage( const Buteo::Pro
         }
     }
 
+    // A storage kept from an earlier session with the same properties is
+    // already initialized
+    StorageAdapter* pooled = takePooledStorage( pluginName, keys );
+    if( pooled ) {
+        pooled->setMaxMessageSize( iMaxMessageSize );
+        pooled->setLinkEstimator( &iLinkEstimator );
+        iStorageKeys.insert( pooled, keys );
+        return pooled;
+    }
+
+    Buteo::StoragePlugin* storage = iCbInterface->createStorage( pluginName );
+
+    if( !storage ) {
+        iCbInterface->releaseStorage( backend, iPlugin );
+        releaseReservation( backend );
+        qCDebug(lcSyncMLPlugin) << "Could not create storage:" << pluginName;
+        return NULL;
+    }
+
     if( !storage->init( keys ) ) {
         qCDebug(lcSyncMLPlugin) << "Could not initialize storage:" << pluginName;
         iCbInterface->destroyStorage( storage );
         iCbInterface->releaseStorage( backend, iPlugin );
+        releaseReservation( backend );
         return NULL;
     }
 
@@ -274,13 +321,143 @@ DataSync::StoragePlugin* SyncMLStorageProvider::acquireStorage( const Buteo::Pro
         qCDebug(lcSyncMLPlugin) << "Initialization of adapter for storage" << pluginName << "FAILED";
         iCbInterface->destroyStorage( storage );
         iCbInterface->releaseStorage( backend, iPlugin );
+        releaseReservation( backend );
         delete adapter;
         return NULL;
     }
 
+    adapter->setMaxMessageSize( iMaxMessageSize );
+    adapter->setLinkEstimator( &iLinkEstimator );
+    iStorageKeys.insert( adapter, keys );
+
     return adapter;
 }
 
+StorageAdapter* SyncMLStorageProvider::takePooledStorage( const QString& aPluginName,
+                                                          const QMap<QString, QString>& aKeys )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    for( int i = 0; i < iPool.count(); ++i ) {
+        if( iPool[i].iAdapter->getPlugin()->getPluginName() != aPluginName ) {
+            continue;
+        }
+
+        PooledStorage entry = iPool.takeAt( i );
+
+        PoolableStorage* poolable = dynamic_cast<PoolableStorage*>( entry.iAdapter->getPlugin() );
+        if( entry.iKeys == aKeys && poolable && poolable->resume() ) {
+            qCDebug(lcSyncMLPlugin) << "Reusing storage" << aPluginName << "idle for"
+                                    << entry.iIdleTime.elapsed() << "ms";
+            return entry.iAdapter;
+        }
+
+        qCDebug(lcSyncMLPlugin) << "Kept storage" << aPluginName << "cannot be reused, initializing again";
+        destroyStorage( entry.iAdapter );
+        break;
+    }
+
+    return NULL;
+}
+
+bool SyncMLStorageProvider::poolStorage( StorageAdapter* aAdapter, const QMap<QString, QString>& aKeys )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    PoolableStorage* poolable = dynamic_cast<PoolableStorage*>( aAdapter->getPlugin() );
+
+    if( iPoolIdleTime <= 0 || !poolable || aKeys.isEmpty() ) {
+        return false;
+    }
+
+    if( !poolable->suspend() || !aAdapter->suspend() ) {
+        qCWarning(lcSyncMLPlugin) << "Could not suspend storage" << aAdapter->getPlugin()->getPluginName();
+        return false;
+    }
+
+    // One storage per plugin is kept, the most recently used one
+    QString pluginName = aAdapter->getPlugin()->getPluginName();
+    for( int i = 0; i < iPool.count(); ++i ) {
+        if( iPool[i].iAdapter->getPlugin()->getPluginName() == pluginName ) {
+            destroyStorage( iPool.takeAt( i ).iAdapter );
+            break;
+        }
+    }
+
+    PooledStorage entry;
+    entry.iAdapter = aAdapter;
+    entry.iKeys = aKeys;
+    entry.iIdleTime.start();
+    iPool.append( entry );
+
+    qCDebug(lcSyncMLPlugin) << "Keeping storage" << pluginName << "for" << iPoolIdleTime << "ms";
+
+    if( !iPoolTimer.isActive() ) {
+        iPoolTimer.start( iPoolIdleTime );
+    }
+
+    return true;
+}
+
+void SyncMLStorageProvider::destroyStorage( StorageAdapter* aAdapter )
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    if( !aAdapter->uninit() ) {
+        qCWarning(lcSyncMLPlugin) << "Storage adapter uninitialization failed";
+    }
+
+    Buteo::StoragePlugin* storage = aAdapter->getPlugin();
+
+    if( !storage->uninit() ) {
+        qCWarning(lcSyncMLPlugin) << "Storage uninitialization failed";
+    }
+
+    iCbInterface->destroyStorage( storage );
+
+    delete aAdapter;
+}
+
+void SyncMLStorageProvider::expirePooledStorages()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    qint64 nextExpiry = -1;
+
+    for( int i = iPool.count() - 1; i >= 0; --i ) {
+        qint64 remaining = iPoolIdleTime - iPool[i].iIdleTime.elapsed();
+        if( remaining <= 0 ) {
+            qCDebug(lcSyncMLPlugin) << "Releasing idle storage" << iPool[i].iAdapter->getPlugin()->getPluginName();
+            destroyStorage( iPool.takeAt( i ).iAdapter );
+        }
+        else if( nextExpiry < 0 || remaining < nextExpiry ) {
+            nextExpiry = remaining;
+        }
+    }
+
+    if( nextExpiry >= 0 ) {
+        iPoolTimer.start( nextExpiry );
+    }
+}
+
+void SyncMLStorageProvider::releaseReservation( const QString& aBackend )
+{
+    if( iReservations ) {
+        iReservations->release( aBackend, this );
+    }
+}
+
+void SyncMLStorageProvider::releasePooledStorages()
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iPoolTimer.stop();
+
+    while( !iPool.isEmpty() ) {
+        destroyStorage( iPool.takeLast().iAdapter );
+    }
+}
+
 void SyncMLStorageProvider::setRemoteName(const QString& aRemoteName)
 {
     iRemoteName = aRemoteName;
@@ -290,3 +467,38 @@ void SyncMLStorageProvider::setUUID(const QString& aUUID)
 {
     iUUID = aUUID;
 }
+
+void SyncMLStorageProvider::setMaxMessageSize(qint64 aMaxMessageSize)
+{
+    iMaxMessageSize = aMaxMessageSize;
+}
+
+qint64 SyncMLStorageProvider::setLink(const QString& aLinkId, qint64 aConfiguredSize)
+{
+    FUNCTION_CALL_TRACE(lcSyncMLPluginTrace);
+
+    iLinkEstimator.init( SyncMLConfig::getDatabasePath() + LINK_ESTIMATE_DB_FILE, aLinkId );
+
+    qint64 size = aConfiguredSize;
+
+    if( !iProfile || iProfile->key( PROF_ADAPTIVE_MESSAGE_SIZE ) != PROPS_FALSE ) {
+        size = iLinkEstimator.messageSize( aConfiguredSize, MIN_LINK_MESSAGE_SIZE, MAX_LINK_MESSAGE_SIZE );
+    }
+
+    qCDebug(lcSyncMLPlugin) << "Message size for link" << aLinkId << ":" << size;
+
+    setMaxMessageSize( size );
+
+    return size;
+}
+
+void SyncMLStorageProvider::setSyncMode(const QString& aDirection, bool aSlowSync)
+{
+    iSyncDirection = aDirection;
+    iSlowSync = aSlowSync;
+}
+
+void SyncMLStorageProvider::setReservations( StorageReservations* aReservations )
+{
+    iReservations = aReservations;
+}
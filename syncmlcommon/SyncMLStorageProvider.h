@@ -24,8 +24,16 @@
 #ifndef SYNCMLSTORAGEPROVIDER_H
 #define SYNCMLSTORAGEPROVIDER_H
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QTimer>
+
 #include <buteosyncml5/StorageProvider.h>
 
+#include "LinkEstimator.h"
+
 namespace Buteo {
     class Profile;
     class SyncPluginBase;
@@ -33,12 +41,21 @@ namespace Buteo {
     class SyncMLStorageProviderTest;
 }
 
+class StorageAdapter;
+class StorageReservations;
+
 /*! \brief Module that provides storages to libmeegosyncml in syncml
  *         client/server plugins
  *
  * This storage provider presumes that all DataSync::StoragePlugin instances
  * passed as parameters to function of this storage provider are originally
  * from this storage provider
+ *
+ * If the profile sets PROF_STORAGE_POOL_IDLE_TIME, released storages that
+ * implement PoolableStorage are kept initialized for that long, and handed to
+ * the next session that acquires them with the same properties. This only
+ * pays off for a provider that outlives its sessions, like the one of the
+ * SyncML server.
  */
 class SyncMLStorageProvider : public DataSync::StorageProvider
 {
@@ -106,18 +123,89 @@ public:
      */
     void setUUID(const QString& aRemoteUUID);
 
+    /*! \brief set the SyncML message size budget passed to acquired storages
+     *
+     * @param aMaxMessageSize maximum message size in bytes, 0 if not known
+     */
+    void setMaxMessageSize(qint64 aMaxMessageSize);
+
+    /*! \brief set the link the session runs over and size messages for it
+     *
+     * Starts measuring the link, and sets the message size budget from
+     * what earlier sessions measured over the same link. The measured
+     * estimate is stored when the provider is uninitialized.
+     *
+     * @param aLinkId identifier of the link, for example the transport and
+     *                address of the remote party
+     * @param aConfiguredSize message size in bytes from the configuration,
+     *                        used if the link has not been measured
+     * @return message size in bytes to use for the session
+     */
+    qint64 setLink(const QString& aLinkId, qint64 aConfiguredSize);
+
+    /*! \brief set the sync direction and mode passed to acquired storages
+     *
+     * A slow sync from remote is passed on as a refresh, in which storages
+     * replace all local items with the items of the remote party.
+     *
+     * @param aDirection one of the STORAGE_SYNC_DIRECTION_* values, empty if not known
+     * @param aSlowSync true for a slow sync, otherwise false
+     */
+    void setSyncMode(const QString& aDirection, bool aSlowSync);
+
+    /*! \brief set the reservations shared with the providers of other
+     *         sessions running at the same time
+     *
+     * A storage whose backend is reserved by another provider is not
+     * acquired.
+     *
+     * @param aReservations reservations, NULL if not shared
+     */
+    void setReservations(StorageReservations* aReservations);
+
+    /*! \brief Uninitializes and destroys the storages kept for later sessions
+     *
+     */
+    void releasePooledStorages();
+
 private:
 
+    struct PooledStorage
+    {
+        StorageAdapter*         iAdapter;
+        QMap<QString, QString>  iKeys;
+        QElapsedTimer           iIdleTime;
+    };
+
     QString getPreferredURINames( const QString &aURI );
 
     DataSync::StoragePlugin* acquireStorage( const Buteo::Profile* aProfile );
 
+    StorageAdapter* takePooledStorage( const QString& aPluginName, const QMap<QString, QString>& aKeys );
+
+    bool poolStorage( StorageAdapter* aAdapter, const QMap<QString, QString>& aKeys );
+
+    void destroyStorage( StorageAdapter* aAdapter );
+
+    void expirePooledStorages();
+
+    void releaseReservation( const QString& aBackend );
+
     Buteo::Profile*            iProfile;
     Buteo::SyncPluginBase*     iPlugin;
     Buteo::PluginCbInterface*  iCbInterface;
     bool                       iRequestStorages;
     QString                    iRemoteName;
     QString                    iUUID;
+    qint64                     iMaxMessageSize;
+    QString                    iSyncDirection;
+    bool                       iSlowSync;
+    qint64                     iPoolIdleTime;
+    QList<PooledStorage>       iPool;
+    QHash<DataSync::StoragePlugin*, QMap<QString, QString> > iStorageKeys;
+    QTimer                     iPoolTimer;
+    StorageReservations*       iReservations;
+    LinkEstimator              iLinkEstimator;
 
     friend class Buteo::SyncMLStorageProviderTest;
 
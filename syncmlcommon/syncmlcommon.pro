@@ -4,7 +4,7 @@ DEPENDPATH += .
 CONFIG += link_pkgconfig create_pc create_prl
 
 TARGET = syncmlcommon5
-PKGCONFIG = buteosyncfw5 buteosyncml5 systemsettings
+PKGCONFIG = buteosyncfw5 buteosyncml5 systemsettings KF5CalendarCore libmkcal-qt5
 
 QT += sql xml
 QT -= gui
@@ -15,9 +15,20 @@ VER_PAT = 0
 
 #input
 HEADERS += ItemAdapter.h \
+           Base64Codec.h \
+           CTCapsTable.h \
+           CalendarSession.h \
+           ContentKey.h \
+           FingerprintStore.h \
+           LinkEstimator.h \
+           IncidenceIdQuery.h \
            ItemIdMapper.h \
+           PayloadCache.h \
+           PoolableStorage.h \
            SimpleItem.h \
            StorageAdapter.h \
+           StorageReservations.h \
+           SyncAgentConfigCache.h \
            SyncMLCommon.h \
            SyncMLConfig.h \
            SyncMLPluginLogging.h \
@@ -26,9 +37,20 @@ HEADERS += ItemAdapter.h \
            DeviceInfo.h
 
 SOURCES += ItemAdapter.cpp \
+           Base64Codec.cpp \
+           CTCapsTable.cpp \
+           CalendarSession.cpp \
+           ContentKey.cpp \
+           FingerprintStore.cpp \
+           LinkEstimator.cpp \
+           IncidenceIdQuery.cpp \
            ItemIdMapper.cpp \
+           PayloadCache.cpp \
+           PoolableStorage.cpp \
            SimpleItem.cpp \
            StorageAdapter.cpp \
+           StorageReservations.cpp \
+           SyncAgentConfigCache.cpp \
            SyncMLConfig.cpp \
            SyncMLPluginLogging.cpp \
            SyncMLStorageProvider.cpp \
@@ -48,9 +70,20 @@ QMAKE_CLEAN += $(OBJECTS_DIR)/*.gcda $(OBJECTS_DIR)/*.gcno $(OBJECTS_DIR)/*.gcov
 target.path = $$[QT_INSTALL_LIBS]/
 headers.path = /usr/include/syncmlcommon/
 headers.files = ItemAdapter.h \
+           Base64Codec.h \
+           CTCapsTable.h \
+           CalendarSession.h \
+           ContentKey.h \
+           FingerprintStore.h \
+           LinkEstimator.h \
+           IncidenceIdQuery.h \
            ItemIdMapper.h \
+           PayloadCache.h \
+           PoolableStorage.h \
            SimpleItem.h \
            StorageAdapter.h \
+           StorageReservations.h \
+           SyncAgentConfigCache.h \
            SyncMLCommon.h \
            SyncMLConfig.h \
            SyncMLStorageProvider.h \
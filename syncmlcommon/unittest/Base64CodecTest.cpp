@@ -0,0 +1,218 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "Base64CodecTest.h"
+
+Q_DECLARE_METATYPE( Base64Codec::Implementation )
+
+// Size of the data in the benchmarks, about the size of a camera photo
+const int BENCHMARK_SIZE = 4 * 1024 * 1024;
+const int BENCHMARK_ROUNDS = 20;
+
+void Base64CodecTest::addImplementations()
+{
+    QTest::addColumn<Base64Codec::Implementation>( "implementation" );
+
+    foreach( Base64Codec::Implementation implementation, Base64Codec::implementations() ) {
+        QTest::newRow( Base64Codec::name( implementation ).toLatin1().constData() ) << implementation;
+    }
+}
+
+void Base64CodecTest::testVectors_data()
+{
+    addImplementations();
+}
+
+void Base64CodecTest::testVectors()
+{
+    QFETCH( Base64Codec::Implementation, implementation );
+
+    // RFC 4648, section 10
+    const char* vectors[][2] = {
+        { "", "" },
+        { "f", "Zg==" },
+        { "fo", "Zm8=" },
+        { "foo", "Zm9v" },
+        { "foob", "Zm9vYg==" },
+        { "fooba", "Zm9vYmE=" },
+        { "foobar", "Zm9vYmFy" }
+    };
+
+    for( unsigned i = 0; i < sizeof( vectors ) / sizeof( vectors[0] ); ++i ) {
+        QByteArray decoded;
+        QCOMPARE( Base64Codec::encode( vectors[i][0], implementation ), QByteArray( vectors[i][1] ) );
+        QVERIFY( Base64Codec::decode( vectors[i][1], decoded, implementation ) );
+        QCOMPARE( decoded, QByteArray( vectors[i][0] ) );
+    }
+}
+
+void Base64CodecTest::testRoundTrip_data()
+{
+    addImplementations();
+}
+
+void Base64CodecTest::testRoundTrip()
+{
+    QFETCH( Base64Codec::Implementation, implementation );
+
+    // Every length around the block sizes of the vector implementations
+    qsrand( 1 );
+    for( int length = 0; length < 300; ++length ) {
+        QByteArray data( length, Qt::Uninitialized );
+        for( int i = 0; i < length; ++i ) {
+            data[i] = static_cast<char>( qrand() );
+        }
+
+        QByteArray encoded = Base64Codec::encode( data, implementation );
+        QCOMPARE( encoded, data.toBase64() );
+
+        QByteArray decoded;
+        QVERIFY( Base64Codec::decode( encoded, decoded, implementation ) );
+        QCOMPARE( decoded, data );
+
+        // Padding is optional
+        while( encoded.endsWith( '=' ) ) {
+            encoded.chop( 1 );
+        }
+        QVERIFY( Base64Codec::decode( encoded, decoded, implementation ) );
+        QCOMPARE( decoded, data );
+    }
+}
+
+void Base64CodecTest::testDecodeFolded_data()
+{
+    addImplementations();
+}
+
+void Base64CodecTest::testDecodeFolded()
+{
+    QFETCH( Base64Codec::Implementation, implementation );
+
+    QByteArray data( 1000, Qt::Uninitialized );
+    for( int i = 0; i < data.size(); ++i ) {
+        data[i] = static_cast<char>( i * 7 );
+    }
+
+    // Folded as in vCard 2.1 and 3.0
+    QByteArray encoded = data.toBase64();
+    QByteArray folded;
+    for( int i = 0; i < encoded.size(); i += 76 ) {
+        folded += encoded.mid( i, 76 ) + "\r\n ";
+    }
+    folded += "\r\n";
+
+    QByteArray decoded;
+    QVERIFY( Base64Codec::decode( folded, decoded, implementation ) );
+    QCOMPARE( decoded, data );
+
+    // Folded at odd positions
+    folded = encoded;
+    for( int i = folded.size() - 5; i > 0; i -= 37 ) {
+        folded.insert( i, "\n\t" );
+    }
+    QVERIFY( Base64Codec::decode( folded, decoded, implementation ) );
+    QCOMPARE( decoded, data );
+}
+
+void Base64CodecTest::testDecodeInvalid_data()
+{
+    addImplementations();
+}
+
+void Base64CodecTest::testDecodeInvalid()
+{
+    QFETCH( Base64Codec::Implementation, implementation );
+
+    QByteArray valid = QByteArray( 200, 'x' ).toBase64();
+    QByteArray decoded;
+
+    QByteArray invalid = valid;
+    invalid[100] = '*';
+    QVERIFY( !Base64Codec::decode( invalid, decoded, implementation ) );
+    QVERIFY( decoded.isEmpty() );
+
+    invalid = valid;
+    invalid[50] = '\xc3';
+    QVERIFY( !Base64Codec::decode( invalid, decoded, implementation ) );
+
+    // Data after padding
+    QVERIFY( !Base64Codec::decode( "Zg==Zg==", decoded, implementation ) );
+
+    // Too much padding
+    QVERIFY( !Base64Codec::decode( "Zm8==", decoded, implementation ) );
+
+    // A single sextet does not make a byte
+    QVERIFY( !Base64Codec::decode( "Zm9vY", decoded, implementation ) );
+}
+
+void Base64CodecTest::benchmarkEncode_data()
+{
+    addImplementations();
+}
+
+void Base64CodecTest::benchmarkEncode()
+{
+    QFETCH( Base64Codec::Implementation, implementation );
+
+    QByteArray data( BENCHMARK_SIZE, Qt::Uninitialized );
+    for( int i = 0; i < data.size(); ++i ) {
+        data[i] = static_cast<char>( i * 31 );
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for( int i = 0; i < BENCHMARK_ROUNDS; ++i ) {
+        QCOMPARE( Base64Codec::encode( data, implementation ).size(), ( BENCHMARK_SIZE + 2 ) / 3 * 4 );
+    }
+    qint64 elapsed = qMax( timer.nsecsElapsed(), qint64( 1 ) );
+
+    qreal bytesPerSecond = qreal( BENCHMARK_SIZE ) * BENCHMARK_ROUNDS * 1000000000 / elapsed;
+    QTest::setBenchmarkResult( bytesPerSecond, QTest::BytesPerSecond );
+    qDebug() << Base64Codec::name( implementation ) << "encodes" << bytesPerSecond / ( 1024 * 1024 ) << "MB/s";
+}
+
+void Base64CodecTest::benchmarkDecode_data()
+{
+    addImplementations();
+}
+
+void Base64CodecTest::benchmarkDecode()
+{
+    QFETCH( Base64Codec::Implementation, implementation );
+
+    QByteArray data( BENCHMARK_SIZE, Qt::Uninitialized );
+    for( int i = 0; i < data.size(); ++i ) {
+        data[i] = static_cast<char>( i * 31 );
+    }
+    QByteArray encoded = data.toBase64();
+    QByteArray decoded;
+
+    QElapsedTimer timer;
+    timer.start();
+    for( int i = 0; i < BENCHMARK_ROUNDS; ++i ) {
+        QVERIFY( Base64Codec::decode( encoded, decoded, implementation ) );
+    }
+    qint64 elapsed = qMax( timer.nsecsElapsed(), qint64( 1 ) );
+
+    QCOMPARE( decoded, data );
+
+    qreal bytesPerSecond = qreal( encoded.size() ) * BENCHMARK_ROUNDS * 1000000000 / elapsed;
+    QTest::setBenchmarkResult( bytesPerSecond, QTest::BytesPerSecond );
+    qDebug() << Base64Codec::name( implementation ) << "decodes" << bytesPerSecond / ( 1024 * 1024 ) << "MB/s";
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#ifndef BASE64CODECTEST_H_
+#define BASE64CODECTEST_H_
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+#include "Base64Codec.h"
+
+class Base64CodecTest: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testVectors_data();
+    void testVectors();
+    void testRoundTrip_data();
+    void testRoundTrip();
+    void testDecodeFolded_data();
+    void testDecodeFolded();
+    void testDecodeInvalid_data();
+    void testDecodeInvalid();
+    void benchmarkEncode_data();
+    void benchmarkEncode();
+    void benchmarkDecode_data();
+    void benchmarkDecode();
+
+private:
+    void addImplementations();
+};
+#endif /*BASE64CODECTEST_H_*/
@@ -0,0 +1,285 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "CTCapsTableTest.h"
+
+// CTCaps as sent by a SyncML 1.1 feature phone, all types in one element
+const QByteArray CTCAPS11(
+    "<CTCap>"
+    "<CTType>text/x-vcard</CTType>"
+    "<PropName>BEGIN</PropName><ValEnum>VCARD</ValEnum>"
+    "<PropName>END</PropName><ValEnum>VCARD</ValEnum>"
+    "<PropName>VERSION</PropName><ValEnum>2.1</ValEnum>"
+    "<PropName>N</PropName>"
+    "<PropName>TEL</PropName>"
+    "<ParamName>HOME</ParamName><ParamName>WORK</ParamName><ParamName>CELL</ParamName>"
+    "<ParamName>FAX</ParamName><ParamName>VOICE</ParamName><ParamName>PREF</ParamName>"
+    "<PropName>EMAIL</PropName><ParamName>INTERNET</ParamName>"
+    "<PropName>ADR</PropName><ParamName>HOME</ParamName><ParamName>WORK</ParamName>"
+    "<PropName>URL</PropName>"
+    "<PropName>NOTE</PropName><Size>256</Size>"
+    "<CTType>text/x-vcalendar</CTType>"
+    "<PropName>BEGIN</PropName><ValEnum>VCALENDAR</ValEnum><ValEnum>VEVENT</ValEnum>"
+    "<PropName>END</PropName><ValEnum>VCALENDAR</ValEnum><ValEnum>VEVENT</ValEnum>"
+    "<PropName>VERSION</PropName><ValEnum>1.0</ValEnum>"
+    "<PropName>SUMMARY</PropName>"
+    "<PropName>DTSTART</PropName>"
+    "<PropName>DTEND</PropName>"
+    "<PropName>AALARM</PropName>"
+    "</CTCap>" );
+
+// CTCaps as sent by a SyncML 1.2 server, inside device info
+const QByteArray CTCAPS12(
+    "<DevInf xmlns='syncml:devinf'>"
+    "<DataStore>"
+    "<Rx-Pref><CTType>text/vcard</CTType><VerCT>3.0</VerCT></Rx-Pref>"
+    "<CTCap>"
+    "<CTType>text/x-vcard</CTType><VerCT>2.1</VerCT>"
+    "<Property><PropName>N</PropName><MaxSize>64</MaxSize></Property>"
+    "<Property><PropName>TEL</PropName><MaxSize>32</MaxSize>"
+    "<PropParam><ParamName>TYPE</ParamName><ValEnum>CELL</ValEnum><ValEnum>HOME</ValEnum></PropParam>"
+    "</Property>"
+    "<Property><PropName>PHOTO</PropName><MaxSize>16384</MaxSize>"
+    "<PropParam><ParamName>ENCODING</ParamName></PropParam>"
+    "</Property>"
+    "</CTCap>"
+    "<CTCap>"
+    "<CTType>text/vcard</CTType><VerCT>3.0</VerCT>"
+    "<Property><PropName>FN</PropName></Property>"
+    "</CTCap>"
+    "</DataStore>"
+    "</DevInf>" );
+
+const QByteArray VCARD(
+    "BEGIN:VCARD\r\n"
+    "VERSION:2.1\r\n"
+    "N:Doe;John;;;\r\n"
+    "FN:John Doe\r\n"
+    "item1.TEL;CELL:+358401234567\r\n"
+    "X-NICKNAME:Johnny\r\n"
+    "NOTE;ENCODING=QUOTED-PRINTABLE:first line=0D=0A=\r\n"
+    "second line\r\n"
+    "ORG;ENCODING=QUOTED-PRINTABLE:Acme=\r\n"
+    " Corp\r\n"
+    "PHOTO;ENCODING=BASE64;TYPE=JPEG:\r\n"
+    " /9j/4AAQSkZJRgABAQEASABIAAD\r\n"
+    " /2wBDAAMCAgICAgMCAgIDAwMDBAY\r\n"
+    "\r\n"
+    "email;internet:john@example.com\r\n"
+    "END:VCARD\r\n" );
+
+void CTCapsTableTest::testParse11()
+{
+    CTCapsTable table;
+    QVERIFY( table.isEmpty() );
+    QVERIFY( table.hasProperty( "PHOTO" ) );
+
+    QVERIFY( table.parse( CTCAPS11, "text/x-vcard" ) );
+    QVERIFY( !table.isEmpty() );
+    QVERIFY( table.hasProperty( "N" ) );
+    QVERIFY( table.hasProperty( "tel" ) );
+    QVERIFY( !table.hasProperty( "PHOTO" ) );
+    QVERIFY( !table.hasProperty( "SUMMARY" ) );
+    QVERIFY( table.hasParameter( "TEL", "CELL" ) );
+    QVERIFY( !table.hasParameter( "TEL", "PAGER" ) );
+    QVERIFY( !table.hasParameter( "N", "HOME" ) );
+    QVERIFY( !table.hasParameter( "VERSION", "2.1" ) );
+    QCOMPARE( table.maxSize( "NOTE" ), 256 );
+    QCOMPARE( table.maxSize( "N" ), 0 );
+
+    QVERIFY( table.parse( CTCAPS11, "text/x-vcalendar" ) );
+    QVERIFY( table.hasProperty( "SUMMARY" ) );
+    QVERIFY( !table.hasProperty( "N" ) );
+
+    QVERIFY( table.parse( CTCAPS11, "" ) );
+    QVERIFY( table.hasProperty( "SUMMARY" ) );
+    QVERIFY( table.hasProperty( "N" ) );
+
+    // Nothing known about the type
+    QVERIFY( table.parse( CTCAPS11, "text/calendar" ) );
+    QVERIFY( table.isEmpty() );
+}
+
+void CTCapsTableTest::testParse12()
+{
+    CTCapsTable table;
+
+    QVERIFY( table.parse( CTCAPS12, "text/x-vcard" ) );
+    QCOMPARE( table.iProperties.count(), 3 );
+    QVERIFY( table.hasProperty( "TEL" ) );
+    QVERIFY( !table.hasProperty( "FN" ) );
+    QVERIFY( table.hasParameter( "TEL", "TYPE" ) );
+    QVERIFY( table.hasParameter( "TEL", "HOME" ) );
+    QVERIFY( !table.hasParameter( "TEL", "WORK" ) );
+    QCOMPARE( table.maxSize( "N" ), 64 );
+    QCOMPARE( table.maxSize( "PHOTO" ), 16384 );
+
+    QVERIFY( table.parse( CTCAPS12, "text/vcard" ) );
+    QCOMPARE( table.iProperties.count(), 1 );
+    QVERIFY( table.hasProperty( "FN" ) );
+}
+
+void CTCapsTableTest::testInvalid()
+{
+    CTCapsTable table;
+
+    QVERIFY( table.parse( CTCAPS11, "text/x-vcard" ) );
+    QVERIFY( !table.parse( "<CTCap><CTType>text/x-vcard</CTType><PropName>N</CTCap>", "text/x-vcard" ) );
+    QVERIFY( table.isEmpty() );
+
+    QVERIFY( !table.load( "/nonexistent/ctcaps.xml", "text/x-vcard" ) );
+    QVERIFY( table.isEmpty() );
+}
+
+void CTCapsTableTest::testPrune()
+{
+    CTCapsTable table;
+
+    // Nothing is left out without capabilities
+    QCOMPARE( table.prune( VCARD ), VCARD );
+
+    QVERIFY( table.parse( CTCAPS11, "text/x-vcard" ) );
+
+    QByteArray expected(
+        "BEGIN:VCARD\r\n"
+        "VERSION:2.1\r\n"
+        "N:Doe;John;;;\r\n"
+        "item1.TEL;CELL:+358401234567\r\n"
+        "NOTE;ENCODING=QUOTED-PRINTABLE:first line=0D=0A=\r\n"
+        "second line\r\n"
+        "\r\n"
+        "email;internet:john@example.com\r\n"
+        "END:VCARD\r\n" );
+
+    QCOMPARE( table.prune( VCARD ), expected );
+
+    // Line feeds without carriage returns
+    QByteArray vcard = VCARD;
+    vcard.replace( "\r\n", "\n" );
+    expected.replace( "\r\n", "\n" );
+    QCOMPARE( table.prune( vcard ), expected );
+}
+
+void CTCapsTableTest::testPruneTimezone()
+{
+    CTCapsTable table;
+    QVERIFY( table.parse( "<CTCap><CTType>text/calendar</CTType>"
+                          "<PropName>SUMMARY</PropName><PropName>DTSTART</PropName>"
+                          "</CTCap>", "text/calendar" ) );
+
+    QByteArray ical(
+        "BEGIN:VCALENDAR\r\n"
+        "PRODID:-//K Desktop Environment//NONSGML libkcal 4.3//EN\r\n"
+        "VERSION:2.0\r\n"
+        "BEGIN:VTIMEZONE\r\n"
+        "TZID:Europe/Helsinki\r\n"
+        "BEGIN:STANDARD\r\n"
+        "TZOFFSETFROM:+0300\r\n"
+        "TZOFFSETTO:+0200\r\n"
+        "DTSTART:19701025T040000\r\n"
+        "END:STANDARD\r\n"
+        "END:VTIMEZONE\r\n"
+        "BEGIN:VEVENT\r\n"
+        "DTSTART;TZID=Europe/Helsinki:20261019T100000\r\n"
+        "LOCATION:Office\r\n"
+        "SUMMARY:Meeting\r\n"
+        "END:VEVENT\r\n"
+        "END:VCALENDAR\r\n" );
+
+    QByteArray expected = ical;
+    expected.replace( "PRODID:-//K Desktop Environment//NONSGML libkcal 4.3//EN\r\n", "" );
+    expected.replace( "LOCATION:Office\r\n", "" );
+
+    QCOMPARE( table.prune( ical ), expected );
+}
+
+void CTCapsTableTest::testKey()
+{
+    CTCapsTable table;
+    QVERIFY( table.key().isEmpty() );
+
+    QVERIFY( table.parse( "<CTCap><CTType>text/x-vcard</CTType>"
+                          "<PropName>TEL</PropName><ParamName>HOME</ParamName><ParamName>CELL</ParamName>"
+                          "<PropName>N</PropName><Size>10</Size>"
+                          "</CTCap>", "text/x-vcard" ) );
+    QByteArray key = table.key();
+    QCOMPARE( key, QByteArray( "N:10\nTEL:0;CELL;HOME\n" ) );
+
+    // Same capabilities in a different order and format
+    QVERIFY( table.parse( "<CTCap><CTType>text/x-vcard</CTType>"
+                          "<Property><PropName>N</PropName><MaxSize>10</MaxSize></Property>"
+                          "<Property><PropName>TEL</PropName>"
+                          "<PropParam><ParamName>CELL</ParamName></PropParam>"
+                          "<PropParam><ParamName>HOME</ParamName></PropParam>"
+                          "</Property>"
+                          "</CTCap>", "text/x-vcard" ) );
+    QCOMPARE( table.key(), key );
+}
+
+void CTCapsTableTest::benchmarkPrune()
+{
+    // A contact with the details a phone address book typically has, sent
+    // to the feature phone of CTCAPS11 and the server of CTCAPS12
+    QByteArray photo;
+    for( int i = 0; i < 100; ++i ) {
+        photo += " /9j/4AAQSkZJRgABAQEASABIAAD/2wBDAAMCAgICAgMCAgIDAwMDBAYEBAQEBAgGBgUG\r\n";
+    }
+
+    QByteArray vcard(
+        "BEGIN:VCARD\r\n"
+        "VERSION:2.1\r\n"
+        "N:Doe;John;;;\r\n"
+        "FN:John Doe\r\n"
+        "TEL;CELL:+358401234567\r\n"
+        "TEL;WORK:+358901234567\r\n"
+        "EMAIL;INTERNET:john@example.com\r\n"
+        "ADR;HOME:;;Street 1;Helsinki;;00100;Finland\r\n"
+        "ORG:Acme Corp\r\n"
+        "TITLE:Engineer\r\n"
+        "BDAY:1980-01-01\r\n"
+        "NOTE:Met at the conference\r\n"
+        "X-NICKNAME:Johnny\r\n"
+        "X-JABBER:john@example.com\r\n"
+        "X-GENDER:Male\r\n"
+        "REV:20261019T100000Z\r\n"
+        "PHOTO;ENCODING=BASE64;TYPE=JPEG:\r\n" + photo +
+        "\r\n"
+        "END:VCARD\r\n" );
+
+    CTCapsTable phone;
+    QVERIFY( phone.parse( CTCAPS11, "text/x-vcard" ) );
+    CTCapsTable server;
+    QVERIFY( server.parse( CTCAPS12, "text/x-vcard" ) );
+
+    QByteArray prunedPhone;
+    QByteArray prunedServer;
+
+    QBENCHMARK {
+        prunedPhone = phone.prune( vcard );
+        prunedServer = server.prune( vcard );
+    }
+
+    QVERIFY( prunedPhone.size() < vcard.size() );
+    QVERIFY( prunedServer.size() < vcard.size() );
+    QVERIFY( !prunedPhone.contains( "PHOTO" ) );
+    QVERIFY( prunedServer.contains( "PHOTO" ) );
+
+    qDebug() << "vCard of" << vcard.size() << "bytes pruned to" << prunedPhone.size()
+             << "bytes for the phone and" << prunedServer.size() << "bytes for the server";
+}
@@ -0,0 +1,147 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+
+#include "ContentKeyTest.h"
+
+// vCard 3.0 as exported from the local contacts
+static const char LOCAL_CONTACT[] =
+    "BEGIN:VCARD\r\n"
+    "VERSION:3.0\r\n"
+    "UID:42\r\n"
+    "N:Doe;J\xc3\xb6hn;;;\r\n"
+    "FN:J\xc3\xb6hn Doe\r\n"
+    "TEL;TYPE=CELL,PREF:+358 40 123-4567\r\n"
+    "EMAIL:John.Doe@example.com\r\n"
+    "NOTE:Met at the conference\\, in the lob\r\n"
+    " by\\nCall back later\r\n"
+    "PHOTO;ENCODING=b;TYPE=JPEG:/9j/4AAQSkZJRgAB\r\n"
+    " AQEASABIAAD/\r\n"
+    "X-QTPROJECT-FAVORITE:false;0\r\n"
+    "REV:2026-10-19T10:00:00Z\r\n"
+    "END:VCARD\r\n";
+
+// The same contact as vCard 2.1 from the server
+static const char SERVER_CONTACT[] =
+    "BEGIN:VCARD\n"
+    "VERSION:2.1\n"
+    "TEL;PREF;CELL:+358401234567\n"
+    "FN;CHARSET=ISO-8859-1;ENCODING=QUOTED-PRINTABLE:J=F6hn Doe\n"
+    "item1.EMAIL:john.doe@example.com\n"
+    "N;CHARSET=UTF-8;ENCODING=QUOTED-PRINTABLE:Doe;J=C3=B6hn\n"
+    "NOTE;ENCODING=QUOTED-PRINTABLE:Met at the conference, in=\n"
+    " the lobby=0D=0ACall back later\n"
+    "PHOTO;TYPE=JPEG;ENCODING=BASE64:\n"
+    "    /9j/4AAQSkZJRgABAQEASABIAAD/\n"
+    "\n"
+    "END:VCARD\n";
+
+static const char LOCAL_EVENT[] =
+    "BEGIN:VCALENDAR\r\n"
+    "PRODID:-//Local//Calendar//EN\r\n"
+    "VERSION:2.0\r\n"
+    "BEGIN:VEVENT\r\n"
+    "UID:1234@local\r\n"
+    "DTSTAMP:20261019T100000Z\r\n"
+    "CREATED:20261001T080000Z\r\n"
+    "SUMMARY:Project meeting\r\n"
+    "DTSTART:20261020T090000Z\r\n"
+    "DTEND:20261020T100000Z\r\n"
+    "BEGIN:VALARM\r\n"
+    "ACTION:DISPLAY\r\n"
+    "TRIGGER:-PT15M\r\n"
+    "END:VALARM\r\n"
+    "END:VEVENT\r\n"
+    "END:VCALENDAR\r\n";
+
+static const char SERVER_EVENT[] =
+    "BEGIN:VCALENDAR\n"
+    "VERSION:2.0\n"
+    "PRODID:-//Server//Calendar//EN\n"
+    "BEGIN:VEVENT\n"
+    "DTEND:20261020T100000Z\n"
+    "BEGIN:VALARM\n"
+    "TRIGGER:-PT15M\n"
+    "ACTION:DISPLAY\n"
+    "END:VALARM\n"
+    "DTSTART:20261020T090000Z\n"
+    "SUMMARY:Project \n"
+    " meeting\n"
+    "UID:5678@server\n"
+    "END:VEVENT\n"
+    "END:VCALENDAR\n";
+
+void ContentKeyTest::testContact()
+{
+    QCOMPARE( ContentKey::key( SERVER_CONTACT ), ContentKey::key( LOCAL_CONTACT ) );
+}
+
+void ContentKeyTest::testContactChanged()
+{
+    QByteArray local( LOCAL_CONTACT );
+    QByteArray key = ContentKey::key( local );
+
+    QByteArray number = local;
+    number.replace( "123-4567", "123-4568" );
+    QVERIFY( ContentKey::key( number ) != key );
+
+    QByteArray type = local;
+    type.replace( "TYPE=CELL,PREF", "TYPE=HOME" );
+    QVERIFY( ContentKey::key( type ) != key );
+
+    QByteArray name = local;
+    name.replace( "N:Doe;J\xc3\xb6hn;;;", "N:Doe;;J\xc3\xb6hn;;" );
+    QVERIFY( ContentKey::key( name ) != key );
+
+    QByteArray photo = local;
+    photo.replace( "AQEASABIAAD/", "AQEASABIAAE/" );
+    QVERIFY( ContentKey::key( photo ) != key );
+
+    // Timestamps and extension properties are not content
+    QByteArray revised = local;
+    revised.replace( "REV:2026-10-19T10:00:00Z", "REV:2026-10-20T10:00:00Z" );
+    revised.replace( "X-QTPROJECT-FAVORITE:false;0", "X-QTPROJECT-FAVORITE:true;0" );
+    QCOMPARE( ContentKey::key( revised ), key );
+}
+
+void ContentKeyTest::testIncidence()
+{
+    QCOMPARE( ContentKey::key( SERVER_EVENT ), ContentKey::key( LOCAL_EVENT ) );
+}
+
+void ContentKeyTest::testIncidenceChanged()
+{
+    QByteArray local( LOCAL_EVENT );
+    QByteArray key = ContentKey::key( local );
+
+    QByteArray start = local;
+    start.replace( "DTSTART:20261020T090000Z", "DTSTART:20261020T083000Z" );
+    QVERIFY( ContentKey::key( start ) != key );
+
+    // The alarm belongs to the event, not to the calendar
+    QByteArray alarm = local;
+    alarm.replace( "TRIGGER:-PT15M\r\nEND:VALARM\r\nEND:VEVENT\r\n",
+                   "END:VALARM\r\nEND:VEVENT\r\nTRIGGER:-PT15M\r\n" );
+    QVERIFY( ContentKey::key( alarm ) != key );
+}
+
+void ContentKeyTest::testText()
+{
+    QCOMPARE( ContentKey::key( "Buy milk\r\nand bread\r\n" ), ContentKey::key( "Buy milk\nand bread" ) );
+    QVERIFY( ContentKey::key( "Buy milk\nand bread" ) != ContentKey::key( "Buy milk and bread" ) );
+}
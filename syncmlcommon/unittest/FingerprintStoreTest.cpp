@@ -0,0 +1,138 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "FingerprintStoreTest.h"
+
+const QString TESTDBFILE( "fingerprints.db" );
+const QString TESTSTORAGE( "storage" );
+
+const QByteArray TESTVCARD( "BEGIN:VCARD\r\nVERSION:2.1\r\nN:Doe;John\r\nREV:20100101T120000Z\r\nEND:VCARD\r\n" );
+
+void FingerprintStoreTest::initTestCase()
+{
+    QFile::remove( TESTDBFILE );
+}
+
+void FingerprintStoreTest::cleanupTestCase()
+{
+    QFile::remove( TESTDBFILE );
+}
+
+void FingerprintStoreTest::testFingerprint()
+{
+    QByteArray fingerprint = FingerprintStore::fingerprint( TESTVCARD );
+    QVERIFY( !fingerprint.isEmpty() );
+
+    // Line endings, folding and revision stamps don't matter
+    QCOMPARE( FingerprintStore::fingerprint( "BEGIN:VCARD\nVERSION:2.1\nN:Doe;John\nEND:VCARD\n" ), fingerprint );
+    QCOMPARE( FingerprintStore::fingerprint( "BEGIN:VCARD\r\nVERSION:2.1\r\nN:Doe;\r\n John\r\nEND:VCARD" ), fingerprint );
+    QCOMPARE( FingerprintStore::fingerprint( "BEGIN:VCARD\r\nVERSION:2.1\r\nN:Doe;John\r\nREV:20200101T120000Z\r\nEND:VCARD\r\n" ), fingerprint );
+
+    // Content does
+    QVERIFY( FingerprintStore::fingerprint( "BEGIN:VCARD\r\nVERSION:2.1\r\nN:Doe;Jane\r\nEND:VCARD\r\n" ) != fingerprint );
+    QVERIFY( FingerprintStore::fingerprint( "BEGIN:VCARD\r\nVERSION:2.1\r\nN:Doe;John\r\nTEL:1\r\nEND:VCARD\r\n" ) != fingerprint );
+}
+
+void FingerprintStoreTest::testMatches()
+{
+    FingerprintStore store;
+    QVERIFY( store.init( TESTDBFILE, TESTSTORAGE ) );
+
+    QDateTime revision = QDateTime::fromSecsSinceEpoch( 1000 );
+
+    QVERIFY( !store.matches( "1", TESTVCARD, revision ) );
+
+    store.update( "1", TESTVCARD, revision );
+    QVERIFY( store.matches( "1", TESTVCARD, revision ) );
+    QVERIFY( store.matches( "1", TESTVCARD, revision.addMSecs( 500 ) ) );
+
+    // Modified locally since the payload was recorded
+    QVERIFY( !store.matches( "1", TESTVCARD, revision.addSecs( 1 ) ) );
+    QVERIFY( !store.matches( "1", TESTVCARD, QDateTime() ) );
+
+    QVERIFY( !store.matches( "1", "BEGIN:VCARD\r\nN:Other\r\nEND:VCARD\r\n", revision ) );
+    QVERIFY( !store.matches( "2", TESTVCARD, revision ) );
+
+    store.remove( "1" );
+    QVERIFY( !store.matches( "1", TESTVCARD, revision ) );
+
+    store.uninit();
+}
+
+void FingerprintStoreTest::testPersistence()
+{
+    QDateTime revision = QDateTime::fromSecsSinceEpoch( 2000 );
+
+    {
+        FingerprintStore store;
+        QVERIFY( store.init( TESTDBFILE, TESTSTORAGE ) );
+        store.update( "3", TESTVCARD, revision );
+        store.update( "4", TESTVCARD, revision );
+        store.uninit();
+    }
+
+    {
+        FingerprintStore store;
+        QVERIFY( store.init( TESTDBFILE, TESTSTORAGE ) );
+        QVERIFY( store.matches( "3", TESTVCARD, revision ) );
+        QVERIFY( store.matches( "4", TESTVCARD, revision ) );
+        QVERIFY( !store.matches( "1", TESTVCARD, QDateTime::fromSecsSinceEpoch( 1000 ) ) );
+        store.remove( "4" );
+    }
+
+    {
+        FingerprintStore store;
+        QVERIFY( store.init( TESTDBFILE, TESTSTORAGE ) );
+        QVERIFY( store.matches( "3", TESTVCARD, revision ) );
+        QVERIFY( !store.matches( "4", TESTVCARD, revision ) );
+
+        FingerprintStore otherStorage;
+        QVERIFY( otherStorage.init( TESTDBFILE, "other" ) );
+        QVERIFY( !otherStorage.matches( "3", TESTVCARD, revision ) );
+    }
+}
+
+void FingerprintStoreTest::testFlush()
+{
+    QDateTime revision = QDateTime::fromSecsSinceEpoch( 3000 );
+
+    FingerprintStore store;
+    QVERIFY( store.init( TESTDBFILE, TESTSTORAGE ) );
+    store.update( "5", TESTVCARD, revision );
+    QVERIFY( store.flush() );
+
+    // Written while the store stays in use
+    {
+        FingerprintStore reader;
+        QVERIFY( reader.init( TESTDBFILE, TESTSTORAGE ) );
+        QVERIFY( reader.matches( "5", TESTVCARD, revision ) );
+    }
+
+    QVERIFY( store.matches( "5", TESTVCARD, revision ) );
+    store.remove( "5" );
+    QVERIFY( store.flush() );
+    QVERIFY( store.flush() );
+
+    {
+        FingerprintStore reader;
+        QVERIFY( reader.init( TESTDBFILE, TESTSTORAGE ) );
+        QVERIFY( !reader.matches( "5", TESTVCARD, revision ) );
+    }
+
+    store.uninit();
+}
@@ -0,0 +1,252 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "IncidenceIdQueryTest.h"
+
+const QString TESTDBFILE( "incidenceids.db" );
+const QString TESTCONNECTION( "incidenceidstest" );
+const QString TESTNOTEBOOK( "notebook" );
+
+void IncidenceIdQueryTest::initTestCase()
+{
+    QFile::remove( TESTDBFILE );
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", TESTCONNECTION );
+        db.setDatabaseName( TESTDBFILE );
+        QVERIFY( db.open() );
+
+        // Subset of the mKCal Components, Recursive and Rdates tables
+        QSqlQuery query( db );
+        QVERIFY( query.exec( "CREATE TABLE Components (ComponentId INTEGER PRIMARY KEY, "
+                             "Notebook TEXT, Type TEXT, UID TEXT, RecurId INTEGER, "
+                             "RecurIdLocal INTEGER, RecurIdTimeZone TEXT, DateCreated INTEGER, "
+                             "DateLastModified INTEGER, DateDeleted INTEGER, "
+                             "DateStart INTEGER DEFAULT 0, DateEndDue INTEGER DEFAULT 0)" ) );
+        QVERIFY( query.exec( "CREATE TABLE Recursive (ComponentId INTEGER, RuleType INTEGER, Rule TEXT)" ) );
+        QVERIFY( query.exec( "CREATE TABLE Rdates (ComponentId INTEGER, Type INTEGER, Date INTEGER)" ) );
+    }
+
+    addComponent( "event-old", "Event", 100, 100, 0 );
+    addComponent( "event-new", "Event", 300, 300, 0 );
+    addComponent( "todo-modified", "Todo", 100, 300, 0 );
+    addComponent( "event-deleted", "Event", 100, 100, 300 );
+    addComponent( "journal-new", "Journal", 300, 300, 0 );
+    addComponent( "event-recurring", "Event", 100, 100, 0, 1262347200 );
+
+    iQuery = new IncidenceIdQuery();
+}
+
+void IncidenceIdQueryTest::cleanupTestCase()
+{
+    delete iQuery;
+    iQuery = 0;
+
+    QSqlDatabase::removeDatabase( TESTCONNECTION );
+    QFile::remove( TESTDBFILE );
+}
+
+void IncidenceIdQueryTest::testInit()
+{
+    QCOMPARE( iQuery->iDb.isOpen(), false );
+    QVERIFY( iQuery->init( TESTDBFILE ) );
+    QCOMPARE( iQuery->iDb.isOpen(), true );
+    QCOMPARE( iQuery->iDb.databaseName(), TESTDBFILE );
+}
+
+void IncidenceIdQueryTest::testAllIds()
+{
+    QList<IncidenceId> ids;
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, TESTNOTEBOOK,
+                               QStringList(), QDateTime(), ids ) );
+    QCOMPARE( ids.count(), 5 );
+
+    ids.clear();
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, TESTNOTEBOOK,
+                               QStringList( "Journal" ), QDateTime(), ids ) );
+    QCOMPARE( ids.count(), 1 );
+    QCOMPARE( ids.first().iUid, QString( "journal-new" ) );
+    QCOMPARE( ids.first().iType, QString( "Journal" ) );
+
+    ids.clear();
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, "other",
+                               QStringList(), QDateTime(), ids ) );
+    QCOMPARE( ids.count(), 0 );
+}
+
+void IncidenceIdQueryTest::testChangedIds()
+{
+    QDateTime time = QDateTime::fromSecsSinceEpoch( 200, Qt::UTC );
+    QStringList types;
+    types << "Event" << "Todo";
+
+    QList<IncidenceId> ids;
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::NEW_INCIDENCES, TESTNOTEBOOK, types, time, ids ) );
+    QCOMPARE( ids.count(), 1 );
+    QCOMPARE( ids.first().iUid, QString( "event-new" ) );
+
+    ids.clear();
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::MODIFIED_INCIDENCES, TESTNOTEBOOK, types, time, ids ) );
+    QCOMPARE( ids.count(), 1 );
+    QCOMPARE( ids.first().iUid, QString( "todo-modified" ) );
+
+    ids.clear();
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::DELETED_INCIDENCES, TESTNOTEBOOK, types, time, ids ) );
+    QCOMPARE( ids.count(), 1 );
+    QCOMPARE( ids.first().iUid, QString( "event-deleted" ) );
+}
+
+void IncidenceIdQueryTest::testWindow()
+{
+    const QString notebook( "windowed" );
+
+    addDatedComponent( "before", 100, 200, false );
+    addDatedComponent( "overlapping-start", 900, 1100, false );
+    addDatedComponent( "inside", 1200, 1300, false );
+    addDatedComponent( "no-end", 1500, 0, false );
+    addDatedComponent( "after", 3000, 3100, false );
+    addDatedComponent( "undated", 0, 0, false );
+    addDatedComponent( "recurring-before", 100, 200, true );
+
+    QDateTime windowStart = QDateTime::fromSecsSinceEpoch( 1000, Qt::UTC );
+    QDateTime windowEnd = QDateTime::fromSecsSinceEpoch( 2000, Qt::UTC );
+
+    QList<IncidenceId> ids;
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, notebook, QStringList(),
+                               QDateTime(), ids, windowStart, windowEnd ) );
+
+    QStringList uids;
+    foreach( const IncidenceId& id, ids ) {
+        uids.append( id.iUid );
+        QCOMPARE( id.iRecurs, id.iUid == QString( "recurring-before" ) );
+    }
+    uids.sort();
+
+    QCOMPARE( uids, QStringList() << "inside" << "no-end" << "overlapping-start"
+                                  << "recurring-before" << "undated" );
+
+    // Without a window everything is returned
+    ids.clear();
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, notebook, QStringList(),
+                               QDateTime(), ids ) );
+    QCOMPARE( ids.count(), 7 );
+}
+
+void IncidenceIdQueryTest::testRecurrenceId()
+{
+    QList<IncidenceId> ids;
+    QVERIFY( iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, TESTNOTEBOOK,
+                               QStringList( "Event" ), QDateTime(), ids ) );
+
+    bool found = false;
+    foreach( const IncidenceId& id, ids ) {
+        if( id.iUid == "event-recurring" ) {
+            found = true;
+            QCOMPARE( id.iRecurrenceId.toUTC(), QDateTime( QDate( 2010, 1, 1 ), QTime( 12, 0 ), Qt::UTC ) );
+        }
+        else {
+            QVERIFY( !id.iRecurrenceId.isValid() );
+        }
+    }
+    QVERIFY( found );
+
+    iQuery->uninit();
+    QCOMPARE( iQuery->iDb.isOpen(), false );
+}
+
+void IncidenceIdQueryTest::addComponent( const QString& aUid, const QString& aType, qint64 aCreated,
+                                         qint64 aModified, qint64 aDeleted, qint64 aRecurId )
+{
+    QSqlQuery query( QSqlDatabase::database( TESTCONNECTION ) );
+    query.prepare( "INSERT INTO Components (Notebook, Type, UID, RecurId, RecurIdLocal, "
+                   "RecurIdTimeZone, DateCreated, DateLastModified, DateDeleted) "
+                   "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?)" );
+    query.addBindValue( TESTNOTEBOOK );
+    query.addBindValue( aType );
+    query.addBindValue( aUid );
+    query.addBindValue( aRecurId );
+    query.addBindValue( aRecurId );
+    query.addBindValue( aRecurId ? QString( "UTC" ) : QString() );
+    query.addBindValue( aCreated );
+    query.addBindValue( aModified );
+    query.addBindValue( aDeleted );
+    QVERIFY( query.exec() );
+}
+
+void IncidenceIdQueryTest::addDatedComponent( const QString& aUid, qint64 aStart, qint64 aEnd, bool aRecurs )
+{
+    QSqlQuery query( QSqlDatabase::database( TESTCONNECTION ) );
+    query.prepare( "INSERT INTO Components (Notebook, Type, UID, RecurId, RecurIdLocal, "
+                   "DateCreated, DateLastModified, DateDeleted, DateStart, DateEndDue) "
+                   "VALUES ('windowed', 'Event', ?, 0, 0, 100, 100, 0, ?, ?)" );
+    query.addBindValue( aUid );
+    query.addBindValue( aStart );
+    query.addBindValue( aEnd );
+    QVERIFY( query.exec() );
+
+    if( aRecurs ) {
+        QVERIFY( query.exec( "INSERT INTO Recursive (ComponentId, RuleType, Rule) VALUES (" +
+                             query.lastInsertId().toString() + ", 1, 'FREQ=DAILY')" ) );
+    }
+}
+
+void IncidenceIdQueryTest::testSchema()
+{
+    const QString dbFile( "incidenceids-schema.db" );
+    QFile::remove( dbFile );
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase( "QSQLITE", "incidenceidsschema" );
+        db.setDatabaseName( dbFile );
+        QVERIFY( db.open() );
+
+        // Components without the local recurrence id column
+        QSqlQuery query( db );
+        QVERIFY( query.exec( "CREATE TABLE Components (ComponentId INTEGER PRIMARY KEY, "
+                             "Notebook TEXT, Type TEXT, UID TEXT, RecurId INTEGER, "
+                             "RecurIdTimeZone TEXT, DateCreated INTEGER, "
+                             "DateLastModified INTEGER, DateDeleted INTEGER, "
+                             "DateStart INTEGER, DateEndDue INTEGER)" ) );
+        QVERIFY( query.exec( "CREATE TABLE Recursive (ComponentId INTEGER, RuleType INTEGER, Rule TEXT)" ) );
+        QVERIFY( query.exec( "CREATE TABLE Rdates (ComponentId INTEGER, Type INTEGER, Date INTEGER)" ) );
+    }
+    QSqlDatabase::removeDatabase( "incidenceidsschema" );
+
+    IncidenceIdQuery query;
+    QVERIFY( !query.init( dbFile ) );
+    QCOMPARE( query.iDb.isOpen(), false );
+    QVERIFY( query.iConnectionName.isEmpty() );
+
+    QFile::remove( dbFile );
+}
+
+void IncidenceIdQueryTest::testQueryFailure()
+{
+    QSqlQuery query( QSqlDatabase::database( TESTCONNECTION ) );
+    QVERIFY( query.exec( "ALTER TABLE Rdates RENAME TO RdatesRenamed" ) );
+
+    // Windowed queries read the Rdates table
+    QList<IncidenceId> ids;
+    ids.append( IncidenceId() );
+    QVERIFY( !iQuery->queryIds( IncidenceIdQuery::ALL_INCIDENCES, TESTNOTEBOOK, QStringList(),
+                                QDateTime(), ids, QDateTime::fromSecsSinceEpoch( 1000, Qt::UTC ),
+                                QDateTime::fromSecsSinceEpoch( 2000, Qt::UTC ) ) );
+    QCOMPARE( ids.count(), 1 );
+
+    QVERIFY( query.exec( "ALTER TABLE RdatesRenamed RENAME TO Rdates" ) );
+}
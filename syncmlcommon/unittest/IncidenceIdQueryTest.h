@@ -0,0 +1,50 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#ifndef INCIDENCEIDQUERYTEST_H_
+#define INCIDENCEIDQUERYTEST_H_
+
+#include <QObject>
+#include <QtTest/QtTest>
+
+#include "IncidenceIdQuery.h"
+
+class IncidenceIdQueryTest: public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void testInit();
+    void testAllIds();
+    void testChangedIds();
+    void testWindow();
+    void testRecurrenceId();
+    void testSchema();
+    void testQueryFailure();
+
+private:
+    void addComponent( const QString& aUid, const QString& aType, qint64 aCreated,
+                       qint64 aModified, qint64 aDeleted, qint64 aRecurId = 0 );
+
+    void addDatedComponent( const QString& aUid, qint64 aStart, qint64 aEnd, bool aRecurs );
+
+    IncidenceIdQuery *iQuery;
+};
+#endif /*INCIDENCEIDQUERYTEST_H_*/
@@ -71,6 +71,17 @@ void ItemIdMapperTest::testKeyValueAdd()
     QCOMPARE(iMapper->key("1234"), QString("1234"));
 }
 
+void ItemIdMapperTest::testClear()
+{
+    QCOMPARE(iMapper->value("key"), QString("1"));
+
+    // After clearing, old values are not mapped and numbering starts over
+    iMapper->clear();
+    QCOMPARE(iMapper->key("1"), QString("1"));
+    QCOMPARE(iMapper->value("other"), QString("1"));
+    QCOMPARE(iMapper->key("1"), QString("other"));
+}
+
 void ItemIdMapperTest::testUninit()
 {
 	QStringList list = iMapper->iDb.tables(QSql::Tables);
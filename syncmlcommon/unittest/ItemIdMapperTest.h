@@ -37,6 +37,7 @@ class ItemIdMapperTest: public QObject
 	void cleanupTestCase();
 	void testInit();
 	void testKeyValueAdd();
+	void testClear();
 	void testUninit();
 	
 	public:
@@ -0,0 +1,140 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "LinkEstimatorTest.h"
+
+const QString TESTDBFILE( "links.db" );
+const QString TESTLINK( "bt:00:11:22:33:44:55" );
+
+void LinkEstimatorTest::initTestCase()
+{
+    QFile::remove( TESTDBFILE );
+}
+
+void LinkEstimatorTest::cleanupTestCase()
+{
+    QFile::remove( TESTDBFILE );
+}
+
+void LinkEstimatorTest::testSampling()
+{
+    LinkEstimator estimator;
+    QVERIFY( estimator.init( "", TESTLINK ) );
+
+    QCOMPARE( estimator.roundTripTime(), qint64( 0 ) );
+    QCOMPARE( estimator.throughput(), qint64( 0 ) );
+
+    // Items sent in one message, served in two calls
+    estimator.begin();
+    estimator.end( 1000, 0 );
+    estimator.begin();
+    estimator.end( 1000, 0 );
+
+    QTest::qSleep( 100 );
+
+    // Items received in the reply
+    estimator.begin();
+    estimator.end( 0, 2000 );
+
+    // The round trip is counted once the reply has been handled
+    QCOMPARE( estimator.iSamples, 0 );
+
+    QTest::qSleep( 100 );
+
+    estimator.begin();
+    estimator.end( 0, 0 );
+
+    QCOMPARE( estimator.iSamples, 1 );
+    QVERIFY( estimator.roundTripTime() >= 100 );
+    QVERIFY( estimator.throughput() > 0 );
+    QVERIFY( estimator.throughput() <= 4000 * 1000 / 100 );
+
+    estimator.uninit();
+
+    // Nothing is measured when not initialized
+    estimator.begin();
+    estimator.end( 1000, 0 );
+    QCOMPARE( estimator.iSamples, 0 );
+}
+
+void LinkEstimatorTest::testMessageSize()
+{
+    LinkEstimator estimator;
+    QVERIFY( estimator.init( "", TESTLINK ) );
+
+    QCOMPARE( estimator.messageSize( 16384, 8192, 262144 ), qint64( 16384 ) );
+
+    // 100 kB/s with 100 ms round trips fits four round trips in a message
+    estimator.sample( 100, 10000 );
+    QCOMPARE( estimator.roundTripTime(), qint64( 100 ) );
+    QCOMPARE( estimator.throughput(), qint64( 100000 ) );
+    QCOMPARE( estimator.messageSize( 16384, 8192, 262144 ), qint64( 40000 ) );
+
+    // Round trips dominated by transfer don't raise the latency
+    estimator.sample( 500, 10000 );
+    QCOMPARE( estimator.roundTripTime(), qint64( 100 ) );
+    QCOMPARE( estimator.throughput(), qint64( 100000 ) );
+
+    // Fast links are limited by the largest size
+    estimator.sample( 100, 1000000 );
+    QCOMPARE( estimator.messageSize( 16384, 8192, 262144 ), qint64( 262144 ) );
+
+    estimator.uninit();
+
+    // Slow links by the transfer time, and then by the smallest size
+    QVERIFY( estimator.init( "", TESTLINK ) );
+    estimator.sample( 2000, 4000 );
+    QCOMPARE( estimator.messageSize( 16384, 1024, 262144 ), qint64( 10000 ) );
+    QCOMPARE( estimator.messageSize( 16384, 16384, 262144 ), qint64( 16384 ) );
+    estimator.uninit();
+}
+
+void LinkEstimatorTest::testPersistence()
+{
+    {
+        LinkEstimator estimator;
+        QVERIFY( estimator.init( TESTDBFILE, TESTLINK ) );
+        estimator.sample( 200, 20000 );
+        estimator.uninit();
+    }
+
+    {
+        LinkEstimator estimator;
+        QVERIFY( estimator.init( TESTDBFILE, TESTLINK ) );
+        QCOMPARE( estimator.roundTripTime(), qint64( 200 ) );
+        QCOMPARE( estimator.throughput(), qint64( 100000 ) );
+
+        // Other links are estimated separately
+        LinkEstimator other;
+        QVERIFY( other.init( TESTDBFILE, "usb" ) );
+        QCOMPARE( other.roundTripTime(), qint64( 0 ) );
+        other.uninit();
+
+        estimator.sample( 100, 20000 );
+        estimator.uninit();
+    }
+
+    {
+        // Sessions are averaged
+        LinkEstimator estimator;
+        QVERIFY( estimator.init( TESTDBFILE, TESTLINK ) );
+        QCOMPARE( estimator.roundTripTime(), qint64( 150 ) );
+        QCOMPARE( estimator.throughput(), qint64( 150000 ) );
+        estimator.uninit();
+    }
+}
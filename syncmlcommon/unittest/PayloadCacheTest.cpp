@@ -0,0 +1,206 @@
+/*
+ * This file is part of buteo-sync-plugins package
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ *
+ */
+#include "PayloadCacheTest.h"
+
+
+const QString TESTDBFILE( "payloads.db" );
+const QString TESTSTORAGE( "storage" );
+const QString TESTFORMAT( "text/x-vcard 2.1" );
+const QByteArray TESTCAPS( "<CTCap/>" );
+const qint64 TESTMAXSIZE = 1000;
+
+void PayloadCacheTest::initTestCase()
+{
+    QFile::remove( TESTDBFILE );
+
+    iCache = new PayloadCache();
+}
+
+void PayloadCacheTest::cleanupTestCase()
+{
+    delete iCache;
+    iCache = 0;
+
+    QFile::remove( TESTDBFILE );
+}
+
+void PayloadCacheTest::testInit()
+{
+    QVERIFY( iCache->iConnectionName.isEmpty() );
+    QVERIFY( iCache->init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( !iCache->iConnectionName.isEmpty() );
+    QCOMPARE( iCache->iSize, qint64( 0 ) );
+
+    QVERIFY( iCache->iDb.isOpen() );
+    QVERIFY( iCache->iDb.tables().contains( "payloads" ) );
+}
+
+void PayloadCacheTest::testFetchStore()
+{
+    QDateTime revision = QDateTime::fromMSecsSinceEpoch( 1000 );
+    QByteArray data;
+
+    QVERIFY( !iCache->fetch( "1", revision, data ) );
+
+    iCache->store( "1", revision, "BEGIN:VCARD" );
+    QCOMPARE( iCache->iSize, qint64( 11 ) );
+    QVERIFY( iCache->fetch( "1", revision, data ) );
+    QCOMPARE( data, QByteArray( "BEGIN:VCARD" ) );
+
+    // A changed item must not be served from the cache
+    QVERIFY( !iCache->fetch( "1", revision.addSecs( 1 ), data ) );
+
+    // Storing a new revision replaces the old one
+    iCache->store( "1", revision.addSecs( 1 ), "BEGIN:VCARD2" );
+    QCOMPARE( iCache->iSize, qint64( 12 ) );
+    QVERIFY( !iCache->fetch( "1", revision, data ) );
+    QVERIFY( iCache->fetch( "1", revision.addSecs( 1 ), data ) );
+    QCOMPARE( data, QByteArray( "BEGIN:VCARD2" ) );
+
+    // Items without revision are never cached
+    iCache->store( "2", QDateTime(), "BEGIN:VCARD" );
+    QVERIFY( !iCache->fetch( "2", QDateTime(), data ) );
+}
+
+void PayloadCacheTest::testKeys()
+{
+    QDateTime revision = QDateTime::fromMSecsSinceEpoch( 2000 );
+    QByteArray data;
+
+    iCache->store( "3", revision, "BEGIN:VCARD" );
+    iCache->flush();
+
+    PayloadCache otherFormat;
+    QVERIFY( otherFormat.init( TESTDBFILE, TESTSTORAGE, "text/vcard 3.0", TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( !otherFormat.fetch( "3", revision, data ) );
+
+    PayloadCache otherCaps;
+    QVERIFY( otherCaps.init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, "<CTCap></CTCap>", TESTMAXSIZE ) );
+    QVERIFY( !otherCaps.fetch( "3", revision, data ) );
+
+    PayloadCache otherStorage;
+    QVERIFY( otherStorage.init( TESTDBFILE, "other", TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( !otherStorage.fetch( "3", revision, data ) );
+
+    PayloadCache sameKey;
+    QVERIFY( sameKey.init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( sameKey.fetch( "3", revision, data ) );
+    QCOMPARE( data, QByteArray( "BEGIN:VCARD" ) );
+}
+
+void PayloadCacheTest::testDigest()
+{
+    QDateTime revision = QDateTime::fromMSecsSinceEpoch( 6000 );
+    QByteArray data;
+
+    iCache->store( "11", revision, "BEGIN:VCARD", "first" );
+    QVERIFY( iCache->fetch( "11", revision, data, "first" ) );
+
+    // Changes within the same second keep the revision but not the content
+    QVERIFY( !iCache->fetch( "11", revision, data, "second" ) );
+    QVERIFY( !iCache->fetch( "11", revision, data ) );
+
+    iCache->flush();
+
+    PayloadCache other;
+    QVERIFY( other.init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( other.fetch( "11", revision, data, "first" ) );
+    QVERIFY( !other.fetch( "11", revision, data, "second" ) );
+    other.uninit();
+
+    iCache->remove( "11" );
+}
+
+void PayloadCacheTest::testRemove()
+{
+    QDateTime revision = QDateTime::fromMSecsSinceEpoch( 3000 );
+    QByteArray data;
+
+    iCache->store( "4", revision, "BEGIN:VCARD" );
+    qint64 size = iCache->iSize;
+
+    iCache->remove( "4" );
+    QCOMPARE( iCache->iSize, size - 11 );
+    QVERIFY( !iCache->fetch( "4", revision, data ) );
+}
+
+void PayloadCacheTest::testFlush()
+{
+    QDateTime revision = QDateTime::fromMSecsSinceEpoch( 5000 );
+    QByteArray data;
+
+    // Stored payloads are served from memory until flushed
+    iCache->store( "10", revision, "BEGIN:VCARD" );
+    QVERIFY( iCache->iPending.contains( "10" ) );
+    QVERIFY( iCache->fetch( "10", revision, data ) );
+
+    PayloadCache other;
+    QVERIFY( other.init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( !other.fetch( "10", revision, data ) );
+    other.uninit();
+
+    iCache->flush();
+    QVERIFY( iCache->iPending.isEmpty() );
+    QVERIFY( iCache->iUsed.isEmpty() );
+
+    QVERIFY( other.init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( other.fetch( "10", revision, data ) );
+    QCOMPARE( data, QByteArray( "BEGIN:VCARD" ) );
+
+    // Removals are written on flush as well
+    iCache->remove( "10" );
+    QVERIFY( !iCache->fetch( "10", revision, data ) );
+    iCache->flush();
+    other.uninit();
+
+    QVERIFY( other.init( TESTDBFILE, TESTSTORAGE, TESTFORMAT, TESTCAPS, TESTMAXSIZE ) );
+    QVERIFY( !other.fetch( "10", revision, data ) );
+    other.uninit();
+}
+
+void PayloadCacheTest::testEviction()
+{
+    QDateTime revision = QDateTime::fromMSecsSinceEpoch( 4000 );
+    QByteArray payload( 300, 'x' );
+    QByteArray data;
+
+    iCache->store( "5", revision, payload );
+    QTest::qWait( 5 );
+    iCache->store( "6", revision, payload );
+    QTest::qWait( 5 );
+
+    // Using an item makes it the most recently used one
+    QVERIFY( iCache->fetch( "5", revision, data ) );
+    QTest::qWait( 5 );
+
+    iCache->store( "7", revision, payload );
+    QTest::qWait( 5 );
+    iCache->store( "8", revision, payload );
+
+    QVERIFY( iCache->iSize <= TESTMAXSIZE );
+    QVERIFY( !iCache->fetch( "6", revision, data ) );
+    QVERIFY( iCache->fetch( "8", revision, data ) );
+
+    // Payloads larger than the whole cache are not stored
+    iCache->store( "9", revision, QByteArray( TESTMAXSIZE + 1, 'x' ) );
+    QVERIFY( !iCache->fetch( "9", revision, data ) );
+
+    iCache->uninit();
+    QVERIFY( iCache->iConnectionName.isEmpty() );
+}
@@ -44,3 +44,38 @@ void SyncMLConfigTest::testXmldatabasePath()
 	//testing the function getXmlDataPath()
 	QVERIFY(iConfig->getXmlDataPath().contains("/etc/buteo/xml/"));
 }
+
+void SyncMLConfigTest::testFileContents()
+{
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	QString path = dir.path() + "/CTCaps_test.xml";
+
+	QVERIFY(iConfig->getFileContents(path).isEmpty());
+
+	QFile file(path);
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	file.write("<CTCap>first</CTCap>");
+	file.close();
+	QCOMPARE(iConfig->getFileContents(path), QByteArray("<CTCap>first</CTCap>"));
+
+	// Served from memory while the file is unchanged, read again once it changes
+	QCOMPARE(iConfig->getFileContents(path), QByteArray("<CTCap>first</CTCap>"));
+	QVERIFY(file.open(QIODevice::WriteOnly));
+	file.write("<CTCap>second one</CTCap>");
+	file.close();
+	QCOMPARE(iConfig->getFileContents(path), QByteArray("<CTCap>second one</CTCap>"));
+
+	QVERIFY(QFile::remove(path));
+	QVERIFY(iConfig->getFileContents(path).isEmpty());
+}
+
+void SyncMLConfigTest::testObexMtu()
+{
+	QCOMPARE(iConfig->getObexMtu(QString(), 4096), 4096);
+	QCOMPARE(iConfig->getObexMtu("8192", 4096), 8192);
+	QCOMPARE(iConfig->getObexMtu("abc", 4096), 4096);
+	QCOMPARE(iConfig->getObexMtu("0", 4096), 4096);
+	QCOMPARE(iConfig->getObexMtu("100", 4096), 255);
+	QCOMPARE(iConfig->getObexMtu("100000", 4096), 65535);
+}
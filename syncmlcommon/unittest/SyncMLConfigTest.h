@@ -35,6 +35,8 @@ class SyncMLConfigTest:public QObject
 	void initTestCase();
 	void cleanupTestCase();
 	void testXmldatabasePath();
+	void testFileContents();
+	void testObexMtu();
 	
 	public:
 	SyncMLConfig *iConfig;
@@ -29,6 +29,8 @@
 #endif
 #include <QDomDocument>
 
+#include "StorageReservations.h"
+
 #include <QtTest/QtTest>
 
 
@@ -109,6 +111,88 @@ void SyncMLStorageProviderTest :: testStorages()
     delete tempSyncMLStorageProvider;
 }
 
+void SyncMLStorageProviderTest :: testStoragePool()
+{
+    const QString profileXML =
+            " <profile name=\"syncml\" type=\"server\" > "
+                " <key name=\"Storage Pool Idle Time\" value=\"60\"/> "
+                " <profile name=\"hcontacts\" type=\"storage\" > "
+                        " <key name=\"enabled\" value=\"true\" /> "
+                        " <key name=\"Local URI\" value=\"./contacts\" /> "
+                        " <key name=\"Type\" value=\"text/x-vcard\" /> "
+                        " <key name=\"Version\" value=\"2.1\" /> "
+                "</profile>"
+             "</profile>";
+
+    QDomDocument doc;
+    QVERIFY(doc.setContent(profileXML, false));
+    Profile poolProfile(doc.documentElement());
+    poolProfile.setName("poolProfile");
+
+    SyncMLStorageProvider provider;
+    QVERIFY(provider.init(&poolProfile, iTempSyncPluginBase, iTempPluginCbInterface, true));
+
+    DataSync::StoragePlugin *storage = provider.acquireStorageByURI("./contacts");
+    QVERIFY(storage);
+    provider.releaseStorage(storage);
+    QCOMPARE(provider.iPool.count(), 1);
+    QVERIFY(provider.uninit());
+
+    // The next session gets the same storage back
+    QVERIFY(provider.init(&poolProfile, iTempSyncPluginBase, iTempPluginCbInterface, true));
+    DataSync::StoragePlugin *warmStorage = provider.acquireStorageByURI("./contacts");
+    QVERIFY(warmStorage == storage);
+    QCOMPARE(provider.iPool.count(), 0);
+    provider.releaseStorage(warmStorage);
+    QVERIFY(provider.uninit());
+
+    provider.releasePooledStorages();
+    QCOMPARE(provider.iPool.count(), 0);
+}
+
+void SyncMLStorageProviderTest :: testSharedReservations()
+{
+    const QString profileXML =
+            " <profile name=\"syncml\" type=\"server\" > "
+                " <profile name=\"hcontacts\" type=\"storage\" > "
+                        " <key name=\"enabled\" value=\"true\" /> "
+                        " <key name=\"Local URI\" value=\"./contacts\" /> "
+                        " <key name=\"Type\" value=\"text/x-vcard\" /> "
+                        " <key name=\"Version\" value=\"2.1\" /> "
+                "</profile>"
+             "</profile>";
+
+    QDomDocument doc;
+    QVERIFY(doc.setContent(profileXML, false));
+    Profile sharedProfile(doc.documentElement());
+    sharedProfile.setName("sharedProfile");
+
+    StorageReservations reservations;
+    SyncMLStorageProvider usbProvider;
+    SyncMLStorageProvider btProvider;
+    usbProvider.setReservations(&reservations);
+    btProvider.setReservations(&reservations);
+    QVERIFY(usbProvider.init(&sharedProfile, iTempSyncPluginBase, iTempPluginCbInterface, true));
+    QVERIFY(btProvider.init(&sharedProfile, iTempSyncPluginBase, iTempPluginCbInterface, true));
+
+    // The backend in use by one session is refused to the other
+    DataSync::StoragePlugin *usbStorage = usbProvider.acquireStorageByURI("./contacts");
+    QVERIFY(usbStorage);
+    QVERIFY(reservations.isReserved("hcontacts"));
+    QVERIFY(btProvider.acquireStorageByURI("./contacts") == 0);
+
+    usbProvider.releaseStorage(usbStorage);
+    QVERIFY(!reservations.isReserved("hcontacts"));
+
+    DataSync::StoragePlugin *btStorage = btProvider.acquireStorageByURI("./contacts");
+    QVERIFY(btStorage);
+    btProvider.releaseStorage(btStorage);
+    QVERIFY(!reservations.isReserved("hcontacts"));
+
+    QVERIFY(usbProvider.uninit());
+    QVERIFY(btProvider.uninit());
+}
+
 /* #####################################
    TempPluginCbInterface class functions
    #####################################
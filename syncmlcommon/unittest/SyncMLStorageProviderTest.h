@@ -44,6 +44,8 @@ private slots:
     void cleanupTestCase();
 
     void testStorages();
+    void testStoragePool();
+    void testSharedReservations();
 
 private:
     SyncMLStorageProvider *iSyncMLStorageProvider;
@@ -29,6 +29,13 @@
 #include "SyncMLStorageProviderTest.h"
 #include "FolderItemParserTest.h"
 #include "DeviceInfoTest.h"
+#include "IncidenceIdQueryTest.h"
+#include "PayloadCacheTest.h"
+#include "FingerprintStoreTest.h"
+#include "LinkEstimatorTest.h"
+#include "CTCapsTableTest.h"
+#include "Base64CodecTest.h"
+#include "ContentKeyTest.h"
 
 int main(int argc, char* argv[])
 {
@@ -40,6 +47,13 @@ int main(int argc, char* argv[])
 	Buteo::SyncMLStorageProviderTest storageTest;
 	FolderItemParserTest parserTest;
 	Buteo::DeviceInfoTest deviceInfoTest;
+	IncidenceIdQueryTest incidenceIdQueryTest;
+	PayloadCacheTest payloadCacheTest;
+	FingerprintStoreTest fingerprintStoreTest;
+	LinkEstimatorTest linkEstimatorTest;
+	CTCapsTableTest ctCapsTableTest;
+	Base64CodecTest base64CodecTest;
+	ContentKeyTest contentKeyTest;
 
 	if (QTest::qExec(&simpleItemTest, argc, argv))
 		return 1;
@@ -55,5 +69,19 @@ int main(int argc, char* argv[])
 		return 1;
 	if (QTest::qExec(&deviceInfoTest, argc, argv))
 		return 1;
+	if (QTest::qExec(&incidenceIdQueryTest, argc, argv))
+		return 1;
+	if (QTest::qExec(&payloadCacheTest, argc, argv))
+		return 1;
+	if (QTest::qExec(&fingerprintStoreTest, argc, argv))
+		return 1;
+	if (QTest::qExec(&linkEstimatorTest, argc, argv))
+		return 1;
+	if (QTest::qExec(&ctCapsTableTest, argc, argv))
+		return 1;
+	if (QTest::qExec(&base64CodecTest, argc, argv))
+		return 1;
+	if (QTest::qExec(&contentKeyTest, argc, argv))
+		return 1;
 	return 0;
 }
@@ -43,12 +43,28 @@ HEADERS += ItemAdapterTest.h \
            ../SyncMLConfig.h \
            SyncMLConfigTest.h \
            ../StorageAdapter.h \
+           ../PoolableStorage.h \
+           ../StorageReservations.h \
            ../SyncMLStorageProvider.h \
            SyncMLStorageProviderTest.h \
                FolderItemParserTest.h \
            ../FolderItemParser.h \
            DeviceInfoTest.h \
            ../DeviceInfo.h \
+           IncidenceIdQueryTest.h \
+           ../IncidenceIdQuery.h \
+           PayloadCacheTest.h \
+           ../PayloadCache.h \
+           FingerprintStoreTest.h \
+           ../FingerprintStore.h \
+           LinkEstimatorTest.h \
+           ../LinkEstimator.h \
+           CTCapsTableTest.h \
+           ../CTCapsTable.h \
+           Base64CodecTest.h \
+           ../Base64Codec.h \
+           ContentKeyTest.h \
+           ../ContentKey.h \
 
 
 SOURCES += main.cpp \
@@ -61,12 +77,28 @@ SOURCES += main.cpp \
            ../SyncMLConfig.cpp \
            SyncMLConfigTest.cpp \
            ../StorageAdapter.cpp \
+           ../PoolableStorage.cpp \
+           ../StorageReservations.cpp \
            ../SyncMLStorageProvider.cpp \
            SyncMLStorageProviderTest.cpp \
                FolderItemParserTest.cpp \
            ../FolderItemParser.cpp \
            DeviceInfoTest.cpp \
-           ../DeviceInfo.cpp
+           ../DeviceInfo.cpp \
+           IncidenceIdQueryTest.cpp \
+           ../IncidenceIdQuery.cpp \
+           PayloadCacheTest.cpp \
+           ../PayloadCache.cpp \
+           FingerprintStoreTest.cpp \
+           ../FingerprintStore.cpp \
+           LinkEstimatorTest.cpp \
+           ../LinkEstimator.cpp \
+           CTCapsTableTest.cpp \
+           ../CTCapsTable.cpp \
+           Base64CodecTest.cpp \
+           ../Base64Codec.cpp \
+           ContentKeyTest.cpp \
+           ../ContentKey.cpp
 
 
 QT += testlib sql xml